@@ -3,28 +3,27 @@
 // Single URL holder for dynamic changes
 static const char* dynamicURL[1] = { "" };
 
+AudioModule::AudioModule(WiFiModule* wifi)
+    : AudioModule(nullptr, nullptr) {
+    wifiMgr = wifi;
+}
+
 AudioModule::AudioModule(const char* ssid, const char* password) 
-    : wifiSSID(ssid), wifiPassword(password), playing(false), currentVolume(0.05),
-      sleepTimerActive(false), sleepEndTime(0), sleepFadeStart(0), sleepStartVolume(0) {
-    
-    urlStream = new URLStream(wifiSSID, wifiPassword);
-    source = new AudioSourceURL(*urlStream, dynamicURL, "audio/mp3");
-    i2s = new I2SStream();
-    decoder = new MP3DecoderHelix();
-    player = new AudioPlayer(*source, *i2s, *decoder);
+    : wifiMgr(nullptr), wifiSSID(ssid), wifiPassword(password), playing(false), currentVolume(0.05),
+      pendingVolume(0.05), volumePending(false), stateVersion(0),
+      stateStore("audio", AUDIO_STATE_SCHEMA), seenVersion(0), lastStateChange(0), stateDirty(false),
+      savedVolume(50), savedPlaying(false), resumePending(false), resumeTries(0), resumeAt(0),
+      sleepEndTime(0), sleepFadeStart(0), sleepStartVolume(0), sleepTimerActive(false),
+      fadingOut(false), released(false), fadeStart(0) {
+    memset(&streamStats, 0, sizeof(streamStats));
+    createPipeline();
 }
 
 bool AudioModule::begin() {
     Serial.println("Setting up audio...");
     
     // I2S setup (exactly as working example)
-    auto cfg = i2s->defaultConfig(TX_MODE);
-    cfg.pin_bck = I2S_BCLK_PIN;
-    cfg.pin_ws = I2S_LRCK_PIN;
-    cfg.pin_data = I2S_DATA_PIN;
-    cfg.channels = 2;
-    
-    if (!i2s->begin(cfg)) {
+    if (!i2s->begin(outputConfig())) {
         Serial.println("I2S init failed");
         return false;
     }
@@ -35,32 +34,80 @@ bool AudioModule::begin() {
         return false;
     }
     
-    // Start paused - wait for user to select a station
+    // Start paused; a stream that was playing at power-off is reopened
+    // from process() once the link is up
     playing = false;
+    loadState();
     player->setVolume(currentVolume);
+    seenVersion = stateVersion;
     
-    Serial.println("Audio ready (paused - select station to play)");
+    if (resumePending) {
+        Serial.print("Audio ready (resuming ");
+        Serial.print(resumeURL);
+        Serial.println(")");
+    } else {
+        Serial.println("Audio ready (paused - select station to play)");
+    }
     return true;
 }
 
 void AudioModule::process() {
-    if (playing) {
-        player->copy();
+    // An update is taking the pipeline
+    if (fadingOut) {
+        processFade();
+    }
+    
+    // Reopen the saved stream first thing; nothing else is playing yet
+    if (resumePending && !released && (long)(millis() - resumeAt) >= 0 &&
+        (wifiMgr == nullptr || wifiMgr->isConnected())) {
+        resume();
+    }
+    
+    // Apply only the latest volume requested since the last tick
+    if (volumePending) {
+        volumePending = false;
+        setVolume(pendingVolume);
+    }
+    
+    if (playing && !released) {
+        if (player->copy() > 0 && streamStats.firstAudioMs == 0) {
+            streamStats.firstAudioMs = millis();
+        }
     }
     
     // Handle sleep timer
     if (sleepTimerActive) {
         processSleepTimer();
     }
+    
+    // Save once changes settle
+    if (stateVersion != seenVersion) {
+        seenVersion = stateVersion;
+        lastStateChange = millis();
+        stateDirty = true;
+    }
+    if (stateDirty && millis() - lastStateChange >= AUDIO_STATE_DELAY) {
+        stateDirty = false;
+        saveState();
+    }
 }
 
 void AudioModule::play() {
+    // Booted paused, nothing is open: Tuner::play() tunes in the saved
+    // stream rather than block here on the open
+    if (currentURL.length() == 0) {
+        Serial.println("Audio: no stream to play");
+        return;
+    }
     playing = true;
+    stateVersion++;
     Serial.println("Audio: playing");
 }
 
 void AudioModule::pause() {
+    resumePending = false;
     playing = false;
+    stateVersion++;
     Serial.println("Audio: paused");
 }
 
@@ -72,13 +119,23 @@ void AudioModule::setVolume(float vol) {
     if (vol < 0.0) vol = 0.0;
     if (vol > 1.0) vol = 1.0;
     currentVolume = vol;
-    player->setVolume(currentVolume);
+    stateVersion++;
+    if (player && !fadingOut) player->setVolume(currentVolume);
     Serial.print("Volume: ");
     Serial.println(currentVolume);
 }
 
+void AudioModule::requestVolume(float vol) {
+    if (vol < 0.0) vol = 0.0;
+    if (vol > 1.0) vol = 1.0;
+    pendingVolume = vol;
+    volumePending = true;
+    stateVersion++;
+}
+
 float AudioModule::getVolume() {
-    return currentVolume;
+    // Report the requested value so the UI never sees a stale level
+    return volumePending ? pendingVolume : currentVolume;
 }
 
 bool AudioModule::setURL(const char* url) {
@@ -86,47 +143,47 @@ bool AudioModule::setURL(const char* url) {
         Serial.println("setURL: Invalid URL");
         return false;
     }
+    if (fadingOut || released) {
+        Serial.println("setURL: update in progress");
+        streamStats.openFailures++;
+        return false;
+    }
+    resumePending = false;  // a new choice replaces the saved stream
+    
+    // Without a link the open can only fail (or, with credentials, block
+    // in URLStream's own join loop); the supervisor brings it back
+    if (wifiMgr && !wifiMgr->isConnected()) {
+        Serial.println("setURL: network down");
+        streamStats.openFailures++;
+        return false;
+    }
     
     Serial.print("Changing stream to: ");
     Serial.println(url);
+    unsigned long start = millis();
     
     currentURL = String(url);
+    stateVersion++;
     
-    // Stop current playback
+    // Stop current playback; copy() only runs from process(), so nothing
+    // is reading the old stream any more
     bool wasPlaying = playing;
     playing = false;
-    delay(200); // Give audio thread time to stop
-    
-    // Clean up old objects (in reverse order of creation)
-    if (player) { delete player; player = nullptr; }
-    if (decoder) { delete decoder; decoder = nullptr; }
-    if (source) { delete source; source = nullptr; }
-    if (i2s) { delete i2s; i2s = nullptr; }
-    if (urlStream) { delete urlStream; urlStream = nullptr; }
     
-    // Recreate with new URL
+    // Clean up old objects, then recreate with the new URL
+    releasePipeline();
     dynamicURL[0] = currentURL.c_str();
-    
-    urlStream = new URLStream(wifiSSID, wifiPassword);
-    source = new AudioSourceURL(*urlStream, dynamicURL, "audio/mp3");
-    i2s = new I2SStream();
-    decoder = new MP3DecoderHelix();
-    player = new AudioPlayer(*source, *i2s, *decoder);
+    createPipeline();
     
     // Reinitialize
-    auto cfg = i2s->defaultConfig(TX_MODE);
-    cfg.pin_bck = I2S_BCLK_PIN;
-    cfg.pin_ws = I2S_LRCK_PIN;
-    cfg.pin_data = I2S_DATA_PIN;
-    cfg.channels = 2;
-    
-    if (!i2s->begin(cfg)) {
+    if (!i2s->begin(outputConfig())) {
         Serial.println("I2S reinit failed");
         return false;
     }
     
     if (!player->begin()) {
         Serial.println("Player reinit failed");
+        streamStats.openFailures++;
         return false;
     }
     
@@ -137,14 +194,215 @@ bool AudioModule::setURL(const char* url) {
         playing = true;
     }
     
-    Serial.println("Stream changed successfully");
+    streamStats.lastOpenMs = millis() - start;
+    if (streamStats.lastOpenMs > streamStats.maxOpenMs) streamStats.maxOpenMs = streamStats.lastOpenMs;
+    streamStats.opens++;
+    
+    Serial.print("Stream changed successfully in ");
+    Serial.print(streamStats.lastOpenMs);
+    Serial.println(" ms");
     return true;
 }
 
+const StreamStats& AudioModule::getStreamStats() {
+    return streamStats;
+}
+
+const BlobStats& AudioModule::getStorageStats() {
+    return stateStore.getStats();
+}
+
+bool AudioModule::isResuming() {
+    return resumePending;
+}
+
+void AudioModule::loadState() {
+    std::vector<uint8_t> payload;
+    if (!stateStore.load(payload)) return;
+    
+    BlobReader reader(payload);
+    uint16_t volume = reader.getU16();
+    bool wasPlaying = reader.getU8() != 0;
+    String url = reader.getString();
+    if (!reader.ok()) return;
+    
+    savedVolume = volume;
+    savedPlaying = wasPlaying;
+    savedURL = url;
+    currentVolume = pendingVolume = volume / 1000.0;
+    
+    if (wasPlaying && url.length() > 0) {
+        resumeURL = url;
+        resumePending = true;
+        resumeTries = 0;
+        resumeAt = millis();
+    }
+}
+
+// Writes only when the stored values differ. A pending resume counts as
+// playing, so a failed reopen does not lose the station for the next boot.
+void AudioModule::saveState() {
+    uint16_t volume = (uint16_t)(getVolume() * 1000 + 0.5);
+    bool wasPlaying = playing || resumePending;
+    String url = resumePending ? resumeURL : currentURL;
+    if (url.length() == 0) url = savedURL;  // booted paused, nothing chosen yet
+    
+    if (volume == savedVolume && wasPlaying == savedPlaying && url == savedURL) return;
+    
+    // Payload: u16 volume (thousandths), u8 playing, URL
+    std::vector<uint8_t> payload;
+    BlobWriter writer(payload);
+    writer.putU16(volume);
+    writer.putU8(wasPlaying ? 1 : 0);
+    writer.putString(url);
+    
+    if (stateStore.save(payload)) {
+        savedVolume = volume;
+        savedPlaying = wasPlaying;
+        savedURL = url;
+        Serial.println("Audio: state saved");
+    }
+}
+
+// Nothing pending is saved afterwards, so the next boot starts from defaults
+void AudioModule::clearState() {
+    stateStore.erase();
+    stateDirty = false;
+    seenVersion = stateVersion;
+    resumePending = false;
+    Serial.println("Audio: state cleared");
+}
+
+void AudioModule::resume() {
+    String url = resumeURL;
+    resumeTries++;
+    Serial.print("Resuming ");
+    Serial.println(url);
+    
+    if (setURL(url.c_str())) {
+        play();
+        return;
+    }
+    
+    // Station or uplink not answering yet
+    if (resumeTries < AUDIO_RESUME_TRIES) {
+        resumePending = true;
+        resumeAt = millis() + AUDIO_RESUME_RETRY;
+    } else {
+        Serial.println("Resume failed, staying paused");
+    }
+}
+
+// Starts the fade; process() frees the pipeline once it is silent
+void AudioModule::suspendForUpdate(bool wait) {
+    if (!fadingOut && !released) {
+        Serial.println("Audio: fading out for update");
+        fadingOut = true;
+        fadeStart = millis();
+    }
+    
+    // Callers about to block (ArduinoOTA) fade here instead
+    while (wait && fadingOut) {
+        process();
+        delay(1);
+    }
+}
+
+bool AudioModule::isReleased() {
+    return released;
+}
+
+// Reopens the stream if one was playing; otherwise an idle pipeline as
+// after begin(). Without a link the resume logic retries the stream.
+void AudioModule::resumeAfterUpdate() {
+    if (fadingOut) {
+        fadingOut = false;
+        player->setVolume(currentVolume);
+        return;
+    }
+    if (!released) return;
+    released = false;
+    Serial.println("Audio: back after update");
+    
+    bool wasPlaying = playing;
+    if (currentURL.length() > 0 && setURL(currentURL.c_str())) return;
+    
+    if (!player) {
+        createPipeline();
+        if (!i2s->begin(outputConfig()) || !player->begin()) {
+            Serial.println("Audio: pipeline restart failed");
+        }
+        player->setVolume(currentVolume);
+    }
+    if (wasPlaying && currentURL.length() > 0) {
+        playing = false;
+        resumeURL = currentURL;
+        resumePending = true;
+        resumeTries = 0;
+        resumeAt = millis() + AUDIO_RESUME_RETRY;
+    }
+}
+
+// Ramps the player (not the saved volume) down while copy() keeps running
+void AudioModule::processFade() {
+    unsigned long elapsed = millis() - fadeStart;
+    if (playing && elapsed < AUDIO_FADE_MS) {
+        player->setVolume(currentVolume * (1.0 - (float)elapsed / AUDIO_FADE_MS));
+        return;
+    }
+    
+    fadingOut = false;
+    released = true;
+    releasePipeline();
+    Serial.println("Audio: released for update");
+}
+
+void AudioModule::createPipeline() {
+    urlStream = createStream();
+    source = new AudioSourceURL(*urlStream, dynamicURL, "audio/mp3");
+    i2s = new I2SStream();
+    decoder = new MP3DecoderHelix();
+    player = new AudioPlayer(*source, *i2s, *decoder);
+}
+
+// In reverse order of creation
+void AudioModule::releasePipeline() {
+    if (player) { delete player; player = nullptr; }
+    if (decoder) { delete decoder; decoder = nullptr; }
+    if (source) { delete source; source = nullptr; }
+    if (i2s) { delete i2s; i2s = nullptr; }
+    if (urlStream) { delete urlStream; urlStream = nullptr; }
+}
+
+I2SConfig AudioModule::outputConfig() {
+    auto cfg = i2s->defaultConfig(TX_MODE);
+    cfg.pin_bck = I2S_BCLK_PIN;
+    cfg.pin_ws = I2S_LRCK_PIN;
+    cfg.pin_data = I2S_DATA_PIN;
+    cfg.channels = 2;
+    return cfg;
+}
+
+// Without credentials URLStream uses whatever interface is up
+URLStream* AudioModule::createStream() {
+    if (wifiSSID && wifiPassword) {
+        return new URLStream(wifiSSID, wifiPassword);
+    }
+    return new URLStream();
+}
+
 String AudioModule::getCurrentURL() {
     return currentURL;
 }
 
+String AudioModule::getSavedURL() {
+    return savedURL;
+}
+
+uint32_t AudioModule::getStateVersion() {
+    return stateVersion;
+}
+
 void AudioModule::setSleepTimer(unsigned long durationMinutes) {
     unsigned long durationMs = durationMinutes * 60 * 1000;
     unsigned long fadeMs = 2 * 60 * 1000; // 2 minute fade
@@ -195,6 +453,6 @@ void AudioModule::processSleepTimer() {
         float fadeProgress = (float)fadeElapsed / fadeDuration;
         
         float newVolume = sleepStartVolume * (1.0 - fadeProgress);
-        player->setVolume(newVolume);
+        if (!fadingOut && !released) player->setVolume(newVolume);
     }
 }
\ No newline at end of file
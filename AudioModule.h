@@ -5,27 +5,65 @@
 #include "AudioTools/AudioCodecs/CodecMP3Helix.h"
 #include "AudioTools/Disk/AudioSourceURL.h"
 #include "AudioTools/Communication/AudioHttp.h"
+#include "WiFiModule.h"
+#include "BlobStore.h"
 
 // I2S Pin Configuration
 #define I2S_LRCK_PIN 5
 #define I2S_DATA_PIN 3
 #define I2S_BCLK_PIN 4
 
+// Volume, last URL and play state survive power loss. Changes are saved
+// once they have settled, so a volume drag is one NVS write. A stream that
+// was playing is reopened as soon as the link is up after boot.
+#define AUDIO_STATE_SCHEMA 1
+#define AUDIO_STATE_DELAY 5000    // ms without changes before saving
+#define AUDIO_RESUME_RETRY 10000  // ms between failed resume attempts
+#define AUDIO_RESUME_TRIES 3
+#define AUDIO_FADE_MS 600         // fade-out before an update takes the pipeline
+
+// Stream (re)opens: setURL() start to the player reading the new stream
+struct StreamStats {
+    uint32_t lastOpenMs;
+    uint32_t maxOpenMs;
+    uint32_t opens;
+    uint32_t openFailures;  // includes refusals while the link is down
+    uint32_t firstAudioMs;  // millis() of the first decoded audio, 0 = none yet
+};
+
 class AudioModule {
 public:
+    // Streams over the link WiFiModule keeps up; URLStream never touches WiFi
+    AudioModule(WiFiModule* wifi);
+    
+    // Legacy: URLStream joins ssid itself whenever the link is down
     AudioModule(const char* ssid, const char* password);
     
     bool begin();
     void process();
     
-    // Simple controls
+    // Simple controls; play() needs a stream open (see Tuner::play())
     void play();
     void pause();
     bool isPlaying();
     void setVolume(float vol); // 0.0 to 1.0
+    void requestVolume(float vol); // coalesced, applied once per process()
     float getVolume();
     bool setURL(const char* url);
     String getCurrentURL();
+    String getSavedURL();       // last stream saved, for play after booting paused
+    uint32_t getStateVersion(); // bumped on play/pause/volume/URL changes
+    bool isResuming();          // waiting to reopen the stream saved at power-off
+    const StreamStats& getStreamStats();
+    const BlobStats& getStorageStats();
+    void clearState();          // factory reset: forget volume, stream and play state
+    
+    // Firmware updates: fade out, then free the stream, decoder and I2S
+    // buffers for the transfer. The play state is kept (and saved), so
+    // resumeAfterUpdate() or the next boot picks the stream up again.
+    void suspendForUpdate(bool wait);  // wait: fade here rather than in process()
+    bool isReleased();                 // pipeline freed
+    void resumeAfterUpdate();
     
     // Sleep timer
     void setSleepTimer(unsigned long durationMinutes);
@@ -35,9 +73,11 @@ public:
     void processSleepTimer(); // call in loop
     
 private:
-    // WiFi credentials
+    // Network: either the shared WiFiModule or legacy credentials
+    WiFiModule* wifiMgr;
     const char* wifiSSID;
     const char* wifiPassword;
+    StreamStats streamStats;
     
     // Audio objects (same as working example)
     URLStream* urlStream;
@@ -49,6 +89,27 @@ private:
     bool playing;
     float currentVolume;
     
+    // Coalesced volume requests (latest value wins per loop tick)
+    float pendingVolume;
+    bool volumePending;
+    
+    uint32_t stateVersion;
+    
+    // Persisted state (see AUDIO_STATE_DELAY)
+    BlobStore stateStore;
+    uint32_t seenVersion;       // stateVersion at the last change check
+    unsigned long lastStateChange;
+    bool stateDirty;
+    uint16_t savedVolume;       // thousandths, as stored
+    bool savedPlaying;
+    String savedURL;
+    
+    // Resume after power loss
+    String resumeURL;
+    bool resumePending;
+    uint8_t resumeTries;
+    unsigned long resumeAt;
+    
     // Sleep timer state
     unsigned long sleepEndTime;
     unsigned long sleepFadeStart;
@@ -58,8 +119,21 @@ private:
     // Current URL storage
     String currentURL;
     
+    // Update suspension (see suspendForUpdate)
+    bool fadingOut;
+    bool released;
+    unsigned long fadeStart;
+    
     // Helper to restart with new URL
     bool restartWithURL(const char* url);
+    URLStream* createStream();
+    void createPipeline();
+    void releasePipeline();
+    I2SConfig outputConfig();
+    void processFade();
+    void loadState();
+    void saveState();
+    void resume();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "BlobStore.h"
+
+static const char* SLOT_KEYS[2] = { "blob0", "blob1" };
+
+// --- BlobWriter ---
+
+void BlobWriter::putU8(uint8_t v) {
+    buf.push_back(v);
+}
+
+void BlobWriter::putU16(uint16_t v) {
+    buf.push_back(v & 0xFF);
+    buf.push_back(v >> 8);
+}
+
+void BlobWriter::putU32(uint32_t v) {
+    putU16(v & 0xFFFF);
+    putU16(v >> 16);
+}
+
+void BlobWriter::putString(const String& s) {
+    uint16_t len = s.length() > 0xFFFF ? 0xFFFF : s.length();
+    putU16(len);
+    buf.insert(buf.end(), (const uint8_t*)s.c_str(), (const uint8_t*)s.c_str() + len);
+}
+
+// --- BlobReader ---
+
+bool BlobReader::need(size_t n) {
+    if (failed || pos + n > buf.size()) {
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+uint8_t BlobReader::getU8() {
+    if (!need(1)) return 0;
+    return buf[pos++];
+}
+
+uint16_t BlobReader::getU16() {
+    if (!need(2)) return 0;
+    uint16_t v = buf[pos] | (buf[pos + 1] << 8);
+    pos += 2;
+    return v;
+}
+
+uint32_t BlobReader::getU32() {
+    uint32_t lo = getU16();
+    uint32_t hi = getU16();
+    return lo | (hi << 16);
+}
+
+String BlobReader::getString() {
+    uint16_t len = getU16();
+    if (!need(len)) return String();
+    
+    String s;
+    s.reserve(len);
+    for (uint16_t i = 0; i < len; i++) {
+        s += (char)buf[pos + i];
+    }
+    pos += len;
+    return s;
+}
+
+// --- BlobStore ---
+
+BlobStore::BlobStore(const char* nvsNamespace, uint16_t schemaVersion)
+    : ns(nvsNamespace), schema(schemaVersion), sequence(0), activeSlot(-1), scanned(false) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool BlobStore::load(std::vector<uint8_t>& payload) {
+    unsigned long start = micros();
+    
+    std::vector<uint8_t> raw[2];
+    Header headers[2];
+    bool valid[2];
+    
+    prefs.begin(ns, true);
+    for (int slot = 0; slot < 2; slot++) {
+        valid[slot] = readSlot(slot, raw[slot], headers[slot]);
+    }
+    prefs.end();
+    
+    // Newest valid copy wins; sequence comparison tolerates wrap-around
+    int best = -1;
+    if (valid[0] && valid[1]) {
+        best = (int32_t)(headers[1].sequence - headers[0].sequence) > 0 ? 1 : 0;
+    } else if (valid[0]) {
+        best = 0;
+    } else if (valid[1]) {
+        best = 1;
+    }
+    
+    scanned = true;
+    activeSlot = best;
+    payload.clear();
+    
+    if (best >= 0) {
+        sequence = headers[best].sequence;
+        payload.assign(raw[best].begin() + sizeof(Header), raw[best].end());
+    }
+    
+    stats.loadUs = micros() - start;
+    return best >= 0;
+}
+
+bool BlobStore::save(const std::vector<uint8_t>& payload) {
+    // Learn which slot is current so we never overwrite it
+    if (!scanned) {
+        std::vector<uint8_t> ignored;
+        load(ignored);
+    }
+    
+    unsigned long start = micros();
+    
+    Header header;
+    header.magic = BLOB_MAGIC;
+    header.schema = schema;
+    header.reserved = 0;
+    header.sequence = sequence + 1;
+    header.length = payload.size();
+    header.crc = crc32(payload.data(), payload.size());
+    
+    std::vector<uint8_t> raw(sizeof(Header) + payload.size());
+    memcpy(raw.data(), &header, sizeof(Header));
+    if (!payload.empty()) {
+        memcpy(raw.data() + sizeof(Header), payload.data(), payload.size());
+    }
+    
+    int slot = activeSlot == 0 ? 1 : 0;
+    prefs.begin(ns, false);
+    size_t written = prefs.putBytes(SLOT_KEYS[slot], raw.data(), raw.size());
+    prefs.end();
+    
+    if (written != raw.size()) {
+        Serial.print("BlobStore: write failed for ");
+        Serial.println(ns);
+        return false;
+    }
+    
+    activeSlot = slot;
+    sequence = header.sequence;
+    
+    // NVS stores blobs in 32-byte entries plus an index and a header entry
+    stats.lastWriteBytes = ((raw.size() + 31) / 32 + 2) * 32;
+    stats.totalWriteBytes += stats.lastWriteBytes;
+    stats.saves++;
+    stats.saveUs = micros() - start;
+    return true;
+}
+
+bool BlobStore::erase() {
+    prefs.begin(ns, false);
+    for (int slot = 0; slot < 2; slot++) {
+        if (prefs.getBytesLength(SLOT_KEYS[slot]) > 0) prefs.remove(SLOT_KEYS[slot]);
+    }
+    bool erased = prefs.getBytesLength(SLOT_KEYS[0]) == 0 && prefs.getBytesLength(SLOT_KEYS[1]) == 0;
+    prefs.end();
+    
+    if (!erased) {
+        Serial.print("BlobStore: erase failed for ");
+        Serial.println(ns);
+        return false;
+    }
+    scanned = true;
+    activeSlot = -1;
+    return true;
+}
+
+bool BlobStore::readSlot(int slot, std::vector<uint8_t>& raw, Header& header) {
+    size_t len = prefs.getBytesLength(SLOT_KEYS[slot]);
+    if (len < sizeof(Header)) return false;
+    
+    raw.resize(len);
+    if (prefs.getBytes(SLOT_KEYS[slot], raw.data(), len) != len) return false;
+    memcpy(&header, raw.data(), sizeof(Header));
+    
+    if (header.magic != BLOB_MAGIC || header.schema != schema) return false;
+    if (header.length != len - sizeof(Header)) return false;
+    return header.crc == crc32(raw.data() + sizeof(Header), header.length);
+}
+
+uint32_t BlobStore::crc32(const uint8_t* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    while (len--) {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,81 @@
+#ifndef BLOB_STORE_H
+#define BLOB_STORE_H
+
+#include <Preferences.h>
+#include <vector>
+
+#define BLOB_MAGIC 0x424C4247  // "GBLB"
+
+// Timing and flash cost of the last load/save
+struct BlobStats {
+    uint32_t loadUs;
+    uint32_t saveUs;
+    uint32_t lastWriteBytes;   // NVS bytes of the last save (32-byte entries)
+    uint32_t totalWriteBytes;
+    uint32_t saves;
+};
+
+// Appends little-endian fields and length-prefixed strings to a payload
+class BlobWriter {
+public:
+    BlobWriter(std::vector<uint8_t>& out) : buf(out) {}
+    void putU8(uint8_t v);
+    void putU16(uint16_t v);
+    void putU32(uint32_t v);
+    void putString(const String& s);
+    
+private:
+    std::vector<uint8_t>& buf;
+};
+
+// Reads a payload back; any overrun marks the reader as failed
+class BlobReader {
+public:
+    BlobReader(const std::vector<uint8_t>& in) : buf(in), pos(0), failed(false) {}
+    uint8_t getU8();
+    uint16_t getU16();
+    uint32_t getU32();
+    String getString();
+    bool ok() { return !failed; }
+    
+private:
+    const std::vector<uint8_t>& buf;
+    size_t pos;
+    bool failed;
+    bool need(size_t n);
+};
+
+// One versioned, CRC-checked record stored as a single NVS blob. Saves go to
+// the older of two keys, so a torn write always leaves the previous copy.
+class BlobStore {
+public:
+    BlobStore(const char* nvsNamespace, uint16_t schemaVersion);
+    
+    bool load(std::vector<uint8_t>& payload);
+    bool save(const std::vector<uint8_t>& payload);
+    bool erase();   // both copies; load() then finds nothing
+    const BlobStats& getStats() { return stats; }
+    
+private:
+    struct Header {
+        uint32_t magic;
+        uint16_t schema;
+        uint16_t reserved;
+        uint32_t sequence;
+        uint32_t length;
+        uint32_t crc;
+    };
+    
+    Preferences prefs;
+    const char* ns;
+    uint16_t schema;
+    uint32_t sequence;
+    int activeSlot;   // -1 = nothing stored yet
+    bool scanned;
+    BlobStats stats;
+    
+    bool readSlot(int slot, std::vector<uint8_t>& raw, Header& header);
+    static uint32_t crc32(const uint8_t* data, size_t len);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "BootTrace.h"
+
+BootTrace::BootTrace() : count(0), readyMs(0), firstAudioMs(0), fastBoot(false) {
+    memset(phases, 0, sizeof(phases));
+}
+
+int BootTrace::begin(const char* name) {
+    if (count >= BOOT_TRACE_PHASES) return -1;
+    phases[count].name = name;
+    phases[count].startMs = millis();
+    phases[count].endMs = 0;
+    return count++;
+}
+
+void BootTrace::end(int phase) {
+    if (phase < 0 || phase >= count) return;
+    BootPhase& p = phases[phase];
+    p.endMs = millis();
+    
+    Serial.print("Boot: ");
+    Serial.print(p.name);
+    Serial.print(" took ");
+    Serial.print(p.endMs - p.startMs);
+    Serial.print(" ms (at ");
+    Serial.print(p.startMs);
+    Serial.println(" ms)");
+}
+
+void BootTrace::ready() {
+    readyMs = millis();
+    Serial.print("Boot: setup done at ");
+    Serial.print(readyMs);
+    Serial.println(" ms");
+}
+
+void BootTrace::firstAudio(uint32_t ms) {
+    if (firstAudioMs != 0) return;
+    firstAudioMs = ms;
+    Serial.print("Boot: first audio at ");
+    Serial.print(firstAudioMs);
+    Serial.println(" ms");
+}
+
+void BootTrace::setFastBoot(bool fast) {
+    fastBoot = fast;
+}
+
+int BootTrace::getCount() {
+    return count;
+}
+
+const BootPhase* BootTrace::getPhases() {
+    return phases;
+}
+
+uint32_t BootTrace::getReadyMs() {
+    return readyMs;
+}
+
+uint32_t BootTrace::getFirstAudioMs() {
+    return firstAudioMs;
+}
+
+bool BootTrace::isFastBoot() {
+    return fastBoot;
+}
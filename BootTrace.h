@@ -0,0 +1,41 @@
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include <Arduino.h>
+
+// Startup timeline: each setup() phase with its start and end in millis()
+// since power-on, plus when setup() finished and when the first audio was
+// decoded. Served at /boot and in /metrics.
+#define BOOT_TRACE_PHASES 12
+
+struct BootPhase {
+    const char* name;      // static string
+    uint32_t startMs;
+    uint32_t endMs;        // 0 while the phase runs
+};
+
+class BootTrace {
+public:
+    BootTrace();
+    
+    int begin(const char* name);  // returns the phase slot, -1 when full
+    void end(int phase);
+    void ready();                 // setup() returned
+    void firstAudio(uint32_t ms); // first decoded audio, millis()
+    void setFastBoot(bool fast);
+    
+    int getCount();
+    const BootPhase* getPhases();
+    uint32_t getReadyMs();        // 0 until setup() returns
+    uint32_t getFirstAudioMs();   // 0 until audio plays
+    bool isFastBoot();
+    
+private:
+    BootPhase phases[BOOT_TRACE_PHASES];
+    int count;
+    uint32_t readyMs;
+    uint32_t firstAudioMs;
+    bool fastBoot;
+};
+
+#endif
@@ -0,0 +1,731 @@
+#include "DirectoryModule.h"
+#include <algorithm>
+
+#define DIRECTORY_RECORDS_PATH "/directory/records.dat"
+#define DIRECTORY_OFFSETS_PATH "/directory/offsets.dat"
+#define DIRECTORY_INDEX_PATH "/directory/index.dat"
+#define DIRECTORY_KEYS_PATH "/directory/keys.tmp"   // per-station keys, build only
+
+#define DIRECTORY_RECORD_MAX (1 + 5 * 2 + DIRECTORY_NAME_MAX + DIRECTORY_URL_MAX + DIRECTORY_TAGS_MAX + DIRECTORY_COUNTRY_MAX + 8)
+#define DIRECTORY_STATION_KEYS 512   // keys kept per station
+#define DIRECTORY_PASS_BUCKETS 1024  // buckets per build pass
+
+enum KeyKind : uint8_t { KEY_PREFIX1 = 1, KEY_PREFIX2 = 2, KEY_TRIGRAM = 3 };
+
+static uint16_t keyHash(uint8_t kind, const char* s, int len) {
+    uint32_t hash = (2166136261u ^ kind) * 16777619u;
+    for (int i = 0; i < len; i++) {
+        hash ^= (uint8_t)s[i];
+        hash *= 16777619u;
+    }
+    return (hash ^ (hash >> 15)) & (DIRECTORY_INDEX_BUCKETS - 1);
+}
+
+// Lowercase words of ASCII letters/digits; UTF-8 bytes count as letters
+template <typename F>
+static void forEachWord(const char* text, F fn) {
+    char word[DIRECTORY_WORD_MAX + 1];
+    int len = 0;
+    for (const char* p = text;; p++) {
+        uint8_t c = *p;
+        if (c >= 0x80 || isalnum(c)) {
+            if (len < DIRECTORY_WORD_MAX) word[len++] = tolower(c);
+            continue;
+        }
+        if (len > 0) {
+            word[len] = '\0';
+            fn(word, len);
+            len = 0;
+        }
+        if (c == '\0') break;
+    }
+}
+
+template <typename F>
+static void forEachKey(const char* word, int len, F fn) {
+    fn(keyHash(KEY_PREFIX1, word, 1));
+    if (len >= 2) fn(keyHash(KEY_PREFIX2, word, 2));
+    for (int i = 0; i + 3 <= len; i++) {
+        fn(keyHash(KEY_TRIGRAM, word + i, 3));
+    }
+}
+
+static int sortUnique(uint16_t* keys, int count) {
+    std::sort(keys, keys + count);
+    return std::unique(keys, keys + count) - keys;
+}
+
+static const uint32_t INDEX_TABLE_START = 24;  // sizeof(IndexHeader)
+static const uint32_t INDEX_DATA_START = INDEX_TABLE_START + (DIRECTORY_INDEX_BUCKETS + 1) * 4;
+
+// Pulls station objects out of a JSON array one at a time. Only the fields
+// the directory keeps are copied (truncated to their limits); everything
+// else, nested values included, is skipped without being stored.
+class JsonStationReader {
+public:
+    JsonStationReader(File& file) : file(file), len(0), at(0) {}
+    bool next(DirectoryEntry& out);
+
+private:
+    File& file;
+    uint8_t buf[512];
+    int len;
+    int at;
+
+    int peek() {
+        if (at >= len) {
+            len = file.read(buf, sizeof(buf));
+            at = 0;
+            if (len <= 0) {
+                len = 0;
+                return -1;
+            }
+        }
+        return buf[at];
+    }
+    int get() {
+        int c = peek();
+        if (c >= 0) at++;
+        return c;
+    }
+    int getNonSpace() {
+        int c;
+        while ((c = get()) == ' ' || c == '\n' || c == '\r' || c == '\t') {}
+        return c;
+    }
+
+    bool readString(char* out, size_t max);
+    bool readHex(uint32_t& value);
+    bool skipValue(int first);
+};
+
+bool JsonStationReader::next(DirectoryEntry& out) {
+    char key[24];
+    char name[DIRECTORY_NAME_MAX + 1];
+    char url[DIRECTORY_URL_MAX + 1];
+    char resolved[DIRECTORY_URL_MAX + 1];
+    char tags[DIRECTORY_TAGS_MAX + 1];
+    char country[DIRECTORY_COUNTRY_MAX + 1];
+    char code[8];
+
+    while (true) {
+        int c = getNonSpace();
+        if (c < 0 || c == ']') return false;
+        if (c == '[' || c == ',') continue;
+        if (c != '{') {
+            if (!skipValue(c)) return false;
+            continue;
+        }
+
+        name[0] = url[0] = resolved[0] = tags[0] = country[0] = code[0] = '\0';
+        while (true) {
+            c = getNonSpace();
+            if (c == '}') break;
+            if (c == ',') continue;
+            if (c != '"' || !readString(key, sizeof(key))) return false;
+            if (getNonSpace() != ':') return false;
+
+            char* target = nullptr;
+            size_t size = 0;
+            if (strcmp(key, "name") == 0) { target = name; size = sizeof(name); }
+            else if (strcmp(key, "url") == 0) { target = url; size = sizeof(url); }
+            else if (strcmp(key, "url_resolved") == 0) { target = resolved; size = sizeof(resolved); }
+            else if (strcmp(key, "tags") == 0) { target = tags; size = sizeof(tags); }
+            else if (strcmp(key, "country") == 0) { target = country; size = sizeof(country); }
+            else if (strcmp(key, "countrycode") == 0) { target = code; size = sizeof(code); }
+
+            c = getNonSpace();
+            if (c == '"') {
+                if (!readString(target, size)) return false;
+            } else if (!skipValue(c)) {
+                return false;
+            }
+        }
+
+        // The export's resolved URL already skips playlists and redirects
+        const char* stream = resolved[0] ? resolved : url;
+        if (name[0] == '\0' || stream[0] == '\0') continue;
+
+        out.name = name;
+        out.url = stream;
+        out.tags = tags;
+        out.country = country;
+        out.countryCode = code;
+        return true;
+    }
+}
+
+// Reads up to the closing quote. Escapes are decoded to UTF-8; a value that
+// does not fit is cut at a character boundary.
+bool JsonStationReader::readString(char* out, size_t max) {
+    size_t n = 0;
+    bool full = out == nullptr;
+
+    while (true) {
+        int c = get();
+        if (c < 0) return false;
+        if (c == '"') break;
+
+        uint8_t bytes[4];
+        int count = 1;
+        bytes[0] = c;
+
+        if (c == '\\') {
+            c = get();
+            if (c < 0) return false;
+            bytes[0] = c;
+            if (c == 'n' || c == 'r' || c == 't' || c == 'b' || c == 'f') {
+                bytes[0] = ' ';
+            } else if (c == 'u') {
+                uint32_t cp;
+                if (!readHex(cp)) return false;
+                if (cp >= 0xD800 && cp < 0xDC00) {
+                    uint32_t low;
+                    if (get() == '\\' && get() == 'u' && readHex(low) && low >= 0xDC00 && low < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    } else {
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp < 0xE000) {
+                    cp = 0xFFFD;
+                }
+
+                if (cp < 0x80) {
+                    bytes[0] = cp < 0x20 ? ' ' : cp;
+                } else if (cp < 0x800) {
+                    bytes[0] = 0xC0 | (cp >> 6);
+                    bytes[1] = 0x80 | (cp & 0x3F);
+                    count = 2;
+                } else if (cp < 0x10000) {
+                    bytes[0] = 0xE0 | (cp >> 12);
+                    bytes[1] = 0x80 | ((cp >> 6) & 0x3F);
+                    bytes[2] = 0x80 | (cp & 0x3F);
+                    count = 3;
+                } else {
+                    bytes[0] = 0xF0 | (cp >> 18);
+                    bytes[1] = 0x80 | ((cp >> 12) & 0x3F);
+                    bytes[2] = 0x80 | ((cp >> 6) & 0x3F);
+                    bytes[3] = 0x80 | (cp & 0x3F);
+                    count = 4;
+                }
+            }
+        } else if (c < 0x20) {
+            bytes[0] = ' ';
+        }
+
+        if (full) continue;
+        if (n + count >= max) {
+            full = true;
+            continue;
+        }
+        memcpy(out + n, bytes, count);
+        n += count;
+    }
+
+    if (out == nullptr) return true;
+
+    // Drop a raw multi-byte sequence the limit cut in half
+    size_t end = n;
+    int continuation = 0;
+    while (end > 0 && ((uint8_t)out[end - 1] & 0xC0) == 0x80 && continuation < 3) {
+        end--;
+        continuation++;
+    }
+    if (end > 0) {
+        uint8_t lead = out[end - 1];
+        int needed = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+        if (continuation < needed) n = end - 1;
+    }
+    out[n] = '\0';
+    return true;
+}
+
+bool JsonStationReader::readHex(uint32_t& value) {
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = get();
+        if (c >= '0' && c <= '9') value = (value << 4) | (c - '0');
+        else if (c >= 'a' && c <= 'f') value = (value << 4) | (c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') value = (value << 4) | (c - 'A' + 10);
+        else return false;
+    }
+    return true;
+}
+
+bool JsonStationReader::skipValue(int first) {
+    if (first == '"') return readString(nullptr, 0);
+
+    if (first == '{' || first == '[') {
+        int depth = 1;
+        while (depth > 0) {
+            int c = get();
+            if (c < 0) return false;
+            if (c == '"') {
+                if (!readString(nullptr, 0)) return false;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                depth--;
+            }
+        }
+        return true;
+    }
+
+    // Number, true, false or null
+    if (first < 0) return false;
+    while (true) {
+        int c = peek();
+        if (c < 0 || c == ',' || c == '}' || c == ']' || c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            return true;
+        }
+        get();
+    }
+}
+
+DirectoryModule::DirectoryModule() : ready(false) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool DirectoryModule::begin() {
+    if (!LittleFS.begin(true)) {
+        Serial.println("Directory: LittleFS mount failed");
+        return false;
+    }
+
+    // The export may be deleted once indexed to free flash
+    File source = LittleFS.open(DIRECTORY_SOURCE_PATH, "r");
+    uint32_t sourceSize = source ? source.size() : 0;
+
+    if (!open(sourceSize)) {
+        if (!source) {
+            Serial.println("Directory: no station export");
+            return false;
+        }
+        if (!build(source) || !open(sourceSize)) {
+            Serial.println("Directory: index build failed");
+            return false;
+        }
+    }
+
+    Serial.print("Directory: ");
+    Serial.print(stats.stations);
+    Serial.println(" stations searchable");
+    return true;
+}
+
+bool DirectoryModule::rebuild() {
+    File source = LittleFS.open(DIRECTORY_SOURCE_PATH, "r");
+    if (!source) return false;
+    return build(source) && open(source.size());
+}
+
+bool DirectoryModule::isReady() {
+    return ready;
+}
+
+const DirectoryStats& DirectoryModule::getStats() {
+    return stats;
+}
+
+// sourceSize 0 accepts any complete index
+bool DirectoryModule::open(uint32_t sourceSize) {
+    ready = false;
+    indexFile = LittleFS.open(DIRECTORY_INDEX_PATH, "r");
+    if (!indexFile) return false;
+
+    IndexHeader header;
+    if (indexFile.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != DIRECTORY_INDEX_MAGIC || header.buckets != DIRECTORY_INDEX_BUCKETS ||
+        (sourceSize != 0 && header.sourceSize != sourceSize)) {
+        indexFile.close();
+        return false;
+    }
+
+    recordsFile = LittleFS.open(DIRECTORY_RECORDS_PATH, "r");
+    offsetsFile = LittleFS.open(DIRECTORY_OFFSETS_PATH, "r");
+    if (!recordsFile || !offsetsFile || offsetsFile.size() < header.stations * 4) {
+        indexFile.close();
+        return false;
+    }
+
+    stats.stations = header.stations;
+    stats.postings = header.postings;
+    stats.recordBytes = recordsFile.size();
+    stats.indexBytes = indexFile.size() + offsetsFile.size();
+    ready = true;
+    return true;
+}
+
+bool DirectoryModule::build(File& source) {
+    unsigned long start = millis();
+    Serial.println("Directory: indexing station export...");
+
+    ready = false;
+    indexFile.close();
+    recordsFile.close();
+    offsetsFile.close();
+    LittleFS.mkdir(DIRECTORY_DIR);
+    LittleFS.remove(DIRECTORY_INDEX_PATH);
+
+    uint16_t* counts = (uint16_t*)calloc(DIRECTORY_INDEX_BUCKETS, sizeof(uint16_t));
+    if (!counts) return false;
+
+    bool ok = writeRecords(source, counts) && writeIndex(counts, source.size());
+    free(counts);
+    LittleFS.remove(DIRECTORY_KEYS_PATH);
+
+    stats.buildMs = millis() - start;
+    Serial.print("Directory: ");
+    Serial.print(stats.stations);
+    Serial.print(" stations, ");
+    Serial.print(stats.postings);
+    Serial.print(" postings in ");
+    Serial.print(stats.buildMs);
+    Serial.println(" ms");
+    return ok;
+}
+
+// Pass 1: export -> records + offsets, and each station's keys to a
+// temporary file so later passes need not parse text again
+bool DirectoryModule::writeRecords(File& source, uint16_t* counts) {
+    File records = LittleFS.open(DIRECTORY_RECORDS_PATH, "w");
+    File offsets = LittleFS.open(DIRECTORY_OFFSETS_PATH, "w");
+    File keysFile = LittleFS.open(DIRECTORY_KEYS_PATH, "w");
+    if (!records || !offsets || !keysFile) return false;
+
+    JsonStationReader reader(source);
+    DirectoryEntry entry;
+    uint16_t keys[DIRECTORY_STATION_KEYS];
+    uint8_t record[DIRECTORY_RECORD_MAX];
+    uint32_t offset = 0;
+    uint32_t count = 0;
+    uint32_t postings = 0;
+
+    while (count < DIRECTORY_MAX_STATIONS && reader.next(entry)) {
+        const String* fields[5] = { &entry.name, &entry.url, &entry.tags, &entry.country, &entry.countryCode };
+        size_t len = 0;
+        record[len++] = 5;
+        for (int i = 0; i < 5; i++) {
+            uint16_t fieldLen = fields[i]->length();
+            record[len++] = fieldLen & 0xFF;
+            record[len++] = fieldLen >> 8;
+            memcpy(record + len, fields[i]->c_str(), fieldLen);
+            len += fieldLen;
+        }
+
+        if (records.write(record, len) != len || offsets.write((const uint8_t*)&offset, 4) != 4) {
+            Serial.println("Directory: write failed (flash full?)");
+            return false;
+        }
+        offset += len;
+
+        uint16_t n = collectKeys(entry, keys, DIRECTORY_STATION_KEYS);
+        keysFile.write((const uint8_t*)&n, sizeof(n));
+        keysFile.write((const uint8_t*)keys, n * sizeof(uint16_t));
+        for (int i = 0; i < n; i++) counts[keys[i]]++;
+        postings += n;
+        count++;
+
+        // Long import: let the idle task run so the watchdog stays fed
+        if ((count & 255) == 0) delay(1);
+    }
+
+    stats.stations = count;
+    stats.postings = postings;
+    return count > 0;
+}
+
+// Later passes: for a range of buckets whose postings fit in RAM, scan the
+// key file, gather station IDs per bucket (already in ascending order) and
+// append them delta/varint encoded. The bucket table is patched per pass.
+bool DirectoryModule::writeIndex(const uint16_t* counts, uint32_t sourceSize) {
+    File index = LittleFS.open(DIRECTORY_INDEX_PATH, "w");
+    File keysFile = LittleFS.open(DIRECTORY_KEYS_PATH, "r");
+    if (!index || !keysFile) return false;
+
+    // Magic stays zero until the last write, so a cut-short build is ignored
+    IndexHeader header = { 0, DIRECTORY_INDEX_BUCKETS, stats.stations, stats.postings, sourceSize, 0 };
+    index.write((const uint8_t*)&header, sizeof(header));
+    uint8_t zeros[256] = { 0 };
+    for (uint32_t left = INDEX_DATA_START - INDEX_TABLE_START; left > 0;) {
+        uint32_t n = left < sizeof(zeros) ? left : sizeof(zeros);
+        index.write(zeros, n);
+        left -= n;
+    }
+
+    uint32_t capacity = DIRECTORY_BUILD_BUDGET;
+    for (int b = 0; b < DIRECTORY_INDEX_BUCKETS; b++) {
+        if (counts[b] > capacity) capacity = counts[b];
+    }
+
+    uint16_t* ids = (uint16_t*)malloc(capacity * sizeof(uint16_t));
+    uint32_t* starts = (uint32_t*)malloc(DIRECTORY_PASS_BUCKETS * sizeof(uint32_t));
+    uint32_t* table = (uint32_t*)malloc(DIRECTORY_PASS_BUCKETS * sizeof(uint32_t));
+    uint16_t* fill = (uint16_t*)malloc(DIRECTORY_PASS_BUCKETS * sizeof(uint16_t));
+    bool ok = ids && starts && table && fill;
+
+    uint16_t keys[DIRECTORY_STATION_KEYS];
+    uint8_t out[256];
+    uint32_t written = 0;
+
+    for (int lo = 0, hi = 0; ok && lo < DIRECTORY_INDEX_BUCKETS; lo = hi) {
+        uint32_t total = 0;
+        while (hi < DIRECTORY_INDEX_BUCKETS && hi - lo < DIRECTORY_PASS_BUCKETS &&
+               (hi == lo || total + counts[hi] <= capacity)) {
+            starts[hi - lo] = total;
+            total += counts[hi];
+            hi++;
+        }
+        memset(fill, 0, (hi - lo) * sizeof(uint16_t));
+
+        keysFile.seek(0);
+        for (uint32_t station = 0; station < stats.stations; station++) {
+            uint16_t n;
+            if (keysFile.read((uint8_t*)&n, sizeof(n)) != sizeof(n) ||
+                keysFile.read((uint8_t*)keys, n * sizeof(uint16_t)) != n * sizeof(uint16_t)) {
+                ok = false;
+                break;
+            }
+            for (int i = 0; i < n; i++) {
+                if (keys[i] >= lo && keys[i] < hi) {
+                    int b = keys[i] - lo;
+                    ids[starts[b] + fill[b]++] = station;
+                }
+            }
+        }
+
+        int outLen = 0;
+        for (int b = 0; ok && b < hi - lo; b++) {
+            table[b] = written;
+            int32_t prev = -1;
+            for (uint32_t i = 0; i < fill[b]; i++) {
+                uint32_t delta = ids[starts[b] + i] - prev;
+                prev = ids[starts[b] + i];
+                do {
+                    uint8_t byte = delta & 0x7F;
+                    delta >>= 7;
+                    out[outLen++] = delta ? byte | 0x80 : byte;
+                    written++;
+                } while (delta);
+
+                if (outLen > (int)sizeof(out) - 8) {
+                    ok = index.write(out, outLen) == (size_t)outLen;
+                    outLen = 0;
+                }
+            }
+        }
+        if (ok && outLen > 0) ok = index.write(out, outLen) == (size_t)outLen;
+
+        ok = ok && index.seek(INDEX_TABLE_START + lo * 4) &&
+             index.write((const uint8_t*)table, (hi - lo) * 4) == (size_t)(hi - lo) * 4 &&
+             index.seek(INDEX_DATA_START + written);
+        delay(1);
+    }
+
+    free(ids);
+    free(starts);
+    free(table);
+    free(fill);
+
+    if (!ok) {
+        Serial.println("Directory: index write failed");
+        return false;
+    }
+
+    index.seek(INDEX_TABLE_START + DIRECTORY_INDEX_BUCKETS * 4);
+    index.write((const uint8_t*)&written, 4);
+    header.magic = DIRECTORY_INDEX_MAGIC;
+    index.seek(0);
+    index.write((const uint8_t*)&header, sizeof(header));
+    index.close();
+    return true;
+}
+
+int DirectoryModule::collectKeys(const DirectoryEntry& entry, uint16_t* keys, int maxKeys) {
+    int count = 0;
+    auto add = [&](uint16_t key) {
+        if (count < maxKeys) keys[count++] = key;
+    };
+    auto addWord = [&](const char* word, int len) {
+        forEachKey(word, len, add);
+    };
+
+    forEachWord(entry.name.c_str(), addWord);
+    forEachWord(entry.tags.c_str(), addWord);
+    forEachWord(entry.country.c_str(), addWord);
+    forEachWord(entry.countryCode.c_str(), addWord);
+    return sortUnique(keys, count);
+}
+
+int DirectoryModule::search(const String& query, int limit, std::vector<DirectoryEntry>& out, bool* more) {
+    out.clear();
+    if (more) *more = false;
+    if (!ready) return 0;
+    if (limit <= 0 || limit > DIRECTORY_RESULTS_MAX) limit = DIRECTORY_RESULTS_MAX;
+
+    unsigned long start = micros();
+    stats.searches++;
+
+    char words[DIRECTORY_QUERY_WORDS][DIRECTORY_WORD_MAX + 1];
+    int wordCount = 0;
+    uint16_t keys[DIRECTORY_QUERY_WORDS * (DIRECTORY_WORD_MAX + 2)];
+    int keyCount = 0;
+
+    forEachWord(query.c_str(), [&](const char* word, int len) {
+        if (wordCount == DIRECTORY_QUERY_WORDS) return;
+        memcpy(words[wordCount++], word, len + 1);
+        forEachKey(word, len, [&](uint16_t key) { keys[keyCount++] = key; });
+    });
+    keyCount = sortUnique(keys, keyCount);
+
+    // Shortest posting lists first; the rest only cost verification
+    Cursor cursors[DIRECTORY_QUERY_KEYS];
+    int cursorCount = 0;
+    for (int i = 0; i < keyCount; i++) {
+        uint32_t range[2];
+        indexFile.seek(INDEX_TABLE_START + keys[i] * 4);
+        if (indexFile.read((uint8_t*)range, sizeof(range)) != sizeof(range)) return 0;
+        if (range[1] <= range[0]) {
+            stats.lastSearchUs = micros() - start;
+            return 0;
+        }
+
+        Cursor cursor = { range[0], range[1], {}, 0, 0, -1 };
+        int at = cursorCount < DIRECTORY_QUERY_KEYS ? cursorCount++ : DIRECTORY_QUERY_KEYS;
+        while (at > 0 && cursors[at - 1].end - cursors[at - 1].pos > cursor.end - cursor.pos) {
+            if (at < DIRECTORY_QUERY_KEYS) cursors[at] = cursors[at - 1];
+            at--;
+        }
+        if (at < DIRECTORY_QUERY_KEYS) cursors[at] = cursor;
+    }
+
+    // Leapfrog intersection: advance every list to the largest current ID
+    int checked = 0;
+    bool exhausted = cursorCount == 0 || !nextPosting(cursors[0]);
+    while (!exhausted) {
+        int32_t candidate = cursors[0].id;
+        bool aligned = true;
+        for (int i = 1; i < cursorCount && aligned; i++) {
+            while (cursors[i].id < candidate) {
+                if (!nextPosting(cursors[i])) {
+                    exhausted = true;
+                    break;
+                }
+            }
+            if (exhausted) break;
+            if (cursors[i].id > candidate) {
+                aligned = false;
+                while (cursors[0].id < cursors[i].id) {
+                    if (!nextPosting(cursors[0])) {
+                        exhausted = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (exhausted) break;
+        if (!aligned) continue;
+
+        if (checked++ == DIRECTORY_VERIFY_MAX) {
+            if (more) *more = true;
+            break;
+        }
+
+        DirectoryEntry entry;
+        if (readRecord(candidate, entry) && matches(entry, words, wordCount)) {
+            if ((int)out.size() == limit) {
+                if (more) *more = true;
+                break;
+            }
+            out.push_back(entry);
+        }
+        exhausted = !nextPosting(cursors[0]);
+    }
+
+    stats.lastSearchUs = micros() - start;
+    return out.size();
+}
+
+bool DirectoryModule::getEntry(uint32_t id, DirectoryEntry& out) {
+    return ready && readRecord(id, out);
+}
+
+bool DirectoryModule::nextPosting(Cursor& cursor) {
+    uint32_t delta = 0;
+    for (int shift = 0; shift <= 28; shift += 7) {
+        if (cursor.at >= cursor.len) {
+            if (cursor.pos >= cursor.end) return false;
+            uint32_t n = cursor.end - cursor.pos;
+            if (n > sizeof(cursor.buf)) n = sizeof(cursor.buf);
+            indexFile.seek(INDEX_DATA_START + cursor.pos);
+            if (indexFile.read(cursor.buf, n) != n) return false;
+            cursor.pos += n;
+            cursor.len = n;
+            cursor.at = 0;
+        }
+
+        uint8_t byte = cursor.buf[cursor.at++];
+        delta |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            cursor.id += delta;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DirectoryModule::readRecord(uint32_t id, DirectoryEntry& out) {
+    if (id >= stats.stations) return false;
+
+    // Records are contiguous, so the next offset gives the length
+    uint32_t bounds[2];
+    offsetsFile.seek(id * 4);
+    if (id + 1 < stats.stations) {
+        if (offsetsFile.read((uint8_t*)bounds, 8) != 8) return false;
+    } else {
+        if (offsetsFile.read((uint8_t*)bounds, 4) != 4) return false;
+        bounds[1] = stats.recordBytes;
+    }
+
+    uint8_t buf[DIRECTORY_RECORD_MAX];
+    uint32_t len = bounds[1] - bounds[0];
+    if (bounds[1] < bounds[0] || len > sizeof(buf)) return false;
+    recordsFile.seek(bounds[0]);
+    if (recordsFile.read(buf, len) != len) return false;
+
+    String* fields[5] = { &out.name, &out.url, &out.tags, &out.country, &out.countryCode };
+    size_t pos = 1;
+    for (int i = 0; i < buf[0] && i < 5; i++) {
+        if (pos + 2 > len) return false;
+        uint16_t fieldLen = buf[pos] | (buf[pos + 1] << 8);
+        pos += 2;
+        if (pos + fieldLen > len || fieldLen > DIRECTORY_URL_MAX) return false;
+
+        char field[DIRECTORY_URL_MAX + 1];
+        memcpy(field, buf + pos, fieldLen);
+        field[fieldLen] = '\0';
+        *fields[i] = field;
+        pos += fieldLen;
+    }
+
+    out.id = id;
+    return true;
+}
+
+bool DirectoryModule::matches(const DirectoryEntry& entry, char words[][DIRECTORY_WORD_MAX + 1], int wordCount) {
+    const String* fields[4] = { &entry.name, &entry.tags, &entry.country, &entry.countryCode };
+
+    for (int w = 0; w < wordCount; w++) {
+        const char* query = words[w];
+        int queryLen = strlen(query);
+        bool found = false;
+
+        for (int f = 0; f < 4 && !found; f++) {
+            forEachWord(fields[f]->c_str(), [&](const char* word, int len) {
+                if (!found && len >= queryLen && memcmp(word, query, queryLen) == 0) found = true;
+            });
+        }
+        if (!found) return false;
+    }
+    return true;
+}
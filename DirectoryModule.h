@@ -0,0 +1,107 @@
+#ifndef DIRECTORY_MODULE_H
+#define DIRECTORY_MODULE_H
+
+#include <LittleFS.h>
+#include <vector>
+
+// Offline station directory, searchable by name, tags and country.
+//
+// Source: a radio-browser style JSON export (array of station objects) at
+// DIRECTORY_SOURCE_PATH. It is parsed as a stream and turned into:
+//   /directory/records.dat  station records: u8 field count, then
+//                           u16-length-prefixed fields (name, url, tags,
+//                           country, countrycode)
+//   /directory/offsets.dat  u32 record offset per station ID
+//   /directory/index.dat    header, u32 posting offset per key bucket, then
+//                           posting lists (varint-delta station IDs)
+// Keys are the 1- and 2-character prefixes and all trigrams of every word,
+// hashed into DIRECTORY_INDEX_BUCKETS. A query intersects the lists of its
+// keys and checks each candidate record, so hash collisions cost time, never
+// wrong results.
+#define DIRECTORY_SOURCE_PATH "/directory.json"
+#define DIRECTORY_DIR "/directory"
+#define DIRECTORY_INDEX_MAGIC 0x44494247  // "GBID"
+#define DIRECTORY_MAX_STATIONS 65535      // IDs are u16 in the build pass
+#define DIRECTORY_NAME_MAX 64
+#define DIRECTORY_URL_MAX 256
+#define DIRECTORY_TAGS_MAX 96
+#define DIRECTORY_COUNTRY_MAX 32
+#define DIRECTORY_WORD_MAX 24             // longer words are indexed by their start
+#define DIRECTORY_INDEX_BUCKETS 8192      // power of two
+#define DIRECTORY_BUILD_BUDGET 16384      // postings held in RAM per build pass
+#define DIRECTORY_QUERY_WORDS 4
+#define DIRECTORY_QUERY_KEYS 8            // most selective keys used per query
+#define DIRECTORY_VERIFY_MAX 2048         // candidate records checked per query
+#define DIRECTORY_RESULTS_MAX 50
+
+struct DirectoryEntry {
+    uint32_t id;
+    String name;
+    String url;
+    String tags;
+    String country;
+    String countryCode;
+};
+
+struct DirectoryStats {
+    uint32_t stations;
+    uint32_t postings;
+    uint32_t buildMs;        // 0 when the index was reused
+    uint32_t recordBytes;
+    uint32_t indexBytes;
+    uint32_t searches;
+    uint32_t lastSearchUs;
+};
+
+class DirectoryModule {
+public:
+    DirectoryModule();
+
+    bool begin();    // Opens the index, rebuilding it if the export changed
+    bool rebuild();
+    bool isReady();
+
+    // Every query word must prefix a word of the station's name, tags or
+    // country. Results are in export order; more is set when the limit cut
+    // the list short.
+    int search(const String& query, int limit, std::vector<DirectoryEntry>& out, bool* more = nullptr);
+    bool getEntry(uint32_t id, DirectoryEntry& out);
+    const DirectoryStats& getStats();
+
+private:
+    struct IndexHeader {
+        uint32_t magic;
+        uint32_t buckets;
+        uint32_t stations;
+        uint32_t postings;
+        uint32_t sourceSize;   // export size the index was built from
+        uint32_t reserved;
+    };
+
+    // Streams one posting list through a small buffer
+    struct Cursor {
+        uint32_t pos;
+        uint32_t end;
+        uint8_t buf[32];
+        uint8_t len;
+        uint8_t at;
+        int32_t id;
+    };
+
+    File recordsFile;
+    File offsetsFile;
+    File indexFile;
+    bool ready;
+    DirectoryStats stats;
+
+    bool open(uint32_t sourceSize);
+    bool build(File& source);
+    bool writeRecords(File& source, uint16_t* counts);
+    bool writeIndex(const uint16_t* counts, uint32_t sourceSize);
+    bool readRecord(uint32_t id, DirectoryEntry& out);
+    bool matches(const DirectoryEntry& entry, char words[][DIRECTORY_WORD_MAX + 1], int wordCount);
+    bool nextPosting(Cursor& cursor);
+    int collectKeys(const DirectoryEntry& entry, uint16_t* keys, int maxKeys);
+};
+
+#endif
@@ -1,10 +1,26 @@
 #include "DiscoveryModule.h"
 
-DiscoveryModule::DiscoveryModule() 
-    : lastBroadcast(0), isPlaying(false), currentStation("") {
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        devices[i].active = false;
-    }
+static uint32_t readU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void writeU32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+DiscoveryModule::DiscoveryModule(int maxPeers, uint32_t peerTimeoutMs) 
+    : isPlaying(false), currentStation(""), maxPeers(maxPeers < PEER_NONE ? maxPeers : PEER_NONE - 1),
+      peerTimeout(peerTimeoutMs), running(false), outgoingNext(0), nextSeq(1), recentNext(0),
+      lastBroadcast(0), lastTextPeer(0), mdnsRunning(false), txtDirty(false), lastTxt(0),
+      keepaliveWait(DISCOVERY_KEEPALIVE), announceAt(0), announcePending(false), myId(0) {
+    memset(&stats, 0, sizeof(stats));
+    memset(recent, 0, sizeof(recent));
+    for (int i = 0; i < DISCOVERY_CMD_SLOTS; i++) outgoing[i].status.seq = 0;
+    peers.reserve(DISCOVERY_PEERS_INITIAL);
+    index.assign(DISCOVERY_PEERS_INITIAL * 2, PEER_NONE);
 }
 
 bool DiscoveryModule::begin(const char* deviceName) {
@@ -21,6 +37,14 @@ bool DiscoveryModule::begin(const char* deviceName) {
     }
     
     myIP = WiFi.localIP();
+    myId = deviceId(myName.c_str(), myName.length());
+    
+    prefs.begin("discovery", true);
+    myGroup = prefs.getString("group", "");
+    prefs.end();
+    
+    // Peers remember (sender, seq) pairs; a restart must not reuse them
+    nextSeq = random(1, 0x7FFFFFFF);
     
     Serial.print("Discovery: Device name is '");
     Serial.print(myName);
@@ -31,125 +55,881 @@ bool DiscoveryModule::begin(const char* deviceName) {
         Serial.println("Discovery: UDP multicast failed");
         return false;
     }
+#if DISCOVERY_LEGACY
+    if (!legacyUdp.beginMulticast(IPAddress(239, 255, 0, 1), DISCOVERY_LEGACY_PORT)) {
+        Serial.println("Discovery: Legacy port unavailable");
+    }
+#endif
+    
+    startMdns();
     
     Serial.println("Discovery: Started");
+    running = true;
     
-    // Send initial query to discover existing devices
-    broadcast();
+    // Ask existing devices to announce themselves; the query also
+    // introduces us
+    sendBeacon(BEACON_QUERY);
+    lastBroadcast = millis();
     
     return true;
 }
 
+// Called every loop; only a real change costs anything
 void DiscoveryModule::setStatus(bool playing, const char* stationName) {
+    if (!stationName) stationName = "";
+    if (playing == isPlaying && currentStation == stationName) return;
+    
     isPlaying = playing;
-    currentStation = stationName ? String(stationName) : "";
+    currentStation = stationName;
+    stats.changes++;
+    scheduleAnnounce(DISCOVERY_JITTER);
+    txtDirty = true;
 }
 
 void DiscoveryModule::handle() {
     unsigned long now = millis();
     
-    // Broadcast every 30 seconds
-    if (now - lastBroadcast > 30000) {
-        broadcast();
+    // A new address (rejoin after an outage) counts as joining again
+    IPAddress ip = WiFi.localIP();
+    if ((uint32_t)ip != (uint32_t)myIP) {
+        myIP = ip;
+        sendBeacon(BEACON_QUERY);
         lastBroadcast = now;
     }
     
+    if (announcePending) {
+        if ((long)(now - announceAt) >= 0) broadcast();
+    } else if (now - lastBroadcast >= keepaliveWait) {
+        stats.keepalives++;
+        broadcast();
+    }
+    
     // Check for incoming messages
     handleIncoming();
+    retryCommands();
+    
+    if (txtDirty && now - lastTxt >= MDNS_TXT_INTERVAL) updateTxt();
     
     // Clean up stale devices
-    cleanupStale();
+    expireStale();
+}
+
+// Keeps the earliest pending time, so a burst of changes is one packet
+void DiscoveryModule::scheduleAnnounce(unsigned long maxDelay) {
+    unsigned long at = millis() + random(0, maxDelay + 1);
+    if (!announcePending || (long)(at - announceAt) < 0) {
+        announceAt = at;
+        announcePending = true;
+    }
 }
 
 void DiscoveryModule::broadcast() {
-    String status = isPlaying ? "playing" : "paused";
-    String message = "GRIDBEACON|" + myName + "|" + myIP.toString() + "|" + status + "|" + currentStation;
+    announcePending = false;
+    lastBroadcast = millis();
+    keepaliveWait = DISCOVERY_KEEPALIVE - random(0, DISCOVERY_KEEPALIVE / 10);
+    sendBeacon(BEACON_ANNOUNCE);
+    
+    // Older firmware only reads the text format
+    bool textPeers = lastTextPeer != 0 && millis() - lastTextPeer < peerTimeout;
+    if (textPeers) sendText();
+    
+    Serial.print("Discovery: Broadcast ");
+    Serial.print(myName);
+    Serial.println(isPlaying ? " (playing)" : " (paused)");
+}
+
+void DiscoveryModule::sendBeacon(uint8_t type) {
+    BeaconView beacon;
+    memset(&beacon, 0, sizeof(beacon));
+    beacon.deviceId = myId;
+    beacon.type = type;
+    beacon.flags = isPlaying ? BEACON_FLAG_PLAYING : 0;
+    beacon.name = myName.c_str();
+    beacon.nameLen = myName.length() > 255 ? 255 : myName.length();
+    beacon.station = currentStation.c_str();
+    beacon.stationLen = currentStation.length() > 255 ? 255 : currentStation.length();
+    beacon.group = myGroup.c_str();
+    beacon.groupLen = myGroup.length();
+    for (int i = 0; i < 4; i++) beacon.ip[i] = myIP[i];
+    beacon.hasIp = true;
     
+    uint8_t packet[DISCOVERY_PACKET_MAX];
+    int len = encodeBeacon(beacon, packet, sizeof(packet));
     udp.beginMulticastPacket();
-    udp.print(message);
+    udp.write(packet, len);
     udp.endPacket();
+    stats.sent++;
+}
+
+void DiscoveryModule::sendText() {
+#if DISCOVERY_LEGACY
+    char message[DISCOVERY_PACKET_MAX];
+    int len = snprintf(message, sizeof(message), DISCOVERY_TEXT_PREFIX "%s|%u.%u.%u.%u|%s|%s", myName.c_str(),
+                       myIP[0], myIP[1], myIP[2], myIP[3], isPlaying ? "playing" : "paused", currentStation.c_str());
+    if (len >= (int)sizeof(message)) len = sizeof(message) - 1;
     
-    Serial.print("Discovery: Broadcast: ");
-    Serial.println(message);
+    legacyUdp.beginMulticastPacket();
+    legacyUdp.write((const uint8_t*)message, len);
+    legacyUdp.endPacket();
+    stats.sent++;
+#endif
 }
 
+// Drains a few packets per call: a burst of query replies must not wait
+// one loop() each, or overflow the stack's small receive queue
 void DiscoveryModule::handleIncoming() {
-    int packetSize = udp.parsePacket();
-    if (packetSize == 0) return;
+    drain(udp);
+#if DISCOVERY_LEGACY
+    drain(legacyUdp);
+#endif
+}
+
+void DiscoveryModule::drain(WiFiUDP& socket) {
+    for (int i = 0; i < DISCOVERY_RX_BURST; i++) {
+        if (socket.parsePacket() == 0) return;
+        
+        uint8_t buffer[DISCOVERY_PACKET_MAX];
+        int len = socket.read(buffer, sizeof(buffer));
+        if (len > 0) receive(buffer, len, socket.remoteIP());
+    }
+}
+
+// Runs before OTA, whose ArduinoOTA.begin() would otherwise claim the
+// shared "GridBeacon" hostname for every unit
+void DiscoveryModule::startMdns() {
+    hostname = hostnameFor(myName);
+    if (!MDNS.begin(hostname.c_str())) {
+        Serial.println("Discovery: mDNS failed");
+        return;
+    }
+    MDNS.setInstanceName(myName);
+    MDNS.addService("http", "tcp", MDNS_HTTP_PORT);
+    MDNS.addServiceTxt("http", "tcp", "path", "/");
+    MDNS.addService("gridbeacon", "udp", DISCOVERY_PORT);
+    MDNS.addServiceTxt("gridbeacon", "udp", "id", String(myId, HEX));
+    MDNS.addServiceTxt("gridbeacon", "udp", "ver", String(DISCOVERY_VERSION));
     
-    char buffer[256];
-    int len = udp.read(buffer, sizeof(buffer) - 1);
-    if (len <= 0) return;
-    buffer[len] = '\0';
+    // Every key once; updateTxt() then sends only what changed
+    txtStatus = isPlaying ? "playing" : "paused";
+    txtStation = currentStation.substring(0, MDNS_STATION_MAX);
+    txtGroup = myGroup;
+    MDNS.addServiceTxt("gridbeacon", "udp", "status", txtStatus);
+    MDNS.addServiceTxt("gridbeacon", "udp", "station", txtStation);
+    MDNS.addServiceTxt("gridbeacon", "udp", "group", txtGroup);
+    mdnsRunning = true;
     
-    String message = String(buffer);
+    Serial.print("Discovery: mDNS ");
+    Serial.print(hostname);
+    Serial.println(".local");
+}
+
+void DiscoveryModule::updateTxt() {
+    txtDirty = false;
+    lastTxt = millis();
+    if (!mdnsRunning) return;
     
-    // Parse: "GRIDBEACON|name|ip|status|station"
-    if (!message.startsWith("GRIDBEACON|")) return;
+    setTxt("status", txtStatus, isPlaying ? "playing" : "paused");
+    setTxt("station", txtStation, currentStation.substring(0, MDNS_STATION_MAX));
+    setTxt("group", txtGroup, myGroup);
+}
+
+void DiscoveryModule::setTxt(const char* key, String& current, const String& value) {
+    if (current == value) return;
+    current = value;
+    MDNS.addServiceTxt("gridbeacon", "udp", key, value);
+}
+
+// DNS label: lowercase letters, digits and single hyphens, at most 63
+String DiscoveryModule::hostnameFor(const String& name) {
+    String host;
+    for (unsigned int i = 0; i < name.length() && host.length() < 63; i++) {
+        char c = name[i];
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+            host += c;
+        } else if (host.length() > 0 && host[host.length() - 1] != '-') {
+            host += '-';
+        }
+    }
+    while (host.length() > 0 && host[host.length() - 1] == '-') host.remove(host.length() - 1);
+    return host.length() > 0 ? host : String("gridbeacon");
+}
+
+void DiscoveryModule::receive(const uint8_t* data, int len, IPAddress from) {
+    stats.received++;
     
-    int idx1 = message.indexOf('|', 11);
-    int idx2 = message.indexOf('|', idx1 + 1);
-    int idx3 = message.indexOf('|', idx2 + 1);
+    BeaconView beacon;
+    if (!parseBeacon(data, len, beacon) || beacon.type < BEACON_ANNOUNCE || beacon.type > BEACON_ACK) {
+        stats.rejected++;
+        return;
+    }
     
-    if (idx1 < 0 || idx2 < 0 || idx3 < 0) return;
+    // Ignore messages from self
+    if (beacon.deviceId == myId && beacon.nameLen == myName.length() &&
+        memcmp(beacon.name, myName.c_str(), beacon.nameLen) == 0) {
+        return;
+    }
     
-    String name = message.substring(11, idx1);
-    String ipStr = message.substring(idx1 + 1, idx2);
-    String status = message.substring(idx2 + 1, idx3);
-    String station = message.substring(idx3 + 1);
+    // Commands and acks say nothing about the sender's status
+    if (beacon.type == BEACON_COMMAND) {
+        runCommand(beacon);
+        return;
+    }
+    if (beacon.type == BEACON_ACK) {
+        receiveAck(beacon);
+        return;
+    }
     
-    // Ignore messages from self
-    if (name == myName) return;
+    int slot = findDevice(beacon);
+    if (beacon.text) {
+        // Current firmware sends text only as a copy for older peers
+        if (slot >= 0 && !peers[slot].text) return;
+        stats.text++;
+        lastTextPeer = millis();
+        
+        // Older firmware never queries; a new one learns about us from this
+        if (slot < 0) scheduleAnnounce(DISCOVERY_REPLY_JITTER);
+    } else {
+        stats.binary++;
+    }
+    
+    // Everyone answers a query; spread the replies wider on a big site
+    if (beacon.type == BEACON_QUERY) {
+        stats.queries++;
+        scheduleAnnounce(DISCOVERY_REPLY_JITTER + peers.size() * DISCOVERY_REPLY_SPREAD);
+    }
+    
+    IPAddress ip = beacon.hasIp ? IPAddress(beacon.ip[0], beacon.ip[1], beacon.ip[2], beacon.ip[3]) : from;
+    updateDevice(beacon, ip, slot);
+}
+
+// Linear probing from the ID's home bucket; the name settles collisions
+int DiscoveryModule::findDevice(const BeaconView& beacon) {
+    uint32_t mask = index.size() - 1;
+    for (uint32_t i = beacon.deviceId & mask;; i = (i + 1) & mask) {
+        uint16_t slot = index[i];
+        if (slot == PEER_NONE) return -1;
+        const GridBeaconDevice& peer = peers[slot];
+        if (peer.id == beacon.deviceId && peer.name.length() == beacon.nameLen &&
+            memcmp(peer.name.c_str(), beacon.name, beacon.nameLen) == 0) {
+            return slot;
+        }
+    }
+}
+
+// Strings are only rebuilt when a field changed, so a steady peer costs no
+// allocations
+void DiscoveryModule::updateDevice(const BeaconView& beacon, IPAddress ip, int slot) {
+    const char* status = (beacon.flags & BEACON_FLAG_PLAYING) ? "playing" : "paused";
+    
+    if (slot < 0) {
+        addPeer(beacon, ip);
+        return;
+    }
+    
+    // The expiry heap is not touched; expireStale() requeues on demand
+    GridBeaconDevice& device = peers[slot];
+    device.ip = ip;
+    if (device.status != status) device.status = status;
+    assignField(device.station, beacon.station, beacon.stationLen);
+    assignField(device.group, beacon.group, beacon.groupLen);
+    if (!beacon.text) device.text = false;
+    device.lastSeen = millis();
+}
+
+void DiscoveryModule::addPeer(const BeaconView& beacon, IPAddress ip) {
+    if ((int)peers.size() >= maxPeers) {
+        stats.dropped++;
+        return;
+    }
+    
+    int slot = peers.size();
+    peers.emplace_back();
+    GridBeaconDevice& device = peers.back();
+    device.id = beacon.deviceId;
+    assignField(device.name, beacon.name, beacon.nameLen);
+    device.ip = ip;
+    device.status = (beacon.flags & BEACON_FLAG_PLAYING) ? "playing" : "paused";
+    assignField(device.station, beacon.station, beacon.stationLen);
+    assignField(device.group, beacon.group, beacon.groupLen);
+    device.text = beacon.text;
+    device.lastSeen = millis();
+    
+    if (peers.size() * 2 > index.size()) growIndex();
+    indexInsert(slot);
+    
+    ExpiryEntry entry = { device.lastSeen + peerTimeout, (uint16_t)slot };
+    expiry.push_back(entry);
+    heapPos.push_back(expiry.size() - 1);
+    siftUp(expiry.size() - 1);
+    
+    Serial.print("Discovery: Found device '");
+    Serial.print(device.name);
+    Serial.print("' at ");
+    Serial.print(ip);
+    Serial.println(beacon.text ? " (text)" : "");
+}
+
+// Only called for the heap's top entry
+void DiscoveryModule::removePeer(int slot) {
+    // Out of the heap
+    int last = expiry.size() - 1;
+    heapSwap(0, last);
+    expiry.pop_back();
+    if (!expiry.empty()) siftDown(0);
+    
+    // Out of the index, then the last peer fills the hole
+    indexErase(slot);
+    int tail = peers.size() - 1;
+    if (slot != tail) {
+        index[indexFind(tail)] = slot;
+        peers[slot] = std::move(peers[tail]);
+        heapPos[slot] = heapPos[tail];
+        expiry[heapPos[slot]].peer = slot;
+    }
+    peers.pop_back();
+    heapPos.pop_back();
+}
+
+// First peer with this ID; a name collision is not told apart
+const GridBeaconDevice* DiscoveryModule::findPeer(uint32_t id) {
+    uint32_t mask = index.size() - 1;
+    for (uint32_t i = id & mask; index[i] != PEER_NONE; i = (i + 1) & mask) {
+        if (peers[index[i]].id == id) return &peers[index[i]];
+    }
+    return nullptr;
+}
+
+void DiscoveryModule::indexInsert(int slot) {
+    uint32_t mask = index.size() - 1;
+    uint32_t i = peers[slot].id & mask;
+    while (index[i] != PEER_NONE) i = (i + 1) & mask;
+    index[i] = slot;
+}
+
+int DiscoveryModule::indexFind(int slot) {
+    uint32_t mask = index.size() - 1;
+    uint32_t i = peers[slot].id & mask;
+    while (index[i] != slot) i = (i + 1) & mask;
+    return i;
+}
+
+// Backward-shift deletion keeps every probe chain unbroken
+void DiscoveryModule::indexErase(int slot) {
+    uint32_t mask = index.size() - 1;
+    uint32_t hole = indexFind(slot);
+    for (uint32_t i = (hole + 1) & mask; index[i] != PEER_NONE; i = (i + 1) & mask) {
+        uint32_t home = peers[index[i]].id & mask;
+        // Move the entry back unless its home lies cyclically in (hole, i]
+        bool between = hole <= i ? (home > hole && home <= i) : (home > hole || home <= i);
+        if (!between) {
+            index[hole] = index[i];
+            hole = i;
+        }
+    }
+    index[hole] = PEER_NONE;
+}
+
+void DiscoveryModule::growIndex() {
+    index.assign(index.size() * 2, PEER_NONE);
+    for (int slot = 0; slot < (int)peers.size() - 1; slot++) indexInsert(slot);
+}
+
+void DiscoveryModule::heapSwap(int a, int b) {
+    ExpiryEntry entry = expiry[a];
+    expiry[a] = expiry[b];
+    expiry[b] = entry;
+    heapPos[expiry[a].peer] = a;
+    heapPos[expiry[b].peer] = b;
+}
+
+void DiscoveryModule::siftUp(int pos) {
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if ((long)(expiry[pos].due - expiry[parent].due) >= 0) return;
+        heapSwap(pos, parent);
+        pos = parent;
+    }
+}
+
+void DiscoveryModule::siftDown(int pos) {
+    int count = expiry.size();
+    while (true) {
+        int smallest = pos;
+        int left = pos * 2 + 1;
+        int right = left + 1;
+        if (left < count && (long)(expiry[left].due - expiry[smallest].due) < 0) smallest = left;
+        if (right < count && (long)(expiry[right].due - expiry[smallest].due) < 0) smallest = right;
+        if (smallest == pos) return;
+        heapSwap(pos, smallest);
+        pos = smallest;
+    }
+}
+
+void DiscoveryModule::setGroup(const char* group) {
+    String name = group ? group : "";
+    if (name.length() > DISCOVERY_GROUP_MAX) name = name.substring(0, DISCOVERY_GROUP_MAX);
+    if (name == myGroup) return;
     
-    IPAddress ip;
-    if (!ip.fromString(ipStr)) return;
+    myGroup = name;
+    saveGroup();
+    Serial.print("Discovery: Group is '");
+    Serial.print(myGroup);
+    Serial.println("'");
     
-    updateDevice(name, ip, status, station);
+    stats.changes++;
+    txtDirty = true;
+    if (running) scheduleAnnounce(DISCOVERY_JITTER);
 }
 
-void DiscoveryModule::updateDevice(String name, IPAddress ip, String status, String station) {
-    // Find existing device or empty slot
-    int emptySlot = -1;
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        if (devices[i].active && devices[i].name == name) {
-            // Update existing
-            devices[i].ip = ip;
-            devices[i].status = status;
-            devices[i].station = station;
-            devices[i].lastSeen = millis();
+String DiscoveryModule::getGroup() {
+    return myGroup;
+}
+
+void DiscoveryModule::onCommand(CommandHandler handler) {
+    commandHandler = handler;
+}
+
+uint32_t DiscoveryModule::sendCommand(const GroupCommand& command, const String& group) {
+    std::vector<uint32_t> targets;
+    bool self = group.length() == 0 || group == myGroup;
+    for (int i = 0; i < (int)peers.size(); i++) {
+        // Older firmware has no idea what a command is
+        if (peers[i].text) continue;
+        if (group.length() == 0 || peers[i].group == group) targets.push_back(peers[i].id);
+    }
+    return startCommand(command, group.length() == 0 ? BEACON_FLAG_ALL : 0, group, targets, self);
+}
+
+uint32_t DiscoveryModule::sendCommand(const GroupCommand& command, const std::vector<uint32_t>& devices) {
+    std::vector<uint32_t> targets;
+    bool self = false;
+    for (int i = 0; i < (int)devices.size(); i++) {
+        if (devices[i] == myId) self = true;
+        else targets.push_back(devices[i]);
+    }
+    return startCommand(command, 0, "", targets, self);
+}
+
+// Sent at once, then retried from handle(). Our own share runs after the
+// packet is out, so peers do not wait for a slow stream open here.
+uint32_t DiscoveryModule::startCommand(const GroupCommand& command, uint8_t flags, const String& group,
+                                       const std::vector<uint32_t>& devices, bool self) {
+    if (!running || command.op < CMD_PLAY || command.op > CMD_SLEEP) return 0;
+    if (command.op == CMD_STATION && command.urlLen == 0) return 0;
+    // Device lists only; a group command reaches members we have not met
+    bool listed = !(flags & BEACON_FLAG_ALL) && group.length() == 0;
+    if (group.length() > DISCOVERY_GROUP_MAX || (listed && devices.size() > DISCOVERY_CMD_TARGETS)) return 0;
+    
+    std::vector<uint8_t> ids;
+    if (listed) {
+        ids.resize(devices.size() * 4);
+        for (int i = 0; i < (int)devices.size(); i++) writeU32(ids.data() + i * 4, devices[i]);
+    }
+    
+    BeaconView beacon;
+    memset(&beacon, 0, sizeof(beacon));
+    beacon.deviceId = myId;
+    beacon.type = BEACON_COMMAND;
+    beacon.flags = flags;
+    beacon.name = myName.c_str();
+    beacon.nameLen = myName.length() > 255 ? 255 : myName.length();
+    beacon.group = group.c_str();
+    beacon.groupLen = group.length();
+    beacon.seq = nextSeq;
+    beacon.command = command;
+    beacon.hasCommand = true;
+    beacon.targets = ids.data();
+    beacon.targetCount = ids.size() / 4;
+    
+    // A cut-short URL or target list would do the wrong thing, so refuse
+    int need = 12 + 2 + beacon.nameLen + 2 + beacon.groupLen + 6 + 5 + 2 + command.urlLen + 2 + beacon.targetCount * 4;
+    if (need > DISCOVERY_PACKET_MAX) {
+        Serial.println("Discovery: Command too large");
+        return 0;
+    }
+    
+    OutgoingCommand& out = outgoing[outgoingNext];
+    outgoingNext = (outgoingNext + 1) % DISCOVERY_CMD_SLOTS;
+    out.packet.resize(DISCOVERY_PACKET_MAX);
+    out.packet.resize(encodeBeacon(beacon, out.packet.data(), out.packet.size()));
+    
+    CommandStatus& status = out.status;
+    status.seq = nextSeq;
+    status.targets = devices;
+    status.results.assign(devices.size(), CMD_PENDING);
+    status.self = CMD_NONE;
+    status.tries = 1;
+    status.done = devices.empty();
+    out.sentAt = millis();
+    out.nextSend = out.sentAt + DISCOVERY_CMD_RETRY;
+    if (++nextSeq == 0) nextSeq = 1;
+    
+    // Nothing to send when the list named only this device
+    if (!listed || !devices.empty()) {
+        udp.beginMulticastPacket();
+        udp.write(out.packet.data(), out.packet.size());
+        udp.endPacket();
+        stats.sent++;
+        stats.commandsSent++;
+        
+        Serial.print("Discovery: Command ");
+        Serial.print(status.seq);
+        Serial.print(" to ");
+        Serial.print(devices.size());
+        Serial.println(" peer(s)");
+    }
+    
+    if (self) {
+        stats.commandsRun++;
+        CommandTicket ticket = { myId, status.seq };
+        status.self = commandHandler ? commandHandler(command, ticket) : CMD_FAILED;
+    }
+    return status.seq;
+}
+
+// Runs a command once per (sender, seq); every copy is acknowledged, since
+// a repeat means our last ack went missing
+void DiscoveryModule::runCommand(const BeaconView& beacon) {
+    bool target = (beacon.flags & BEACON_FLAG_ALL) || (beacon.groupLen > 0 && inGroup(beacon.group, beacon.groupLen));
+    for (int i = 0; !target && i < beacon.targetCount; i++) {
+        target = readU32(beacon.targets + i * 4) == myId;
+    }
+    if (!target) return;
+    if (!beacon.hasCommand || beacon.seq == 0) {
+        stats.rejected++;
+        return;
+    }
+    
+    for (int i = 0; i < DISCOVERY_CMD_RECENT; i++) {
+        if (recent[i].seq == beacon.seq && recent[i].sender == beacon.deviceId) {
+            stats.duplicates++;
+            sendAck(beacon.deviceId, beacon.seq, recent[i].result);
             return;
         }
-        if (!devices[i].active && emptySlot < 0) {
-            emptySlot = i;
+    }
+    
+    stats.commandsRun++;
+    CommandTicket ticket = { beacon.deviceId, beacon.seq };
+    uint8_t result = commandHandler ? commandHandler(beacon.command, ticket) : CMD_FAILED;
+    RecentCommand& entry = recent[recentNext];
+    recentNext = (recentNext + 1) % DISCOVERY_CMD_RECENT;
+    entry.sender = beacon.deviceId;
+    entry.seq = beacon.seq;
+    entry.result = result;
+    sendAck(beacon.deviceId, beacon.seq, result);
+}
+
+// The final result of a command the handler accepted: kept for repeats
+// and sent at once, since the sender is waiting for it
+void DiscoveryModule::completeCommand(const CommandTicket& ticket, bool ok) {
+    uint8_t result = ok ? CMD_OK : CMD_FAILED;
+    if (ticket.sender == myId) {
+        for (int s = 0; s < DISCOVERY_CMD_SLOTS; s++) {
+            if (outgoing[s].status.seq == ticket.seq && outgoing[s].status.self == CMD_ACCEPTED) {
+                outgoing[s].status.self = result;
+            }
         }
+        return;
     }
     
-    // Add new device
-    if (emptySlot >= 0) {
-        devices[emptySlot].name = name;
-        devices[emptySlot].ip = ip;
-        devices[emptySlot].status = status;
-        devices[emptySlot].station = station;
-        devices[emptySlot].lastSeen = millis();
-        devices[emptySlot].active = true;
+    for (int i = 0; i < DISCOVERY_CMD_RECENT; i++) {
+        if (recent[i].seq == ticket.seq && recent[i].sender == ticket.sender) recent[i].result = result;
+    }
+    if (running) sendAck(ticket.sender, ticket.seq, result);
+}
+
+void DiscoveryModule::sendAck(uint32_t to, uint32_t seq, uint8_t result) {
+    uint8_t sender[4];
+    writeU32(sender, to);
+    
+    BeaconView beacon;
+    memset(&beacon, 0, sizeof(beacon));
+    beacon.deviceId = myId;
+    beacon.type = BEACON_ACK;
+    beacon.name = myName.c_str();
+    beacon.nameLen = myName.length() > 255 ? 255 : myName.length();
+    beacon.seq = seq;
+    beacon.targets = sender;
+    beacon.targetCount = 1;
+    beacon.result = result;
+    
+    uint8_t packet[DISCOVERY_PACKET_MAX];
+    int len = encodeBeacon(beacon, packet, sizeof(packet));
+    udp.beginMulticastPacket();
+    udp.write(packet, len);
+    udp.endPacket();
+    stats.sent++;
+}
+
+// Acks from devices we did not list (group members not yet met) are added
+void DiscoveryModule::receiveAck(const BeaconView& beacon) {
+    if (beacon.targetCount != 1 || readU32(beacon.targets) != myId) return;
+    if (beacon.result != CMD_OK && beacon.result != CMD_FAILED && beacon.result != CMD_ACCEPTED) return;
+    
+    for (int s = 0; s < DISCOVERY_CMD_SLOTS; s++) {
+        CommandStatus& status = outgoing[s].status;
+        if (status.seq == 0 || status.seq != beacon.seq) continue;
+        stats.acks++;
         
-        Serial.print("Discovery: Found device '");
-        Serial.print(name);
-        Serial.print("' at ");
-        Serial.println(ip);
+        int open = 0;
+        bool found = false;
+        for (int i = 0; i < (int)status.targets.size(); i++) {
+            if (status.targets[i] == beacon.deviceId) {
+                // A late copy of the receipt must not hide the final result
+                if (beacon.result != CMD_ACCEPTED || status.results[i] == CMD_PENDING) status.results[i] = beacon.result;
+                found = true;
+            }
+            if (status.results[i] == CMD_PENDING || status.results[i] == CMD_ACCEPTED) open++;
+        }
+        if (!found) {
+            status.targets.push_back(beacon.deviceId);
+            status.results.push_back(beacon.result);
+            if (beacon.result == CMD_ACCEPTED) open++;
+        }
+        if (open == 0) status.done = true;
+        return;
     }
 }
 
-void DiscoveryModule::cleanupStale() {
+void DiscoveryModule::retryCommands() {
     unsigned long now = millis();
+    for (int s = 0; s < DISCOVERY_CMD_SLOTS; s++) {
+        OutgoingCommand& out = outgoing[s];
+        if (out.status.seq == 0 || out.status.done || (long)(now - out.nextSend) < 0) continue;
+        
+        int pending = 0;
+        int accepted = 0;
+        for (int i = 0; i < (int)out.status.results.size(); i++) {
+            if (out.status.results[i] == CMD_PENDING) pending++;
+            if (out.status.results[i] == CMD_ACCEPTED) accepted++;
+        }
+        
+        // Silent targets get the quick retries; accepted ones are asked
+        // again now and then for the result of what they queued
+        unsigned long wait;
+        if (pending > 0 && out.status.tries < DISCOVERY_CMD_TRIES) {
+            wait = DISCOVERY_CMD_RETRY;
+        } else if (accepted > 0 && now - out.sentAt < DISCOVERY_CMD_WAIT) {
+            wait = DISCOVERY_CMD_POLL;
+        } else {
+            out.status.done = true;
+            Serial.print("Discovery: Command ");
+            Serial.print(out.status.seq);
+            Serial.println(accepted > 0 ? " gave up waiting for results" : " gave up on silent peers");
+            continue;
+        }
+        
+        udp.beginMulticastPacket();
+        udp.write(out.packet.data(), out.packet.size());
+        udp.endPacket();
+        stats.sent++;
+        out.status.tries++;
+        out.nextSend = now + wait;
+    }
+}
+
+const CommandStatus* DiscoveryModule::getCommandStatus(uint32_t seq) {
+    for (int s = 0; s < DISCOVERY_CMD_SLOTS; s++) {
+        if (seq != 0 && outgoing[s].status.seq == seq) return &outgoing[s].status;
+    }
+    return nullptr;
+}
+
+bool DiscoveryModule::inGroup(const char* group, int len) {
+    return myGroup.length() == (unsigned int)len && memcmp(myGroup.c_str(), group, len) == 0;
+}
+
+void DiscoveryModule::assignField(String& field, const char* value, int len) {
+    if (field.length() == (unsigned int)len && memcmp(field.c_str(), value, len) == 0) return;
+    field = "";
+    field.concat(value, len);
+}
+
+// The last field is cut short rather than dropped when the packet is full
+static int putTlv(uint8_t* out, int pos, int size, uint8_t type, const void* value, int len) {
+    if (len > size - pos - 2) len = size - pos - 2;
+    if (len < 0) return pos;
+    out[pos] = type;
+    out[pos + 1] = len;
+    memcpy(out + pos + 2, value, len);
+    return pos + 2 + len;
+}
+
+int DiscoveryModule::encodeBeacon(const BeaconView& beacon, uint8_t* out, int size) {
+    if (size < 12) return 0;
+    writeU32(out, DISCOVERY_MAGIC);
+    out[4] = DISCOVERY_VERSION;
+    out[5] = beacon.type;
+    out[6] = beacon.flags;
+    out[7] = 0;
+    writeU32(out + 8, beacon.deviceId);
+    
+    int pos = putTlv(out, 12, size, TLV_NAME, beacon.name, beacon.nameLen);
+    if (beacon.hasIp) pos = putTlv(out, pos, size, TLV_IP, beacon.ip, 4);
+    if (beacon.groupLen) pos = putTlv(out, pos, size, TLV_GROUP, beacon.group, beacon.groupLen);
+    if (beacon.seq) {
+        uint8_t seq[4];
+        writeU32(seq, beacon.seq);
+        pos = putTlv(out, pos, size, TLV_SEQ, seq, 4);
+    }
+    if (beacon.hasCommand) {
+        uint8_t command[3] = { beacon.command.op, (uint8_t)beacon.command.value, (uint8_t)(beacon.command.value >> 8) };
+        pos = putTlv(out, pos, size, TLV_COMMAND, command, 3);
+        if (beacon.command.urlLen) pos = putTlv(out, pos, size, TLV_URL, beacon.command.url, beacon.command.urlLen);
+    }
+    if (beacon.targetCount) pos = putTlv(out, pos, size, TLV_TARGETS, beacon.targets, beacon.targetCount * 4);
+    if (beacon.type == BEACON_ACK) pos = putTlv(out, pos, size, TLV_RESULT, &beacon.result, 1);
     
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        if (devices[i].active && (now - devices[i].lastSeen > DEVICE_TIMEOUT)) {
-            Serial.print("Discovery: Device '");
-            Serial.print(devices[i].name);
-            Serial.println("' timed out");
-            devices[i].active = false;
+    // Last, so a long station name is what gets cut
+    if (beacon.station) pos = putTlv(out, pos, size, TLV_STATION, beacon.station, beacon.stationLen);
+    return pos;
+}
+
+bool DiscoveryModule::parseBeacon(const uint8_t* data, int len, BeaconView& out) {
+    memset(&out, 0, sizeof(out));
+    if (len < 12 || readU32(data) != DISCOVERY_MAGIC) {
+        return parseText((const char*)data, len, out);
+    }
+    
+    // Newer versions keep this header and only add TLVs
+    if (data[4] < DISCOVERY_VERSION) return false;
+    out.type = data[5];
+    out.flags = data[6];
+    out.deviceId = readU32(data + 8);
+    out.result = CMD_NONE;
+    
+    int pos = 12;
+    while (pos + 2 <= len) {
+        uint8_t type = data[pos];
+        uint8_t n = data[pos + 1];
+        const uint8_t* value = data + pos + 2;
+        if (pos + 2 + n > len) return false;
+        
+        switch (type) {
+            case TLV_NAME:
+                out.name = (const char*)value;
+                out.nameLen = n;
+                break;
+            case TLV_IP:
+                if (n == 4) {
+                    memcpy(out.ip, value, 4);
+                    out.hasIp = true;
+                }
+                break;
+            case TLV_STATION:
+                out.station = (const char*)value;
+                out.stationLen = n;
+                break;
+            case TLV_GROUP:
+                out.group = (const char*)value;
+                out.groupLen = n;
+                break;
+            case TLV_SEQ:
+                if (n == 4) out.seq = readU32(value);
+                break;
+            case TLV_COMMAND:
+                if (n == 3) {
+                    out.command.op = value[0];
+                    out.command.value = value[1] | (value[2] << 8);
+                    out.hasCommand = true;
+                }
+                break;
+            case TLV_URL:
+                out.command.url = (const char*)value;
+                out.command.urlLen = n;
+                break;
+            case TLV_TARGETS:
+                if (n % 4 == 0) {
+                    out.targets = value;
+                    out.targetCount = n / 4;
+                }
+                break;
+            case TLV_RESULT:
+                if (n == 1) out.result = value[0];
+                break;
         }
+        pos += 2 + n;
+    }
+    return out.nameLen > 0;
+}
+
+// "GRIDBEACON|name|ip|status|station", split in place; the station is the
+// rest of the packet
+bool DiscoveryModule::parseText(const char* data, int len, BeaconView& out) {
+    const int prefixLen = sizeof(DISCOVERY_TEXT_PREFIX) - 1;
+    if (len < prefixLen || memcmp(data, DISCOVERY_TEXT_PREFIX, prefixLen) != 0) return false;
+    
+    const char* field[3];
+    int fieldLen[3];
+    const char* p = data + prefixLen;
+    const char* end = data + len;
+    for (int i = 0; i < 3; i++) {
+        const char* bar = (const char*)memchr(p, '|', end - p);
+        if (!bar) return false;
+        field[i] = p;
+        fieldLen[i] = bar - p;
+        p = bar + 1;
+    }
+    if (fieldLen[0] == 0 || fieldLen[0] > 255 || end - p > 255) return false;
+    
+    // Dotted quad
+    const char* ip = field[1];
+    const char* ipEnd = ip + fieldLen[1];
+    for (int octet = 0; octet < 4; octet++) {
+        int value = 0;
+        int digits = 0;
+        while (ip < ipEnd && *ip >= '0' && *ip <= '9' && digits < 3) {
+            value = value * 10 + (*ip++ - '0');
+            digits++;
+        }
+        if (digits == 0 || value > 255) return false;
+        out.ip[octet] = value;
+        if (octet < 3 && (ip >= ipEnd || *ip++ != '.')) return false;
+    }
+    if (ip != ipEnd) return false;
+    out.hasIp = true;
+    
+    out.type = BEACON_ANNOUNCE;
+    out.text = true;
+    out.name = field[0];
+    out.nameLen = fieldLen[0];
+    out.deviceId = deviceId(out.name, out.nameLen);
+    if (fieldLen[2] == 7 && memcmp(field[2], "playing", 7) == 0) out.flags |= BEACON_FLAG_PLAYING;
+    out.station = p;
+    out.stationLen = end - p;
+    return true;
+}
+
+// FNV-1a
+uint32_t DiscoveryModule::deviceId(const char* name, int len) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Only the earliest deadline is looked at. An entry whose peer was heard
+// since it was queued moves to the peer's real deadline instead.
+void DiscoveryModule::expireStale() {
+    unsigned long now = millis();
+    
+    while (!expiry.empty() && (long)(now - expiry[0].due) >= 0) {
+        int slot = expiry[0].peer;
+        unsigned long due = peers[slot].lastSeen + peerTimeout;
+        if ((long)(now - due) < 0) {
+            expiry[0].due = due;
+            siftDown(0);
+            continue;
+        }
+        
+        Serial.print("Discovery: Device '");
+        Serial.print(peers[slot].name);
+        Serial.println("' timed out");
+        stats.expired++;
+        removePeer(slot);
     }
 }
 
@@ -157,16 +937,24 @@ String DiscoveryModule::getDeviceName() {
     return myName;
 }
 
+String DiscoveryModule::getHostname() {
+    return hostname;
+}
+
+uint32_t DiscoveryModule::getDeviceId() {
+    return myId;
+}
+
 int DiscoveryModule::getDeviceCount() {
-    int count = 0;
-    for (int i = 0; i < MAX_DEVICES; i++) {
-        if (devices[i].active) count++;
-    }
-    return count;
+    return peers.size();
 }
 
 GridBeaconDevice* DiscoveryModule::getDevices() {
-    return devices;
+    return peers.data();
+}
+
+const DiscoveryStats& DiscoveryModule::getStats() {
+    return stats;
 }
 
 void DiscoveryModule::saveDeviceName(const char* name) {
@@ -175,6 +963,12 @@ void DiscoveryModule::saveDeviceName(const char* name) {
     prefs.end();
 }
 
+void DiscoveryModule::saveGroup() {
+    prefs.begin("discovery", false);
+    prefs.putString("group", myGroup);
+    prefs.end();
+}
+
 String DiscoveryModule::loadDeviceName() {
     prefs.begin("discovery", true);
     String name = prefs.getString("name", "");
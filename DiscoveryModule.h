@@ -4,52 +4,315 @@
 #include <WiFi.h>
 #include <WiFiUdp.h>
 #include <Preferences.h>
+#include <ESPmDNS.h>
+#include <vector>
+#include <functional>
 
-#define DISCOVERY_PORT 5353
+#define DISCOVERY_PORT 45353          // off 5353, which belongs to mDNS
 #define DISCOVERY_MULTICAST "239.255.0.1"
-#define MAX_DEVICES 10
 #define DEVICE_TIMEOUT 120000  // 2 minutes
 
+// Firmware before the binary beacon sent text beacons to port 5353. With
+// DISCOVERY_LEGACY a second socket still talks text with such units there;
+// it also receives the LAN's mDNS traffic, so it is off by default.
+#ifndef DISCOVERY_LEGACY
+#define DISCOVERY_LEGACY 0
+#endif
+#define DISCOVERY_LEGACY_PORT 5353
+
+// mDNS/DNS-SD: <hostname>.local with _http._tcp (web UI) and _gridbeacon._udp
+// (this protocol, TXT: id, ver, status, station, group). The ESP-IDF
+// responder answers queries, probes the name and applies known-answer
+// suppression. Each TXT change is announced to the LAN, so status changes
+// are passed on at most every MDNS_TXT_INTERVAL, and only changed values.
+#define MDNS_TXT_INTERVAL 2000       // ms
+#define MDNS_STATION_MAX 48          // TXT station value, bytes
+#define MDNS_HTTP_PORT 80
+
+// Peer table: dense array, open-addressing index on the device ID and a
+// min-heap of expiry times, so lookups and the per-loop expiry check cost
+// the same with 5 peers or 200. Grows on demand up to the constructor's
+// maxPeers.
+#define DISCOVERY_MAX_PEERS 256
+#define DISCOVERY_PEERS_INITIAL 16
+#define DISCOVERY_RX_BURST 8         // packets read per handle()
+#define PEER_NONE 0xFFFF
+
+// Announcements are event driven: a status change is announced within
+// DISCOVERY_JITTER (random, so peers reacting to the same event do not
+// collide), otherwise a keepalive goes out every DISCOVERY_KEEPALIVE, which
+// leaves room for one lost keepalive before DEVICE_TIMEOUT. A node that
+// joins (or rejoins with a new IP) multicasts a query; peers answer with an
+// announcement within DISCOVERY_REPLY_JITTER.
+#define DISCOVERY_KEEPALIVE 55000    // ms, less up to 10% jitter
+#define DISCOVERY_JITTER 100         // ms, max delay of a change announcement
+#define DISCOVERY_REPLY_JITTER 250   // ms, max delay of a query reply
+#define DISCOVERY_REPLY_SPREAD 4     // ms of reply window added per known peer
+
+// Beacon v1, little-endian, parsed in place from the receive buffer:
+//   u32 magic "GBDP", u8 version, u8 type, u8 flags, u8 reserved,
+//   u32 device ID (FNV-1a of the name), then TLVs (u8 type, u8 length,
+//   value). Unknown TLV types are skipped so later versions can add fields.
+// Text beacons from older firmware ("GRIDBEACON|name|ip|status|station")
+// are still understood, and answered in text while such a peer is around.
+#define DISCOVERY_MAGIC 0x50444247  // "GBDP"
+#define DISCOVERY_VERSION 1
+#define DISCOVERY_PACKET_MAX 512     // room for a station URL in a command
+#define DISCOVERY_TEXT_PREFIX "GRIDBEACON|"
+#define BEACON_ANNOUNCE 1
+#define BEACON_QUERY 2              // announce yourselves; carries the sender
+#define BEACON_COMMAND 3            // group command, see below
+#define BEACON_ACK 4
+#define BEACON_FLAG_PLAYING 0x01
+#define BEACON_FLAG_ALL 0x02        // command: every device
+#define TLV_NAME 1                  // UTF-8, no terminator
+#define TLV_IP 2                    // 4 bytes, network order
+#define TLV_STATION 3
+#define TLV_GROUP 4                 // announce: own group; command: target group
+#define TLV_SEQ 5                   // u32
+#define TLV_COMMAND 6               // u8 op, u16 value
+#define TLV_URL 7
+#define TLV_TARGETS 8               // u32 device IDs (command), the sender (ack)
+#define TLV_RESULT 9                // u8 CMD_OK / CMD_FAILED / CMD_ACCEPTED
+
+// Group commands ride the discovery socket. A BEACON_COMMAND names its
+// targets (every device, a group, or device IDs) and carries a sequence
+// number. A target runs it once however often it arrives and acknowledges
+// every copy; the sender repeats it while targets it knows of are silent,
+// every DISCOVERY_CMD_RETRY, DISCOVERY_CMD_TRIES times in all. A command
+// that takes longer than a packet round trip (a station change) is acked
+// CMD_ACCEPTED on receipt and CMD_OK / CMD_FAILED once it has run; the
+// sender asks again every DISCOVERY_CMD_POLL until that final result, for
+// up to DISCOVERY_CMD_WAIT, and repeats are answered with the latest
+// result. No authentication, like the web UI.
+#define CMD_PLAY 1
+#define CMD_PAUSE 2
+#define CMD_STATION 3               // url; also starts playback
+#define CMD_VOLUME 4                // value: thousandths
+#define CMD_SLEEP 5                 // value: minutes, 0 cancels
+#define CMD_OK 0
+#define CMD_FAILED 1
+#define CMD_PENDING 2               // no ack (yet)
+#define CMD_NONE 3                  // this device was not a target
+#define CMD_ACCEPTED 4              // queued; the result follows
+#define DISCOVERY_CMD_RETRY 250      // ms
+#define DISCOVERY_CMD_TRIES 4
+#define DISCOVERY_CMD_POLL 2000      // ms, while targets have only accepted
+#define DISCOVERY_CMD_WAIT 45000     // ms, a playlist resolve and two stream opens
+#define DISCOVERY_CMD_SLOTS 4        // commands tracked; status kept until reused
+#define DISCOVERY_CMD_RECENT 16      // (sender, seq) pairs remembered for dedup
+#define DISCOVERY_CMD_TARGETS 48     // device IDs per command
+#define DISCOVERY_GROUP_MAX 20
+
 struct GridBeaconDevice {
+    uint32_t id;        // FNV-1a of the name
     String name;
     IPAddress ip;
     String status;      // "playing" or "paused"
     String station;     // current station name
+    String group;       // empty = none
+    bool text;          // only speaks the legacy text format
     unsigned long lastSeen;
-    bool active;
+};
+
+struct GroupCommand {
+    uint8_t op;         // CMD_*
+    uint16_t value;
+    const char* url;    // CMD_STATION; into the packet on receipt
+    uint8_t urlLen;
+};
+
+// Names a received command for completeCommand()
+struct CommandTicket {
+    uint32_t sender;    // our own ID for our own share
+    uint32_t seq;
+};
+
+// A received beacon; strings and targets point into the packet buffer
+struct BeaconView {
+    uint32_t deviceId;
+    uint8_t type;
+    uint8_t flags;
+    const char* name;
+    uint8_t nameLen;
+    const char* station;
+    uint8_t stationLen;
+    const char* group;
+    uint8_t groupLen;
+    uint8_t ip[4];
+    bool hasIp;
+    bool text;          // legacy text format
+    uint32_t seq;
+    GroupCommand command;
+    bool hasCommand;
+    const uint8_t* targets;  // little-endian u32s
+    uint8_t targetCount;
+    uint8_t result;
+};
+
+// A sent command; results[i] (CMD_*) belongs to targets[i]
+struct CommandStatus {
+    uint32_t seq;       // 0 = unused
+    std::vector<uint32_t> targets;
+    std::vector<uint8_t> results;
+    uint8_t self;       // result on this device, CMD_NONE if not a target
+    uint8_t tries;
+    bool done;          // all answered finally, or out of time
+};
+
+struct DiscoveryStats {
+    uint32_t received;
+    uint32_t binary;
+    uint32_t text;
+    uint32_t rejected;  // malformed or foreign packets
+    uint32_t sent;
+    uint32_t changes;   // status changes announced
+    uint32_t keepalives;
+    uint32_t queries;   // received from joining peers
+    uint32_t expired;
+    uint32_t dropped;   // new peers refused with the table full
+    uint32_t commandsSent;
+    uint32_t commandsRun;
+    uint32_t duplicates; // repeated commands answered without running
+    uint32_t acks;
 };
 
 class DiscoveryModule {
 public:
-    DiscoveryModule();
+    DiscoveryModule(int maxPeers = DISCOVERY_MAX_PEERS, uint32_t peerTimeoutMs = DEVICE_TIMEOUT);
     
     bool begin(const char* deviceName);
-    void setStatus(bool playing, const char* stationName);
+    void setStatus(bool playing, const char* stationName);  // cheap when nothing changed
     void handle();  // Call in loop
     
     String getDeviceName();
+    String getHostname();            // mDNS, without ".local"
+    uint32_t getDeviceId();
     int getDeviceCount();
-    GridBeaconDevice* getDevices();
+    GridBeaconDevice* getDevices();  // getDeviceCount() entries, all live
+    const DiscoveryStats& getStats();
+    
+    const GridBeaconDevice* findPeer(uint32_t id);
+    
+    // Group membership, announced to peers and saved
+    void setGroup(const char* group);
+    String getGroup();
+    
+    // Group control. The handler runs commands addressed to this device,
+    // including our own, and returns CMD_OK or CMD_FAILED, or CMD_ACCEPTED
+    // after queuing the work, which then reports with completeCommand().
+    // send*() return the sequence number, 0 on failure.
+    typedef std::function<uint8_t(const GroupCommand&, const CommandTicket&)> CommandHandler;
+    void onCommand(CommandHandler handler);
+    void completeCommand(const CommandTicket& ticket, bool ok);
+    uint32_t sendCommand(const GroupCommand& command, const String& group);  // "" = every device
+    uint32_t sendCommand(const GroupCommand& command, const std::vector<uint32_t>& devices);
+    const CommandStatus* getCommandStatus(uint32_t seq);
+    
+    // handle() runs both; public for the host benchmark
+    void receive(const uint8_t* data, int len, IPAddress from);
+    void expireStale();
+    
+    // Packet codec, no heap use; also used by the host benchmark
+    static bool parseBeacon(const uint8_t* data, int len, BeaconView& out);
+    static int encodeBeacon(const BeaconView& beacon, uint8_t* out, int size);
+    static uint32_t deviceId(const char* name, int len);
     
 private:
     WiFiUDP udp;
+#if DISCOVERY_LEGACY
+    WiFiUDP legacyUdp;
+#endif
     Preferences prefs;
     String myName;
     IPAddress myIP;
     bool isPlaying;
     String currentStation;
     
-    GridBeaconDevice devices[MAX_DEVICES];
+    struct ExpiryEntry {
+        unsigned long due;   // lastSeen + timeout when (re)queued
+        uint16_t peer;
+    };
+    
+    std::vector<GridBeaconDevice> peers;
+    std::vector<uint16_t> heapPos;       // per peer: its entry in expiry
+    std::vector<ExpiryEntry> expiry;     // min-heap on due
+    std::vector<uint16_t> index;         // peer slot or PEER_NONE, power-of-two size
+    int maxPeers;
+    uint32_t peerTimeout;
+    
+    // Group commands
+    struct OutgoingCommand {
+        CommandStatus status;
+        std::vector<uint8_t> packet;  // resent as is
+        unsigned long sentAt;
+        unsigned long nextSend;
+    };
+    struct RecentCommand {
+        uint32_t sender;
+        uint32_t seq;
+        uint8_t result;
+    };
+    String myGroup;
+    bool running;
+    CommandHandler commandHandler;
+    OutgoingCommand outgoing[DISCOVERY_CMD_SLOTS];
+    int outgoingNext;
+    uint32_t nextSeq;
+    RecentCommand recent[DISCOVERY_CMD_RECENT];
+    int recentNext;
     unsigned long lastBroadcast;
+    unsigned long lastTextPeer;  // last legacy beacon heard, 0 = never
+    
+    // mDNS; txt* hold what the responder has, so only changes go out
+    String hostname;
+    bool mdnsRunning;
+    bool txtDirty;
+    unsigned long lastTxt;
+    String txtStatus;
+    String txtStation;
+    String txtGroup;
+    unsigned long keepaliveWait; // jittered DISCOVERY_KEEPALIVE
+    unsigned long announceAt;
+    bool announcePending;
+    uint32_t myId;
+    DiscoveryStats stats;
     
     void broadcast();
+    void sendBeacon(uint8_t type);
+    void scheduleAnnounce(unsigned long maxDelay);
     void handleIncoming();
-    void cleanupStale();
-    void updateDevice(String name, IPAddress ip, String status, String station);
+    int findDevice(const BeaconView& beacon);
+    void updateDevice(const BeaconView& beacon, IPAddress ip, int slot);
+    void addPeer(const BeaconView& beacon, IPAddress ip);
+    void removePeer(int slot);
+    void indexInsert(int slot);
+    void indexErase(int slot);
+    int indexFind(int slot);
+    void growIndex();
+    void heapSwap(int a, int b);
+    void siftUp(int pos);
+    void siftDown(int pos);
+    void sendText();
+    void drain(WiFiUDP& socket);
+    void startMdns();
+    void updateTxt();
+    void setTxt(const char* key, String& current, const String& value);
+    static String hostnameFor(const String& name);
+    uint32_t startCommand(const GroupCommand& command, uint8_t flags, const String& group,
+                          const std::vector<uint32_t>& devices, bool self);
+    void runCommand(const BeaconView& beacon);
+    void receiveAck(const BeaconView& beacon);
+    void sendAck(uint32_t to, uint32_t seq, uint8_t result);
+    void retryCommands();
+    bool inGroup(const char* group, int len);
+    static bool parseText(const char* data, int len, BeaconView& out);
+    static void assignField(String& field, const char* value, int len);
     
     // Device name storage
     void saveDeviceName(const char* name);
     String loadDeviceName();
+    void saveGroup();
 };
 
 #endif
\ No newline at end of file
@@ -9,18 +9,171 @@
 #include "WebServerModule.h"
 #include "OTAModule.h"
 #include "DiscoveryModule.h"
+#include "DirectoryModule.h"
+#include "BootTrace.h"
+#include "Scheduler.h"
+#include "HeapMonitor.h"
+#include "Tuner.h"
+
+// Fast boot: no wait for the serial monitor, audio is set up before WiFi
+// (it needs no network), and discovery, OTA and the directory start from
+// loop(), one per pass, once audio runs. Off by default so the first log
+// lines reach a monitor opened after reset.
+#ifndef FAST_BOOT
+#define FAST_BOOT 0
+#endif
+#define BOOT_DEFER_MAX 5000  // ms deferred services wait for the first audio
 
 // Global instances
 WiFiModule wifi;
 LibraryModule library;
 OTAModule ota;
 DiscoveryModule discovery;
+DirectoryModule directory;
+BootTrace boot;
+Scheduler scheduler;
+HeapMonitor heapMonitor;
+Tuner tuner(&library);
 AudioModule* audio = nullptr;
 WebServerModule* webServer = nullptr;
+bool discoveryStarted = false;
+int deferredStage = 0;  // FAST_BOOT: deferred services started so far
+
+void startAudio() {
+  int phase = boot.begin("audio");
+  HeapTag tag(HEAP_AUDIO);
+  Serial.println("Creating AudioModule instance...");
+  audio = new AudioModule(&wifi);  // streams over the link WiFiModule keeps up
+  
+  Serial.println("Calling audio->begin()...");
+  if (audio->begin()) {
+    Serial.println("Audio: initialized (paused)");
+  } else {
+    Serial.println("ERROR: Audio init failed - continuing without audio");
+    delete audio;
+    audio = nullptr;
+  }
+  boot.end(phase);
+}
+
+void startDiscovery() {
+  int phase = boot.begin("discovery");
+  HeapTag tag(HEAP_DISCOVERY);
+  discovery.begin("");  // Empty = load from Preferences
+  discoveryStarted = true;
+  Serial.println("Discovery: OK");
+  boot.end(phase);
+}
+
+void startOTA() {
+  int phase = boot.begin("ota");
+  HeapTag tag(HEAP_OTA);
+  ota.setAudio(audio);  // fades out or throttles around updates
+  ota.begin("GridBeacon");
+  Serial.println("OTA: OK");
+  boot.end(phase);
+}
+
+// Offline station directory (indexes /directory.json on first boot)
+void startDirectory() {
+  int phase = boot.begin("directory");
+  HeapTag tag(HEAP_DIRECTORY);
+  directory.begin();
+  boot.end(phase);
+}
+
+// FAST_BOOT: the services setup() skipped, one per loop() pass. They wait
+// for the first audio so they never delay it; a paused or failed player
+// does not hold them back.
+void startDeferred() {
+  bool audioSettled = audio == nullptr || !audio->isPlaying() || audio->getStreamStats().firstAudioMs != 0 ||
+                      millis() - boot.getReadyMs() > BOOT_DEFER_MAX;
+  if (!audioSettled) return;
+  
+  bool station = wifi.getMode() == MODE_STATION;
+  switch (deferredStage++) {
+    case 0: if (station) startDiscovery(); break;
+    case 1: if (station) startOTA(); break;
+    case 2: startDirectory(); break;
+  }
+}
+
+// loop()'s work, audio first; budgets are per run, in microseconds. Each
+// task tags what it allocates with its module (see /heap).
+void registerTasks() {
+  // Blocks in I2S for up to a frame (26 ms) once the buffer is full
+  scheduler.add("audio", PRIORITY_AUDIO, 0, 30000, []() {
+    if (audio == nullptr) return;
+    HeapTag tag(HEAP_AUDIO);
+    audio->process();
+    if (boot.getFirstAudioMs() == 0 && audio->getStreamStats().firstAudioMs != 0) {
+      boot.firstAudio(audio->getStreamStats().firstAudioMs);
+    }
+  });
+  
+  // OTA (only active in station mode); flash writes show up as overruns
+  scheduler.add("ota", PRIORITY_NETWORK, 0, 2000, []() {
+    HeapTag tag(HEAP_OTA);
+    ota.handle();
+  });
+  
+  // Keep the station link up (rejoin, roam); never blocks
+  scheduler.add("wifi", PRIORITY_NETWORK, 0, 1000, []() {
+    wifi.handle();
+  });
+  
+  scheduler.add("discovery", PRIORITY_NETWORK, 0, 2000, []() {
+    if (!wifi.isConnected() || !discoveryStarted) return;
+    HeapTag tag(HEAP_DISCOVERY);
+    discovery.handle();
+    
+    // Announced only when the state actually changes
+    if (audio != nullptr) {
+      discovery.setStatus(audio->isPlaying(), tuner.getStationName().c_str());
+    }
+  });
+  
+  // Handlers count as web, including what they ask other modules to do
+  scheduler.add("web", PRIORITY_NETWORK, 0, 10000, []() {
+    HeapTag tag(HEAP_WEB);
+    if (webServer != nullptr) webServer->handle();
+  });
+  
+  // Station changes queued by the web UI and group commands, a step per
+  // pass; a resolve hop or a stream open overruns while playback is paused
+  scheduler.add("tune", PRIORITY_NETWORK, 0, 5000, []() {
+    HeapTag tag(HEAP_AUDIO);
+    tuner.handle();
+  });
+  
+  // Accrue listening time; commit library edits once they settle
+  scheduler.add("library", PRIORITY_HOUSEKEEPING, 100, 5000, []() {
+    HeapTag tag(HEAP_LIBRARY);
+    library.notePlayback(audio != nullptr && audio->isPlaying());
+    library.handle();
+  });
+  
+  // Heap and fragmentation samples; one free-list walk per run
+  scheduler.add("heap", PRIORITY_HOUSEKEEPING, HEAP_POLL_INTERVAL, 1000, []() {
+    heapMonitor.handle();
+  });
+  
+  // Fast boot: discovery, OTA, directory
+  if (FAST_BOOT) {
+    scheduler.add("startup", PRIORITY_HOUSEKEEPING, 0, 50000, []() {
+      if (deferredStage < 3) startDeferred();
+    });
+  }
+}
 
 void setup() {
   Serial.begin(115200);
-  delay(2000);  // Longer delay to ensure serial is ready
+  boot.setFastBoot(FAST_BOOT);
+  if (!FAST_BOOT) {
+    int phase = boot.begin("serial");
+    delay(2000);  // Longer delay to ensure serial is ready
+    boot.end(phase);
+  }
   
   Serial.println("\n\n=================================");
   Serial.println("    GridBeacon Starting Up");
@@ -29,8 +182,15 @@ void setup() {
   // Enable audio library logging
   AudioToolsLogger.begin(Serial, AudioToolsLogLevel::Info);
   
+  // I2S and the decoder do not depend on the network
+  if (FAST_BOOT) {
+    Serial.println("Fast boot: audio first, services after");
+    startAudio();
+  }
+  
   // 1. Initialize WiFi (tries stored credentials or starts AP)
   Serial.println("[1/4] Initializing WiFi...");
+  int wifiPhase = boot.begin("wifi");
   if (!wifi.begin()) {
     Serial.println("ERROR: WiFi init failed - halting");
     while(1) { 
@@ -38,54 +198,63 @@ void setup() {
       Serial.print(".");
     }
   }
+  boot.end(wifiPhase);
   Serial.println("WiFi: OK");
   Serial.print("Mode: ");
   Serial.println(wifi.getMode() == MODE_STATION ? "STATION" : "AP");
   
   // 2. If connected to WiFi, initialize audio, discovery, and OTA
   if (wifi.getMode() == MODE_STATION) {
-    Serial.println("\n[2/4] Station Mode - Loading credentials...");
-    char ssid[64], password[64];
-    wifi.loadCredentials(ssid, password, 64);
+    Serial.println("\n[2/4] Station Mode");
     Serial.print("SSID: ");
-    Serial.println(ssid);
-    
-    // Initialize discovery (loads saved room name)
-    Serial.println("\n[3/4] Initializing discovery...");
-    discovery.begin("");  // Empty = load from Preferences
-    Serial.println("Discovery: OK");
+    Serial.println(WiFi.SSID());
     
-    // Initialize audio (starts paused)
-    Serial.println("\n[4/4] Initializing audio...");
-    Serial.println("Creating AudioModule instance...");
-    audio = new AudioModule(ssid, password);
+    // Wall-clock time for the library's last-played stamps
+    configTime(0, 0, "pool.ntp.org");
     
-    Serial.println("Calling audio->begin()...");
-    if (audio->begin()) {
-      Serial.println("Audio: initialized (paused)");
-    } else {
-      Serial.println("ERROR: Audio init failed - continuing without audio");
-      delete audio;
-      audio = nullptr;
+    if (!FAST_BOOT) {
+      // Initialize discovery (loads saved room name)
+      Serial.println("\n[3/4] Initializing discovery...");
+      startDiscovery();
+      
+      // Initialize audio (starts paused)
+      Serial.println("\n[4/4] Initializing audio...");
+      startAudio();
+      
+      // Enable OTA updates
+      Serial.println("\nEnabling OTA updates...");
+      startOTA();
     }
     
-    // Enable OTA updates
-    Serial.println("\nEnabling OTA updates...");
-    ota.begin("GridBeacon");
-    Serial.println("OTA: OK");
-    
   } else {
     Serial.println("\n[2/4] AP Mode - Skipping audio/discovery/OTA");
     Serial.print("Connect to AP: ");
     Serial.println(AP_SSID);
     Serial.print("Password: ");
     Serial.println(AP_PASSWORD);
+    
+    // Set up before the mode was known; nothing to stream in AP mode
+    if (audio != nullptr) {
+      delete audio;
+      audio = nullptr;
+    }
+  }
+  
+  if (!FAST_BOOT) {
+    startDirectory();
   }
   
   // 3. Start web server (works in both AP and station mode)
   Serial.println("\nStarting web server...");
-  webServer = new WebServerModule(&wifi, audio, &library, &discovery);
-  webServer->begin();
+  int webPhase = boot.begin("web");
+  tuner.setAudio(audio);
+  {
+    HeapTag tag(HEAP_WEB);
+    webServer = new WebServerModule(&wifi, audio, &library, &discovery, &directory, &boot, &ota, &scheduler,
+                                    &heapMonitor, &tuner);
+    webServer->begin();
+  }
+  boot.end(webPhase);
   Serial.println("Web server: OK");
   
   Serial.println("\n=================================");
@@ -107,32 +276,11 @@ void setup() {
     Serial.println(WiFi.localIP());
   }
   Serial.println("\n");
+  
+  registerTasks();
+  boot.ready();
 }
 
 void loop() {
-  // Handle OTA (only active in station mode)
-  ota.handle();
-  
-  // Handle device discovery
-  if (wifi.getMode() == MODE_STATION) {
-    discovery.handle();
-    
-    // Update discovery status when audio state changes
-    if (audio != nullptr) {
-      discovery.setStatus(audio->isPlaying(), "Current Station");
-    }
-  }
-  
-  // Handle web requests
-  if (webServer != nullptr) {
-    webServer->handle();
-  }
-  
-  // Process audio stream
-  if (audio != nullptr) {
-    audio->process();
-  }
-  
-  // Small yield to prevent watchdog
-  //yield();
+  scheduler.run();
 }
\ No newline at end of file
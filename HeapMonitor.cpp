@@ -0,0 +1,230 @@
+#include "HeapMonitor.h"
+#include <atomic>
+#include <new>
+
+namespace {
+
+struct ModuleCounters {
+    std::atomic<uint32_t> allocs;
+    std::atomic<uint32_t> frees;
+    std::atomic<uint32_t> liveBytes;
+    std::atomic<uint32_t> peakBytes;
+    std::atomic<uint32_t> failed;
+};
+
+// Zero before any constructor runs, so allocations during static
+// initialisation are counted too
+ModuleCounters counters[HEAP_MODULES];
+
+// Per task: the web or audio tag never leaks into the WiFi or lwIP tasks
+thread_local uint8_t currentModule = HEAP_OTHER;
+
+const char* MODULE_NAMES[HEAP_MODULES] = {
+    "other", "audio", "web", "library", "discovery", "directory", "ota"
+};
+
+}  // namespace
+
+HeapTag::HeapTag(HeapModule module) : previous(currentModule) {
+    currentModule = module;
+}
+
+HeapTag::~HeapTag() {
+    currentModule = previous;
+}
+
+#if HEAP_ACCOUNTING
+
+namespace {
+
+// Keeps malloc()'s alignment: 8 on the ESP32 heap, 16 on a 64-bit host
+const size_t HEADER_SIZE = sizeof(void*) == 4 ? 8 : 16;
+const size_t ALIGN_MAX = 0x8000;  // offset must fit the header's u16
+
+// Sits right before the pointer handed out; offset leads back to the start
+// of the malloc() block, which over-aligned blocks pad out
+struct BlockHeader {
+    uint32_t size;
+    uint8_t module;
+    uint8_t reserved;
+    uint16_t offset;
+};
+
+void* trackedAlloc(size_t size, size_t align = HEADER_SIZE) {
+    uint8_t module = currentModule;
+    ModuleCounters& c = counters[module];
+    if (align < HEADER_SIZE) align = HEADER_SIZE;
+    
+    // Over-aligned: room to move the pointer up to the next boundary
+    size_t pad = align > HEADER_SIZE ? align - 1 : 0;
+    uint8_t* block = align <= ALIGN_MAX ? (uint8_t*)malloc(size + HEADER_SIZE + pad) : nullptr;
+    if (block == nullptr) {
+        c.failed.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    
+    uint8_t* ptr = block + HEADER_SIZE;
+    if (pad > 0) ptr = (uint8_t*)(((uintptr_t)ptr + pad) & ~(uintptr_t)pad);
+    BlockHeader* header = (BlockHeader*)(ptr - HEADER_SIZE);
+    header->size = size;
+    header->module = module;
+    header->offset = ptr - block;
+    c.allocs.fetch_add(1, std::memory_order_relaxed);
+    
+    // Other tasks allocate too: only ever raise the peak
+    uint32_t live = c.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    uint32_t peak = c.peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !c.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+    return ptr;
+}
+
+void trackedFree(void* ptr) {
+    if (ptr == nullptr) return;
+    BlockHeader* header = (BlockHeader*)((uint8_t*)ptr - HEADER_SIZE);
+    ModuleCounters& c = counters[header->module];
+    c.frees.fetch_add(1, std::memory_order_relaxed);
+    c.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+    free((uint8_t*)ptr - header->offset);
+}
+
+void* throwingAlloc(size_t size, size_t align = HEADER_SIZE) {
+    void* ptr = trackedAlloc(size, align);
+    if (ptr == nullptr) {
+#if __cpp_exceptions
+        throw std::bad_alloc();
+#else
+        abort();
+#endif
+    }
+    return ptr;
+}
+
+}  // namespace
+
+void* operator new(size_t size) { return throwingAlloc(size); }
+void* operator new[](size_t size) { return throwingAlloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return trackedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return trackedAlloc(size); }
+void operator delete(void* ptr) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+
+// Over-aligned types (alignas beyond the default) come through these
+#if __cpp_aligned_new
+void* operator new(size_t size, std::align_val_t align) { return throwingAlloc(size, (size_t)align); }
+void* operator new[](size_t size, std::align_val_t align) { return throwingAlloc(size, (size_t)align); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return trackedAlloc(size, (size_t)align);
+}
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return trackedAlloc(size, (size_t)align);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+#endif
+
+#endif
+
+HeapMonitor::HeapMonitor() : head(0), stored(0), lastPoll(0), lastSample(0), lowFree(UINT32_MAX),
+                             lowLargest(UINT32_MAX) {
+    memset(history, 0, sizeof(history));
+}
+
+void HeapMonitor::handle() {
+    unsigned long now = millis();
+    if (stored > 0 && now - lastPoll < HEAP_POLL_INTERVAL) return;
+    lastPoll = now;
+    poll();
+    
+    // First sample at boot, then one per interval
+    if (stored == 0 || now - lastSample >= HEAP_SAMPLE_INTERVAL) {
+        lastSample = now;
+        record();
+    }
+}
+
+void HeapMonitor::poll() {
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largest = ESP.getMaxAllocHeap();
+    if (freeHeap < lowFree) lowFree = freeHeap;
+    if (largest < lowLargest) lowLargest = largest;
+}
+
+void HeapMonitor::record() {
+    HeapSample sample = getCurrent();
+    history[head] = sample;
+    head = (head + 1) % HEAP_HISTORY;
+    if (stored < HEAP_HISTORY) stored++;
+    lowFree = UINT32_MAX;
+    lowLargest = UINT32_MAX;
+
+    Serial.print("Heap: ");
+    Serial.print(sample.freeHeap);
+    Serial.print(" free, largest block ");
+    Serial.print(sample.largestBlock);
+    Serial.print(" (");
+    Serial.print(getFragmentation());
+    Serial.print("% fragmented), low ");
+    Serial.print(sample.lowFree);
+    Serial.print(", ");
+    Serial.print(sample.liveBlocks);
+    Serial.println(" blocks");
+}
+
+HeapSample HeapMonitor::getCurrent() {
+    HeapSample sample;
+    sample.ms = millis();
+    sample.freeHeap = ESP.getFreeHeap();
+    sample.largestBlock = ESP.getMaxAllocHeap();
+    sample.lowFree = lowFree < sample.freeHeap ? lowFree : sample.freeHeap;
+    sample.lowLargest = lowLargest < sample.largestBlock ? lowLargest : sample.largestBlock;
+    sample.liveBlocks = 0;
+    for (int i = 0; i < HEAP_MODULES; i++) {
+        HeapModuleStats stats = getModuleStats((HeapModule)i);
+        sample.liveBlocks += stats.allocs - stats.frees;
+    }
+    return sample;
+}
+
+uint32_t HeapMonitor::getMinEverFree() {
+    return ESP.getMinFreeHeap();
+}
+
+int HeapMonitor::getFragmentation() {
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largest = ESP.getMaxAllocHeap();
+    if (freeHeap == 0 || largest >= freeHeap) return 0;
+    return 100 - (int)((largest * 100ULL) / freeHeap);
+}
+
+int HeapMonitor::getHistoryCount() {
+    return stored;
+}
+
+const HeapSample& HeapMonitor::getHistory(int index) {
+    int oldest = stored < HEAP_HISTORY ? 0 : head;
+    return history[(oldest + index) % HEAP_HISTORY];
+}
+
+const char* HeapMonitor::moduleName(HeapModule module) {
+    return module < HEAP_MODULES ? MODULE_NAMES[module] : "?";
+}
+
+HeapModuleStats HeapMonitor::getModuleStats(HeapModule module) {
+    HeapModuleStats stats;
+    const ModuleCounters& c = counters[module];
+    stats.allocs = c.allocs.load(std::memory_order_relaxed);
+    stats.frees = c.frees.load(std::memory_order_relaxed);
+    stats.liveBytes = c.liveBytes.load(std::memory_order_relaxed);
+    stats.peakBytes = c.peakBytes.load(std::memory_order_relaxed);
+    stats.failed = c.failed.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,98 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+
+// Heap and fragmentation telemetry. Free heap alone hides fragmentation:
+// it can stay flat while the largest free block shrinks until a decoder or
+// TLS buffer no longer fits. Every HEAP_POLL_INTERVAL the monitor reads the
+// free heap and the largest free block and keeps the lowest of each; every
+// HEAP_SAMPLE_INTERVAL that window goes into a ring of HEAP_HISTORY samples
+// (three days), so leaks and fragmentation show as trends. Served at /heap
+// and in /metrics.
+#define HEAP_POLL_INTERVAL 1000      // ms, walks the free list once
+#define HEAP_SAMPLE_INTERVAL 1800000 // 30 min per history sample
+#define HEAP_HISTORY 144             // 24 bytes each
+
+// Per-module accounting: operator new/delete (aligned forms included) are
+// replaced, and each block carries a small header with its size and the
+// module that was running when it was allocated, set with a HeapTag around
+// the module's work.
+// Covers everything C++ allocates (String, vectors, new); C code calling
+// malloc() directly (the MP3 decoder, lwIP, I2S DMA) only shows in the
+// totals. HEAP_ACCOUNTING 0 compiles the hooks out.
+#ifndef HEAP_ACCOUNTING
+#define HEAP_ACCOUNTING 1
+#endif
+
+enum HeapModule {
+    HEAP_OTHER,         // untagged: setup(), other tasks, library internals
+    HEAP_AUDIO,
+    HEAP_WEB,
+    HEAP_LIBRARY,
+    HEAP_DISCOVERY,
+    HEAP_DIRECTORY,
+    HEAP_OTA,
+    HEAP_MODULES
+};
+
+struct HeapModuleStats {
+    uint32_t allocs;
+    uint32_t frees;         // of blocks this module allocated
+    uint32_t liveBytes;     // requested bytes still allocated
+    uint32_t peakBytes;
+    uint32_t failed;        // allocations the heap refused
+};
+
+struct HeapSample {
+    uint32_t ms;            // millis() when taken
+    uint32_t freeHeap;
+    uint32_t largestBlock;
+    uint32_t lowFree;       // lowest polled since the previous sample
+    uint32_t lowLargest;
+    uint32_t liveBlocks;    // tracked blocks, all modules
+};
+
+// Attributes allocations to a module until it goes out of scope:
+//   HeapTag tag(HEAP_AUDIO);
+// Only the task that sets it is affected; scopes nest.
+class HeapTag {
+public:
+    explicit HeapTag(HeapModule module);
+    ~HeapTag();
+
+private:
+    uint8_t previous;
+};
+
+class HeapMonitor {
+public:
+    HeapMonitor();
+
+    void handle();                // polls; call at least every HEAP_POLL_INTERVAL
+
+    HeapSample getCurrent();      // read now, window lows so far
+    uint32_t getMinEverFree();    // allocator's lowest since boot
+    int getFragmentation();       // % of free heap outside the largest block
+
+    // Oldest first; index 0 .. getHistoryCount() - 1
+    int getHistoryCount();
+    const HeapSample& getHistory(int index);
+
+    static const char* moduleName(HeapModule module);
+    static HeapModuleStats getModuleStats(HeapModule module);
+
+private:
+    HeapSample history[HEAP_HISTORY];
+    int head;                     // next slot to write
+    int stored;
+    unsigned long lastPoll;
+    unsigned long lastSample;
+    uint32_t lowFree;
+    uint32_t lowLargest;
+
+    void poll();
+    void record();
+};
+
+#endif
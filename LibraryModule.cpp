@@ -1,85 +1,843 @@
 #include "LibraryModule.h"
+#include <time.h>
 
-LibraryModule::LibraryModule() {}
+#define LIBRARY_RECORD_MAX (1 + 2 + LIBRARY_NAME_MAX + 2 * (2 + LIBRARY_URL_MAX))
+#define LIBRARY_BATCH 16  // index entries read per file access
 
-bool LibraryModule::addStation(const char* name, const char* url) {
-    std::vector<Station> stations = load();
-    
-    if (stations.size() >= MAX_LIBRARY_ENTRIES) {
+LibraryModule::LibraryModule()
+    : generation(0), version(0), highWater(0), liveCount(0), dataSize(0),
+      loaded(false), dirty(false), lastChange(0), compacting(false), compactSlot(0),
+      compactSize(0), compactStart(0), playSeq(0), playVersion(0), pendingCount(0),
+      currentStation(LIBRARY_NO_STATION), lastPlaybackTick(0), lastPlaysCommit(0) {
+    memset(blockLive, 0, sizeof(blockLive));
+    memset(&stats, 0, sizeof(stats));
+    memset(pending, 0, sizeof(pending));
+}
+
+bool LibraryModule::addStation(const char* name, const char* url, uint32_t* idOut) {
+    size_t nameLen = strlen(name);
+    size_t urlLen = strlen(url);
+    if (nameLen == 0 || nameLen > LIBRARY_NAME_MAX || urlLen == 0 || urlLen > LIBRARY_URL_MAX) {
+        Serial.println("Library: invalid name or URL length");
+        return false;
+    }
+
+    // Playlists and redirects are resolved on the first play (see Tuner),
+    // which stores the endpoint with setEndpoint()
+    return insertStation(name, url, "", idOut);
+}
+
+bool LibraryModule::insertStation(const char* name, const char* url, const char* endpoint, uint32_t* idOut) {
+    ensureLoaded();
+    if (!indexFile) return false;
+
+    int slot = findFreeSlot();
+    if (slot < 0) {
         Serial.println("Library full");
         return false;
     }
-    
-    Station newStation;
-    newStation.name = String(name);
-    newStation.url = String(url);
-    
-    stations.push_back(newStation);
-    save(stations);
-    
+
+    Station station;
+    station.name = name;
+    station.url = url;
+    station.endpoint = endpoint;
+
+    uint16_t length;
+    uint32_t offset = appendRecord(station, length);
+    if (length == 0) return false;
+
+    IndexEntry entry = { offset, length, SLOT_LIVE, 0 };
+    if (!writeEntry(slot, entry)) return false;
+
+    blockLive[slot / LIBRARY_BLOCK_SLOTS]++;
+    liveCount++;
+    markDirty(length + sizeof(IndexEntry));
+
+    if (idOut) *idOut = slot;
+
     Serial.print("Added to library: ");
     Serial.println(name);
     return true;
 }
 
-bool LibraryModule::removeStation(int index) {
-    std::vector<Station> stations = load();
-    
-    if (index < 0 || index >= stations.size()) {
+bool LibraryModule::removeStation(uint32_t id) {
+    ensureLoaded();
+
+    IndexEntry entry;
+    if (!readEntry(id, entry) || entry.state != SLOT_LIVE) {
         return false;
     }
-    
-    stations.erase(stations.begin() + index);
-    save(stations);
-    
-    Serial.print("Removed station at index: ");
-    Serial.println(index);
+
+    // Tombstone only; the record becomes garbage until compaction
+    entry.state = SLOT_DELETED;
+    if (!writeEntry(id, entry)) return false;
+
+    blockLive[id / LIBRARY_BLOCK_SLOTS]--;
+    liveCount--;
+    stats.garbageBytes += entry.length;
+    markDirty(sizeof(IndexEntry));
+    resetPlays(id);
+
+    Serial.print("Removed station: ");
+    Serial.println(id);
     return true;
 }
 
-std::vector<Station> LibraryModule::getStations() {
-    return load();
+bool LibraryModule::getStation(uint32_t id, Station& out) {
+    ensureLoaded();
+
+    IndexEntry entry;
+    if (!readEntry(id, entry) || entry.state != SLOT_LIVE) {
+        return false;
+    }
+
+    out.id = id;
+    readPlays(id, 1, &out.play);
+    return readRecord(entry, out);
+}
+
+// A station's URL was resolved (first play, or the stored endpoint went
+// stale): rewrite the record if the result changed.
+bool LibraryModule::setEndpoint(Station& station, const String& endpoint) {
+    ensureLoaded();
+
+    if (endpoint == station.playUrl() || endpoint.length() > LIBRARY_URL_MAX) return false;
+
+    IndexEntry entry;
+    if (!readEntry(station.id, entry) || entry.state != SLOT_LIVE) {
+        return false;
+    }
+
+    station.endpoint = endpoint == station.url ? String("") : endpoint;
+
+    uint16_t length;
+    uint32_t offset = appendRecord(station, length);
+    if (length == 0) return false;
+
+    stats.garbageBytes += entry.length;
+    entry.offset = offset;
+    entry.length = length;
+    if (!writeEntry(station.id, entry)) return false;
+    markDirty(length + sizeof(IndexEntry));
+
+    Serial.print("Library: new endpoint for ");
+    Serial.println(station.name);
+    return true;
+}
+
+int LibraryModule::getPage(int offset, int limit, std::vector<Station>& out, LibraryOrder order, int* total) {
+    ensureLoaded();
+    out.clear();
+
+    if (offset < 0) offset = 0;
+    if (limit > LIBRARY_PAGE_MAX) limit = LIBRARY_PAGE_MAX;
+    if (order != ORDER_ADDED) {
+        return getRankedPage(offset, limit, out, order, total);
+    }
+
+    if (total) *total = liveCount;
+    if (limit <= 0 || offset >= (int)liveCount) return 0;
+
+    // Skip whole blocks using their live counts, then walk the rest
+    uint32_t slot = 0;
+    int skip = offset;
+    for (int block = 0; block < MAX_LIBRARY_ENTRIES / LIBRARY_BLOCK_SLOTS; block++) {
+        if (skip < blockLive[block]) break;
+        skip -= blockLive[block];
+        slot += LIBRARY_BLOCK_SLOTS;
+    }
+
+    IndexEntry batch[LIBRARY_BATCH];
+    while (slot < highWater && (int)out.size() < limit) {
+        uint32_t n = highWater - slot;
+        if (n > LIBRARY_BATCH) n = LIBRARY_BATCH;
+
+        indexFile.seek(sizeof(IndexHeader) + slot * sizeof(IndexEntry));
+        if (indexFile.read((uint8_t*)batch, n * sizeof(IndexEntry)) != n * sizeof(IndexEntry)) break;
+
+        for (uint32_t i = 0; i < n && (int)out.size() < limit; i++) {
+            if (batch[i].state != SLOT_LIVE) continue;
+            if (skip > 0) {
+                skip--;
+                continue;
+            }
+
+            Station station;
+            station.id = slot + i;
+            readPlays(station.id, 1, &station.play);
+            if (readRecord(batch[i], station)) {
+                out.push_back(station);
+            }
+        }
+        slot += n;
+    }
+
+    return out.size();
+}
+
+// Ranked orders keep only the best offset + limit candidates (at most
+// LIBRARY_RANKED_MAX) while streaming the stats file once.
+int LibraryModule::getRankedPage(int offset, int limit, std::vector<Station>& out, LibraryOrder order, int* total) {
+    struct Ranked {
+        uint32_t id;
+        uint32_t primary;
+        uint32_t secondary;
+    };
+    Ranked top[LIBRARY_RANKED_MAX];
+    int topCount = 0;
+    int played = 0;
+
+    int wanted = offset + limit;
+    if (wanted > LIBRARY_RANKED_MAX) wanted = LIBRARY_RANKED_MAX;
+
+    PlayStats batch[LIBRARY_BATCH];
+    for (uint32_t first = 0; first < highWater; first += LIBRARY_BATCH) {
+        uint32_t n = highWater - first;
+        if (n > LIBRARY_BATCH) n = LIBRARY_BATCH;
+        readPlays(first, n, batch);
+
+        for (uint32_t i = 0; i < n; i++) {
+            if (batch[i].plays == 0) continue;
+            played++;
+
+            Ranked r;
+            r.id = first + i;
+            r.primary = order == ORDER_RECENT ? batch[i].lastSeq : batch[i].listenSeconds;
+            r.secondary = order == ORDER_RECENT ? 0 : batch[i].plays;
+
+            // Insertion into a short sorted array; ties keep ID order
+            int pos = topCount;
+            while (pos > 0 && (top[pos - 1].primary < r.primary ||
+                               (top[pos - 1].primary == r.primary && top[pos - 1].secondary < r.secondary))) {
+                pos--;
+            }
+            if (pos >= wanted) continue;
+            if (topCount < wanted) topCount++;
+            memmove(&top[pos + 1], &top[pos], (topCount - 1 - pos) * sizeof(Ranked));
+            top[pos] = r;
+        }
+    }
+
+    if (total) *total = played < LIBRARY_RANKED_MAX ? played : LIBRARY_RANKED_MAX;
+
+    // Stats of removed stations are reset, but skip anything no longer live
+    for (int i = offset; i < topCount; i++) {
+        Station station;
+        if (getStation(top[i].id, station)) {
+            out.push_back(station);
+        }
+    }
+    return out.size();
+}
+
+void LibraryModule::clear() {
+    ensureLoaded();
+    if (liveCount == 0 && highWater == 0) return;
+    if (compacting) abandonCompaction("library cleared");
+
+    indexFile.close();
+    dataFile.close();
+    LittleFS.remove(recordsPath(generation));
+    createStore(generation + 1);
+
+    playsFile.close();
+    LittleFS.remove(LIBRARY_PLAYS_PATH);
+    pendingCount = 0;
+    currentStation = LIBRARY_NO_STATION;
+    openPlays();
+
+    markDirty(sizeof(IndexHeader));
+    Serial.println("Library cleared");
 }
 
 int LibraryModule::getCount() {
-    return load().size();
+    ensureLoaded();
+    return liveCount;
+}
+
+uint32_t LibraryModule::getVersion() {
+    return version;
+}
+
+uint32_t LibraryModule::getPlayVersion() {
+    return playVersion;
+}
+
+void LibraryModule::notePlay(uint32_t id) {
+    ensureLoaded();
+
+    // Listening time up to now belongs to the previous station
+    notePlayback(false);
+    currentStation = id;
+    if (id == LIBRARY_NO_STATION) return;
+
+    PendingPlay* p = findPending(id, true);
+    p->plays++;
+    version++;  // ranked listings change
+    playVersion++;
+    p->lastSeq = ++playSeq;
+    time_t now = time(nullptr);
+    p->lastPlayed = now > 1600000000 ? now : 0;
+}
+
+void LibraryModule::notePlayback(bool playing) {
+    unsigned long now = millis();
+    if (playing && currentStation != LIBRARY_NO_STATION) {
+        PendingPlay* p = findPending(currentStation, true);
+        uint32_t seconds = p->listenMs / 1000;
+        p->listenMs += now - lastPlaybackTick;
+        if (p->listenMs / 1000 != seconds) playVersion++;  // listenSeconds moved
+    }
+    lastPlaybackTick = now;
+}
+
+bool LibraryModule::getPlayStats(uint32_t id, PlayStats& out) {
+    ensureLoaded();
+    if (id >= highWater) return false;
+    readPlays(id, 1, &out);
+    return true;
+}
+
+const LibraryStats& LibraryModule::getStorageStats() {
+    stats.dataBytes = dataSize;
+    return stats;
+}
+
+void LibraryModule::handle() {
+    // Debounce: a burst of edits results in a single sync
+    if (dirty && millis() - lastChange >= LIBRARY_COMMIT_DELAY) {
+        flush();
+
+        // Only reclaim space once dead records dominate the file
+        if (!compacting && stats.garbageBytes > LIBRARY_COMPACT_MIN && stats.garbageBytes > dataSize / 2) {
+            startCompaction();
+        }
+    }
+
+    if (compacting) compactStep();
+
+    if (pendingCount > 0 && millis() - lastPlaysCommit >= LIBRARY_PLAYS_COMMIT) {
+        commitPlays();
+    }
+}
+
+void LibraryModule::flush() {
+    if (pendingCount > 0) commitPlays();
+    if (!dirty) return;
+
+    // Records before index, so a synced index never points past the data
+    dataFile.flush();
+    indexFile.flush();
+    playsFile.flush();  // stats slots zeroed by removals
+    dirty = false;
+    stats.syncs++;
+}
+
+void LibraryModule::ensureLoaded() {
+    if (loaded) return;
+    loaded = true;
+
+    unsigned long start = micros();
+
+    if (!LittleFS.begin(true)) {
+        Serial.println("Library: LittleFS mount failed");
+        return;
+    }
+
+    if (!mount()) {
+        if (!createStore(1)) {
+            Serial.println("Library: cannot create store");
+            return;
+        }
+        migrateFromNvs();
+    }
+    openPlays();
+
+    stats.loadUs = micros() - start;
+
+    Serial.print("Library: ");
+    Serial.print(liveCount);
+    Serial.print(" stations, index scanned in ");
+    Serial.print(stats.loadUs);
+    Serial.println(" us");
+}
+
+void LibraryModule::markDirty(uint32_t bytesWritten) {
+    // Slots already copied would go stale; start over once edits settle
+    if (compacting) abandonCompaction("library changed");
+    dirty = true;
+    lastChange = millis();
+    version++;
+    stats.lastWriteBytes = bytesWritten;
+    stats.totalWriteBytes += bytesWritten;
+}
+
+bool LibraryModule::mount() {
+    if (!LittleFS.exists(LIBRARY_INDEX_PATH)) return false;
+
+    indexFile = LittleFS.open(LIBRARY_INDEX_PATH, "r+");
+    IndexHeader header;
+    if (!indexFile || indexFile.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != LIBRARY_INDEX_MAGIC || header.entrySize != sizeof(IndexEntry)) {
+        Serial.println("Library: index unreadable, starting empty");
+        indexFile.close();
+        return false;
+    }
+
+    generation = header.generation;
+    dataFile = LittleFS.open(recordsPath(generation), "r+");
+    if (!dataFile) {
+        Serial.println("Library: records file missing, starting empty");
+        indexFile.close();
+        return false;
+    }
+    dataSize = dataFile.size();
+
+    // A compaction cut short leaves the other generation behind
+    LittleFS.remove(recordsPath(generation - 1));
+    LittleFS.remove(recordsPath(generation + 1));
+    LittleFS.remove(LIBRARY_COMPACT_INDEX_PATH);
+
+    // One sequential pass rebuilds the per-block live counts
+    memset(blockLive, 0, sizeof(blockLive));
+    highWater = 0;
+    liveCount = 0;
+    uint32_t liveBytes = 0;
+
+    uint32_t slots = (indexFile.size() - sizeof(IndexHeader)) / sizeof(IndexEntry);
+    if (slots > MAX_LIBRARY_ENTRIES) slots = MAX_LIBRARY_ENTRIES;
+
+    IndexEntry batch[LIBRARY_BATCH];
+    indexFile.seek(sizeof(IndexHeader));
+    for (uint32_t slot = 0; slot < slots; slot += LIBRARY_BATCH) {
+        uint32_t n = slots - slot;
+        if (n > LIBRARY_BATCH) n = LIBRARY_BATCH;
+        if (indexFile.read((uint8_t*)batch, n * sizeof(IndexEntry)) != n * sizeof(IndexEntry)) break;
+
+        for (uint32_t i = 0; i < n; i++) {
+            if (batch[i].state == SLOT_FREE) continue;
+            highWater = slot + i + 1;
+            if (batch[i].state == SLOT_LIVE) {
+                blockLive[(slot + i) / LIBRARY_BLOCK_SLOTS]++;
+                liveCount++;
+                liveBytes += batch[i].length;
+            }
+        }
+    }
+
+    stats.garbageBytes = dataSize > liveBytes ? dataSize - liveBytes : 0;
+    return true;
+}
+
+bool LibraryModule::createStore(uint32_t gen) {
+    LittleFS.mkdir(LIBRARY_DIR);
+
+    IndexHeader header = { LIBRARY_INDEX_MAGIC, sizeof(IndexEntry), 0, gen, 0 };
+    File f = LittleFS.open(LIBRARY_INDEX_PATH, "w");
+    if (!f) return false;
+    f.write((const uint8_t*)&header, sizeof(header));
+    f.close();
+
+    f = LittleFS.open(recordsPath(gen), "w");
+    if (!f) return false;
+    f.close();
+
+    indexFile = LittleFS.open(LIBRARY_INDEX_PATH, "r+");
+    dataFile = LittleFS.open(recordsPath(gen), "r+");
+
+    generation = gen;
+    memset(blockLive, 0, sizeof(blockLive));
+    highWater = 0;
+    liveCount = 0;
+    dataSize = 0;
+    stats.garbageBytes = 0;
+    return indexFile && dataFile;
+}
+
+bool LibraryModule::readEntry(uint32_t slot, IndexEntry& entry) {
+    if (!indexFile || slot >= highWater) return false;
+
+    indexFile.seek(sizeof(IndexHeader) + slot * sizeof(IndexEntry));
+    return indexFile.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry);
+}
+
+bool LibraryModule::writeEntry(uint32_t slot, const IndexEntry& entry) {
+    if (!indexFile || slot >= MAX_LIBRARY_ENTRIES) return false;
+
+    indexFile.seek(sizeof(IndexHeader) + slot * sizeof(IndexEntry));
+    if (indexFile.write((const uint8_t*)&entry, sizeof(entry)) != sizeof(entry)) {
+        Serial.println("Library: index write failed");
+        return false;
+    }
+
+    if (slot >= highWater) highWater = slot + 1;
+    return true;
 }
 
-void LibraryModule::save(const std::vector<Station>& stations) {
+bool LibraryModule::readRecord(const IndexEntry& entry, Station& out) {
+    uint8_t buf[LIBRARY_RECORD_MAX];
+    if (entry.length > sizeof(buf)) return false;
+
+    dataFile.seek(entry.offset);
+    if (dataFile.read(buf, entry.length) != entry.length) return false;
+
+    // Unknown trailing fields are skipped, so newer records stay readable
+    uint8_t fields = buf[0];
+    size_t pos = 1;
+    for (uint8_t i = 0; i < fields; i++) {
+        if (pos + 2 > entry.length) return false;
+        uint16_t len = buf[pos] | (buf[pos + 1] << 8);
+        pos += 2;
+        if (pos + len > entry.length) return false;
+
+        char field[LIBRARY_URL_MAX + 1];
+        size_t copy = len > LIBRARY_URL_MAX ? LIBRARY_URL_MAX : len;
+        memcpy(field, buf + pos, copy);
+        field[copy] = '\0';
+        pos += len;
+
+        if (i == 0) out.name = field;
+        else if (i == 1) out.url = field;
+        else if (i == 2) out.endpoint = field;
+    }
+
+    return out.url.length() > 0;
+}
+
+uint32_t LibraryModule::appendRecord(const Station& station, uint16_t& length) {
+    uint8_t buf[LIBRARY_RECORD_MAX];
+    size_t pos = 0;
+    const String* fields[3] = { &station.name, &station.url, &station.endpoint };
+    const size_t limits[3] = { LIBRARY_NAME_MAX, LIBRARY_URL_MAX, LIBRARY_URL_MAX };
+
+    buf[pos++] = 3;
+    for (int i = 0; i < 3; i++) {
+        if (fields[i]->length() > limits[i]) {
+            Serial.println("Library: record field too long");
+            length = 0;
+            return 0;
+        }
+        uint16_t len = fields[i]->length();
+        buf[pos++] = len & 0xFF;
+        buf[pos++] = len >> 8;
+        memcpy(buf + pos, fields[i]->c_str(), len);
+        pos += len;
+    }
+
+    uint32_t offset = dataSize;
+    dataFile.seek(offset);
+    if (dataFile.write(buf, pos) != pos) {
+        Serial.println("Library: record write failed");
+        length = 0;
+        return 0;
+    }
+
+    dataSize += pos;
+    length = pos;
+    return offset;
+}
+
+int LibraryModule::findFreeSlot() {
+    if (highWater < MAX_LIBRARY_ENTRIES) return highWater;
+
+    // Only when the ID space is exhausted are deleted slots reused
+    IndexEntry batch[LIBRARY_BATCH];
+    for (int block = 0; block < MAX_LIBRARY_ENTRIES / LIBRARY_BLOCK_SLOTS; block++) {
+        if (blockLive[block] >= LIBRARY_BLOCK_SLOTS) continue;
+
+        uint32_t first = block * LIBRARY_BLOCK_SLOTS;
+        for (uint32_t slot = first; slot < first + LIBRARY_BLOCK_SLOTS; slot += LIBRARY_BATCH) {
+            indexFile.seek(sizeof(IndexHeader) + slot * sizeof(IndexEntry));
+            if (indexFile.read((uint8_t*)batch, sizeof(batch)) != sizeof(batch)) return -1;
+            for (int i = 0; i < LIBRARY_BATCH; i++) {
+                if (batch[i].state != SLOT_LIVE) return slot + i;
+            }
+        }
+    }
+    return -1;
+}
+
+// Copies live records into a new generation; IDs (slots) are unchanged.
+// The index rename is the commit point, so an interruption loses nothing.
+void LibraryModule::startCompaction() {
+    uint32_t newGen = generation + 1;
+    compactData = LittleFS.open(recordsPath(newGen), "w");
+    compactIndex = LittleFS.open(LIBRARY_COMPACT_INDEX_PATH, "w");
+    compacting = true;
+    compactSlot = 0;
+    compactSize = 0;
+    compactStart = millis();
+
+    IndexHeader header = { LIBRARY_INDEX_MAGIC, sizeof(IndexEntry), 0, newGen, 0 };
+    if (!compactData || !compactIndex ||
+        compactIndex.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+        abandonCompaction("cannot start");
+    }
+}
+
+// LIBRARY_COMPACT_STEP slots per call, so a large library never holds up
+// the loop for a whole file rewrite
+void LibraryModule::compactStep() {
+    uint8_t record[LIBRARY_RECORD_MAX];
+    uint32_t end = compactSlot + LIBRARY_COMPACT_STEP;
+    if (end > highWater) end = highWater;
+
+    for (; compactSlot < end; compactSlot++) {
+        IndexEntry entry;
+        if (!readEntry(compactSlot, entry)) {
+            abandonCompaction("index read failed");
+            return;
+        }
+
+        if (entry.state == SLOT_LIVE && entry.length <= sizeof(record)) {
+            dataFile.seek(entry.offset);
+            if (dataFile.read(record, entry.length) != entry.length ||
+                compactData.write(record, entry.length) != entry.length) {
+                abandonCompaction("record copy failed");
+                return;
+            }
+            entry.offset = compactSize;
+            compactSize += entry.length;
+        } else {
+            entry.offset = 0;
+            entry.length = 0;
+        }
+        if (compactIndex.write((const uint8_t*)&entry, sizeof(entry)) != sizeof(entry)) {
+            abandonCompaction("index write failed");
+            return;
+        }
+    }
+
+    if (compactSlot >= highWater) finishCompaction();
+}
+
+void LibraryModule::finishCompaction() {
+    uint32_t newGen = generation + 1;
+    compactData.close();
+    compactIndex.close();
+    indexFile.close();
+    dataFile.close();
+
+    if (!LittleFS.rename(LIBRARY_COMPACT_INDEX_PATH, LIBRARY_INDEX_PATH)) {
+        indexFile = LittleFS.open(LIBRARY_INDEX_PATH, "r+");
+        dataFile = LittleFS.open(recordsPath(generation), "r+");
+        abandonCompaction("index rename failed");
+        return;
+    }
+    LittleFS.remove(recordsPath(generation));
+
+    compacting = false;
+    generation = newGen;
+    indexFile = LittleFS.open(LIBRARY_INDEX_PATH, "r+");
+    dataFile = LittleFS.open(recordsPath(generation), "r+");
+    dataSize = compactSize;
+    stats.garbageBytes = 0;
+
+    Serial.print("Library: compacted to ");
+    Serial.print(compactSize);
+    Serial.print(" bytes in ");
+    Serial.print(millis() - compactStart);
+    Serial.println(" ms");
+}
+
+// The current generation is untouched until the rename, so dropping the
+// new one is all it takes
+void LibraryModule::abandonCompaction(const char* reason) {
+    compactData.close();
+    compactIndex.close();
+    LittleFS.remove(recordsPath(generation + 1));
+    LittleFS.remove(LIBRARY_COMPACT_INDEX_PATH);
+    compacting = false;
+
+    Serial.print("Library: compaction abandoned, ");
+    Serial.println(reason);
+}
+
+// Earlier firmware kept the library in NVS: first as one blob, before that
+// as one key per field (count, nameN, urlN)
+void LibraryModule::migrateFromNvs() {
+    int migrated = 0;
+
+    BlobStore blob("library", LIBRARY_NVS_SCHEMA);
+    std::vector<uint8_t> payload;
+    if (blob.load(payload)) {
+        BlobReader reader(payload);
+        uint16_t count = reader.getU16();
+        for (int i = 0; i < count && reader.ok(); i++) {
+            String name = reader.getString();
+            String url = reader.getString();
+            if (reader.ok() && migrateStation(name, url)) migrated++;
+        }
+    } else {
+        prefs.begin("library", true); // Read-only
+        int count = prefs.getInt("count", 0);
+        for (int i = 0; i < count; i++) {
+            String name = prefs.getString(("name" + String(i)).c_str(), "");
+            String url = prefs.getString(("url" + String(i)).c_str(), "");
+            if (migrateStation(name, url)) migrated++;
+        }
+        prefs.end();
+    }
+
+    if (migrated == 0) return;
+
+    // Sync the file store before dropping the NVS copy
+    flush();
     prefs.begin("library", false);
-    prefs.clear(); // Clear old data
-    
-    prefs.putInt("count", stations.size());
-    
-    for (int i = 0; i < stations.size(); i++) {
-        String nameKey = "name" + String(i);
-        String urlKey = "url" + String(i);
-        prefs.putString(nameKey.c_str(), stations[i].name);
-        prefs.putString(urlKey.c_str(), stations[i].url);
-    }
-    
+    prefs.clear();
     prefs.end();
+
+    Serial.print("Library: migrated ");
+    Serial.print(migrated);
+    Serial.println(" stations from NVS");
 }
 
-std::vector<Station> LibraryModule::load() {
-    std::vector<Station> stations;
-    
-    prefs.begin("library", true); // Read-only
-    int count = prefs.getInt("count", 0);
-    
-    for (int i = 0; i < count; i++) {
-        String nameKey = "name" + String(i);
-        String urlKey = "url" + String(i);
-        
-        Station station;
-        station.name = prefs.getString(nameKey.c_str(), "");
-        station.url = prefs.getString(urlKey.c_str(), "");
-        
-        if (station.url.length() > 0) {
-            stations.push_back(station);
+// Old firmware stored names and URLs unchecked. A long name is cut to fit;
+// a long URL could not play cut short, so that station is dropped.
+bool LibraryModule::migrateStation(String name, const String& url) {
+    if (url.length() == 0) return false;
+    if (url.length() > LIBRARY_URL_MAX) {
+        Serial.print("Library: URL too long, not migrated: ");
+        Serial.println(name);
+        return false;
+    }
+    if (name.length() > LIBRARY_NAME_MAX) name.remove(LIBRARY_NAME_MAX);
+    return insertStation(name.c_str(), url.c_str(), "", nullptr);
+}
+
+bool LibraryModule::openPlays() {
+    LittleFS.mkdir(LIBRARY_DIR);
+
+    PlaysHeader header;
+    if (LittleFS.exists(LIBRARY_PLAYS_PATH)) {
+        playsFile = LittleFS.open(LIBRARY_PLAYS_PATH, "r+");
+        if (playsFile && playsFile.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == LIBRARY_PLAYS_MAGIC) {
+            playSeq = header.playSeq;
+            lastPlaysCommit = millis();
+            return true;
         }
+        Serial.println("Library: play stats unreadable, starting over");
+        playsFile.close();
     }
-    
-    prefs.end();
-    return stations;
-}
\ No newline at end of file
+
+    header = { LIBRARY_PLAYS_MAGIC, playSeq, 0, 0 };
+    File f = LittleFS.open(LIBRARY_PLAYS_PATH, "w");
+    if (!f) return false;
+    f.write((const uint8_t*)&header, sizeof(header));
+    f.close();
+
+    playsFile = LittleFS.open(LIBRARY_PLAYS_PATH, "r+");
+    lastPlaysCommit = millis();
+    return (bool)playsFile;
+}
+
+LibraryModule::PendingPlay* LibraryModule::findPending(uint32_t id, bool create) {
+    for (int i = 0; i < pendingCount; i++) {
+        if (pending[i].id == id) return &pending[i];
+    }
+    if (!create) return nullptr;
+
+    // Full: write everything back early rather than drop plays
+    if (pendingCount >= LIBRARY_PLAYS_PENDING) {
+        commitPlays();
+        for (int i = 0; i < pendingCount; i++) {
+            if (pending[i].id == id) return &pending[i];
+        }
+    }
+
+    PendingPlay* p = &pending[pendingCount++];
+    memset(p, 0, sizeof(*p));
+    p->id = id;
+    return p;
+}
+
+// Stats for count consecutive IDs: the file slots plus whatever is pending.
+// Slots past the end of the file read as zero.
+void LibraryModule::readPlays(uint32_t firstId, uint32_t count, PlayStats* out) {
+    memset(out, 0, count * sizeof(PlayStats));
+
+    if (playsFile) {
+        uint32_t pos = sizeof(PlaysHeader) + firstId * sizeof(PlayStats);
+        uint32_t size = playsFile.size();
+        if (pos < size) {
+            uint32_t bytes = count * sizeof(PlayStats);
+            if (bytes > size - pos) bytes = size - pos;
+            playsFile.seek(pos);
+            playsFile.read((uint8_t*)out, bytes);
+        }
+    }
+
+    for (int i = 0; i < pendingCount; i++) {
+        const PendingPlay& p = pending[i];
+        if (p.id < firstId || p.id >= firstId + count) continue;
+
+        PlayStats& s = out[p.id - firstId];
+        s.plays += p.plays;
+        s.listenSeconds += p.listenMs / 1000;
+        if (p.lastSeq) s.lastSeq = p.lastSeq;
+        if (p.lastPlayed) s.lastPlayed = p.lastPlayed;
+    }
+}
+
+// One write per touched slot plus the header, then a single sync. Sub-second
+// listening time of the station still playing carries over to the next commit.
+void LibraryModule::commitPlays() {
+    lastPlaysCommit = millis();
+    if (!playsFile) {
+        pendingCount = 0;
+        return;
+    }
+
+    uint32_t bytes = 0;
+    int kept = 0;
+    for (int i = 0; i < pendingCount; i++) {
+        PendingPlay& p = pending[i];
+
+        PlayStats s;
+        readPlays(p.id, 1, &s);  // includes this entry's deltas
+        uint32_t remainder = p.listenMs % 1000;
+
+        playsFile.seek(sizeof(PlaysHeader) + p.id * sizeof(PlayStats));
+        if (playsFile.write((const uint8_t*)&s, sizeof(s)) != sizeof(s)) {
+            Serial.println("Library: play stats write failed");
+        }
+        bytes += sizeof(s);
+
+        if (p.id == currentStation && remainder > 0) {
+            PendingPlay carry = { p.id, 0, remainder, 0, 0 };
+            pending[kept++] = carry;
+        }
+    }
+    pendingCount = kept;
+
+    PlaysHeader header = { LIBRARY_PLAYS_MAGIC, playSeq, 0, 0 };
+    playsFile.seek(0);
+    playsFile.write((const uint8_t*)&header, sizeof(header));
+    playsFile.flush();
+
+    stats.playCommits++;
+    stats.totalWriteBytes += bytes + sizeof(header);
+}
+
+void LibraryModule::resetPlays(uint32_t id) {
+    for (int i = 0; i < pendingCount; i++) {
+        if (pending[i].id == id) {
+            pending[i] = pending[--pendingCount];
+            break;
+        }
+    }
+    if (currentStation == id) currentStation = LIBRARY_NO_STATION;
+
+    uint32_t pos = sizeof(PlaysHeader) + id * sizeof(PlayStats);
+    if (playsFile && pos < playsFile.size()) {
+        PlayStats zero;
+        memset(&zero, 0, sizeof(zero));
+        playsFile.seek(pos);
+        playsFile.write((const uint8_t*)&zero, sizeof(zero));
+    }
+}
+
+String LibraryModule::recordsPath(uint32_t gen) {
+    return String(LIBRARY_DIR) + "/records." + String(gen);
+}
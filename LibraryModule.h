@@ -2,28 +2,191 @@
 #define LIBRARY_MODULE_H
 
 #include <Preferences.h>
+#include <LittleFS.h>
 #include <vector>
+#include "BlobStore.h"
 
-#define MAX_LIBRARY_ENTRIES 10
+#define MAX_LIBRARY_ENTRIES 4096
+#define LIBRARY_PAGE_MAX 50         // largest page getPage() will return
+#define LIBRARY_NAME_MAX 64
+#define LIBRARY_URL_MAX 256
+#define LIBRARY_COMMIT_DELAY 2000   // ms without changes before syncing to flash
+#define LIBRARY_NVS_SCHEMA 1        // blob layout used before the file store
+
+// On-flash layout (LittleFS):
+//   /library/index.dat     header + one fixed-size slot per station ID
+//   /library/records.<gen> append-only records: u8 field count, then
+//                          u16-length-prefixed fields (name, url, endpoint)
+// A station's ID is its slot number, so lookups are a single seek. Slots are
+// never reused while free ones remain, which keeps ID order = insertion order.
+#define LIBRARY_DIR "/library"
+#define LIBRARY_INDEX_PATH "/library/index.dat"
+#define LIBRARY_INDEX_MAGIC 0x494C4247  // "GBLI"
+#define LIBRARY_BLOCK_SLOTS 256         // slots per live-count block
+#define LIBRARY_COMPACT_MIN 65536       // garbage bytes before compaction
+#define LIBRARY_COMPACT_STEP 8          // records copied per handle() while compacting
+#define LIBRARY_COMPACT_INDEX_PATH "/library/index.tmp"
+
+// Play statistics live apart from the records in /library/plays.dat: a header,
+// then one PlayStats slot per station ID. Plays and listening time collect in
+// RAM and are written back in batches, never once per play.
+#define LIBRARY_PLAYS_PATH "/library/plays.dat"
+#define LIBRARY_PLAYS_MAGIC 0x504C4247  // "GBLP"
+#define LIBRARY_PLAYS_COMMIT 300000     // ms between play-stat write-backs
+#define LIBRARY_PLAYS_PENDING 16        // stations with unsaved play stats
+#define LIBRARY_RANKED_MAX 100          // ranked orders list the top N stations
+#define LIBRARY_NO_STATION 0xFFFFFFFF   // playback not from the library
+
+struct PlayStats {
+    uint32_t plays;
+    uint32_t listenSeconds;
+    uint32_t lastSeq;     // play sequence number, orders "recent" across reboots
+    uint32_t lastPlayed;  // Unix time, 0 if the clock was not set
+};
+
+enum LibraryOrder {
+    ORDER_ADDED,      // ID order
+    ORDER_MOST_USED,  // listening time, then plays; played stations only
+    ORDER_RECENT      // last played first; played stations only
+};
 
 struct Station {
+    uint32_t id;
     String name;
-    String url;
+    String url;       // as entered by the user
+    String endpoint;  // resolved stream URL (playlists/redirects followed), may be empty
+    PlayStats play;
+    
+    const String& playUrl() const { return endpoint.length() > 0 ? endpoint : url; }
+};
+
+struct LibraryStats {
+    uint32_t loadUs;           // index scan at mount
+    uint32_t lastWriteBytes;   // bytes written by the last edit
+    uint32_t totalWriteBytes;
+    uint32_t syncs;
+    uint32_t dataBytes;        // size of the records file
+    uint32_t garbageBytes;     // dead records awaiting compaction
+    uint32_t playCommits;      // play-stat write-backs
 };
 
 class LibraryModule {
 public:
     LibraryModule();
-    
-    bool addStation(const char* name, const char* url);
-    bool removeStation(int index);
-    std::vector<Station> getStations();
+
+    bool addStation(const char* name, const char* url, uint32_t* idOut = nullptr);
+    bool removeStation(uint32_t id);
+    bool getStation(uint32_t id, Station& out);
+    bool setEndpoint(Station& station, const String& endpoint); // resolved stream URL
+    // total, if given, receives the number of stations the order lists
+    int getPage(int offset, int limit, std::vector<Station>& out, LibraryOrder order = ORDER_ADDED,
+                int* total = nullptr);
+    void clear();
     int getCount();
-    
+    uint32_t getVersion(); // bumped on every change
+    uint32_t getPlayVersion(); // bumped when any station's reported play stats change
+
+    void notePlay(uint32_t id);          // a station was tuned in (LIBRARY_NO_STATION for plain URLs)
+    void notePlayback(bool playing);     // Call in loop - accrues listening time
+    bool getPlayStats(uint32_t id, PlayStats& out);
+
+    void handle(); // Call in loop - syncs pending changes
+    void flush();  // Sync pending changes now (e.g. before restart)
+    const LibraryStats& getStorageStats();
+
 private:
+    struct IndexHeader {
+        uint32_t magic;
+        uint16_t entrySize;
+        uint16_t reserved;
+        uint32_t generation;   // selects the records file
+        uint32_t reserved2;
+    };
+
+    struct IndexEntry {
+        uint32_t offset;
+        uint16_t length;
+        uint8_t state;
+        uint8_t reserved;
+    };
+
+    struct PlaysHeader {
+        uint32_t magic;
+        uint32_t playSeq;
+        uint32_t reserved;
+        uint32_t reserved2;
+    };
+
+    // Play stats not yet written back, as deltas on the file slot
+    struct PendingPlay {
+        uint32_t id;
+        uint32_t plays;
+        uint32_t listenMs;
+        uint32_t lastSeq;
+        uint32_t lastPlayed;
+    };
+
+    enum SlotState : uint8_t { SLOT_FREE = 0, SLOT_LIVE = 1, SLOT_DELETED = 2 };
+
     Preferences prefs;
-    void save(const std::vector<Station>& stations);
-    std::vector<Station> load();
+    File indexFile;
+    File dataFile;
+    uint32_t generation;
+    uint32_t version;
+
+    // Everything below is fixed-size, whatever the library holds
+    uint16_t blockLive[MAX_LIBRARY_ENTRIES / LIBRARY_BLOCK_SLOTS];
+    uint32_t highWater;    // slots ever used
+    uint32_t liveCount;
+    uint32_t dataSize;
+    LibraryStats stats;
+
+    // Write-back: file buffers are synced after LIBRARY_COMMIT_DELAY
+    bool loaded;
+    bool dirty;
+    unsigned long lastChange;
+
+    // Compaction runs a few records per handle() into the next generation;
+    // any edit meanwhile abandons it
+    bool compacting;
+    uint32_t compactSlot;
+    uint32_t compactSize;
+    File compactData;
+    File compactIndex;
+    unsigned long compactStart;
+
+    File playsFile;
+    uint32_t playSeq;
+    uint32_t playVersion;
+    PendingPlay pending[LIBRARY_PLAYS_PENDING];
+    int pendingCount;
+    uint32_t currentStation;
+    unsigned long lastPlaybackTick;
+    unsigned long lastPlaysCommit;
+
+    void ensureLoaded();
+    void markDirty(uint32_t bytesWritten);
+    bool mount();
+    bool createStore(uint32_t gen);
+    bool readEntry(uint32_t slot, IndexEntry& entry);
+    bool writeEntry(uint32_t slot, const IndexEntry& entry);
+    bool readRecord(const IndexEntry& entry, Station& out);
+    bool insertStation(const char* name, const char* url, const char* endpoint, uint32_t* idOut);
+    uint32_t appendRecord(const Station& station, uint16_t& length);
+    int findFreeSlot();
+    void startCompaction();
+    void compactStep();
+    void finishCompaction();
+    void abandonCompaction(const char* reason);
+    void migrateFromNvs();
+    bool migrateStation(String name, const String& url);
+    bool openPlays();
+    PendingPlay* findPending(uint32_t id, bool create);
+    void readPlays(uint32_t firstId, uint32_t count, PlayStats* out);
+    void commitPlays();
+    void resetPlays(uint32_t id);
+    int getRankedPage(int offset, int limit, std::vector<Station>& out, LibraryOrder order, int* total);
+    String recordsPath(uint32_t gen);
 };
 
-#endif
\ No newline at end of file
+#endif
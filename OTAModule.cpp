@@ -1,30 +1,678 @@
 #include "ArduinoOTA.h"
 #include "OTAModule.h"
+#include "AudioModule.h"
+#include <WiFi.h>
+
+// skipGzipHeader() phases (RFC 1952); flagged fields only
+enum {
+    GZ_FIXED,           // ID1 ID2 CM FLG MTIME XFL OS
+    GZ_EXTRA_LEN,
+    GZ_EXTRA,
+    GZ_NAME,
+    GZ_COMMENT,
+    GZ_HCRC,
+    GZ_DATA
+};
+
+OTAModule::OTAModule()
+    : enabled(false), audioMgr(nullptr), audioMode(OTA_AUDIO_DEFAULT), audioSuspended(false), transferStart(0),
+      reportAt(0), reportBytes(0), tokens(0), tokensAt(0), pumpAllowedUs(0), heldSince(0), autoReboot(true),
+      nextCheck(0), resumeAt(0), lastData(0), started(0), gzip(false), http(nullptr), skip(0), input(nullptr),
+      inPos(0), inLen(0), inflator(nullptr), dict(nullptr), dictPos(0), flushPos(0), flushLen(0), inflateDone(false),
+      gzipPhase(GZ_FIXED), gzipCount(0), gzipFlags(0), gzipExtra(0) {
+    pull.state = OTA_IDLE;
+    pull.checks = pull.imageSize = pull.written = pull.downloaded = pull.transferred = 0;
+    pull.resumes = pull.durationMs = 0;
+    telemetry = OtaTelemetry();
+}
 
 void OTAModule::begin(const char* hostname) {
     ArduinoOTA.setHostname(hostname);
-    ArduinoOTA.setPassword("gridbeacon");
+    ArduinoOTA.setPassword(OTA_PASSWORD);
     
-    ArduinoOTA.onStart([]() {
+    ArduinoOTA.onStart([this]() {
         Serial.println("\nOTA: Starting update");
+        prepareAudio(true, 0);
+    });
+    
+    // ArduinoOTA holds loop() until the image is in. In BACKGROUND mode the
+    // player is fed from here; a full I2S buffer blocks copy(), which paces
+    // the transfer.
+    ArduinoOTA.onProgress([this](unsigned int progress, unsigned int total) {
+        noteProgress(progress, total ? (uint64_t)progress * 100 / total : 0);
+        if (audioMgr && !audioSuspended) audioMgr->process();
     });
     
-    ArduinoOTA.onEnd([]() {
+    ArduinoOTA.onEnd([this]() {
         Serial.println("\nOTA: Complete");
+        logTelemetry();
     });
     
-    ArduinoOTA.onError([](ota_error_t error) {
+    ArduinoOTA.onError([this](ota_error_t error) {
         Serial.print("OTA Error: ");
         Serial.println(error);
+        restoreAudio();
     });
     
     ArduinoOTA.begin();
     enabled = true;
     Serial.println("OTA enabled");
+    
+    prefs.begin("ota", true);
+    manifestUrl = prefs.getString("manifest", "");
+    audioMode = (OtaAudioMode)prefs.getUChar("audio", OTA_AUDIO_DEFAULT);
+    prefs.end();
+    nextCheck = millis() + OTA_FIRST_CHECK;
 }
 
 void OTAModule::handle() {
     if (enabled) {
         ArduinoOTA.handle();
     }
-}
\ No newline at end of file
+    
+    unsigned long now = millis();
+    switch (pull.state) {
+        case OTA_IDLE:
+        case OTA_FAILED:
+            if (manifestUrl.length() > 0 && (long)(now - nextCheck) >= 0 && WiFi.status() == WL_CONNECTED) {
+                checkNow();
+            }
+            break;
+        case OTA_PREPARING:
+            if (audioMgr->isReleased() || now - transferStart > OTA_RELEASE_TIMEOUT) startDownload();
+            break;
+        case OTA_DOWNLOADING:
+            if (!holdBack()) {
+                unsigned long t0 = micros();
+                pump();
+                unsigned long spent = micros() - t0;
+                pumpAllowedUs = micros() + spent * (OTA_BACKGROUND_SHARE - 1);
+            }
+            break;
+        case OTA_RESUME_WAIT:
+            if ((long)(now - resumeAt) >= 0 && !openImage()) interrupted("reconnect failed");
+            break;
+        case OTA_READY:
+            break;
+    }
+}
+
+void OTAModule::setManifestUrl(const char* url) {
+    manifestUrl = url ? url : "";
+    prefs.begin("ota", false);
+    prefs.putString("manifest", manifestUrl);
+    prefs.end();
+}
+
+String OTAModule::getManifestUrl() {
+    return manifestUrl;
+}
+
+void OTAModule::setAutoReboot(bool reboot) {
+    autoReboot = reboot;
+}
+
+const OtaPullStats& OTAModule::getPullStats() {
+    return pull;
+}
+
+void OTAModule::setAudio(AudioModule* audio) {
+    audioMgr = audio;
+}
+
+void OTAModule::setAudioMode(OtaAudioMode mode) {
+    audioMode = mode;
+    prefs.begin("ota", false);
+    prefs.putUChar("audio", mode);
+    prefs.end();
+}
+
+OtaAudioMode OTAModule::getAudioMode() {
+    return audioMode;
+}
+
+const OtaTelemetry& OTAModule::getTelemetry() {
+    return telemetry;
+}
+
+// Blocks for the manifest only (OTA_MANIFEST_MAX bytes); the image itself
+// is fetched from handle()
+bool OTAModule::checkNow() {
+    if (manifestUrl.length() == 0 || pull.state == OTA_PREPARING || pull.state == OTA_DOWNLOADING ||
+        pull.state == OTA_RESUME_WAIT || pull.state == OTA_READY) {
+        return false;
+    }
+    
+    pull.checks++;
+    nextCheck = millis() + OTA_CHECK_INTERVAL;
+    if (!fetchManifest()) return true;
+    
+    if (pull.version == FIRMWARE_VERSION) {
+        pull.state = OTA_IDLE;
+        pull.error = "";
+        return true;
+    }
+    
+    Serial.print("OTA: Version ");
+    Serial.print(pull.version);
+    Serial.print(" available, ");
+    Serial.print(pull.imageSize);
+    Serial.println(" bytes");
+    
+    // The inflater's buffers are what BACKGROUND has to fit next to audio
+    prepareAudio(false, OTA_CHUNK + (gzip ? sizeof(tinfl_decompressor) + TINFL_LZ_DICT_SIZE : 0));
+    if (audioSuspended) {
+        pull.state = OTA_PREPARING;
+    } else {
+        startDownload();
+    }
+    return true;
+}
+
+bool OTAModule::fetchManifest() {
+    HTTPClient client;
+    uint16_t timeout = httpTimeout();
+    client.setTimeout(timeout);
+    client.setConnectTimeout(timeout);
+    client.useHTTP10(true);  // the body is read raw: no chunk-size lines in it
+    if (!client.begin(manifestUrl)) {
+        fail("bad manifest URL");
+        return false;
+    }
+    
+    int code = client.GET();
+    if (code != HTTP_CODE_OK) {
+        fail("manifest: HTTP " + String(code));
+        return false;
+    }
+    
+    // Never more than OTA_MANIFEST_MAX, whatever Content-Length says or if
+    // it is missing; without one the body ends with the connection
+    int length = client.getSize();
+    if (length > OTA_MANIFEST_MAX) {
+        fail("manifest too large");
+        return false;
+    }
+    int limit = length >= 0 ? length : OTA_MANIFEST_MAX + 1;
+    String body;
+    body.reserve(limit);
+    WiFiClient& stream = client.getStream();
+    unsigned long lastByte = millis();
+    while ((int)body.length() < limit) {
+        int c = stream.available() > 0 ? stream.read() : -1;
+        if (c >= 0) {
+            body += (char)c;
+            lastByte = millis();
+        } else if (!stream.connected() || millis() - lastByte >= timeout) {
+            break;
+        } else {
+            delay(1);
+        }
+    }
+    client.end();
+    if ((int)body.length() > OTA_MANIFEST_MAX) {
+        fail("manifest too large");
+        return false;
+    }
+    
+    String version, url, hash, encoding = "identity";
+    long size = 0;
+    int start = 0;
+    while (start < (int)body.length()) {
+        int end = body.indexOf('\n', start);
+        if (end < 0) end = body.length();
+        String line = body.substring(start, end);
+        line.trim();
+        start = end + 1;
+        
+        int eq = line.indexOf('=');
+        if (eq < 0) continue;
+        String key = line.substring(0, eq);
+        String value = line.substring(eq + 1);
+        if (key == "version") version = value;
+        else if (key == "url") url = value;
+        else if (key == "size") size = value.toInt();
+        else if (key == "sha256") hash = value;
+        else if (key == "encoding") encoding = value;
+    }
+    hash.toLowerCase();
+    
+    if (version.length() == 0 || url.length() == 0 || size <= 0 || hash.length() != 64 ||
+        (encoding != "gzip" && encoding != "identity")) {
+        fail("incomplete manifest");
+        return false;
+    }
+    
+    pull.version = version;
+    pull.imageSize = size;
+    imageUrl = resolveUrl(manifestUrl, url);
+    expectedHash = hash;
+    gzip = encoding == "gzip";
+    return true;
+}
+
+// Heap is sampled before audio lets go, so heapStart shows what the
+// pipeline was holding
+void OTAModule::prepareAudio(bool push, uint32_t heapNeeded) {
+    telemetry = OtaTelemetry();
+    telemetry.push = push;
+    telemetry.mode = audioMode;
+    telemetry.heapStart = telemetry.heapFree = telemetry.heapMin = ESP.getFreeHeap();
+    transferStart = reportAt = millis();
+    reportBytes = 0;
+    heldSince = 0;
+    
+    if (!audioMgr) return;
+    if (audioMode == OTA_AUDIO_BACKGROUND && audioMgr->isPlaying() &&
+        ESP.getMaxAllocHeap() < heapNeeded + OTA_HEAP_RESERVE) {
+        Serial.println("OTA: Not enough heap to keep playing, pausing audio");
+        telemetry.mode = OTA_AUDIO_GRACEFUL;
+    }
+    if (telemetry.mode == OTA_AUDIO_GRACEFUL) {
+        audioMgr->suspendForUpdate(push);
+        audioSuspended = true;
+    }
+}
+
+void OTAModule::restoreAudio() {
+    if (!audioSuspended) return;
+    audioSuspended = false;
+    audioMgr->resumeAfterUpdate();
+}
+
+// BACKGROUND while audio plays: a token bucket for the rate, and after each
+// pump the loop gets (SHARE-1) times as long for itself
+bool OTAModule::holdBack() {
+    if (!background()) return false;
+    
+    unsigned long now = millis();
+    unsigned long elapsed = now - tokensAt;
+    if (elapsed > 1000) elapsed = 1000;
+    uint32_t earned = elapsed * OTA_BACKGROUND_KBPS * 1024 / 1000;
+    if (earned > 0) {
+        tokens = tokens + earned > 4 * OTA_CHUNK ? 4 * OTA_CHUNK : tokens + earned;
+        tokensAt = now;
+    }
+    
+    bool held = tokens < OTA_CHUNK || (long)(micros() - pumpAllowedUs) < 0;
+    if (held && heldSince == 0) {
+        heldSince = now ? now : 1;
+    } else if (!held && heldSince != 0) {
+        telemetry.throttledMs += now - heldSince;
+        heldSince = 0;
+    }
+    return held;
+}
+
+// Playing through a BACKGROUND update
+bool OTAModule::background() {
+    return audioMgr && !audioSuspended && telemetry.mode == OTA_AUDIO_BACKGROUND && audioMgr->isPlaying();
+}
+
+// Any request while audio plays, BACKGROUND downloads and the hourly
+// manifest check alike (see OTA_PLAYING_HTTP_TIMEOUT)
+uint16_t OTAModule::httpTimeout() {
+    bool playing = audioMgr && !audioSuspended && audioMgr->isPlaying();
+    return playing ? OTA_PLAYING_HTTP_TIMEOUT : OTA_HTTP_TIMEOUT;
+}
+
+void OTAModule::noteProgress(uint32_t bytes, uint32_t percent) {
+    unsigned long now = millis();
+    telemetry.bytes = bytes;
+    telemetry.heapFree = ESP.getFreeHeap();
+    if (telemetry.heapFree < telemetry.heapMin) telemetry.heapMin = telemetry.heapFree;
+    if (now != transferStart) telemetry.avgBps = (uint64_t)bytes * 1000 / (now - transferStart);
+    if (now - reportAt < OTA_REPORT_INTERVAL) return;
+    
+    telemetry.rateBps = (uint64_t)(bytes - reportBytes) * 1000 / (now - reportAt);
+    reportAt = now;
+    reportBytes = bytes;
+    Serial.print("OTA: ");
+    Serial.print(percent);
+    Serial.print("%, ");
+    Serial.print(telemetry.rateBps / 1024);
+    Serial.print(" KB/s, heap ");
+    Serial.print(telemetry.heapFree / 1024);
+    Serial.print(" KB free (min ");
+    Serial.print(telemetry.heapMin / 1024);
+    Serial.println(" KB)");
+}
+
+void OTAModule::logTelemetry() {
+    Serial.print("OTA: ");
+    Serial.print(telemetry.bytes / 1024);
+    Serial.print(" KB at ");
+    Serial.print(telemetry.avgBps / 1024);
+    Serial.print(" KB/s, heap min ");
+    Serial.print(telemetry.heapMin / 1024);
+    Serial.print(" KB of ");
+    Serial.print(telemetry.heapStart / 1024);
+    Serial.print(" KB, audio ");
+    Serial.println(telemetry.mode == OTA_AUDIO_BACKGROUND ? "kept playing" : "paused");
+}
+
+bool OTAModule::startDownload() {
+    if (!Update.begin(pull.imageSize)) {
+        fail(String("no room: ") + Update.errorString());
+        return false;
+    }
+    
+    input = (uint8_t*)malloc(OTA_CHUNK);
+    if (gzip) {
+        inflator = (tinfl_decompressor*)calloc(1, sizeof(tinfl_decompressor));
+        dict = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+    }
+    if (!input || (gzip && (!inflator || !dict))) {
+        fail("out of memory");
+        return false;
+    }
+    if (gzip) tinfl_init(inflator);
+    inPos = inLen = 0;
+    flushPos = flushLen = 0;
+    dictPos = 0;
+    inflateDone = false;
+    gzipPhase = GZ_FIXED;
+    gzipCount = 0;
+    gzipFlags = 0;
+    gzipExtra = 0;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    
+    pull.written = pull.downloaded = pull.transferred = pull.resumes = 0;
+    pull.durationMs = 0;
+    pull.error = "";
+    pull.state = OTA_DOWNLOADING;
+    started = transferStart = reportAt = tokensAt = millis();
+    tokens = OTA_CHUNK;
+    pumpAllowedUs = micros();
+    if (!openImage()) interrupted("connect failed");
+    return true;
+}
+
+// From where the last connection stopped
+bool OTAModule::openImage() {
+    http = new HTTPClient();
+    uint16_t timeout = httpTimeout();
+    http->setTimeout(timeout);
+    http->setConnectTimeout(timeout);
+    http->useHTTP10(true);  // receive() reads the body raw
+    if (!http->begin(imageUrl)) {
+        closeImage();
+        return false;
+    }
+    if (pull.downloaded > 0) {
+        http->addHeader("Range", "bytes=" + String(pull.downloaded) + "-");
+    }
+    
+    int code = http->GET();
+    if (code == HTTP_CODE_PARTIAL_CONTENT) {
+        skip = 0;
+    } else if (code == HTTP_CODE_OK) {
+        skip = pull.downloaded;
+    } else {
+        Serial.print("OTA: Image request failed, HTTP ");
+        Serial.println(code);
+        closeImage();
+        return false;
+    }
+    
+    pull.state = OTA_DOWNLOADING;
+    lastData = millis();
+    return true;
+}
+
+// At most OTA_CHUNK bytes per call, so the loop keeps running. Input and
+// inflated output that did not fit the flash budget wait for the next call.
+void OTAModule::pump() {
+    if (inPos == inLen && flushLen == 0) {
+        if (!receive()) return;
+    } else {
+        lastData = millis();  // not reading while work is pending
+    }
+    
+    if (!consume(background() ? OTA_BACKGROUND_WRITE : UINT32_MAX)) return;
+    if (flushLen == 0 && (inflateDone || (!gzip && pull.written == pull.imageSize))) finish();
+}
+
+// One read into the input buffer; false if nothing arrived
+bool OTAModule::receive() {
+    WiFiClient& stream = http->getStream();
+    int available = stream.available();
+    if (available <= 0) {
+        if (!stream.connected()) {
+            interrupted("connection lost");
+        } else if (millis() - lastData > OTA_STALL_TIMEOUT) {
+            interrupted("stalled");
+        }
+        return false;
+    }
+    
+    int n = stream.read(input, available < OTA_CHUNK ? available : OTA_CHUNK);
+    if (n <= 0) return false;
+    lastData = millis();
+    pull.transferred += n;
+    tokens = (uint32_t)n < tokens ? tokens - n : 0;
+    noteProgress(pull.transferred, pull.imageSize ? (uint64_t)pull.written * 100 / pull.imageSize : 0);
+    
+    int offset = 0;
+    if (skip > 0) {
+        offset = (uint32_t)n < skip ? n : skip;
+        skip -= offset;
+    }
+    pull.downloaded += n - offset;
+    inPos = offset;
+    inLen = n;
+    return inPos < inLen;
+}
+
+// Writes at most `budget` bytes to flash. Inflated output wraps around the
+// dictionary; tinfl only runs again once the last output is written, as
+// the next call overwrites it.
+bool OTAModule::consume(uint32_t budget) {
+    while (true) {
+        if (flushLen > 0) {
+            uint32_t n = flushLen < budget ? flushLen : budget;
+            if (!writeImage(dict + flushPos, n)) return false;
+            flushPos += n;
+            flushLen -= n;
+            budget -= n;
+            if (flushLen > 0) return true;
+        }
+        if (inPos == inLen || budget == 0) return true;
+        
+        if (!gzip) {
+            uint32_t available = inLen - inPos;
+            uint32_t n = available < budget ? available : budget;
+            if (!writeImage(input + inPos, n)) return false;
+            inPos += n;
+            return true;
+        }
+        if (inflateDone) {
+            inPos = inLen;  // gzip trailer
+            return true;
+        }
+        
+        if (gzipPhase != GZ_DATA) {
+            int used = skipGzipHeader(input + inPos, inLen - inPos);
+            if (used < 0) {
+                fail("not a gzip image");
+                return false;
+            }
+            inPos += used;
+            if (inPos == inLen) return true;
+        }
+        
+        size_t inBytes = inLen - inPos;
+        size_t outBytes = TINFL_LZ_DICT_SIZE - dictPos;
+        tinfl_status status = tinfl_decompress(inflator, input + inPos, &inBytes, dict, dict + dictPos, &outBytes,
+                                               TINFL_FLAG_HAS_MORE_INPUT);
+        inPos += inBytes;
+        flushPos = dictPos;
+        flushLen = outBytes;
+        dictPos = (dictPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+        
+        if (status == TINFL_STATUS_DONE) {
+            inflateDone = true;
+        } else if (status < TINFL_STATUS_DONE) {
+            fail("corrupt image");
+            return false;
+        } else if (inBytes == 0 && outBytes == 0) {
+            return true;
+        }
+    }
+}
+
+// Returns the bytes belonging to the header, -1 if this is not gzip
+int OTAModule::skipGzipHeader(const uint8_t* data, int len) {
+    static const uint8_t FLAG_FOR_PHASE[] = { 0, 0x04, 0x04, 0x08, 0x10, 0x02 };
+    int i = 0;
+    while (i < len && gzipPhase != GZ_DATA) {
+        uint8_t b = data[i++];
+        bool phaseDone = false;
+        switch (gzipPhase) {
+            case GZ_FIXED:
+                if ((gzipCount == 0 && b != 0x1f) || (gzipCount == 1 && b != 0x8b) || (gzipCount == 2 && b != 8)) {
+                    return -1;
+                }
+                if (gzipCount == 3) gzipFlags = b;
+                phaseDone = ++gzipCount == 10;
+                break;
+            case GZ_EXTRA_LEN:
+                gzipExtra |= b << (8 * gzipCount);
+                phaseDone = ++gzipCount == 2;
+                break;
+            case GZ_EXTRA:
+                phaseDone = ++gzipCount == gzipExtra;
+                break;
+            case GZ_NAME:
+            case GZ_COMMENT:
+                phaseDone = b == 0;
+                break;
+            case GZ_HCRC:
+                phaseDone = ++gzipCount == 2;
+                break;
+        }
+        
+        // On to the next field the flags say is present
+        if (phaseDone) {
+            gzipCount = 0;
+            do {
+                gzipPhase++;
+            } while (gzipPhase < GZ_DATA && (!(gzipFlags & FLAG_FOR_PHASE[gzipPhase]) ||
+                                             (gzipPhase == GZ_EXTRA && gzipExtra == 0)));
+        }
+    }
+    return i;
+}
+
+bool OTAModule::writeImage(const uint8_t* data, int len) {
+    if (pull.written + len > pull.imageSize) {
+        fail("image larger than the manifest says");
+        return false;
+    }
+    if (Update.write((uint8_t*)data, len) != (size_t)len) {
+        fail(String("write failed: ") + Update.errorString());
+        return false;
+    }
+    mbedtls_sha256_update(&sha, data, len);
+    pull.written += len;
+    return true;
+}
+
+// Only a complete image with the manifest's hash becomes the boot image
+void OTAModule::finish() {
+    closeImage();
+    
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    char hex[65];
+    for (int i = 0; i < 32; i++) snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    
+    if (pull.written != pull.imageSize) {
+        fail("image shorter than the manifest says");
+        return;
+    }
+    if (expectedHash != hex) {
+        fail("hash mismatch");
+        return;
+    }
+    if (!Update.end()) {
+        fail(String("install failed: ") + Update.errorString());
+        return;
+    }
+    
+    freeBuffers();
+    pull.state = OTA_READY;
+    pull.durationMs = millis() - started;
+    Serial.print("OTA: Version ");
+    Serial.print(pull.version);
+    Serial.print(" installed in ");
+    Serial.print(pull.durationMs);
+    Serial.print(" ms, ");
+    Serial.print(pull.resumes);
+    Serial.println(" resume(s)");
+    logTelemetry();
+    
+    if (autoReboot) ESP.restart();
+    restoreAudio();
+}
+
+// The partial image stays; the next connection asks for the rest
+void OTAModule::interrupted(const char* why) {
+    closeImage();
+    if (++pull.resumes > OTA_MAX_RESUMES) {
+        fail("too many interruptions");
+        return;
+    }
+    
+    Serial.print("OTA: Download ");
+    Serial.print(why);
+    Serial.print(" at ");
+    Serial.print(pull.downloaded);
+    Serial.println(" bytes, resuming");
+    pull.state = OTA_RESUME_WAIT;
+    resumeAt = millis() + OTA_RESUME_DELAY;
+}
+
+void OTAModule::fail(const String& why) {
+    Serial.print("OTA: ");
+    Serial.println(why);
+    
+    closeImage();
+    if (Update.isRunning()) Update.abort();
+    if (pull.state == OTA_DOWNLOADING || pull.state == OTA_RESUME_WAIT) mbedtls_sha256_free(&sha);
+    freeBuffers();
+    pull.error = why;
+    pull.state = OTA_FAILED;
+    pull.durationMs = millis() - started;
+    restoreAudio();
+}
+
+void OTAModule::closeImage() {
+    if (http) {
+        http->end();
+        delete http;
+        http = nullptr;
+    }
+}
+
+void OTAModule::freeBuffers() {
+    free(input);
+    free(inflator);
+    free(dict);
+    input = nullptr;
+    inflator = nullptr;
+    dict = nullptr;
+}
+
+// Absolute, host-relative ("/x") or relative to the manifest's directory
+String OTAModule::resolveUrl(const String& base, const String& url) {
+    if (url.indexOf("://") >= 0) return url;
+    int hostStart = base.indexOf("://") + 3;
+    if (url.startsWith("/")) {
+        int pathStart = base.indexOf('/', hostStart);
+        return (pathStart < 0 ? base : base.substring(0, pathStart)) + url;
+    }
+    return base.substring(0, base.lastIndexOf('/') + 1) + url;
+}
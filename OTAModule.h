@@ -2,14 +2,192 @@
 #define OTA_MODULE_H
 
 #include <ArduinoOTA.h>
+#include <HTTPClient.h>
+#include <Update.h>
+#include <Preferences.h>
+#include <mbedtls/sha256.h>
+#include <rom/miniz.h>
+
+#ifndef FIRMWARE_VERSION
+#define FIRMWARE_VERSION "1.0.0"
+#endif
+#ifndef OTA_PASSWORD
+#define OTA_PASSWORD "gridbeacon"    // push updates (ArduinoOTA)
+#endif
+
+// Pull updates: every OTA_CHECK_INTERVAL the unit fetches a manifest from
+// the configured URL, one "key=value" per line:
+//   version=1.1.0
+//   url=gridbeacon-1.1.0.bin.gz     relative to the manifest, or absolute
+//   size=1048576                    image bytes after decompression
+//   sha256=<64 hex digits>          of the decompressed image
+//   encoding=gzip                   or identity
+// A different version is downloaded a little per handle() and inflated
+// straight into the OTA partition, so neither the compressed nor the whole
+// image is ever held in RAM. A dropped connection resumes where it stopped
+// with a Range request; a server that ignores Range is read past the part
+// already written. The hash is checked before the boot partition switches.
+#define OTA_MANIFEST_MAX 1024
+#define OTA_FIRST_CHECK 60000        // ms after begin, clear of boot
+#define OTA_CHECK_INTERVAL 3600000   // 1 hour
+// Connects and reads block handle(): one request (manifest check, image
+// open or resume) can hold the loop for up to twice the timeout plus the
+// DNS lookup. While audio plays the short one applies, so the worst case
+// is a dropout of about 0.6 s rather than 6 s; a slow server then fails the
+// attempt and it is retried (next check, next resume).
+#define OTA_HTTP_TIMEOUT 3000        // ms, audio paused or stopped
+#define OTA_PLAYING_HTTP_TIMEOUT 300 // ms, audio playing
+#define OTA_CHUNK 1024               // compressed bytes read per handle()
+#define OTA_STALL_TIMEOUT 10000      // no data: drop the connection and resume
+#define OTA_RESUME_DELAY 2000
+#define OTA_MAX_RESUMES 20
+
+// Playback during an update (push or pull). GRACEFUL fades the stream out
+// and frees the audio pipeline before the transfer starts. BACKGROUND keeps
+// playing: a pull download gets OTA_BACKGROUND_KBPS, one flash sector per
+// loop() pass and 1/OTA_BACKGROUND_SHARE of the loop's time, and a push
+// feeds the player from ArduinoOTA's receive loop. BACKGROUND falls back to
+// GRACEFUL when the heap cannot hold the download buffers next to audio.
+enum OtaAudioMode {
+    OTA_AUDIO_GRACEFUL,
+    OTA_AUDIO_BACKGROUND
+};
+
+#define OTA_AUDIO_DEFAULT OTA_AUDIO_GRACEFUL
+#define OTA_BACKGROUND_KBPS 48
+#define OTA_BACKGROUND_WRITE 4096    // flash bytes per pass, one sector
+#define OTA_BACKGROUND_SHARE 2       // a pump costing T ms waits (SHARE-1)*T
+#define OTA_HEAP_RESERVE 24576       // free heap BACKGROUND keeps for audio
+#define OTA_RELEASE_TIMEOUT 3000     // GRACEFUL: start even if audio hangs on
+#define OTA_REPORT_INTERVAL 2000     // progress, rate and heap log
+
+enum OtaState {
+    OTA_IDLE,
+    OTA_PREPARING,      // waiting for audio to let go
+    OTA_DOWNLOADING,
+    OTA_RESUME_WAIT,
+    OTA_READY,          // verified and installed; reboot to run it
+    OTA_FAILED
+};
+
+struct OtaPullStats {
+    OtaState state;
+    String version;             // offered by the manifest
+    String error;
+    uint32_t checks;
+    uint32_t imageSize;
+    uint32_t written;           // decompressed bytes in the partition
+    uint32_t downloaded;        // compressed bytes consumed
+    uint32_t transferred;       // bytes received, including skipped ones
+    uint32_t resumes;
+    uint32_t durationMs;
+};
+
+// The last (or running) update, push or pull
+struct OtaTelemetry {
+    bool push;                  // ArduinoOTA rather than pull
+    OtaAudioMode mode;          // as applied, after any fallback
+    uint32_t heapStart;         // free heap before audio was touched
+    uint32_t heapFree;
+    uint32_t heapMin;           // lowest free heap seen during the update
+    uint32_t bytes;             // received
+    uint32_t rateBps;           // over the last OTA_REPORT_INTERVAL
+    uint32_t avgBps;
+    uint32_t throttledMs;       // BACKGROUND: download held back
+};
+
+class AudioModule;
 
 class OTAModule {
 public:
+    OTAModule();
+
     void begin(const char* hostname = "GridBeacon");
     void handle();
-    
+
+    // Pull mode; an empty URL turns it off. Saved across reboots.
+    void setManifestUrl(const char* url);
+    String getManifestUrl();
+    void setAutoReboot(bool reboot);  // restart once an update is installed
+    bool checkNow();                  // false if busy or no URL
+    const OtaPullStats& getPullStats();
+
+    // Playback during updates; the mode is saved across reboots
+    void setAudio(AudioModule* audio);
+    void setAudioMode(OtaAudioMode mode);
+    OtaAudioMode getAudioMode();
+    const OtaTelemetry& getTelemetry();
+
 private:
     bool enabled;
+
+    // Audio coordination and telemetry
+    AudioModule* audioMgr;
+    OtaAudioMode audioMode;
+    bool audioSuspended;        // we asked audio to let go
+    OtaTelemetry telemetry;
+    unsigned long transferStart;
+    unsigned long reportAt;
+    uint32_t reportBytes;
+    uint32_t tokens;            // BACKGROUND rate budget, bytes
+    unsigned long tokensAt;
+    unsigned long pumpAllowedUs;
+    unsigned long heldSince;    // 0 = not held
+
+    // Pull state
+    Preferences prefs;
+    String manifestUrl;
+    bool autoReboot;
+    unsigned long nextCheck;
+    unsigned long resumeAt;
+    unsigned long lastData;
+    unsigned long started;
+    OtaPullStats pull;
+
+    String imageUrl;
+    String expectedHash;
+    bool gzip;
+    HTTPClient* http;
+    uint32_t skip;              // consumed bytes a 200 reply sends again
+    uint8_t* input;             // OTA_CHUNK bytes read off the connection
+    uint16_t inPos;
+    uint16_t inLen;
+
+    // Streaming inflate: tinfl writes into a 32 KB circular dictionary,
+    // which is also the window it copies matches from
+    tinfl_decompressor* inflator;
+    uint8_t* dict;
+    uint32_t dictPos;
+    uint32_t flushPos;          // inflated bytes not yet written
+    uint32_t flushLen;
+    bool inflateDone;
+    int gzipPhase;              // where skipGzipHeader() is in the header
+    uint16_t gzipCount;
+    uint8_t gzipFlags;
+    uint16_t gzipExtra;
+    mbedtls_sha256_context sha;
+
+    bool fetchManifest();
+    void prepareAudio(bool wait, uint32_t heapNeeded);
+    void restoreAudio();
+    bool background();
+    uint16_t httpTimeout();
+    bool holdBack();
+    void noteProgress(uint32_t bytes, uint32_t percent);
+    void logTelemetry();
+    bool startDownload();
+    bool openImage();
+    void pump();
+    bool receive();
+    bool consume(uint32_t budget);
+    int skipGzipHeader(const uint8_t* data, int len);
+    bool writeImage(const uint8_t* data, int len);
+    void finish();
+    void interrupted(const char* why);
+    void fail(const String& why);
+    void closeImage();
+    void freeBuffers();
+    static String resolveUrl(const String& base, const String& url);
 };
 
-#endif
\ No newline at end of file
+#endif
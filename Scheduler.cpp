@@ -0,0 +1,111 @@
+#include "Scheduler.h"
+
+Scheduler::Scheduler() : count(0), passes(0), maxPassUs(0) {
+    memset(tasks, 0, sizeof(tasks));
+    memset(nextRun, 0, sizeof(nextRun));
+}
+
+int Scheduler::add(const char* name, TaskPriority priority, uint32_t periodMs, uint32_t budgetUs,
+                   std::function<void()> fn) {
+    if (count >= SCHED_MAX_TASKS) return -1;
+    TaskStats& t = tasks[count];
+    t.name = name;
+    t.priority = priority;
+    t.periodMs = periodMs;
+    t.budgetUs = budgetUs;
+    fns[count] = fn;
+    nextRun[count] = millis();
+    return count++;
+}
+
+void Scheduler::run() {
+    unsigned long passStart = micros();
+    passes++;
+    
+    // Audio first, every pass
+    for (int i = 0; i < count; i++) {
+        if (tasks[i].priority == PRIORITY_AUDIO && isDue(i, millis())) runTask(i);
+    }
+    
+    // Then the rest, highest priority and most overdue first, within budget
+    unsigned long restStart = micros();
+    bool done[SCHED_MAX_TASKS] = {};
+    while (true) {
+        unsigned long now = millis();
+        int next = -1;
+        for (int i = 0; i < count; i++) {
+            if (done[i] || tasks[i].priority == PRIORITY_AUDIO || !isDue(i, now)) continue;
+            if (next < 0 || tasks[i].priority > tasks[next].priority ||
+                (tasks[i].priority == tasks[next].priority && (long)(nextRun[i] - nextRun[next]) < 0)) {
+                next = i;
+            }
+        }
+        if (next < 0) break;
+        
+        if (micros() - restStart >= SCHED_PASS_BUDGET_US) {
+            for (int i = 0; i < count; i++) {
+                if (!done[i] && tasks[i].priority != PRIORITY_AUDIO && isDue(i, now)) tasks[i].deferrals++;
+            }
+            break;
+        }
+        runTask(next);
+        done[next] = true;
+    }
+    
+    uint32_t passUs = micros() - passStart;
+    if (passUs > maxPassUs) maxPassUs = passUs;
+    yield();  // feeds the watchdog
+}
+
+bool Scheduler::isDue(int task, unsigned long now) {
+    return (long)(now - nextRun[task]) >= 0;
+}
+
+void Scheduler::runTask(int task) {
+    TaskStats& t = tasks[task];
+    unsigned long start = micros();
+    fns[task]();
+    uint32_t us = micros() - start;
+    
+    t.runs++;
+    t.lastUs = us;
+    t.totalUs += us;
+    if (us > t.budgetUs) {
+        t.overruns++;
+        if (us > t.maxUs) {
+            Serial.print("Scheduler: ");
+            Serial.print(t.name);
+            Serial.print(" took ");
+            Serial.print(us);
+            Serial.print(" us (budget ");
+            Serial.print(t.budgetUs);
+            Serial.println(" us)");
+        }
+    }
+    if (us > t.maxUs) t.maxUs = us;
+    
+    // Periodic tasks keep their cadence unless they fell a period behind;
+    // every-pass tasks queue behind those that have waited longer
+    if (t.periodMs > 0) {
+        nextRun[task] += t.periodMs;
+        if ((long)(millis() - nextRun[task]) >= 0) nextRun[task] = millis() + t.periodMs;
+    } else {
+        nextRun[task] = millis();
+    }
+}
+
+int Scheduler::getCount() {
+    return count;
+}
+
+const TaskStats* Scheduler::getTasks() {
+    return tasks;
+}
+
+uint32_t Scheduler::getPasses() {
+    return passes;
+}
+
+uint32_t Scheduler::getMaxPassUs() {
+    return maxPassUs;
+}
@@ -0,0 +1,61 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include <functional>
+
+// Cooperative scheduler behind loop(). Modules register tasks with a
+// priority, a period and a time budget per run. Each pass runs the audio
+// tasks first, then the due tasks by priority (most overdue first) until
+// the pass has used SCHED_PASS_BUDGET_US; what is left waits for the next
+// pass, so audio comes around again before the rest. Nothing is cut short:
+// a run longer than its budget counts as an overrun, which is how /tasks
+// shows who takes time from playback.
+#define SCHED_MAX_TASKS 12
+#define SCHED_PASS_BUDGET_US 20000   // non-audio work per pass, inside the I2S buffer
+
+enum TaskPriority {
+    PRIORITY_HOUSEKEEPING,  // storage commits, deferred start-up
+    PRIORITY_NETWORK,       // web, discovery, OTA, link supervisor
+    PRIORITY_AUDIO          // every pass, before anything else
+};
+
+struct TaskStats {
+    const char* name;       // static string
+    TaskPriority priority;
+    uint32_t periodMs;      // 0 = every pass
+    uint32_t budgetUs;
+    uint32_t runs;
+    uint32_t overruns;      // runs longer than budgetUs
+    uint32_t deferrals;     // due, but the pass budget was spent
+    uint32_t lastUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+};
+
+class Scheduler {
+public:
+    Scheduler();
+
+    // Returns the task slot, -1 when full
+    int add(const char* name, TaskPriority priority, uint32_t periodMs, uint32_t budgetUs, std::function<void()> fn);
+    void run();  // one pass; call from loop()
+
+    int getCount();
+    const TaskStats* getTasks();
+    uint32_t getPasses();
+    uint32_t getMaxPassUs();
+
+private:
+    TaskStats tasks[SCHED_MAX_TASKS];
+    std::function<void()> fns[SCHED_MAX_TASKS];
+    unsigned long nextRun[SCHED_MAX_TASKS];
+    int count;
+    uint32_t passes;
+    uint32_t maxPassUs;
+
+    bool isDue(int task, unsigned long now);
+    void runTask(int task);
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include "StreamResolver.h"
+
+StreamResolver::StreamResolver()
+    : state(RESOLVE_IDLE), hop(0), started(0), http(nullptr), type(PLAYLIST_NONE), limit(0), total(0),
+      lastByte(0), lineLen(0), overflow(false) {
+}
+
+StreamResolver::~StreamResolver() {
+    closeHttp();
+}
+
+void StreamResolver::begin(const String& target) {
+    closeHttp();
+    url = target;
+    current = target;
+    endpoint = "";
+    hop = 0;
+    started = millis();
+    state = RESOLVE_RUNNING;
+}
+
+ResolveState StreamResolver::step() {
+    if (state != RESOLVE_RUNNING) return state;
+    return http == nullptr ? request() : readBody();
+}
+
+void StreamResolver::cancel() {
+    closeHttp();
+    if (state == RESOLVE_RUNNING) state = RESOLVE_IDLE;
+}
+
+ResolveState StreamResolver::getState() {
+    return state;
+}
+
+const String& StreamResolver::getEndpoint() {
+    return endpoint;
+}
+
+// One hop: a redirect moves on to the next, audio ends the walk and a
+// playlist is left open for readBody()
+ResolveState StreamResolver::request() {
+    if (WiFi.status() != WL_CONNECTED) return fail();
+    if (hop >= RESOLVE_MAX_HOPS) {
+        Serial.print("Resolver: gave up on ");
+        Serial.println(url);
+        return fail();
+    }
+
+    const char* headers[] = { "Location", "Content-Type" };
+    http = new HTTPClient();
+    http->setFollowRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS);
+    http->setConnectTimeout(RESOLVE_TIMEOUT_MS);
+    http->setTimeout(RESOLVE_TIMEOUT_MS);
+    http->useHTTP10(true);  // the body is read raw: no chunk-size lines in it
+    http->collectHeaders(headers, 2);
+
+    if (!http->begin(current)) {
+        Serial.print("Resolver: bad URL ");
+        Serial.println(current);
+        return fail();
+    }
+
+    int code = http->GET();
+
+    if (code == HTTP_CODE_MOVED_PERMANENTLY || code == HTTP_CODE_FOUND || code == HTTP_CODE_SEE_OTHER ||
+        code == HTTP_CODE_TEMPORARY_REDIRECT || code == HTTP_CODE_PERMANENT_REDIRECT) {
+        String location = http->header("Location");
+        closeHttp();
+        if (location.length() == 0) return fail();
+        current = absoluteUrl(current, location);
+        hop++;
+        return state;
+    }
+
+    if (code != HTTP_CODE_OK) {
+        Serial.print("Resolver: HTTP ");
+        Serial.print(code);
+        Serial.print(" from ");
+        Serial.println(current);
+        return fail();
+    }
+
+    type = playlistType(current, http->header("Content-Type"));
+    if (type == PLAYLIST_NONE) {
+        // Audio (or something the decoder will have to judge): done
+        closeHttp();
+        endpoint = current;
+        state = RESOLVE_DONE;
+
+        Serial.print("Resolver: ");
+        Serial.print(url);
+        Serial.print(" -> ");
+        Serial.print(endpoint);
+        Serial.print(" (");
+        Serial.print(hop);
+        Serial.print(" hops, ");
+        Serial.print(millis() - started);
+        Serial.println(" ms)");
+        return state;
+    }
+
+    limit = RESOLVE_BODY_MAX;
+    int contentLength = http->getSize();
+    if (contentLength >= 0 && contentLength < limit) limit = contentLength;
+    total = 0;
+    lastByte = millis();
+    lineLen = 0;
+    overflow = false;
+    return state;
+}
+
+// Parses what has arrived, line by line through a fixed buffer; nothing
+// beyond the first entry is downloaded
+ResolveState StreamResolver::readBody() {
+    WiFiClient* body = http->getStreamPtr();
+    for (int n = 0; n < RESOLVE_STEP_BYTES; n++) {
+        int c = -1;
+        if (total < limit) {
+            if (body->available() > 0) {
+                c = body->read();
+            }
+            if (c >= 0) {
+                lastByte = millis();
+                total++;
+            } else if (body->connected() && millis() - lastByte < RESOLVE_TIMEOUT_MS) {
+                return state;  // more next step
+            }
+        }
+
+        bool endOfBody = c < 0;
+        if (!endOfBody && c != '\n' && c != '\r') {
+            if (lineLen < sizeof(line) - 1) line[lineLen++] = c;
+            else overflow = true;  // too long for a URL we could store
+            continue;
+        }
+
+        line[lineLen] = '\0';
+        if (lineLen > 0 && !overflow) {
+            String entry;
+            LineResult result = parseLine(line, type, entry);
+            if (result == LINE_ENTRY) {
+                closeHttp();
+                current = absoluteUrl(current, entry);
+                hop++;
+                return state;
+            }
+            if (result == LINE_UNSUPPORTED) {
+                Serial.println("Resolver: HLS playlists are not supported");
+                return fail();
+            }
+        }
+        lineLen = 0;
+        overflow = false;
+
+        if (endOfBody) {
+            Serial.print("Resolver: no playable entry in ");
+            Serial.println(current);
+            return fail();
+        }
+    }
+    return state;
+}
+
+ResolveState StreamResolver::fail() {
+    closeHttp();
+    state = RESOLVE_FAILED;
+    return state;
+}
+
+void StreamResolver::closeHttp() {
+    if (http == nullptr) return;
+    http->end();
+    delete http;
+    http = nullptr;
+}
+
+bool StreamResolver::looksLikePlaylist(const String& url) {
+    String path = url;
+    int query = path.indexOf('?');
+    if (query >= 0) path = path.substring(0, query);
+    path.toLowerCase();
+    return path.endsWith(".m3u") || path.endsWith(".m3u8") || path.endsWith(".pls");
+}
+
+StreamResolver::PlaylistType StreamResolver::playlistType(const String& url, String contentType) {
+    contentType.toLowerCase();
+    int semicolon = contentType.indexOf(';');
+    if (semicolon >= 0) contentType = contentType.substring(0, semicolon);
+    contentType.trim();
+
+    if (contentType.endsWith("mpegurl")) return PLAYLIST_M3U;   // audio/x-mpegurl, application/vnd.apple.mpegurl
+    if (contentType.endsWith("scpls") || contentType == "application/pls+xml") return PLAYLIST_PLS;
+    if (contentType.startsWith("audio/") || contentType == "application/ogg") return PLAYLIST_NONE;
+
+    // Many servers send playlists as text/plain or octet-stream
+    String path = url;
+    int query = path.indexOf('?');
+    if (query >= 0) path = path.substring(0, query);
+    path.toLowerCase();
+    if (path.endsWith(".pls")) return PLAYLIST_PLS;
+    if (path.endsWith(".m3u") || path.endsWith(".m3u8")) return PLAYLIST_M3U;
+    return PLAYLIST_NONE;
+}
+
+StreamResolver::LineResult StreamResolver::parseLine(char* line, PlaylistType type, String& entry) {
+    while (*line == ' ' || *line == '\t') line++;
+    char* end = line + strlen(line);
+    while (end > line && (end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+    if (*line == '\0') return LINE_SKIP;
+
+    if (type == PLAYLIST_M3U) {
+        // HLS segment lists would resolve to a single few-second chunk
+        if (strncmp(line, "#EXT-X-", 7) == 0) return LINE_UNSUPPORTED;
+        if (*line == '#') return LINE_SKIP;
+        entry = line;
+        return LINE_ENTRY;
+    }
+
+    // PLS: FileN=<url>
+    if (strncasecmp(line, "file", 4) != 0) return LINE_SKIP;
+    char* eq = strchr(line, '=');
+    if (!eq || eq[1] == '\0') return LINE_SKIP;
+    entry = eq + 1;
+    return LINE_ENTRY;
+}
+
+String StreamResolver::absoluteUrl(const String& base, const String& ref) {
+    if (ref.indexOf("://") >= 0) return ref;
+
+    int schemeEnd = base.indexOf("://");
+    if (schemeEnd < 0) return ref;
+    if (ref.startsWith("//")) return base.substring(0, schemeEnd + 1) + ref;
+
+    int hostEnd = base.indexOf('/', schemeEnd + 3);
+    String origin = hostEnd < 0 ? base : base.substring(0, hostEnd);
+    if (ref.startsWith("/")) return origin + ref;
+
+    // Relative to the directory of the base path
+    String path = base;
+    int query = path.indexOf('?');
+    if (query >= 0) path = path.substring(0, query);
+    int slash = path.lastIndexOf('/');
+    if (slash < schemeEnd + 3) return origin + "/" + ref;
+    return path.substring(0, slash + 1) + ref;
+}
@@ -0,0 +1,71 @@
+#ifndef STREAM_RESOLVER_H
+#define STREAM_RESOLVER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+
+#define RESOLVE_MAX_HOPS 5          // redirects + nested playlists
+#define RESOLVE_TIMEOUT_MS 4000     // per connect / read
+#define RESOLVE_BODY_MAX 8192       // playlist bytes scanned for an entry
+#define RESOLVE_LINE_MAX 320
+#define RESOLVE_STEP_BYTES 512      // playlist bytes parsed per step()
+
+enum ResolveState {
+    RESOLVE_IDLE,
+    RESOLVE_RUNNING,
+    RESOLVE_DONE,       // getEndpoint() holds the result
+    RESOLVE_FAILED
+};
+
+// Turns a user-supplied URL into the endpoint URLStream can play: follows
+// HTTP redirects and M3U/PLS playlists, reading playlists as a stream and
+// stopping at the first entry. Runs in steps from the scheduler: a step
+// sends one hop's request (connect and response headers, the one wait that
+// cannot be split) or parses what has arrived of a playlist, and returns
+// rather than wait for more.
+class StreamResolver {
+public:
+    StreamResolver();
+    ~StreamResolver();
+
+    void begin(const String& url);
+    ResolveState step();
+    void cancel();
+    ResolveState getState();
+    const String& getEndpoint();
+
+    static bool looksLikePlaylist(const String& url);
+
+private:
+    enum PlaylistType { PLAYLIST_NONE, PLAYLIST_M3U, PLAYLIST_PLS };
+    enum LineResult { LINE_SKIP, LINE_ENTRY, LINE_UNSUPPORTED };
+
+    ResolveState state;
+    String url;                 // as given
+    String current;             // this hop
+    String endpoint;
+    int hop;
+    unsigned long started;
+
+    // Playlist body of the current hop
+    HTTPClient* http;
+    PlaylistType type;
+    int limit;
+    int total;
+    unsigned long lastByte;
+    char line[RESOLVE_LINE_MAX];
+    size_t lineLen;
+    bool overflow;
+
+    ResolveState request();
+    ResolveState readBody();
+    ResolveState fail();
+    void closeHttp();
+
+    static PlaylistType playlistType(const String& url, String contentType);
+    static LineResult parseLine(char* line, PlaylistType type, String& entry);
+    static String absoluteUrl(const String& base, const String& ref);
+};
+
+#endif
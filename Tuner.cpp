@@ -0,0 +1,207 @@
+#include "Tuner.h"
+
+Tuner::Tuner(LibraryModule* library)
+    : audioMgr(nullptr), libraryMgr(library), nextSlot(0), nextId(1), active(nullptr), resolved(false),
+      wasPlaying(false), touched(false), nameVersion(0xFFFFFFFF) {
+    for (int i = 0; i < TUNE_SLOTS; i++) slots[i].id = 0;
+}
+
+void Tuner::setAudio(AudioModule* audio) {
+    audioMgr = audio;
+}
+
+uint32_t Tuner::tune(const String& url, bool play, DoneHandler done) {
+    return start(url, LIBRARY_NO_STATION, play, done);
+}
+
+uint32_t Tuner::tuneStation(uint32_t stationId, bool play) {
+    return start("", stationId, play, nullptr);
+}
+
+uint32_t Tuner::play(DoneHandler done) {
+    if (audioMgr == nullptr) return 0;
+    
+    String saved = audioMgr->getSavedURL();
+    if (audioMgr->getCurrentURL().length() == 0 && saved.length() > 0) {
+        return tune(saved, true, done);
+    }
+    audioMgr->play();
+    return 0;
+}
+
+uint32_t Tuner::start(const String& url, uint32_t stationId, bool play, DoneHandler done) {
+    if (audioMgr == nullptr) return 0;
+    
+    // The latest choice wins; what the replaced change paused stays paused
+    // for this one to resume, and an old stream it tore down stays gone
+    bool resumeAfter = active != nullptr ? wasPlaying : audioMgr->isPlaying();
+    String fallback = active != nullptr ? previous : audioMgr->getCurrentURL();
+    bool tornDown = active != nullptr && touched;
+    if (active != nullptr) finish(TUNE_REPLACED);
+    wasPlaying = resumeAfter;
+    previous = fallback;
+    
+    TuneStatus& job = slots[nextSlot];
+    nextSlot = (nextSlot + 1) % TUNE_SLOTS;
+    job.id = nextId;
+    if (++nextId == 0) nextId = 1;
+    job.state = TUNE_QUEUED;
+    job.stationId = stationId;
+    job.url = url;
+    job.endpoint = "";
+    job.play = play;
+    job.startMs = millis();
+    job.durationMs = 0;
+    
+    active = &job;
+    doneHandler = done;
+    resolved = false;
+    tried = "";
+    touched = tornDown;
+    return job.id;
+}
+
+void Tuner::handle() {
+    if (active == nullptr || audioMgr == nullptr) return;
+    
+    switch (active->state) {
+        case TUNE_QUEUED: begin(); break;
+        case TUNE_RESOLVING: resolve(); break;
+        case TUNE_OPENING: open(); break;
+        default: break;
+    }
+}
+
+// Silences the old stream (a resolve hop would only stutter it) and picks
+// the first URL to try: a stored endpoint, or the URL itself unless it is a
+// playlist, which never plays as it is
+void Tuner::begin() {
+    if (audioMgr->isPlaying()) audioMgr->pause();
+    
+    bool unresolved = true;
+    if (active->stationId != LIBRARY_NO_STATION) {
+        if (libraryMgr == nullptr || !libraryMgr->getStation(active->stationId, station)) {
+            Serial.println("Tuner: station not found");
+            finish(TUNE_FAILED);
+            return;
+        }
+        active->url = station.url;
+        unresolved = station.endpoint.length() == 0;
+    }
+    
+    if (unresolved && StreamResolver::looksLikePlaylist(active->url)) {
+        resolved = true;
+        resolver.begin(active->url);
+        active->state = TUNE_RESOLVING;
+        return;
+    }
+    active->endpoint = active->stationId != LIBRARY_NO_STATION ? station.playUrl() : active->url;
+    active->state = TUNE_OPENING;
+}
+
+void Tuner::resolve() {
+    ResolveState state = resolver.step();
+    if (state == RESOLVE_RUNNING) return;
+    
+    if (state == RESOLVE_DONE && resolver.getEndpoint() != tried) {
+        active->endpoint = resolver.getEndpoint();
+        active->state = TUNE_OPENING;
+    } else if (tried.length() == 0) {
+        // A playlist-looking URL the resolver could not read: maybe a stream
+        active->endpoint = active->url;
+        active->state = TUNE_OPENING;
+    } else {
+        finish(TUNE_FAILED);
+    }
+}
+
+// Blocks for the stream open, as setURL() does everywhere
+void Tuner::open() {
+    touched = true;
+    if (audioMgr->setURL(active->endpoint.c_str())) {
+        onAirUrl = active->endpoint;
+        onAirName = active->stationId != LIBRARY_NO_STATION ? station.name : String("");
+        if (libraryMgr != nullptr) {
+            // Resolved once, then played straight from the stored endpoint
+            if (resolved && active->stationId != LIBRARY_NO_STATION) libraryMgr->setEndpoint(station, active->endpoint);
+            libraryMgr->notePlay(active->stationId);
+        }
+        if (active->play) audioMgr->play();
+        finish(TUNE_DONE);
+        return;
+    }
+    
+    // Stale endpoint or a redirecting URL: resolve the URL and try again
+    tried = active->endpoint;
+    if (!resolved) {
+        resolved = true;
+        resolver.begin(active->url);
+        active->state = TUNE_RESOLVING;
+        return;
+    }
+    finish(TUNE_FAILED);
+}
+
+void Tuner::finish(TuneState state) {
+    resolver.cancel();
+    active->state = state;
+    active->durationMs = millis() - active->startMs;
+    
+    Serial.print("Tuner: ");
+    Serial.print(active->url);
+    if (state == TUNE_DONE) {
+        Serial.print(" playing from ");
+        Serial.print(active->endpoint);
+    } else {
+        Serial.print(state == TUNE_REPLACED ? " replaced" : " failed");
+    }
+    Serial.print(" after ");
+    Serial.print(active->durationMs);
+    Serial.println(" ms");
+    
+    if (state == TUNE_FAILED) restore();
+    active = nullptr;
+    
+    // Last: the handler may start another change
+    DoneHandler handler = doneHandler;
+    doneHandler = nullptr;
+    if (handler) handler(state == TUNE_DONE);
+}
+
+// A failed change leaves things as they were: the old stream, reopened if
+// setURL() already tore it down, and its play state
+void Tuner::restore() {
+    if (touched) {
+        if (previous.length() == 0 || !audioMgr->setURL(previous.c_str())) {
+            Serial.println("Tuner: previous stream did not reopen");
+            return;
+        }
+    }
+    if (wasPlaying) audioMgr->play();
+}
+
+bool Tuner::isBusy() {
+    return active != nullptr;
+}
+
+bool Tuner::willPlay() {
+    if (active != nullptr) return active->play;
+    return audioMgr != nullptr && audioMgr->isPlaying();
+}
+
+// A stream reopened without us (resumed after power loss) shows its URL
+const String& Tuner::getStationName() {
+    if (audioMgr != nullptr && audioMgr->getStateVersion() != nameVersion) {
+        nameVersion = audioMgr->getStateVersion();
+        String url = audioMgr->getCurrentURL();
+        stationName = onAirName.length() > 0 && url == onAirUrl ? onAirName : url;
+    }
+    return stationName;
+}
+
+const TuneStatus* Tuner::getStatus(uint32_t id) {
+    for (int i = 0; i < TUNE_SLOTS; i++) {
+        if (id != 0 && slots[i].id == id) return &slots[i];
+    }
+    return nullptr;
+}
@@ -0,0 +1,93 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <Arduino.h>
+#include <functional>
+#include "AudioModule.h"
+#include "LibraryModule.h"
+#include "StreamResolver.h"
+
+// Station changes. Web handlers and group commands queue a change and
+// return; the scheduler's "tune" task carries it out a step per pass.
+// Playback pauses for the switch, playlists and redirects are resolved a
+// hop per step (StreamResolver), then the new stream opens. A newer change
+// replaces one still running; one that fails puts the previous stream and
+// play state back. Each change gets an id; /api/v1/tune reports
+// its state until TUNE_SLOTS newer changes have been made.
+#define TUNE_SLOTS 4
+
+enum TuneState {
+    TUNE_QUEUED,
+    TUNE_RESOLVING,
+    TUNE_OPENING,
+    TUNE_DONE,
+    TUNE_FAILED,
+    TUNE_REPLACED       // a newer change took over
+};
+
+struct TuneStatus {
+    uint32_t id;            // 0 = unused
+    TuneState state;
+    uint32_t stationId;     // LIBRARY_NO_STATION for a plain URL
+    String url;             // as requested, or the station's URL
+    String endpoint;        // opened (or last tried)
+    bool play;              // playing once the stream is open
+    uint32_t startMs;       // millis() when requested
+    uint32_t durationMs;    // until done or failed
+};
+
+class Tuner {
+public:
+    Tuner(LibraryModule* library);
+
+    void setAudio(AudioModule* audio);
+
+    // Both return the change's id, 0 without audio. done, if given, is
+    // called once with whether the new stream opened.
+    typedef std::function<void(bool)> DoneHandler;
+    uint32_t tune(const String& url, bool play, DoneHandler done = nullptr);
+    uint32_t tuneStation(uint32_t stationId, bool play);
+    // Playback on. Booted paused with nothing open, the saved stream is
+    // tuned in like a station change and its id returned; otherwise 0.
+    uint32_t play(DoneHandler done = nullptr);
+    void handle();                  // one step; call every loop pass
+
+    bool isBusy();
+    bool willPlay();                // playing, or will be once the change is done
+    const String& getStationName(); // library name of what is on air, else its URL
+    const TuneStatus* getStatus(uint32_t id);
+
+private:
+    AudioModule* audioMgr;
+    LibraryModule* libraryMgr;
+    StreamResolver resolver;
+    TuneStatus slots[TUNE_SLOTS];
+    int nextSlot;
+    uint32_t nextId;
+
+    // The running change
+    TuneStatus* active;
+    DoneHandler doneHandler;
+    Station station;            // library stations
+    bool resolved;              // the resolver has run for this change
+    String tried;               // last URL that failed to open
+    bool wasPlaying;            // before the change paused playback
+    String previous;            // stream before the change
+    bool touched;               // setURL() was called: the old stream is gone
+
+    // On air: the last change that opened, and the name derived from it,
+    // redone only when the audio state changes
+    String onAirUrl;
+    String onAirName;           // empty for plain URLs
+    String stationName;
+    uint32_t nameVersion;
+
+    uint32_t start(const String& url, uint32_t stationId, bool play, DoneHandler done);
+    void begin();
+    void resolve();
+    void open();
+    void finish(TuneState state);
+    void restore();
+};
+
+#endif
@@ -1,7 +1,57 @@
 #include "WebServerModule.h"
 
-WebServerModule::WebServerModule(WiFiModule* wifi, AudioModule* audio, LibraryModule* library, DiscoveryModule* discovery)
-  : wifiMgr(wifi), audioMgr(audio), libraryMgr(library), discoveryMgr(discovery) {
+// WiFi setup page (captive portal) - identical for every request
+static const char SETUP_HTML[] PROGMEM =
+    "<!DOCTYPE html><html><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width,initial-scale=1'>"
+    "<title>GridBeacon Setup</title><style>*{margin:0;padding:0;box-sizing:border-box}"
+    "body{font-family:Impact,Arial Black,sans-serif;background:linear-gradient(135deg,#667eea 0%,#764ba2 100%);"
+    "min-height:100vh;display:flex;align-items:center;justify-content:center;padding:20px}"
+    ".container{max-width:420px;width:100%}.card{background:#fff;border-radius:16px;padding:40px 30px;"
+    "box-shadow:0 20px 60px rgba(0,0,0,0.3);position:relative;overflow:hidden}"
+    ".card::before{content:'';position:absolute;top:0;left:0;right:0;height:8px;"
+    "background:linear-gradient(90deg,#FF6B6B,#FFE66D,#4ECDC4,#FF6B6B);background-size:200% 100%;"
+    "animation:slideGradient 3s linear infinite}@keyframes slideGradient{0%{background-position:0% 50%}"
+    "100%{background-position:200% 50%}}h1{font-size:42px;color:#2d3748;text-transform:uppercase;"
+    "letter-spacing:2px;margin-bottom:8px;text-shadow:3px 3px 0px #FFE66D}.tagline{font-family:Arial,sans-serif;"
+    "font-size:14px;color:#718096;margin-bottom:30px;font-weight:normal}label{display:block;font-size:14px;"
+    "color:#4a5568;margin-bottom:8px;margin-top:20px;text-transform:uppercase;letter-spacing:1px;font-weight:bold}"
+    "input{width:100%;padding:14px 16px;border:3px solid #e2e8f0;border-radius:8px;font-size:16px;"
+    "font-family:Arial,sans-serif;transition:all 0.3s;background:#f7fafc}input:focus{outline:none;"
+    "border-color:#4ECDC4;background:#fff;transform:translateY(-2px);box-shadow:0 4px 12px rgba(78,205,196,0.3)}"
+    "button{width:100%;padding:16px;margin-top:30px;background:linear-gradient(135deg,#FF6B6B 0%,#FF8E53 100%);"
+    "color:white;border:none;border-radius:8px;font-size:18px;font-weight:bold;text-transform:uppercase;"
+    "letter-spacing:2px;cursor:pointer;transition:all 0.3s;box-shadow:0 4px 15px rgba(255,107,107,0.4)}"
+    "button:hover{transform:translateY(-3px);box-shadow:0 6px 20px rgba(255,107,107,0.6)}"
+    ".status-badge{display:inline-block;background:#4ECDC4;color:white;padding:6px 12px;border-radius:20px;"
+    "font-size:12px;font-family:Arial,sans-serif;font-weight:bold;margin-top:20px}.footer{text-align:center;"
+    "margin-top:20px;color:white;font-size:12px;font-family:Arial,sans-serif;text-shadow:1px 1px 2px rgba(0,0,0,0.3)}"
+    "</style></head><body><div class='container'><div class='card'><h1>GRIDBEACON</h1>"
+    "<p class='tagline'>Break free. Stream anywhere.</p><form action='/save' method='POST'>"
+    "<label for='ssid'>WiFi Network</label><input type='text' id='ssid' name='ssid' placeholder='Enter network name' required>"
+    "<label for='password'>Password</label><input type='password' id='password' name='password' placeholder='Enter password' required>"
+    "<label for='room'>Room/Location Name</label><input type='text' id='room' name='room' placeholder='e.g. Bedroom, Kitchen' required maxlength='20'>"
+    "<button type='submit'>CONNECT</button></form><div class='status-badge'>● AP MODE</div></div>"
+    "<div class='footer'>Built by rebels, for rebels</div></div></body></html>";
+
+// FNV-1a, used for content ETags
+static uint32_t fnv1a(const char* data) {
+  uint32_t hash = 2166136261u;
+  while (*data) {
+    hash ^= (uint8_t)*data++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+WebServerModule::WebServerModule(WiFiModule* wifi, AudioModule* audio, LibraryModule* library, DiscoveryModule* discovery,
+                                 DirectoryModule* directory, BootTrace* boot, OTAModule* ota, Scheduler* scheduler,
+                                 HeapMonitor* heap, Tuner* tuner)
+  : wifiMgr(wifi), audioMgr(audio), libraryMgr(library), discoveryMgr(discovery), directoryMgr(directory),
+    bootTrace(boot), otaMgr(ota), scheduler(scheduler), heapMonitor(heap), tuner(tuner),
+    cacheHits(0), cacheMisses(0) {
+
+  // Version counters restart at zero on every boot, so tag ETags with a boot id
+  bootTag = String((uint32_t)random(0x7FFFFFFF), HEX);
 
   server = new WebServer(80);
   dnsServer = new DNSServer();
@@ -53,10 +103,63 @@ void WebServerModule::begin() {
   server->on("/reset", HTTP_POST, [this]() {
     handleReset();
   });
+  server->on("/api/v1/batch", HTTP_POST, [this]() {
+    handleBatch();
+  });
+  server->on("/network/get", [this]() {
+    handleGetNetworks();
+  });
+  server->on("/metrics", [this]() {
+    handleMetrics();
+  });
+  server->on("/boot", [this]() {
+    handleBoot();
+  });
+  server->on("/tasks", [this]() {
+    handleTasks();
+  });
+  server->on("/heap", [this]() {
+    handleHeap();
+  });
+  server->on("/api/v1/search", [this]() {
+    handleSearch();
+  });
+  server->on("/api/v1/tune", [this]() {
+    handleTune();
+  });
+  server->on("/api/v1/group", HTTP_GET, [this]() {
+    handleGroup();
+  });
+  server->on("/api/v1/group", HTTP_POST, [this]() {
+    handleGroupCommand();
+  });
+  server->on("/api/v1/group/status", [this]() {
+    handleGroupStatus();
+  });
+  server->on("/api/v1/group/join", HTTP_POST, [this]() {
+    handleGroupJoin();
+  });
+  server->on("/api/v1/ota", HTTP_GET, [this]() {
+    handleOta();
+  });
+  server->on("/api/v1/ota", HTTP_POST, [this]() {
+    handleOtaConfig();
+  });
   server->onNotFound([this]() {
     handleNotFound();
   });
 
+  // Commands from peers (and our own) land here
+  if (discoveryMgr) {
+    discoveryMgr->onCommand([this](const GroupCommand& command, const CommandTicket& ticket) {
+      return runGroupCommand(command, ticket);
+    });
+  }
+
+  // Needed for conditional GETs
+  static const char* headerKeys[] = { "If-None-Match" };
+  server->collectHeaders(headerKeys, 1);
+
   server->begin();
   Serial.println("Web server started");
 }
@@ -76,72 +179,102 @@ void WebServerModule::handleRoot() {
     handlePlayer();
   } else {
     // WiFi setup page (captive portal)
-    String html = "<!DOCTYPE html><html><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width,initial-scale=1'>"
-                  "<title>GridBeacon Setup</title><style>*{margin:0;padding:0;box-sizing:border-box}"
-                  "body{font-family:Impact,Arial Black,sans-serif;background:linear-gradient(135deg,#667eea 0%,#764ba2 100%);"
-                  "min-height:100vh;display:flex;align-items:center;justify-content:center;padding:20px}"
-                  ".container{max-width:420px;width:100%}.card{background:#fff;border-radius:16px;padding:40px 30px;"
-                  "box-shadow:0 20px 60px rgba(0,0,0,0.3);position:relative;overflow:hidden}"
-                  ".card::before{content:'';position:absolute;top:0;left:0;right:0;height:8px;"
-                  "background:linear-gradient(90deg,#FF6B6B,#FFE66D,#4ECDC4,#FF6B6B);background-size:200% 100%;"
-                  "animation:slideGradient 3s linear infinite}@keyframes slideGradient{0%{background-position:0% 50%}"
-                  "100%{background-position:200% 50%}}h1{font-size:42px;color:#2d3748;text-transform:uppercase;"
-                  "letter-spacing:2px;margin-bottom:8px;text-shadow:3px 3px 0px #FFE66D}.tagline{font-family:Arial,sans-serif;"
-                  "font-size:14px;color:#718096;margin-bottom:30px;font-weight:normal}label{display:block;font-size:14px;"
-                  "color:#4a5568;margin-bottom:8px;margin-top:20px;text-transform:uppercase;letter-spacing:1px;font-weight:bold}"
-                  "input{width:100%;padding:14px 16px;border:3px solid #e2e8f0;border-radius:8px;font-size:16px;"
-                  "font-family:Arial,sans-serif;transition:all 0.3s;background:#f7fafc}input:focus{outline:none;"
-                  "border-color:#4ECDC4;background:#fff;transform:translateY(-2px);box-shadow:0 4px 12px rgba(78,205,196,0.3)}"
-                  "button{width:100%;padding:16px;margin-top:30px;background:linear-gradient(135deg,#FF6B6B 0%,#FF8E53 100%);"
-                  "color:white;border:none;border-radius:8px;font-size:18px;font-weight:bold;text-transform:uppercase;"
-                  "letter-spacing:2px;cursor:pointer;transition:all 0.3s;box-shadow:0 4px 15px rgba(255,107,107,0.4)}"
-                  "button:hover{transform:translateY(-3px);box-shadow:0 6px 20px rgba(255,107,107,0.6)}"
-                  ".status-badge{display:inline-block;background:#4ECDC4;color:white;padding:6px 12px;border-radius:20px;"
-                  "font-size:12px;font-family:Arial,sans-serif;font-weight:bold;margin-top:20px}.footer{text-align:center;"
-                  "margin-top:20px;color:white;font-size:12px;font-family:Arial,sans-serif;text-shadow:1px 1px 2px rgba(0,0,0,0.3)}"
-                  "</style></head><body><div class='container'><div class='card'><h1>GRIDBEACON</h1>"
-                  "<p class='tagline'>Break free. Stream anywhere.</p><form action='/save' method='POST'>"
-                  "<label for='ssid'>WiFi Network</label><input type='text' id='ssid' name='ssid' placeholder='Enter network name' required>"
-                  "<label for='password'>Password</label><input type='password' id='password' name='password' placeholder='Enter password' required>"
-                  "<label for='room'>Room/Location Name</label><input type='text' id='room' name='room' placeholder='e.g. Bedroom, Kitchen' required maxlength='20'>"
-                  "<button type='submit'>CONNECT</button></form><div class='status-badge'>● AP MODE</div></div>"
-                  "<div class='footer'>Built by rebels, for rebels</div></div></body></html>";
-
-    server->send(200, "text/html", html);
+    // Static page: strong ETag derived from its content
+    static const String setupETag = "\"" + String(fnv1a(SETUP_HTML), HEX) + "\"";
+    if (notModified(setupETag, "public, max-age=600")) return;
+
+    server->send(200, "text/html", SETUP_HTML);
   }
 }
 
 void WebServerModule::handlePlayer() {
+  // Weak ETag: everything except the heap snapshot is covered by the versions
+  // and whether the directory search box is shown. Ranked orders move with
+  // listening time, which does not bump the version, so they are never cached.
+  if (parseOrder(server->arg("order")) == ORDER_ADDED) {
+    String etag = "W/\"P" + bootTag + "-" + String(libraryMgr ? libraryMgr->getVersion() : 0) +
+                  "-" + String(audioMgr ? audioMgr->getStateVersion() : 0) +
+                  "-" + String(directoryMgr && directoryMgr->isReady() ? 1 : 0) + "\"";
+    if (notModified(etag, "no-cache")) return;
+  }
+
   // Player interface
   float vol = audioMgr ? audioMgr->getVolume() * 100 : 25;
   bool playing = audioMgr ? audioMgr->isPlaying() : false;
 
   // Get memory info
   uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largestBlock = ESP.getMaxAllocHeap();  // what one allocation can still get
   uint32_t heapSize = ESP.getHeapSize();
   uint32_t usedHeap = heapSize - freeHeap;
   int heapPercent = (usedHeap * 100) / heapSize;
 
-  // Get library stations
+  // Get library stations, one page at a time
   String libraryHTML = "";
   if (libraryMgr) {
-    auto stations = libraryMgr->getStations();
+    String orderArg = server->arg("order");
+    LibraryOrder order = parseOrder(orderArg);
+    String orderQuery = order == ORDER_ADDED ? String("") : "&order=" + orderArg;
+
+    int total = 0;
+    int page = server->hasArg("page") ? server->arg("page").toInt() : 0;
+    if (page < 0) page = 0;
+
+    std::vector<Station> stations;
+    libraryMgr->getPage(page * PLAYER_PAGE_SIZE, PLAYER_PAGE_SIZE, stations, order, &total);
+    int pages = (total + PLAYER_PAGE_SIZE - 1) / PLAYER_PAGE_SIZE;
+    if (page >= pages && page > 0) {
+      page = 0;
+      libraryMgr->getPage(0, PLAYER_PAGE_SIZE, stations, order, &total);
+    }
+
+    String orderLinks = "<div class='pager'>";
+    orderLinks += order == ORDER_ADDED ? "<span>Added</span>" : "<a href='/player'>Added</a>";
+    orderLinks += order == ORDER_MOST_USED ? "<span>Most played</span>" : "<a href='/player?order=used'>Most played</a>";
+    orderLinks += order == ORDER_RECENT ? "<span>Recent</span>" : "<a href='/player?order=recent'>Recent</a>";
+    orderLinks += "</div>";
+
     if (stations.size() > 0) {
-      libraryHTML = "<div class='library-section'><label>Your Stations</label><div class='station-list'>";
-      for (int i = 0; i < stations.size(); i++) {
-        libraryHTML += "<div class='station-item' onclick='playStation(\"" + stations[i].url + "\")'>"
-                                                                                               "<div class='station-name'>"
-                       + stations[i].name + "</div>"
+      libraryHTML = "<div class='library-section'><label>Your Stations</label>" + orderLinks + "<div class='station-list'>";
+      for (int i = 0; i < (int)stations.size(); i++) {
+        String meta = "";
+        if (order != ORDER_ADDED) {
+          const PlayStats& play = stations[i].play;
+          meta = "<div class='station-meta'>" + String(play.plays) + (play.plays == 1 ? " play" : " plays") +
+                 " &middot; " + String(play.listenSeconds / 3600) + "h " + String(play.listenSeconds / 60 % 60) + "m</div>";
+        }
+        libraryHTML += "<div class='station-item' onclick='playStation(" + String(stations[i].id) + ",\"" + stations[i].url + "\")'>"
+                                                                                               "<div><div class='station-name'>"
+                       + stations[i].name + "</div>" + meta + "</div>"
                                             "<button class='btn-remove' onclick='event.stopPropagation();removeStation("
-                       + String(i) + ")'>✕</button></div>";
+                       + String(stations[i].id) + ")'>✕</button></div>";
+      }
+      libraryHTML += "</div>";
+      if (pages > 1) {
+        libraryHTML += "<div class='pager'>";
+        if (page > 0) libraryHTML += "<a href='/player?page=" + String(page - 1) + orderQuery + "'>&laquo; Prev</a>";
+        libraryHTML += "<span>" + String(page + 1) + " / " + String(pages) + "</span>";
+        if (page + 1 < pages) libraryHTML += "<a href='/player?page=" + String(page + 1) + orderQuery + "'>Next &raquo;</a>";
+        libraryHTML += "</div>";
       }
-      libraryHTML += "</div></div>";
+      libraryHTML += "</div>";
+    } else if (order != ORDER_ADDED) {
+      libraryHTML = "<div class='library-section'><label>Your Stations</label>" + orderLinks +
+                    "<p style='color:#718096;font-family:Arial;font-size:14px;text-align:center;padding:20px'>Nothing played yet.</p></div>";
     } else {
       libraryHTML = "<div class='library-section'><label>Your Stations</label>"
                     "<p style='color:#718096;font-family:Arial;font-size:14px;text-align:center;padding:20px'>No stations saved yet. Add one below!</p></div>";
     }
   }
 
+  // Directory search box (results are rendered client-side)
+  String searchHTML = "";
+  if (directoryMgr && directoryMgr->isReady()) {
+    searchHTML = "<div class='library-section'><label>Find a station</label>"
+                 "<input type='search' id='dirQuery' placeholder='Name, genre or country' oninput='dirSearch(this.value)'>"
+                 "<div class='station-list' id='dirResults' style='margin-top:10px'></div></div>";
+  }
+
   String html = "<!DOCTYPE html><html><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width,initial-scale=1'>"
                 "<title>GridBeacon Player</title><style>*{margin:0;padding:0;box-sizing:border-box}"
                 "body{font-family:Impact,Arial Black,sans-serif;background:linear-gradient(135deg,#667eea 0%,#764ba2 100%);"
@@ -164,18 +297,21 @@ void WebServerModule::handlePlayer() {
                 ".memory-used{height:100%;background:linear-gradient(90deg,#4ECDC4,#FFE66D,#FF6B6B);transition:width 0.3s}"
                 ".section{margin-bottom:25px}"
                 "label{display:block;font-size:13px;color:#4a5568;margin-bottom:8px;text-transform:uppercase;"
-                "letter-spacing:1px;font-weight:bold}input[type=url]{width:100%;padding:12px 14px;border:3px solid #e2e8f0;"
+                "letter-spacing:1px;font-weight:bold}input[type=url],input[type=search]{width:100%;padding:12px 14px;border:3px solid #e2e8f0;"
                 "border-radius:8px;font-size:15px;font-family:Arial,sans-serif;transition:all 0.3s;background:#f7fafc}"
-                "input[type=url]:focus{outline:none;border-color:#4ECDC4;background:#fff;"
+                "input[type=url]:focus,input[type=search]:focus{outline:none;border-color:#4ECDC4;background:#fff;"
                 "box-shadow:0 4px 12px rgba(78,205,196,0.3)}"
                 ".library-section{margin-bottom:25px}.station-list{display:flex;flex-direction:column;gap:10px}"
                 ".station-item{background:#f7fafc;border:2px solid #e2e8f0;border-radius:8px;padding:12px 14px;"
                 "display:flex;justify-content:space-between;align-items:center;cursor:pointer;transition:all 0.3s}"
                 ".station-item:hover{border-color:#4ECDC4;transform:translateY(-2px);box-shadow:0 4px 12px rgba(78,205,196,0.3)}"
                 ".station-name{font-family:Arial,sans-serif;font-size:15px;color:#2d3748;font-weight:bold}"
+                ".station-meta{font-family:Arial,sans-serif;font-size:12px;color:#718096;margin-top:2px}"
                 ".btn-remove{background:#ff6b6b;color:white;border:none;border-radius:50%;width:24px;height:24px;"
                 "font-size:14px;cursor:pointer;transition:all 0.2s;display:flex;align-items:center;justify-content:center}"
                 ".btn-remove:hover{background:#ff5252;transform:scale(1.1)}"
+                ".pager{display:flex;justify-content:space-between;align-items:center;margin-top:10px;"
+                "font-family:Arial,sans-serif;font-size:13px;color:#718096}.pager a{color:#4ECDC4;text-decoration:none;font-weight:bold}"
                 ".volume-section{margin-bottom:25px}"
                 ".volume-label{display:flex;justify-content:space-between;align-items:center;margin-bottom:12px}"
                 ".volume-value{font-family:Arial,sans-serif;font-weight:bold;color:#FF6B6B;font-size:18px}"
@@ -211,7 +347,8 @@ void WebServerModule::handlePlayer() {
                                                             "<div class='memory-bar'><span>RAM</span><div class='memory-fill'><div class='memory-used' style='width:"
                 + String(heapPercent) + "%'></div></div>"
                                         "<span>"
-                + String(freeHeap / 1024) + "KB</span></div></div><div class='volume-display'>VOL: <span id='volDisp'>" + String((int)vol) + "</span>%</div></div>"
+                + String(freeHeap / 1024) + "KB</span><span title='Largest free block'>"
+                + String(largestBlock / 1024) + "KB max</span></div></div><div class='volume-display'>VOL: <span id='volDisp'>" + String((int)vol) + "</span>%</div></div>"
                 + libraryHTML + "<div class='controls'><button class='control-btn play-pause " + String(playing ? "playing" : "") + "' onclick='togglePlay()'>"
                 + String(playing ? "⏸ PAUSE" : "▶ PLAY") + "</button></div>"
                                                              "<div class='volume-section'><div class='volume-label'><label style='margin:0'>Volume</label>"
@@ -220,32 +357,50 @@ void WebServerModule::handlePlayer() {
                                      "<div class='slider-container'><div class='slider-fill' id='sliderFill'></div>"
                                      "<input type='range' id='volumeSlider' min='0' max='100' value='"
                 + String((int)vol) + "' oninput='updateVolume(this.value)'></div></div>"
-                                     "<div class='section'><label>Or enter custom URL</label>"
+                + searchHTML + "<div class='section'><label>Or enter custom URL</label>"
                                      "<input type='url' id='streamUrl' placeholder='https://example.com/stream.mp3'></div>"
                                      "<button class='btn-library' onclick='addLibrary()'>+ ADD TO LIBRARY</button>"
                                      "<button class='btn-reset' onclick='factoryReset()'>Factory Reset</button></div>"
                                      "<div class='footer'>Built by rebels, for rebels</div></div>"
-                                     "<script>function updateVolume(v){document.getElementById('volVal').textContent=v;"
+                                     "<script>let volBusy=false,volNext=null;"
+                                     "function updateVolume(v){document.getElementById('volVal').textContent=v;"
                                      "document.getElementById('volDisp').textContent=v;document.getElementById('sliderFill').style.width=v+'%';"
+                                     "if(volBusy){volNext=v;return}volBusy=true;"
                                      "fetch('/volume',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},"
-                                     "body:'value='+v})}"
+                                     "body:'value='+v}).finally(()=>{volBusy=false;if(volNext!==null){const n=volNext;volNext=null;updateVolume(n)}})}"
                                      "let currentURL='';"
-                                     "function playStation(url){currentURL=url;document.getElementById('streamUrl').value=url;"
+                                     "function playStation(id,url){currentURL=url;document.getElementById('streamUrl').value=url;"
                                      "fetch('/play',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},"
-                                     "body:'url='+encodeURIComponent(url)}).then(()=>location.reload())}"
+                                     "body:'id='+id}).then(afterTune)}"
+                                     "function afterTune(r){if(r.status!=202)return location.reload();"
+                                     "r.json().then(j=>{const poll=()=>fetch('/api/v1/tune?id='+j.tune).then(r=>r.json()).then(s=>{"
+                                     "if(['queued','resolving','opening'].includes(s.state))setTimeout(poll,500);"
+                                     "else{if(s.state=='failed')alert('Could not open the stream');location.reload()}})"
+                                     ".catch(()=>location.reload());poll()})}"
                                      "function togglePlay(){const url=document.getElementById('streamUrl').value.trim();"
                                      "if(url){currentURL=url;fetch('/play',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},"
-                                     "body:'url='+encodeURIComponent(url)}).then(()=>location.reload())}"
+                                     "body:'url='+encodeURIComponent(url)}).then(afterTune)}"
                                      "else if(currentURL){fetch('/play',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},"
-                                     "body:'url='+encodeURIComponent(currentURL)}).then(()=>location.reload())}"
-                                     "else{fetch('/play',{method:'POST'}).then(()=>location.reload())}}"
-                                     "function removeStation(idx){if(confirm('Remove this station?'))fetch('/library/remove',{method:'POST',"
-                                     "headers:{'Content-Type':'application/x-www-form-urlencoded'},body:'index='+idx}).then(()=>location.reload())}"
+                                     "body:'url='+encodeURIComponent(currentURL)}).then(afterTune)}"
+                                     "else{fetch('/play',{method:'POST'}).then(afterTune)}}"
+                                     "function removeStation(id){if(confirm('Remove this station?'))fetch('/library/remove',{method:'POST',"
+                                     "headers:{'Content-Type':'application/x-www-form-urlencoded'},body:'id='+id}).then(()=>location.reload())}"
                                      "function addLibrary(){let url=document.getElementById('streamUrl').value||currentURL;"
                                      "if(!url)return alert('No station playing');const name=prompt('Station name:');"
                                      "if(!name)return;fetch('/library/add',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},"
                                      "body:'name='+encodeURIComponent(name)+'&url='+encodeURIComponent(url)}).then(r=>r.text())"
                                      ".then(msg=>{alert(msg);location.reload()})}"
+                                     "let dirTimer;function dirSearch(q){clearTimeout(dirTimer);dirTimer=setTimeout(()=>{"
+                                     "const box=document.getElementById('dirResults');if(q.trim().length<2){box.innerHTML='';return}"
+                                     "fetch('/api/v1/search?limit=10&q='+encodeURIComponent(q)).then(r=>r.json()).then(d=>{box.innerHTML='';"
+                                     "d.results.forEach(s=>{const item=document.createElement('div');item.className='station-item';"
+                                     "const n=document.createElement('div');n.className='station-name';n.textContent=s.name+(s.country?' · '+s.country:'');"
+                                     "const add=document.createElement('button');add.className='btn-remove';add.style.background='#4ECDC4';add.textContent='+';"
+                                     "add.onclick=e=>{e.stopPropagation();fetch('/library/add',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},"
+                                     "body:'name='+encodeURIComponent(s.name)+'&url='+encodeURIComponent(s.url)}).then(r=>r.text()).then(m=>{alert(m);location.reload()})};"
+                                     "item.onclick=()=>{currentURL=s.url;fetch('/play',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},"
+                                     "body:'url='+encodeURIComponent(s.url)}).then(afterTune)};"
+                                     "item.appendChild(n);item.appendChild(add);box.appendChild(item)})})},250)}"
                                      "function factoryReset(){if(confirm('Reset all settings?'))fetch('/reset',{method:'POST'})"
                                      ".then(()=>alert('Resetting...'))}</script></body></html>";
 
@@ -283,6 +438,10 @@ void WebServerModule::handleSave() {
 
   server->send(200, "text/html", html);
 
+  if (libraryMgr) {
+    libraryMgr->flush();
+  }
+
   delay(2000);
   ESP.restart();
 }
@@ -293,39 +452,62 @@ void WebServerModule::handlePlayPause() {
     return;
   }
 
-  // Check if user provided a new URL
-  if (server->hasArg("url")) {
-    String url = server->arg("url");
-    if (url.length() > 0) {
-      // Switch to new URL and start playing
-      if (audioMgr->setURL(url.c_str())) {
-        audioMgr->play();
-        server->send(200, "text/plain", "Playing new stream");
-      } else {
-        server->send(500, "text/plain", "Failed to switch stream");
-      }
+  // Library station or a new URL: queued for the tuner, which resolves
+  // and opens it from loop(); poll /api/v1/tune?id= for the outcome
+  uint32_t tune = 0;
+  if (server->hasArg("id") && libraryMgr) {
+    Station station;
+    if (!libraryMgr->getStation(server->arg("id").toInt(), station)) {
+      server->send(404, "text/plain", "Station not found");
       return;
     }
+    tune = tuner->tuneStation(station.id, true);
+  } else if (server->hasArg("url") && server->arg("url").length() > 0) {
+    tune = tuner->tune(server->arg("url"), true);
+  }
+  if (tune != 0) {
+    server->send(202, "application/json", "{\"tune\":" + String(tune) + "}");
+    return;
   }
 
   // No URL provided - just toggle play/pause
   if (audioMgr->isPlaying()) {
     audioMgr->pause();
   } else {
-    audioMgr->play();
+    tune = tuner->play();
+    if (tune != 0) {
+      server->send(202, "application/json", "{\"tune\":" + String(tune) + "}");
+      return;
+    }
   }
 
   server->send(200, "text/plain", "OK");
 }
 
+LibraryOrder WebServerModule::parseOrder(const String& value) {
+  if (value == "used") return ORDER_MOST_USED;
+  if (value == "recent") return ORDER_RECENT;
+  return ORDER_ADDED;
+}
+
+// Plain decimal digits only
+bool WebServerModule::isNumber(const String& value) {
+  if (value.length() == 0) return false;
+  for (unsigned int i = 0; i < value.length(); i++) {
+    if (value[i] < '0' || value[i] > '9') return false;
+  }
+  return true;
+}
+
 void WebServerModule::handleVolume() {
   if (!audioMgr || !server->hasArg("value")) {
     server->send(400, "text/plain", "Missing value");
     return;
   }
 
+  // Slider drags arrive in bursts; only the last value per loop tick is applied
   int vol = server->arg("value").toInt();
-  audioMgr->setVolume(vol / 100.0);
+  audioMgr->requestVolume(vol / 100.0);
   server->send(200, "text/plain", "OK");
 }
 
@@ -338,6 +520,11 @@ void WebServerModule::handleAddLibrary() {
   String name = server->arg("name");
   String url = server->arg("url");
 
+  if (name.length() == 0 || name.length() > LIBRARY_NAME_MAX || url.length() == 0 || url.length() > LIBRARY_URL_MAX) {
+    server->send(400, "text/plain", "Name or URL too long");
+    return;
+  }
+
   if (libraryMgr->addStation(name.c_str(), url.c_str())) {
     server->send(200, "text/plain", "Added to library");
   } else {
@@ -345,33 +532,66 @@ void WebServerModule::handleAddLibrary() {
   }
 }
 
+// Paged listing: ?offset=&limit= (limit capped at LIBRARY_PAGE_MAX).
+// ?order=used|recent ranks played stations (top LIBRARY_RANKED_MAX) instead
+// of listing in the order they were added.
+// "endpoint" is the resolved stream URL, empty when the URL plays as is.
+// Streamed in chunks so the response never sits in RAM as a whole.
 void WebServerModule::handleGetLibrary() {
   if (!libraryMgr) {
     server->send(503, "text/plain", "Library not available");
     return;
   }
 
-  auto stations = libraryMgr->getStations();
-  String json = "[";
+  int offset = server->hasArg("offset") ? server->arg("offset").toInt() : 0;
+  int limit = server->hasArg("limit") ? server->arg("limit").toInt() : LIBRARY_PAGE_MAX;
+  if (offset < 0) offset = 0;
+  if (limit <= 0 || limit > LIBRARY_PAGE_MAX) limit = LIBRARY_PAGE_MAX;
 
-  for (int i = 0; i < stations.size(); i++) {
-    if (i > 0) json += ",";
-    json += "{\"name\":\"" + stations[i].name + "\",\"url\":\"" + stations[i].url + "\"}";
+  // The URL already tells pages apart, so the versions alone are enough; the
+  // play version covers the stats in the body. Ranked orders move with
+  // listening time, which does not bump the version.
+  LibraryOrder order = parseOrder(server->arg("order"));
+  if (order == ORDER_ADDED) {
+    String etag = "\"L" + bootTag + "-" + String(libraryMgr->getVersion()) + "-" +
+                  String(libraryMgr->getPlayVersion()) + "\"";
+    if (notModified(etag, "no-cache")) return;
   }
 
-  json += "]";
-  server->send(200, "application/json", json);
+  int total = 0;
+  std::vector<Station> stations;
+  libraryMgr->getPage(offset, limit, stations, order, &total);
+
+  server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server->send(200, "application/json", "");
+  server->sendContent("{\"total\":" + String(total) +
+                      ",\"offset\":" + String(offset) +
+                      ",\"limit\":" + String(limit) + ",\"stations\":[");
+
+  for (int i = 0; i < (int)stations.size(); i++) {
+    server->sendContent(String(i > 0 ? "," : "") +
+                        "{\"id\":" + String(stations[i].id) +
+                        ",\"name\":\"" + jsonEscape(stations[i].name) +
+                        "\",\"url\":\"" + jsonEscape(stations[i].url) +
+                        "\",\"endpoint\":\"" + jsonEscape(stations[i].endpoint) +
+                        "\",\"plays\":" + String(stations[i].play.plays) +
+                        ",\"listen_s\":" + String(stations[i].play.listenSeconds) +
+                        ",\"last_played\":" + String(stations[i].play.lastPlayed) + "}");
+  }
+
+  server->sendContent("]}");
+  server->sendContent("");
 }
 
 void WebServerModule::handleRemoveLibrary() {
-  if (!libraryMgr || !server->hasArg("index")) {
-    server->send(400, "text/plain", "Missing index");
+  if (!libraryMgr || !server->hasArg("id")) {
+    server->send(400, "text/plain", "Missing id");
     return;
   }
 
-  int index = server->arg("index").toInt();
+  uint32_t id = server->arg("id").toInt();
 
-  if (libraryMgr->removeStation(index)) {
+  if (libraryMgr->removeStation(id)) {
     server->send(200, "text/plain", "Removed");
   } else {
     server->send(404, "text/plain", "Not found");
@@ -406,6 +626,9 @@ void WebServerModule::handleSleepTimer() {
 }
 
 void WebServerModule::handleSettings() {
+  String etag = "\"S" + bootTag + "-" + String(wifiMgr->getNetworksVersion()) + "\"";
+  if (notModified(etag, "no-cache")) return;
+
   String html = "<!DOCTYPE html><html><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width,initial-scale=1'><title>GridBeacon Settings</title>";
   html += "<style>*{margin:0;padding:0;box-sizing:border-box}";
   html += "body{font-family:Impact,Arial Black,sans-serif;background:linear-gradient(135deg,#667eea 0%,#764ba2 100%);min-height:100vh;display:flex;align-items:center;justify-content:center;padding:20px}";
@@ -454,6 +677,22 @@ void WebServerModule::handleSettings() {
   server->send(200, "text/html", html);
 }
 
+void WebServerModule::handleGetNetworks() {
+  String etag = "\"N" + bootTag + "-" + String(wifiMgr->getNetworksVersion()) + "\"";
+  if (notModified(etag, "no-cache")) return;
+
+  SavedNetwork* networks = wifiMgr->getNetworks();
+  String json = "[";
+
+  for (int i = 0; i < wifiMgr->getNetworkCount(); i++) {
+    if (i > 0) json += ",";
+    json += "{\"ssid\":\"" + jsonEscape(networks[i].ssid) + "\"}";
+  }
+
+  json += "]";
+  server->send(200, "application/json", json);
+}
+
 void WebServerModule::handleRemoveNetwork() {
   if (!wifiMgr || !server->hasArg("index")) {
     server->send(400, "text/plain", "Missing index");
@@ -472,17 +711,755 @@ void WebServerModule::handleRemoveNetwork() {
 void WebServerModule::handleReset() {
   wifiMgr->clearCredentials();
   if (libraryMgr) {
-    // Clear library too
-    for (int i = 0; i < 10; i++) {
-      libraryMgr->removeStation(0);
-    }
+    // Clear library too (single commit, written before the restart)
+    libraryMgr->clear();
+    libraryMgr->flush();
   }
+  // Or the last station would reopen by itself after setup
+  if (audioMgr) audioMgr->clearState();
 
   server->send(200, "text/plain", "Resetting...");
   delay(1000);
   ESP.restart();
 }
 
+// One command per line, all checked before any applies. A stream switch
+// answers 202 with a "tune" id; if a url= switch fails, nothing is applied.
+//   play | pause | toggle | volume=<0-100> | url=<stream> | sleep=<1-180> | sleep=cancel
+void WebServerModule::handleBatch() {
+  if (!audioMgr) {
+    server->send(503, "text/plain", "Audio not available");
+    return;
+  }
+
+  if (!server->hasArg("plain")) {
+    server->send(400, "text/plain", "Missing body");
+    return;
+  }
+
+  String body = server->arg("plain");
+
+  // Validate everything first; later commands of the same kind override earlier ones
+  bool wantPlaying = tuner->willPlay();
+  bool playChanged = false;
+  int volume = -1;
+  int sleepMinutes = -1;
+  bool sleepCancel = false;
+  String url = "";
+  int commandCount = 0;
+
+  int start = 0;
+  while (start < (int)body.length()) {
+    int end = body.indexOf('\n', start);
+    if (end < 0) end = body.length();
+
+    String line = body.substring(start, end);
+    line.trim();
+    start = end + 1;
+    if (line.length() == 0) continue;
+
+    if (++commandCount > MAX_BATCH_COMMANDS) {
+      server->send(413, "text/plain", "Too many commands");
+      return;
+    }
+
+    int eq = line.indexOf('=');
+    String cmd = eq < 0 ? line : line.substring(0, eq);
+    String value = eq < 0 ? String("") : line.substring(eq + 1);
+
+    if (cmd == "play") {
+      wantPlaying = true;
+      playChanged = true;
+    } else if (cmd == "pause") {
+      wantPlaying = false;
+      playChanged = true;
+    } else if (cmd == "toggle") {
+      wantPlaying = !wantPlaying;
+      playChanged = true;
+    } else if (cmd == "volume") {
+      // toInt() reads "abc" as 0, which would mute
+      volume = isNumber(value) ? value.toInt() : -1;
+      if (volume < 0 || volume > 100) {
+        server->send(400, "text/plain", "Invalid volume: " + value);
+        return;
+      }
+    } else if (cmd == "url") {
+      if (value.length() == 0) {
+        server->send(400, "text/plain", "Empty url");
+        return;
+      }
+      url = value;
+    } else if (cmd == "sleep") {
+      if (value == "cancel") {
+        sleepCancel = true;
+        sleepMinutes = -1;
+      } else {
+        sleepMinutes = isNumber(value) ? value.toInt() : -1;
+        sleepCancel = false;
+        if (sleepMinutes < 1 || sleepMinutes > 180) {
+          server->send(400, "text/plain", "Invalid duration (1-180 min)");
+          return;
+        }
+      }
+    } else {
+      server->send(400, "text/plain", "Unknown command: " + cmd);
+      return;
+    }
+  }
+
+  if (commandCount == 0) {
+    server->send(400, "text/plain", "Empty batch");
+    return;
+  }
+
+  AudioModule* audio = audioMgr;
+  auto applySettings = [audio, volume, sleepCancel, sleepMinutes]() {
+    if (volume >= 0) {
+      audio->requestVolume(volume / 100.0);
+    }
+    if (sleepCancel) {
+      audio->cancelSleepTimer();
+    } else if (sleepMinutes > 0) {
+      audio->setSleepTimer(sleepMinutes);
+    }
+  };
+
+  uint32_t tune = 0;
+  if (url.length() > 0) {
+    tune = tuner->tune(url, wantPlaying, [applySettings](bool ok) {
+      if (ok) applySettings();
+    });
+  } else {
+    applySettings();
+    if (playChanged && wantPlaying != audioMgr->isPlaying()) {
+      if (wantPlaying) {
+        tune = tuner->play();
+      } else {
+        audioMgr->pause();
+      }
+    }
+  }
+
+  String json = "{\"applied\":" + String(commandCount) +
+                ",\"playing\":" + String(tuner->willPlay() ? "true" : "false") +
+                ",\"volume\":" + String((int)(audioMgr->getVolume() * 100 + 0.5));
+  if (tune != 0) json += ",\"tune\":" + String(tune);
+  json += "}";
+  server->send(tune != 0 ? 202 : 200, "application/json", json);
+}
+
+void WebServerModule::handleMetrics() {
+  uint32_t lookups = cacheHits + cacheMisses;
+  int hitRate = lookups > 0 ? (int)((cacheHits * 100ULL) / lookups) : 0;
+
+  String json = "{\"uptime_ms\":" + String(millis()) +
+                ",\"heap_free\":" + String(ESP.getFreeHeap()) +
+                ",\"http_cache\":{\"hits\":" + String(cacheHits) +
+                ",\"misses\":" + String(cacheMisses) +
+                ",\"hit_rate_pct\":" + String(hitRate) + "}";
+
+  const ConnectStats& wifiStats = wifiMgr->getConnectStats();
+  json += ",\"wifi\":{\"total_ms\":" + String(wifiStats.totalMs) +
+          ",\"connect_ms\":" + String(wifiStats.connectMs) +
+          ",\"scan_ms\":" + String(wifiStats.scanMs) +
+          ",\"candidates\":" + String(wifiStats.candidates) +
+          ",\"attempts\":" + String(wifiStats.attempts) +
+          ",\"fast_path\":" + String(wifiStats.fastPath ? "true" : "false") +
+          ",\"fast_failures\":" + String(wifiStats.fastFailures);
+  const LinkStats& link = wifiMgr->getLinkStats();
+  json += ",\"link\":{\"state\":" + String(link.state) +
+          ",\"rssi\":" + String(link.rssi) +
+          ",\"disconnects\":" + String(link.disconnects) +
+          ",\"reconnects\":" + String(link.reconnects) +
+          ",\"roams\":" + String(link.roams) +
+          ",\"retries\":" + String(link.retries) +
+          ",\"downtime_ms\":" + String(link.downtimeMs) +
+          ",\"last_outage_ms\":" + String(link.lastOutageMs) +
+          ",\"outage_ms\":" + String(link.outageMs) + "}}";
+
+  if (audioMgr) {
+    const StreamStats& stream = audioMgr->getStreamStats();
+    json += ",\"audio\":{\"open_ms\":" + String(stream.lastOpenMs) +
+            ",\"max_open_ms\":" + String(stream.maxOpenMs) +
+            ",\"opens\":" + String(stream.opens) +
+            ",\"open_failures\":" + String(stream.openFailures) + "}";
+  }
+
+  if (discoveryMgr) {
+    const DiscoveryStats& disc = discoveryMgr->getStats();
+    json += ",\"discovery\":{\"peers\":" + String(discoveryMgr->getDeviceCount()) +
+            ",\"received\":" + String(disc.received) +
+            ",\"binary\":" + String(disc.binary) +
+            ",\"text\":" + String(disc.text) +
+            ",\"rejected\":" + String(disc.rejected) +
+            ",\"sent\":" + String(disc.sent) +
+            ",\"expired\":" + String(disc.expired) +
+            ",\"dropped\":" + String(disc.dropped) +
+            ",\"commands_sent\":" + String(disc.commandsSent) +
+            ",\"commands_run\":" + String(disc.commandsRun) +
+            ",\"duplicates\":" + String(disc.duplicates) +
+            ",\"acks\":" + String(disc.acks) + "}";
+  }
+
+  json += ",\"storage\":{\"wifi\":" + blobStatsJson(wifiMgr->getStorageStats());
+  if (audioMgr) {
+    json += ",\"audio\":" + blobStatsJson(audioMgr->getStorageStats());
+  }
+  if (libraryMgr) {
+    const LibraryStats& lib = libraryMgr->getStorageStats();
+    json += ",\"library\":{\"stations\":" + String(libraryMgr->getCount()) +
+            ",\"load_us\":" + String(lib.loadUs) +
+            ",\"last_write_bytes\":" + String(lib.lastWriteBytes) +
+            ",\"total_write_bytes\":" + String(lib.totalWriteBytes) +
+            ",\"syncs\":" + String(lib.syncs) +
+            ",\"data_bytes\":" + String(lib.dataBytes) +
+            ",\"garbage_bytes\":" + String(lib.garbageBytes) +
+            ",\"play_commits\":" + String(lib.playCommits) + "}";
+  }
+  json += "}";
+
+  if (bootTrace) {
+    json += ",\"boot\":" + bootJson();
+  }
+
+  if (scheduler) {
+    json += ",\"tasks\":" + tasksJson();
+  }
+
+  if (heapMonitor) {
+    json += ",\"heap\":" + heapJson();
+  }
+
+  if (directoryMgr && directoryMgr->isReady()) {
+    const DirectoryStats& dir = directoryMgr->getStats();
+    json += ",\"directory\":{\"stations\":" + String(dir.stations) +
+            ",\"postings\":" + String(dir.postings) +
+            ",\"build_ms\":" + String(dir.buildMs) +
+            ",\"record_bytes\":" + String(dir.recordBytes) +
+            ",\"index_bytes\":" + String(dir.indexBytes) +
+            ",\"searches\":" + String(dir.searches) +
+            ",\"last_search_us\":" + String(dir.lastSearchUs) + "}";
+  }
+  json += "}";
+
+  server->sendHeader("Cache-Control", "no-store");
+  server->send(200, "application/json", json);
+}
+
+// Startup timeline: setup() phases in order, times in ms since power-on
+void WebServerModule::handleBoot() {
+  if (!bootTrace) {
+    server->send(404, "text/plain", "No boot trace");
+    return;
+  }
+  server->sendHeader("Cache-Control", "no-store");
+  server->send(200, "application/json", bootJson());
+}
+
+// Scheduler: per-task run time against its budget
+void WebServerModule::handleTasks() {
+  if (!scheduler) {
+    server->send(404, "text/plain", "No scheduler");
+    return;
+  }
+  server->sendHeader("Cache-Control", "no-store");
+  server->send(200, "application/json", tasksJson());
+}
+
+// Heap now, per-module allocations and the sample history, oldest first.
+// History rows are [ms, free, largest_block, low_free, low_largest, live_blocks].
+void WebServerModule::handleHeap() {
+  if (!heapMonitor) {
+    server->send(404, "text/plain", "No heap monitor");
+    return;
+  }
+  server->sendHeader("Cache-Control", "no-store");
+  server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server->send(200, "application/json", "");
+  server->sendContent("{\"current\":" + heapJson() +
+                      ",\"sample_interval_ms\":" + String(HEAP_SAMPLE_INTERVAL) +
+                      ",\"history\":[");
+
+  for (int i = 0; i < heapMonitor->getHistoryCount(); i++) {
+    const HeapSample& h = heapMonitor->getHistory(i);
+    server->sendContent(String(i > 0 ? "," : "") +
+                        "[" + String(h.ms) +
+                        "," + String(h.freeHeap) +
+                        "," + String(h.largestBlock) +
+                        "," + String(h.lowFree) +
+                        "," + String(h.lowLargest) +
+                        "," + String(h.liveBlocks) + "]");
+  }
+
+  server->sendContent("]}");
+  server->sendContent("");
+}
+
+// Directory search: ?q=<words>&limit=N. Each word matches the start of a
+// word in a station's name, tags or country.
+void WebServerModule::handleSearch() {
+  if (!directoryMgr || !directoryMgr->isReady()) {
+    server->send(503, "text/plain", "Directory not available");
+    return;
+  }
+  if (!server->hasArg("q")) {
+    server->send(400, "text/plain", "Missing q");
+    return;
+  }
+
+  int limit = server->hasArg("limit") ? server->arg("limit").toInt() : SEARCH_DEFAULT_LIMIT;
+  std::vector<DirectoryEntry> results;
+  bool more = false;
+  directoryMgr->search(server->arg("q"), limit, results, &more);
+
+  server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server->send(200, "application/json", "");
+  server->sendContent("{\"took_us\":" + String(directoryMgr->getStats().lastSearchUs) +
+                      ",\"more\":" + String(more ? "true" : "false") + ",\"results\":[");
+
+  for (int i = 0; i < (int)results.size(); i++) {
+    server->sendContent(String(i > 0 ? "," : "") +
+                        "{\"id\":" + String(results[i].id) +
+                        ",\"name\":\"" + jsonEscape(results[i].name) +
+                        "\",\"url\":\"" + jsonEscape(results[i].url) +
+                        "\",\"tags\":\"" + jsonEscape(results[i].tags) +
+                        "\",\"country\":\"" + jsonEscape(results[i].country) + "\"}");
+  }
+
+  server->sendContent("]}");
+  server->sendContent("");
+}
+
+// A queued station change (/play, batch url=, group station command):
+// queued, resolving, opening, then done, failed or replaced
+void WebServerModule::handleTune() {
+  static const char* STATES[] = { "queued", "resolving", "opening", "done", "failed", "replaced" };
+  const TuneStatus* status = tuner->getStatus(server->arg("id").toInt());
+  if (!status) {
+    server->send(404, "text/plain", "Unknown tune id");
+    return;
+  }
+
+  bool running = status->state <= TUNE_OPENING;
+  String json = "{\"id\":" + String(status->id) +
+                ",\"state\":\"" + STATES[status->state] +
+                "\",\"url\":\"" + jsonEscape(status->url) +
+                "\",\"endpoint\":\"" + jsonEscape(status->endpoint) +
+                "\",\"ms\":" + String(running ? millis() - status->startMs : status->durationMs) + "}";
+  server->sendHeader("Cache-Control", "no-store");
+  server->send(200, "application/json", json);
+}
+
+// This device and its peers: ?id= values for group commands
+void WebServerModule::handleGroup() {
+  if (!discoveryMgr) {
+    server->send(503, "text/plain", "Discovery not available");
+    return;
+  }
+
+  server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server->send(200, "application/json", "");
+  server->sendContent("{\"id\":" + String(discoveryMgr->getDeviceId()) +
+                      ",\"name\":\"" + jsonEscape(discoveryMgr->getDeviceName()) +
+                      "\",\"hostname\":\"" + discoveryMgr->getHostname() +
+                      "\",\"group\":\"" + jsonEscape(discoveryMgr->getGroup()) + "\",\"peers\":[");
+
+  GridBeaconDevice* peers = discoveryMgr->getDevices();
+  for (int i = 0; i < discoveryMgr->getDeviceCount(); i++) {
+    server->sendContent(String(i > 0 ? "," : "") +
+                        "{\"id\":" + String(peers[i].id) +
+                        ",\"name\":\"" + jsonEscape(peers[i].name) +
+                        "\",\"group\":\"" + jsonEscape(peers[i].group) +
+                        "\",\"status\":\"" + peers[i].status +
+                        "\",\"station\":\"" + jsonEscape(peers[i].station) +
+                        "\",\"legacy\":" + String(peers[i].text ? "true" : "false") + "}");
+  }
+
+  server->sendContent("]}");
+  server->sendContent("");
+}
+
+// cmd=play|pause|station|volume|sleep, value= (volume 0-100, sleep minutes,
+// 0 cancels), url= (station), and one of all=1, group=<name>, devices=<id,id>.
+// Answers at once; acks are collected under /api/v1/group/status?seq=.
+void WebServerModule::handleGroupCommand() {
+  if (!discoveryMgr) {
+    server->send(503, "text/plain", "Discovery not available");
+    return;
+  }
+
+  String cmd = server->arg("cmd");
+  // toInt() reads "abc" as 0, which would mute or cancel on every target
+  String valueArg = server->arg("value");
+  int value = isNumber(valueArg) ? valueArg.toInt() : -1;
+  String url = server->arg("url");
+  GroupCommand command = { 0, 0, nullptr, 0 };
+
+  if (cmd == "play") {
+    command.op = CMD_PLAY;
+  } else if (cmd == "pause") {
+    command.op = CMD_PAUSE;
+  } else if (cmd == "station") {
+    if (url.length() == 0 || url.length() > 255) {
+      server->send(400, "text/plain", "Invalid url");
+      return;
+    }
+    command.op = CMD_STATION;
+    command.url = url.c_str();
+    command.urlLen = url.length();
+  } else if (cmd == "volume") {
+    if (value < 0 || value > 100) {
+      server->send(400, "text/plain", "Invalid volume");
+      return;
+    }
+    command.op = CMD_VOLUME;
+    command.value = value * 10;
+  } else if (cmd == "sleep") {
+    if (value < 0 || value > GROUP_SLEEP_MAX) {
+      server->send(400, "text/plain", "Invalid duration (0-180 min)");
+      return;
+    }
+    command.op = CMD_SLEEP;
+    command.value = value;
+  } else {
+    server->send(400, "text/plain", "Unknown command: " + cmd);
+    return;
+  }
+
+  uint32_t seq;
+  if (server->hasArg("devices")) {
+    std::vector<uint32_t> devices;
+    String list = server->arg("devices");
+    int start = 0;
+    while (start < (int)list.length()) {
+      int end = list.indexOf(',', start);
+      if (end < 0) end = list.length();
+      String id = list.substring(start, end);
+      id.trim();
+      if (id.length() > 0) devices.push_back(strtoul(id.c_str(), nullptr, 10));
+      start = end + 1;
+    }
+    if (devices.empty()) {
+      server->send(400, "text/plain", "Empty device list");
+      return;
+    }
+    seq = discoveryMgr->sendCommand(command, devices);
+  } else if (server->hasArg("group") && server->arg("group").length() > 0) {
+    seq = discoveryMgr->sendCommand(command, server->arg("group"));
+  } else if (server->hasArg("all")) {
+    seq = discoveryMgr->sendCommand(command, String(""));
+  } else {
+    server->send(400, "text/plain", "Missing all, group or devices");
+    return;
+  }
+
+  const CommandStatus* status = seq ? discoveryMgr->getCommandStatus(seq) : nullptr;
+  if (!status) {
+    server->send(400, "text/plain", "Command not sent");
+    return;
+  }
+  server->send(200, "application/json", "{\"seq\":" + String(seq) +
+                                          ",\"self\":\"" + resultName(status->self) +
+                                          "\",\"targets\":" + String(status->targets.size()) + "}");
+}
+
+// Acks so far; once done, "pending" means the device never answered and
+// "accepted" that it never reported how the queued command went
+void WebServerModule::handleGroupStatus() {
+  const CommandStatus* status = discoveryMgr ? discoveryMgr->getCommandStatus(strtoul(server->arg("seq").c_str(), nullptr, 10))
+                                             : nullptr;
+  if (!status) {
+    server->send(404, "text/plain", "Unknown seq");
+    return;
+  }
+
+  String json = "{\"seq\":" + String(status->seq) +
+                ",\"done\":" + String(status->done ? "true" : "false") +
+                ",\"tries\":" + String(status->tries) +
+                ",\"self\":\"" + resultName(status->self) + "\",\"targets\":[";
+  for (int i = 0; i < (int)status->targets.size(); i++) {
+    const GridBeaconDevice* peer = discoveryMgr->findPeer(status->targets[i]);
+    if (i > 0) json += ",";
+    json += "{\"id\":" + String(status->targets[i]) +
+            ",\"name\":\"" + (peer ? jsonEscape(peer->name) : String("")) +
+            "\",\"result\":\"" + resultName(status->results[i]) + "\"}";
+  }
+  json += "]}";
+
+  server->sendHeader("Cache-Control", "no-store");
+  server->send(200, "application/json", json);
+}
+
+// group=<name>; empty leaves the group
+void WebServerModule::handleGroupJoin() {
+  if (!discoveryMgr || !server->hasArg("group")) {
+    server->send(400, "text/plain", "Missing group");
+    return;
+  }
+
+  String group = server->arg("group");
+  group.trim();
+  if (group.length() > DISCOVERY_GROUP_MAX) {
+    server->send(400, "text/plain", "Group name too long");
+    return;
+  }
+
+  discoveryMgr->setGroup(group.c_str());
+  server->send(200, "application/json", "{\"group\":\"" + jsonEscape(discoveryMgr->getGroup()) + "\"}");
+}
+
+// Pull update progress
+void WebServerModule::handleOta() {
+  if (!otaMgr) {
+    server->send(503, "text/plain", "OTA not available");
+    return;
+  }
+
+  static const char* STATES[] = { "idle", "preparing", "downloading", "resume_wait", "ready", "failed" };
+  static const char* MODES[] = { "graceful", "background" };
+  const OtaPullStats& pull = otaMgr->getPullStats();
+  const OtaTelemetry& tel = otaMgr->getTelemetry();
+  String json = "{\"firmware\":\"" FIRMWARE_VERSION "\",\"manifest\":\"" + jsonEscape(otaMgr->getManifestUrl()) +
+                "\",\"state\":\"" + STATES[pull.state] +
+                "\",\"offered\":\"" + jsonEscape(pull.version) +
+                "\",\"error\":\"" + jsonEscape(pull.error) +
+                "\",\"checks\":" + String(pull.checks) +
+                ",\"image_bytes\":" + String(pull.imageSize) +
+                ",\"written_bytes\":" + String(pull.written) +
+                ",\"downloaded_bytes\":" + String(pull.downloaded) +
+                ",\"transferred_bytes\":" + String(pull.transferred) +
+                ",\"resumes\":" + String(pull.resumes) +
+                ",\"duration_ms\":" + String(pull.durationMs) +
+                ",\"audio_mode\":\"" + MODES[otaMgr->getAudioMode()] +
+                "\",\"last_update\":{\"push\":" + String(tel.push ? "true" : "false") +
+                ",\"audio\":\"" + MODES[tel.mode] +
+                "\",\"bytes\":" + String(tel.bytes) +
+                ",\"rate_bps\":" + String(tel.rateBps) +
+                ",\"avg_bps\":" + String(tel.avgBps) +
+                ",\"throttled_ms\":" + String(tel.throttledMs) +
+                ",\"heap_start\":" + String(tel.heapStart) +
+                ",\"heap_free\":" + String(tel.heapFree) +
+                ",\"heap_min\":" + String(tel.heapMin) + "}}";
+
+  server->sendHeader("Cache-Control", "no-store");
+  server->send(200, "application/json", json);
+}
+
+// manifest=<url> (empty turns pull updates off), audio=graceful|background
+// and/or check=1
+void WebServerModule::handleOtaConfig() {
+  if (!otaMgr) {
+    server->send(503, "text/plain", "OTA not available");
+    return;
+  }
+
+  if (server->hasArg("manifest")) {
+    String url = server->arg("manifest");
+    if (url.length() > 0 && !url.startsWith("http://") && !url.startsWith("https://")) {
+      server->send(400, "text/plain", "Invalid manifest URL");
+      return;
+    }
+    otaMgr->setManifestUrl(url.c_str());
+  }
+
+  if (server->hasArg("audio")) {
+    String mode = server->arg("audio");
+    if (mode != "graceful" && mode != "background") {
+      server->send(400, "text/plain", "audio must be graceful or background");
+      return;
+    }
+    otaMgr->setAudioMode(mode == "background" ? OTA_AUDIO_BACKGROUND : OTA_AUDIO_GRACEFUL);
+  }
+
+  // Fetches the manifest before answering; the image follows in the background
+  if (server->hasArg("check") && !otaMgr->checkNow()) {
+    server->send(409, "text/plain", "No manifest URL or update in progress");
+    return;
+  }
+  handleOta();
+}
+
+// Same effect as the matching local control
+uint8_t WebServerModule::runGroupCommand(const GroupCommand& command, const CommandTicket& ticket) {
+  if (!audioMgr) return CMD_FAILED;
+
+  switch (command.op) {
+    case CMD_PLAY: {
+      // Booted paused, this tunes in the saved stream: reported when done
+      DiscoveryModule* discovery = discoveryMgr;
+      uint32_t id = tuner->play([discovery, ticket](bool ok) {
+        discovery->completeCommand(ticket, ok);
+      });
+      if (id != 0) return CMD_ACCEPTED;
+      return audioMgr->isPlaying() ? CMD_OK : CMD_FAILED;
+    }
+    case CMD_PAUSE:
+      audioMgr->pause();
+      return CMD_OK;
+    case CMD_STATION: {
+      // Opening the stream takes seconds: acknowledge now, report when done
+      String url;
+      url.concat(command.url, command.urlLen);
+      DiscoveryModule* discovery = discoveryMgr;
+      uint32_t id = tuner->tune(url, true, [discovery, ticket](bool ok) {
+        discovery->completeCommand(ticket, ok);
+      });
+      return id != 0 ? CMD_ACCEPTED : CMD_FAILED;
+    }
+    case CMD_VOLUME:
+      if (command.value > 1000) return CMD_FAILED;
+      audioMgr->requestVolume(command.value / 1000.0);
+      return CMD_OK;
+    case CMD_SLEEP:
+      if (command.value > GROUP_SLEEP_MAX) return CMD_FAILED;
+      if (command.value == 0) {
+        audioMgr->cancelSleepTimer();
+      } else {
+        audioMgr->setSleepTimer(command.value);
+      }
+      return CMD_OK;
+  }
+  return CMD_FAILED;
+}
+
+const char* WebServerModule::resultName(uint8_t result) {
+  switch (result) {
+    case CMD_OK: return "ok";
+    case CMD_FAILED: return "failed";
+    case CMD_PENDING: return "pending";
+    case CMD_ACCEPTED: return "accepted";
+  }
+  return "none";
+}
+
+String WebServerModule::blobStatsJson(const BlobStats& stats) {
+  return "{\"load_us\":" + String(stats.loadUs) +
+         ",\"save_us\":" + String(stats.saveUs) +
+         ",\"last_write_bytes\":" + String(stats.lastWriteBytes) +
+         ",\"total_write_bytes\":" + String(stats.totalWriteBytes) +
+         ",\"saves\":" + String(stats.saves) + "}";
+}
+
+String WebServerModule::bootJson() {
+  String json = "{\"fast_boot\":" + String(bootTrace->isFastBoot() ? "true" : "false") +
+                ",\"ready_ms\":" + String(bootTrace->getReadyMs()) +
+                ",\"first_audio_ms\":" + String(bootTrace->getFirstAudioMs()) +
+                ",\"phases\":[";
+  const BootPhase* phases = bootTrace->getPhases();
+  for (int i = 0; i < bootTrace->getCount(); i++) {
+    if (i > 0) json += ",";
+    json += "{\"name\":\"" + String(phases[i].name) +
+            "\",\"start_ms\":" + String(phases[i].startMs) +
+            ",\"ms\":" + String(phases[i].endMs ? phases[i].endMs - phases[i].startMs : 0) + "}";
+  }
+  json += "]}";
+  return json;
+}
+
+String WebServerModule::tasksJson() {
+  static const char* PRIORITIES[] = { "housekeeping", "network", "audio" };
+  String json = "{\"passes\":" + String(scheduler->getPasses()) +
+                ",\"max_pass_us\":" + String(scheduler->getMaxPassUs()) +
+                ",\"tasks\":[";
+  const TaskStats* tasks = scheduler->getTasks();
+  for (int i = 0; i < scheduler->getCount(); i++) {
+    const TaskStats& t = tasks[i];
+    if (i > 0) json += ",";
+    json += "{\"name\":\"" + String(t.name) +
+            "\",\"priority\":\"" + PRIORITIES[t.priority] +
+            "\",\"period_ms\":" + String(t.periodMs) +
+            ",\"budget_us\":" + String(t.budgetUs) +
+            ",\"runs\":" + String(t.runs) +
+            ",\"overruns\":" + String(t.overruns) +
+            ",\"deferrals\":" + String(t.deferrals) +
+            ",\"last_us\":" + String(t.lastUs) +
+            ",\"max_us\":" + String(t.maxUs) +
+            ",\"total_ms\":" + String((uint32_t)(t.totalUs / 1000)) + "}";
+  }
+  json += "]}";
+  return json;
+}
+
+String WebServerModule::heapJson() {
+  HeapSample now = heapMonitor->getCurrent();
+  String json = "{\"free\":" + String(now.freeHeap) +
+                ",\"largest_block\":" + String(now.largestBlock) +
+                ",\"fragmentation_pct\":" + String(heapMonitor->getFragmentation()) +
+                ",\"min_free_ever\":" + String(heapMonitor->getMinEverFree()) +
+                ",\"low_free\":" + String(now.lowFree) +
+                ",\"low_largest\":" + String(now.lowLargest) +
+                ",\"live_blocks\":" + String(now.liveBlocks) +
+                ",\"modules\":{";
+  for (int i = 0; i < HEAP_MODULES; i++) {
+    HeapModuleStats m = HeapMonitor::getModuleStats((HeapModule)i);
+    if (i > 0) json += ",";
+    json += "\"" + String(HeapMonitor::moduleName((HeapModule)i)) +
+            "\":{\"allocs\":" + String(m.allocs) +
+            ",\"frees\":" + String(m.frees) +
+            ",\"live_blocks\":" + String(m.allocs - m.frees) +
+            ",\"live_bytes\":" + String(m.liveBytes) +
+            ",\"peak_bytes\":" + String(m.peakBytes) +
+            ",\"failed\":" + String(m.failed) + "}";
+  }
+  json += "}}";
+  return json;
+}
+
+String WebServerModule::jsonEscape(const String& value) {
+  String out;
+  out.reserve(value.length() + 8);
+  for (unsigned int i = 0; i < value.length(); i++) {
+    char c = value[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if ((uint8_t)c < 0x20) {
+      char buf[7];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+// Emits the validators and answers 304 when the client's copy is current.
+// Returns true when the response has already been sent.
+bool WebServerModule::notModified(const String& etag, const char* cacheControl) {
+  server->sendHeader("ETag", etag);
+  server->sendHeader("Cache-Control", cacheControl);
+
+  if (server->hasHeader("If-None-Match") && etagMatches(server->header("If-None-Match"), etag)) {
+    cacheHits++;
+    server->send(304);
+    return true;
+  }
+
+  cacheMisses++;
+  return false;
+}
+
+// If-None-Match uses weak comparison and may list several tags
+bool WebServerModule::etagMatches(const String& header, const String& etag) {
+  String wanted = etag.startsWith("W/") ? etag.substring(2) : etag;
+
+  int start = 0;
+  while (start < (int)header.length()) {
+    int end = header.indexOf(',', start);
+    if (end < 0) end = header.length();
+
+    String tag = header.substring(start, end);
+    tag.trim();
+    if (tag == "*") return true;
+    if (tag.startsWith("W/")) tag = tag.substring(2);
+    if (tag == wanted) return true;
+
+    start = end + 1;
+  }
+  return false;
+}
+
 void WebServerModule::handleNotFound() {
   // Redirect all 404s to root in AP mode, otherwise show player
   if (wifiMgr->getMode() == MODE_AP) {
@@ -8,12 +8,24 @@
 #include "AudioModule.h"
 #include "LibraryModule.h"
 #include "DiscoveryModule.h"
+#include "DirectoryModule.h"
+#include "BootTrace.h"
+#include "OTAModule.h"
+#include "Scheduler.h"
+#include "HeapMonitor.h"
+#include "Tuner.h"
 
 #define DNS_PORT 53
+#define MAX_BATCH_COMMANDS 16
+#define PLAYER_PAGE_SIZE 20      // stations per player page
+#define SEARCH_DEFAULT_LIMIT 20
+#define GROUP_SLEEP_MAX 180       // minutes
 
 class WebServerModule {
 public:
-    WebServerModule(WiFiModule* wifi, AudioModule* audio, LibraryModule* library, DiscoveryModule* discovery);
+    WebServerModule(WiFiModule* wifi, AudioModule* audio, LibraryModule* library, DiscoveryModule* discovery,
+                    DirectoryModule* directory, BootTrace* boot, OTAModule* ota, Scheduler* scheduler,
+                    HeapMonitor* heap, Tuner* tuner);
     
     void begin();
     void handle();
@@ -23,9 +35,32 @@ private:
     AudioModule* audioMgr;
     LibraryModule* libraryMgr;
     DiscoveryModule* discoveryMgr;
+    DirectoryModule* directoryMgr;
+    BootTrace* bootTrace;
+    OTAModule* otaMgr;
+    Scheduler* scheduler;
+    HeapMonitor* heapMonitor;
+    Tuner* tuner;
     WebServer* server;
     DNSServer* dnsServer;
     
+    // HTTP caching
+    String bootTag;
+    uint32_t cacheHits;
+    uint32_t cacheMisses;
+    bool notModified(const String& etag, const char* cacheControl);
+    bool etagMatches(const String& header, const String& etag);
+    
+    String blobStatsJson(const BlobStats& stats);
+    String bootJson();
+    String tasksJson();
+    String heapJson();
+    String jsonEscape(const String& value);
+    LibraryOrder parseOrder(const String& value);
+    bool isNumber(const String& value);
+    uint8_t runGroupCommand(const GroupCommand& command, const CommandTicket& ticket);
+    const char* resultName(uint8_t result);
+    
     // Route handlers
     void handleRoot();
     void handlePlayer();
@@ -36,9 +71,23 @@ private:
     void handleAddLibrary();
     void handleGetLibrary();
     void handleRemoveLibrary();
+    void handleGetNetworks();
     void handleRemoveNetwork();
     void handleSleepTimer();
     void handleReset();
+    void handleBatch();
+    void handleMetrics();
+    void handleBoot();
+    void handleTasks();
+    void handleHeap();
+    void handleSearch();
+    void handleTune();
+    void handleGroup();
+    void handleGroupCommand();
+    void handleGroupStatus();
+    void handleGroupJoin();
+    void handleOta();
+    void handleOtaConfig();
     void handleNotFound();
 };
 
@@ -1,31 +1,45 @@
 #include "WiFiModule.h"
 
-WiFiModule::WiFiModule() : mode(MODE_NONE), networkCount(0) {}
+WiFiModule::WiFiModule()
+    : store("wifi", NETWORKS_SCHEMA), fastStore("wififast", FAST_CONNECT_SCHEMA), fastValid(false),
+      historyCount(0), linkState(LINK_UP), roaming(false), backoffMs(RETRY_MIN), retryWaitMs(0),
+      stateSince(0), downSince(0), lastRssiCheck(0), lastRoamScan(0), mode(MODE_NONE), networkCount(0), networksVersion(0) {
+    memset(&connectStats, 0, sizeof(connectStats));
+    memset(&linkStats, 0, sizeof(linkStats));
+}
 
 bool WiFiModule::begin() {
     Serial.println("WiFi init...");
+    unsigned long start = millis();
+    
+    // This module owns every (re)join; the driver's own retry would race it
+    WiFi.setAutoReconnect(false);
     
     loadAllNetworks();
+    loadFastConnect();
     
-    // Try each saved network
-    for (int i = 0; i < networkCount; i++) {
-        Serial.print("Trying network ");
-        Serial.print(i + 1);
-        Serial.print("/");
-        Serial.print(networkCount);
-        Serial.print(": ");
-        Serial.println(networks[i].ssid);
-        
-        if (tryConnect(networks[i].ssid.c_str(), networks[i].password.c_str())) {
-            mode = MODE_STATION;
-            Serial.print("Connected. IP: ");
-            Serial.println(WiFi.localIP());
-            return true;
-        }
+    if (tryFastConnect() || tryScannedNetworks()) {
+        mode = MODE_STATION;
+        saveFastConnect();  // no-op unless the AP or lease changed
+        linkState = LINK_UP;
+        lastRssiCheck = millis();
+        lastRoamScan = lastRssiCheck - ROAM_SCAN_INTERVAL;  // a weak start may roam at once
+        linkStats.rssi = WiFi.RSSI();
+        connectStats.totalMs = millis() - start;
+        Serial.print("Connected to ");
+        Serial.print(WiFi.SSID());
+        Serial.print(" in ");
+        Serial.print(connectStats.totalMs);
+        Serial.print(" ms. IP: ");
+        Serial.println(WiFi.localIP());
+        return true;
     }
+    connectStats.totalMs = millis() - start;
     
     // No saved networks or none worked - start AP
-    Serial.println("No networks available, starting AP mode");
+    Serial.print("No networks available after ");
+    Serial.print(connectStats.totalMs);
+    Serial.println(" ms, starting AP mode");
     if (startAP()) {
         mode = MODE_AP;
         Serial.print("AP IP: ");
@@ -37,15 +51,358 @@ bool WiFiModule::begin() {
     return false;
 }
 
-bool WiFiModule::tryConnect(const char* ssid, const char* password) {
+// channel/bssid, when known from a scan or the cache, make it a directed
+// connect that skips the driver's own scan
+bool WiFiModule::tryConnect(const char* ssid, const char* password, int32_t channel, const uint8_t* bssid,
+                            uint32_t timeoutMs) {
     WiFi.mode(WIFI_STA);
-    WiFi.begin(ssid, password);
+    unsigned long start = millis();
+    WiFi.begin(ssid, password, channel, bssid);
+    connectStats.attempts++;
+    
+    if (!waitForConnect(timeoutMs)) {
+        WiFi.disconnect();
+        return false;
+    }
+    
+    connectStats.connectMs = millis() - start;
+    return true;
+}
+
+// Directed connect to the cached AP; only used while its SSID is still saved
+bool WiFiModule::tryFastConnect() {
+    if (!fastValid) return false;
+    
+    const char* password = nullptr;
+    for (int i = 0; i < networkCount; i++) {
+        if (networks[i].ssid == fast.ssid) password = networks[i].password.c_str();
+    }
+    if (password == nullptr) return false;
+    
+    Serial.print("Fast connect: ");
+    Serial.print(fast.ssid);
+    Serial.print(" on channel ");
+    Serial.println(fast.channel);
+    
+    WiFi.mode(WIFI_STA);
+    if (FAST_CONNECT_STATIC_IP && fast.ip != 0) {
+        WiFi.config(IPAddress(fast.ip), IPAddress(fast.gateway), IPAddress(fast.subnet), IPAddress(fast.dns));
+    }
+    
+    if (tryConnect(fast.ssid.c_str(), password, fast.channel, fast.bssid, FAST_CONNECT_TIMEOUT)) {
+        connectStats.fastPath = true;
+        return true;
+    }
+    
+    // AP moved or lease taken: back to scan + DHCP, which re-caches
+    Serial.println("Fast connect failed, falling back to scan");
+    connectStats.fastFailures++;
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+    fastValid = false;
+    return false;
+}
+
+// One active scan, matched against every saved network. Candidates are tried
+// strongest first (RSSI plus a bonus for recent successes), each with a short
+// timeout. Saved networks missing from the scan are only tried blind when a
+// hidden AP is around or the scan failed.
+bool WiFiModule::tryScannedNetworks() {
+    if (networkCount == 0) return false;
+    
+    WiFi.mode(WIFI_STA);
+    unsigned long scanStart = millis();
+    int found = WiFi.scanNetworks(false, true);
+    connectStats.scanMs = millis() - scanStart;
+    
+    Candidate candidates[MAX_NETWORKS];
+    bool tryUnseen = found < 0;
+    int candidateCount = rankScan(found, candidates, &tryUnseen);
+    connectStats.candidates = candidateCount;
+    
+    Serial.print("Scan: ");
+    Serial.print(found);
+    Serial.print(" APs, ");
+    Serial.print(candidateCount);
+    Serial.print(" saved networks in range (");
+    Serial.print(connectStats.scanMs);
+    Serial.println(" ms)");
+    
+    for (int c = 0; c < candidateCount; c++) {
+        const SavedNetwork& net = networks[candidates[c].network];
+        Serial.print("Trying ");
+        Serial.print(net.ssid);
+        Serial.print(" (");
+        Serial.print(candidates[c].rssi);
+        Serial.print(" dBm, channel ");
+        Serial.print(candidates[c].channel);
+        Serial.println(")");
+        
+        if (tryConnect(net.ssid.c_str(), net.password.c_str(), candidates[c].channel, candidates[c].bssid,
+                       CANDIDATE_TIMEOUT)) {
+            return true;
+        }
+    }
+    
+    if (!tryUnseen) return false;
+    
+    for (int n = 0; n < networkCount; n++) {
+        bool seen = false;
+        for (int c = 0; c < candidateCount; c++) {
+            if (candidates[c].network == n) seen = true;
+        }
+        if (seen) continue;
+        
+        Serial.print("Trying unlisted ");
+        Serial.println(networks[n].ssid);
+        if (tryConnect(networks[n].ssid.c_str(), networks[n].password.c_str(), 0, nullptr, CANDIDATE_TIMEOUT)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Turns the results of a finished scan into saved-network candidates, best
+// score first, and frees the scan. hiddenSeen is set when a hidden AP showed up.
+int WiFiModule::rankScan(int found, Candidate* candidates, bool* hiddenSeen) {
+    int candidateCount = 0;
+    
+    for (int i = 0; i < found; i++) {
+        String ssid = WiFi.SSID(i);
+        if (ssid.length() == 0) {
+            if (hiddenSeen) *hiddenSeen = true;
+            continue;
+        }
+        
+        for (int n = 0; n < networkCount; n++) {
+            if (networks[n].ssid != ssid) continue;
+            
+            // Several APs may share an SSID; keep the strongest
+            int32_t rssi = WiFi.RSSI(i);
+            int c = 0;
+            while (c < candidateCount && candidates[c].network != n) c++;
+            if (c == candidateCount) {
+                candidateCount++;
+            } else if (candidates[c].rssi >= rssi) {
+                break;
+            }
+            candidates[c].network = n;
+            candidates[c].rssi = rssi;
+            candidates[c].score = rssi + historyBonus(ssid);
+            candidates[c].channel = WiFi.channel(i);
+            memcpy(candidates[c].bssid, WiFi.BSSID(i), 6);
+            break;
+        }
+    }
+    WiFi.scanDelete();
+    
+    // Insertion sort, best score first; at most MAX_NETWORKS entries
+    for (int i = 1; i < candidateCount; i++) {
+        Candidate c = candidates[i];
+        int j = i;
+        while (j > 0 && candidates[j - 1].score < c.score) {
+            candidates[j] = candidates[j - 1];
+            j--;
+        }
+        candidates[j] = c;
+    }
+    return candidateCount;
+}
+
+void WiFiModule::handle() {
+    if (mode != MODE_STATION) return;
+    
+    unsigned long now = millis();
+    switch (linkState) {
+    case LINK_UP:
+        if (WiFi.status() != WL_CONNECTED) {
+            downSince = now;
+            linkStats.disconnects++;
+            linkStats.rssi = 0;
+            backoffMs = RETRY_MIN;
+            Serial.println("WiFi: link lost, rejoining");
+            
+            // The AP usually comes back where it was: rejoin it right away
+            if (fastValid) {
+                for (int i = 0; i < networkCount; i++) {
+                    if (networks[i].ssid == fast.ssid) {
+                        startJoin(networks[i], fast.channel, fast.bssid);
+                        return;
+                    }
+                }
+            }
+            startScan(false);
+        } else if (now - lastRssiCheck >= RSSI_INTERVAL) {
+            lastRssiCheck = now;
+            linkStats.rssi = WiFi.RSSI();
+            if (linkStats.rssi < ROAM_RSSI && now - lastRoamScan >= ROAM_SCAN_INTERVAL) {
+                lastRoamScan = now;
+                startScan(true);
+            }
+        }
+        break;
+        
+    case LINK_JOINING: {
+        wl_status_t status = WiFi.status();
+        if (status == WL_CONNECTED) {
+            linkUp();
+        } else if (status == WL_NO_SSID_AVAIL || status == WL_CONNECT_FAILED ||
+                   now - stateSince >= CANDIDATE_TIMEOUT) {
+            WiFi.disconnect();
+            if (roaming) {
+                // The old AP is gone as well now; treat it as an outage
+                roaming = false;
+                downSince = stateSince;
+                linkStats.disconnects++;
+                backoffMs = RETRY_MIN;
+            }
+            scheduleRetry();
+        }
+        break;
+    }
+        
+    case LINK_BACKOFF:
+        if (now - stateSince >= retryWaitMs) {
+            linkStats.retries++;
+            if (fastValid && linkStats.retries % RETRY_SCAN_EVERY != 0) {
+                for (int i = 0; i < networkCount; i++) {
+                    if (networks[i].ssid == fast.ssid) {
+                        startJoin(networks[i], fast.channel, fast.bssid);
+                        return;
+                    }
+                }
+            }
+            startScan(false);
+        }
+        break;
+        
+    case LINK_SCANNING: {
+        int found = WiFi.scanComplete();
+        if (found == WIFI_SCAN_RUNNING && now - stateSince < SCAN_TIMEOUT) break;
+        finishScan(found);
+        break;
+    }
+    }
+}
+
+void WiFiModule::startJoin(const SavedNetwork& network, int32_t channel, const uint8_t* bssid) {
+    // A cached static lease only fits the network it came from
+    if (network.ssid != fast.ssid) {
+        WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+    }
+    
+    WiFi.begin(network.ssid.c_str(), network.password.c_str(), channel, bssid);
+    linkState = LINK_JOINING;
+    stateSince = millis();
+}
+
+void WiFiModule::startScan(bool roam) {
+    roaming = roam;
+    if (WiFi.scanNetworks(true, true) == WIFI_SCAN_FAILED) {
+        if (roam) {
+            linkState = LINK_UP;
+        } else {
+            scheduleRetry();
+        }
+        return;
+    }
+    linkState = LINK_SCANNING;
+    stateSince = millis();
+}
+
+void WiFiModule::finishScan(int found) {
+    Candidate candidates[MAX_NETWORKS];
+    int candidateCount = found > 0 ? rankScan(found, candidates, nullptr) : 0;
+    if (found <= 0) WiFi.scanDelete();
     
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 40) {
-        delay(500);
-        Serial.print(".");
-        attempts++;
+    if (roaming) {
+        // Only a clearly stronger AP is worth the short interruption
+        linkState = LINK_UP;
+        roaming = false;
+        int32_t current = WiFi.RSSI();
+        for (int c = 0; c < candidateCount; c++) {
+            if (memcmp(candidates[c].bssid, WiFi.BSSID(), 6) == 0) continue;
+            if (candidates[c].rssi < current + ROAM_HYSTERESIS) continue;
+            
+            Serial.print("WiFi: roaming to ");
+            Serial.print(networks[candidates[c].network].ssid);
+            Serial.print(" (");
+            Serial.print(current);
+            Serial.print(" -> ");
+            Serial.print(candidates[c].rssi);
+            Serial.println(" dBm)");
+            roaming = true;
+            startJoin(networks[candidates[c].network], candidates[c].channel, candidates[c].bssid);
+            return;
+        }
+        return;
+    }
+    
+    if (candidateCount > 0) {
+        startJoin(networks[candidates[0].network], candidates[0].channel, candidates[0].bssid);
+    } else {
+        scheduleRetry();
+    }
+}
+
+void WiFiModule::linkUp() {
+    unsigned long now = millis();
+    if (roaming) {
+        roaming = false;
+        linkStats.roams++;
+    } else {
+        linkStats.lastOutageMs = now - downSince;
+        linkStats.downtimeMs += linkStats.lastOutageMs;
+        linkStats.reconnects++;
+        Serial.print("WiFi: link back after ");
+        Serial.print(linkStats.lastOutageMs);
+        Serial.println(" ms");
+    }
+    
+    linkState = LINK_UP;
+    stateSince = now;
+    lastRssiCheck = now;
+    linkStats.rssi = WiFi.RSSI();
+    backoffMs = RETRY_MIN;
+    saveFastConnect();
+}
+
+// Exponential backoff with up to 25% jitter, so a room full of beacons does
+// not hit a rebooting AP in lockstep
+void WiFiModule::scheduleRetry() {
+    linkState = LINK_BACKOFF;
+    stateSince = millis();
+    retryWaitMs = backoffMs + random(backoffMs / 4 + 1);
+    
+    Serial.print("WiFi: next rejoin in ");
+    Serial.print(retryWaitMs);
+    Serial.println(" ms");
+    
+    uint32_t next = backoffMs * 2;
+    backoffMs = next > RETRY_MAX ? RETRY_MAX : next;
+}
+
+// The last network that worked gets HISTORY_BONUS dB, older ones half as much
+// per step back
+int WiFiModule::historyBonus(const String& ssid) {
+    for (int i = 0; i < historyCount; i++) {
+        if (history[i] == ssid) return HISTORY_BONUS >> i;
+    }
+    return 0;
+}
+
+// Short poll so a connection is noticed within 10 ms, not 500. Gives up
+// early once the driver reports the AP missing or the key rejected.
+bool WiFiModule::waitForConnect(uint32_t timeoutMs) {
+    unsigned long start = millis();
+    unsigned long lastDot = start;
+    wl_status_t status;
+    while ((status = WiFi.status()) != WL_CONNECTED && status != WL_NO_SSID_AVAIL &&
+           status != WL_CONNECT_FAILED && millis() - start < timeoutMs) {
+        delay(10);
+        if (millis() - lastDot >= 500) {
+            Serial.print(".");
+            lastDot = millis();
+        }
     }
     Serial.println();
     
@@ -65,6 +422,13 @@ bool WiFiModule::isConnected() {
     return (mode == MODE_STATION && WiFi.status() == WL_CONNECTED);
 }
 
+const LinkStats& WiFiModule::getLinkStats() {
+    linkStats.state = linkState;
+    bool down = mode == MODE_STATION && linkState != LINK_UP && !(roaming && WiFi.status() == WL_CONNECTED);
+    linkStats.outageMs = down ? millis() - downSince : 0;
+    return linkStats;
+}
+
 bool WiFiModule::addNetwork(const char* ssid, const char* password) {
     if (networkCount >= MAX_NETWORKS) {
         Serial.println("Network list full");
@@ -116,6 +480,18 @@ SavedNetwork* WiFiModule::getNetworks() {
     return networks;
 }
 
+uint32_t WiFiModule::getNetworksVersion() {
+    return networksVersion;
+}
+
+const BlobStats& WiFiModule::getStorageStats() {
+    return store.getStats();
+}
+
+const ConnectStats& WiFiModule::getConnectStats() {
+    return connectStats;
+}
+
 void WiFiModule::clearAllNetworks() {
     networkCount = 0;
     saveAllNetworks();
@@ -123,37 +499,146 @@ void WiFiModule::clearAllNetworks() {
 }
 
 void WiFiModule::loadAllNetworks() {
-    prefs.begin("wifi", true);
-    networkCount = prefs.getInt("count", 0);
-    
-    if (networkCount > MAX_NETWORKS) networkCount = MAX_NETWORKS;
+    networkCount = 0;
     
-    for (int i = 0; i < networkCount; i++) {
-        String ssidKey = "ssid" + String(i);
-        String passKey = "pass" + String(i);
-        networks[i].ssid = prefs.getString(ssidKey.c_str(), "");
-        networks[i].password = prefs.getString(passKey.c_str(), "");
+    std::vector<uint8_t> payload;
+    if (store.load(payload)) {
+        BlobReader reader(payload);
+        int count = reader.getU8();
+        for (int i = 0; i < count && reader.ok() && networkCount < MAX_NETWORKS; i++) {
+            networks[networkCount].ssid = reader.getString();
+            networks[networkCount].password = reader.getString();
+            if (reader.ok()) networkCount++;
+        }
+    } else {
+        migrateLegacyNetworks();
     }
     
-    prefs.end();
     Serial.print("Loaded ");
     Serial.print(networkCount);
-    Serial.println(" networks");
+    Serial.print(" networks in ");
+    Serial.print(store.getStats().loadUs);
+    Serial.println(" us");
 }
 
-void WiFiModule::saveAllNetworks() {
-    prefs.begin("wifi", false);
-    prefs.clear();
-    prefs.putInt("count", networkCount);
+bool WiFiModule::saveAllNetworks() {
+    // Payload: u8 count, then ssid/password pairs as length-prefixed strings
+    std::vector<uint8_t> payload;
+    BlobWriter writer(payload);
+    writer.putU8(networkCount);
+    for (int i = 0; i < networkCount; i++) {
+        writer.putString(networks[i].ssid);
+        writer.putString(networks[i].password);
+    }
+    
+    networksVersion++;
+    return store.save(payload);
+}
+
+void WiFiModule::loadFastConnect() {
+    fastValid = false;
+    
+    std::vector<uint8_t> payload;
+    if (!fastStore.load(payload)) return;
+    
+    BlobReader reader(payload);
+    fast.ssid = reader.getString();
+    for (int i = 0; i < 6; i++) fast.bssid[i] = reader.getU8();
+    fast.channel = reader.getU8();
+    fast.ip = reader.getU32();
+    fast.gateway = reader.getU32();
+    fast.subnet = reader.getU32();
+    fast.dns = reader.getU32();
+    fastValid = reader.ok() && fast.ssid.length() > 0 && fast.channel != 0;
+    
+    historyCount = 0;
+    int count = reader.getU8();
+    for (int i = 0; i < count && reader.ok() && historyCount < MAX_NETWORKS; i++) {
+        history[historyCount] = reader.getString();
+        if (reader.ok()) historyCount++;
+    }
+}
+
+// Called after every connect; NVS is only written when the AP, the lease or
+// the most recent network changed
+void WiFiModule::saveFastConnect() {
+    FastConnectCache current;
+    current.ssid = WiFi.SSID();
+    memcpy(current.bssid, WiFi.BSSID(), 6);
+    current.channel = WiFi.channel();
+    current.ip = WiFi.localIP();
+    current.gateway = WiFi.gatewayIP();
+    current.subnet = WiFi.subnetMask();
+    current.dns = WiFi.dnsIP();
+    
+    if (fastValid && current.ssid == fast.ssid && memcmp(current.bssid, fast.bssid, 6) == 0 &&
+        current.channel == fast.channel && current.ip == fast.ip && current.gateway == fast.gateway &&
+        current.subnet == fast.subnet && current.dns == fast.dns &&
+        historyCount > 0 && history[0] == current.ssid) {
+        return;
+    }
+    
+    // Most recent success first
+    int kept = 0;
+    String previous[MAX_NETWORKS];
+    for (int i = 0; i < historyCount; i++) {
+        if (history[i] != current.ssid && kept < MAX_NETWORKS - 1) previous[kept++] = history[i];
+    }
+    history[0] = current.ssid;
+    for (int i = 0; i < kept; i++) history[i + 1] = previous[i];
+    historyCount = kept + 1;
+    
+    // Payload: ssid, bssid, channel, ip/gateway/subnet/dns, then u8 count
+    // and the SSIDs that connected, most recent first
+    std::vector<uint8_t> payload;
+    BlobWriter writer(payload);
+    writer.putString(current.ssid);
+    for (int i = 0; i < 6; i++) writer.putU8(current.bssid[i]);
+    writer.putU8(current.channel);
+    writer.putU32(current.ip);
+    writer.putU32(current.gateway);
+    writer.putU32(current.subnet);
+    writer.putU32(current.dns);
+    writer.putU8(historyCount);
+    for (int i = 0; i < historyCount; i++) writer.putString(history[i]);
+    
+    if (fastStore.save(payload)) {
+        fast = current;
+        fastValid = true;
+    }
+}
+
+// Pre-blob firmware stored one NVS key per field (count, ssidN, passN)
+bool WiFiModule::migrateLegacyNetworks() {
+    prefs.begin("wifi", true);
+    int count = prefs.getInt("count", 0);
+    networkCount = count > MAX_NETWORKS ? MAX_NETWORKS : count;
     
     for (int i = 0; i < networkCount; i++) {
         String ssidKey = "ssid" + String(i);
         String passKey = "pass" + String(i);
-        prefs.putString(ssidKey.c_str(), networks[i].ssid);
-        prefs.putString(passKey.c_str(), networks[i].password);
+        networks[i].ssid = prefs.getString(ssidKey.c_str(), "");
+        networks[i].password = prefs.getString(passKey.c_str(), "");
     }
     
     prefs.end();
+    if (count == 0) return false;
+    
+    // Write the blob first so a power cut never loses credentials
+    if (!saveAllNetworks()) return false;
+    
+    prefs.begin("wifi", false);
+    for (int i = 0; i < count; i++) {
+        prefs.remove(("ssid" + String(i)).c_str());
+        prefs.remove(("pass" + String(i)).c_str());
+    }
+    prefs.remove("count");
+    prefs.end();
+    
+    Serial.print("WiFi: migrated ");
+    Serial.print(networkCount);
+    Serial.println(" networks to blob format");
+    return true;
 }
 
 // Legacy single-network support
@@ -3,16 +3,72 @@
 
 #include <WiFi.h>
 #include <Preferences.h>
+#include "BlobStore.h"
 
 #define AP_SSID "GridBeacon-Setup"
 #define AP_PASSWORD "gridbeacon"
 #define MAX_NETWORKS 10
+#define NETWORKS_SCHEMA 1
+#define CANDIDATE_TIMEOUT 6000     // ms per scanned network (associate + DHCP)
+#define HISTORY_BONUS 10           // dB credited to the last network that worked
+
+// Fast reconnect: the AP (BSSID, channel) and IP settings of the last
+// connection are cached in NVS. A directed connect to them skips the channel
+// scan, and with FAST_CONNECT_STATIC_IP also DHCP. Any failure falls back to
+// the full path, which refreshes the cache.
+#define FAST_CONNECT_SCHEMA 2      // 2: adds the success history
+#define FAST_CONNECT_TIMEOUT 1500  // ms before giving up on the cached AP
+#ifndef FAST_CONNECT_STATIC_IP
+#define FAST_CONNECT_STATIC_IP 1   // reuse the last DHCP lease as static config
+#endif
+
+// Runtime supervision (handle()): a lost link is rejoined with exponential
+// backoff, alternating directed rejoins of the last AP with full scans. A
+// weak link triggers a background scan; a saved AP at least
+// ROAM_HYSTERESIS dB stronger is joined.
+#define RETRY_MIN 1000             // ms before the first rejoin
+#define RETRY_MAX 60000            // backoff cap
+#define RETRY_SCAN_EVERY 3         // every Nth rejoin scans for other networks
+#define SCAN_TIMEOUT 10000         // ms an async scan may take
+#define RSSI_INTERVAL 5000         // ms between link quality checks
+#define ROAM_RSSI -75              // dBm below which a roam scan starts
+#define ROAM_HYSTERESIS 8          // dB a new AP must beat the current one by
+#define ROAM_SCAN_INTERVAL 60000   // ms between roam scans
 
 struct SavedNetwork {
     String ssid;
     String password;
 };
 
+struct ConnectStats {
+    uint32_t totalMs;      // begin() to connected (or AP fallback), this boot
+    uint32_t connectMs;    // WiFi.begin() to connected, last attempt
+    uint32_t scanMs;       // 0 when the cached AP answered
+    uint8_t candidates;    // saved networks found by the scan
+    uint8_t attempts;      // WiFi.begin() calls
+    bool fastPath;         // connected through the cached AP
+    uint32_t fastFailures; // cached AP tried and missed, this boot
+};
+
+struct LinkStats {
+    uint8_t state;          // LinkState
+    int32_t rssi;           // dBm, last check
+    uint32_t disconnects;
+    uint32_t reconnects;
+    uint32_t roams;
+    uint32_t downtimeMs;    // total of finished outages, this boot
+    uint32_t lastOutageMs;
+    uint32_t outageMs;      // running outage, 0 while up
+    uint32_t retries;       // rejoin attempts, this boot
+};
+
+enum LinkState {
+    LINK_UP,
+    LINK_BACKOFF,    // waiting before the next rejoin
+    LINK_JOINING,    // WiFi.begin() issued, waiting for the link
+    LINK_SCANNING    // async scan running (rejoin or roam)
+};
+
 enum WiFiMode {
     MODE_STATION,
     MODE_AP,
@@ -24,8 +80,10 @@ public:
     WiFiModule();
     
     bool begin();
+    void handle(); // Call in loop - supervises the link, never blocks
     WiFiMode getMode();
     bool isConnected();
+    const LinkStats& getLinkStats();
     
     // Multi-network credentials
     bool addNetwork(const char* ssid, const char* password);
@@ -33,6 +91,9 @@ public:
     int getNetworkCount();
     SavedNetwork* getNetworks();
     void clearAllNetworks();
+    uint32_t getNetworksVersion(); // bumped on every change
+    const BlobStats& getStorageStats();
+    const ConnectStats& getConnectStats();
     
     // Legacy single-network support (for compatibility)
     bool saveCredentials(const char* ssid, const char* password);
@@ -40,15 +101,66 @@ public:
     void clearCredentials();
     
 private:
+    struct FastConnectCache {
+        String ssid;
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint32_t ip;        // network byte order, 0 = not cached
+        uint32_t gateway;
+        uint32_t subnet;
+        uint32_t dns;
+    };
+    
+    struct Candidate {
+        int network;
+        int32_t rssi;
+        int score;
+        int32_t channel;
+        uint8_t bssid[6];
+    };
+    
     Preferences prefs;
+    BlobStore store;
+    BlobStore fastStore;
+    FastConnectCache fast;
+    bool fastValid;
+    String history[MAX_NETWORKS];  // SSIDs that connected, most recent first
+    int historyCount;
+    ConnectStats connectStats;
+    
+    // Link supervisor
+    LinkStats linkStats;
+    LinkState linkState;
+    bool roaming;              // current join/scan is a roam, not a rejoin
+    uint32_t backoffMs;        // base of the next wait
+    uint32_t retryWaitMs;      // current wait, with jitter
+    unsigned long stateSince;
+    unsigned long downSince;
+    unsigned long lastRssiCheck;
+    unsigned long lastRoamScan;
     WiFiMode mode;
     SavedNetwork networks[MAX_NETWORKS];
     int networkCount;
+    uint32_t networksVersion;
     
-    bool tryConnect(const char* ssid, const char* password);
+    bool tryConnect(const char* ssid, const char* password, int32_t channel, const uint8_t* bssid,
+                    uint32_t timeoutMs);
+    bool tryFastConnect();
+    bool tryScannedNetworks();
+    int rankScan(int found, Candidate* candidates, bool* hiddenSeen);
+    void startJoin(const SavedNetwork& network, int32_t channel, const uint8_t* bssid);
+    void startScan(bool roam);
+    void finishScan(int found);
+    void linkUp();
+    void scheduleRetry();
+    int historyBonus(const String& ssid);
+    bool waitForConnect(uint32_t timeoutMs);
+    void loadFastConnect();
+    void saveFastConnect();
     bool startAP();
     void loadAllNetworks();
-    void saveAllNetworks();
+    bool saveAllNetworks();
+    bool migrateLegacyNetworks();
 };
 
 #endif
\ No newline at end of file
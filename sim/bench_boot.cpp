@@ -0,0 +1,263 @@
+/**
+ * Boot-to-connected benchmark for the host build.
+ *
+ * Boots WiFiModule against the simulated AP with radio timings close to an
+ * ESP32-C3 (all-channel scan, associate, DHCP) and reports how long
+ * begin() takes to reach WL_CONNECTED:
+ *
+ *   cold      no cached AP: scan + associate + DHCP
+ *   warm      cached BSSID/channel/IP: directed associate only
+ *   moved     AP changed channel: cached attempt times out, full path
+ *   recached  first boot after the fallback
+ *   ranked    MAX_NETWORKS saved, two in range: one scan, strongest first
+ *   absent    MAX_NETWORKS saved, none in range: scan, then AP fallback
+ *
+ * Then the runtime supervisor (handle() in a loop, like the sketch):
+ *
+ *   outage    both APs reboot (down for --outage-ms): time until rejoined
+ *   roam      the AP fades to -82 dBm while a second one is at -58 dBm
+ *
+ * The longest single handle() call shows whether the loop ever blocks.
+ *
+ * Finally stream opens (AudioModule::setURL) with the shared link and with
+ * the legacy credential constructor, once connected and once while the APs
+ * are rebooting (--outage-ms). A legacy open blocks the whole loop.
+ *
+ * Last, a power loss while playing: the volume is changed 50 times, the
+ * state settles into NVS, and a fresh boot resumes on its own. Reports the
+ * NVS writes and power-on to first audio.
+ *
+ *   ./bench_boot [--scan-ms MS] [--assoc-ms MS] [--dhcp-ms MS] [--boots N] [--outage-ms MS] [--open-ms MS] [--verbose]
+ */
+
+#include "Arduino.h"
+#include "SimControl.h"
+#include "WiFiModule.h"
+#include "AudioModule.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+struct BootResult {
+    uint32_t beginMs;   // whole begin(), including NVS loads
+    ConnectStats stats;
+    bool station;
+};
+
+// A fresh module per boot; only NVS carries over, as on the device
+static BootResult boot() {
+    WiFi.disconnect(true);
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+
+    WiFiModule wifi;
+    unsigned long start = millis();
+    wifi.begin();
+
+    BootResult result;
+    result.beginMs = millis() - start;
+    result.stats = wifi.getConnectStats();
+    result.station = wifi.getMode() == MODE_STATION;
+    return result;
+}
+
+static void report(const char* name, const BootResult& r) {
+    printf("%-10s %10u %10u %8u %6u %6s %9u  %s\n", name, r.beginMs, r.stats.totalMs, r.stats.scanMs,
+           r.stats.attempts, r.stats.fastPath ? "fast" : "scan", r.stats.fastFailures,
+           r.station ? WiFi.SSID().c_str() : "(AP mode)");
+}
+
+// Runs handle() until done() or the timeout; returns elapsed ms
+static uint32_t supervise(WiFiModule& wifi, uint32_t timeoutMs, const std::function<bool()>& done,
+                          uint32_t& maxHandleUs) {
+    unsigned long start = millis();
+    while (!done() && millis() - start < timeoutMs) {
+        auto t0 = std::chrono::steady_clock::now();
+        wifi.handle();
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+        if (us > maxHandleUs) maxHandleUs = us;
+        delay(2);
+    }
+    return millis() - start;
+}
+
+int main(int argc, char** argv) {
+    uint32_t scanMs = 1600;
+    uint32_t assocMs = 250;
+    uint32_t dhcpMs = 800;
+    int boots = 5;
+    uint32_t outageMs = 8000;
+    uint32_t openMs = 150;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--scan-ms" && i + 1 < argc) scanMs = atoi(argv[++i]);
+        else if (a == "--assoc-ms" && i + 1 < argc) assocMs = atoi(argv[++i]);
+        else if (a == "--dhcp-ms" && i + 1 < argc) dhcpMs = atoi(argv[++i]);
+        else if (a == "--boots" && i + 1 < argc) boots = atoi(argv[++i]);
+        else if (a == "--outage-ms" && i + 1 < argc) outageMs = atoi(argv[++i]);
+        else if (a == "--open-ms" && i + 1 < argc) openMs = atoi(argv[++i]);
+        else if (a == "--verbose") verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--scan-ms MS] [--assoc-ms MS] [--dhcp-ms MS] [--boots N] [--outage-ms MS] [--open-ms MS] [--verbose]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    sim::setSerialEnabled(verbose);
+    sim::nvsClear();
+    sim::setScanDelayMs(scanMs);
+    sim::setAssociateDelayMs(assocMs);
+    sim::setDhcpDelayMs(dhcpMs);
+
+    {
+        WiFiModule setupWifi;
+        setupWifi.addNetwork("SimNet", "simpassword");
+    }
+
+    printf("GridBeacon boot bench: scan %u ms, associate %u ms, DHCP %u ms\n\n", scanMs, assocMs, dhcpMs);
+    printf("%-10s %10s %10s %8s %6s %6s %9s  %s\n", "boot", "begin ms", "total ms", "scan ms", "tries", "path",
+           "failures", "network");
+
+    report("cold", boot());
+
+    uint32_t warmTotal = 0;
+    uint32_t warmMax = 0;
+    for (int i = 0; i < boots; i++) {
+        BootResult r = boot();
+        if (i == 0) report("warm", r);
+        warmTotal += r.beginMs;
+        if (r.beginMs > warmMax) warmMax = r.beginMs;
+    }
+
+    sim::moveAccessPoint(0, 11);
+    report("moved", boot());
+    report("recached", boot());
+
+    // A full list of saved networks; only the last two are around, and the
+    // stronger one has never connected before
+    sim::nvsClear();
+    sim::clearAccessPoints();
+    {
+        WiFiModule setupWifi;
+        for (int i = 0; i < MAX_NETWORKS; i++) {
+            String ssid = "Net" + String(i);
+            setupWifi.addNetwork(ssid.c_str(), "simpassword");
+        }
+    }
+    sim::addAccessPoint("Neighbour", 1, -48);
+    sim::addAccessPoint("Net8", 3, -78);
+    sim::addAccessPoint("Net9", 11, -61);
+    sim::addAccessPoint("Net9", 6, -70);
+    report("ranked", boot());
+
+    sim::clearAccessPoints();
+    sim::addAccessPoint("Neighbour", 1, -48);
+    report("absent", boot());
+
+    printf("\nwarm boots: %d, mean %.1f ms, max %u ms\n", boots, warmTotal / (double)boots, warmMax);
+
+    // Runtime: two APs with one SSID, the device on the stronger one
+    sim::nvsClear();
+    sim::clearAccessPoints();
+    int home = sim::addAccessPoint("Home", 6, -60);
+    int annex = sim::addAccessPoint("Home", 11, -90);
+    WiFi.disconnect(true);
+    WiFiModule wifi;
+    wifi.addNetwork("Home", "simpassword");
+    wifi.begin();
+
+    uint32_t maxHandleUs = 0;
+    sim::setAccessPointUp(home, false);
+    sim::setAccessPointUp(annex, false);
+    supervise(wifi, outageMs, [] { return false; }, maxHandleUs);
+    sim::setAccessPointUp(home, true);
+    sim::setAccessPointUp(annex, true);
+    uint32_t rejoinMs = supervise(wifi, 120000, [&] { return wifi.getLinkStats().reconnects > 0; }, maxHandleUs);
+    const LinkStats& link = wifi.getLinkStats();
+    printf("\noutage:   APs down %u ms, link back %u ms after the AP, outage %u ms, %u retries\n", outageMs, rejoinMs,
+           link.lastOutageMs, link.retries);
+
+    sim::setAccessPointRssi(home, -82);
+    sim::setAccessPointRssi(annex, -58);
+    uint32_t roamMs = supervise(wifi, 120000, [&] { return wifi.getLinkStats().roams > 0; }, maxHandleUs);
+    printf("roam:     %s after %u ms, now on channel %d at %d dBm\n", link.roams > 0 ? "roamed" : "no roam", roamMs,
+           WiFi.channel(), WiFi.RSSI());
+    printf("handle(): longest call %.2f ms\n", maxHandleUs / 1000.0);
+
+    // Stream opens: shared link vs. URLStream joining with credentials
+    sim::setStreamOpenMs(openMs);
+    AudioModule shared(&wifi);
+    AudioModule legacy("Home", "simpassword");
+    shared.begin();
+    legacy.begin();
+
+    printf("\n%-22s %10s %10s %s\n", "stream open", "shared ms", "legacy ms", "");
+    uint32_t sharedMs[2], legacyMs[2];
+    bool sharedOk[2], legacyOk[2];
+    for (int down = 0; down < 2; down++) {
+        AudioModule* modules[2] = { &shared, &legacy };
+        for (int m = 0; m < 2; m++) {
+            if (down) {
+                // Like a real outage: the supervisor has noticed the drop
+                sim::setAccessPointDownFor(home, outageMs);
+                sim::setAccessPointDownFor(annex, outageMs);
+                supervise(wifi, 100, [] { return false; }, maxHandleUs);
+            }
+            // Before the supervisor the driver's auto-reconnect was on;
+            // without it a legacy open during an outage never returns
+            WiFi.setAutoReconnect(m == 1);
+            unsigned long start = millis();
+            bool ok = modules[m]->setURL("http://127.0.0.1/stream0.mp3");
+            WiFi.setAutoReconnect(false);
+            (m == 0 ? sharedMs : legacyMs)[down] = millis() - start;
+            (m == 0 ? sharedOk : legacyOk)[down] = ok;
+            if (down) {
+                supervise(wifi, 120000, [] { return WiFi.status() == WL_CONNECTED; }, maxHandleUs);
+                supervise(wifi, 100, [] { return false; }, maxHandleUs);
+            }
+        }
+        printf("%-22s %10u %10u   shared %s, legacy %s\n", down ? "while APs reboot" : "link up", sharedMs[down],
+               legacyMs[down], sharedOk[down] ? "opened" : "refused", legacyOk[down] ? "opened" : "refused");
+    }
+
+    // Playing at power-off: a volume drag, then the state settles in NVS
+    AudioModule before(&wifi);
+    before.begin();
+    before.setURL("http://127.0.0.1/stream0.mp3");
+    before.play();
+    for (int i = 1; i <= 50; i++) {
+        before.requestVolume(i / 100.0);
+        before.process();
+        delay(20);
+    }
+    unsigned long settle = millis();
+    while (millis() - settle < AUDIO_STATE_DELAY + 100) {
+        before.process();
+        delay(2);
+    }
+    uint32_t stateSaves = before.getStorageStats().saves;
+
+    // Power on: fresh modules, NVS kept; nothing but loop() restarts audio
+    WiFi.disconnect(true);
+    unsigned long powerOn = millis();
+    WiFiModule wifiAfter;
+    AudioModule after(&wifiAfter);
+    after.begin();
+    wifiAfter.begin();
+    uint32_t linkMs = millis() - powerOn;
+    while (after.getStreamStats().firstAudioMs == 0 && millis() - powerOn < 30000) {
+        wifiAfter.handle();
+        after.process();
+    }
+    uint32_t firstAudioMs = after.getStreamStats().firstAudioMs - powerOn;
+    printf("\nresume:   50 volume steps -> %u NVS write(s); after power loss first audio %u ms (link %u ms, "
+           "open %u ms) at volume %.2f, %s\n",
+           stateSaves, firstAudioMs, linkMs, after.getStreamStats().lastOpenMs, after.getVolume(),
+           after.isPlaying() ? "playing" : "paused");
+    return 0;
+}
@@ -0,0 +1,539 @@
+/**
+ * Discovery packet parse benchmark for the host build.
+ *
+ * Times one received beacon through three parsers over a mix of device
+ * names and stations:
+ *
+ *   legacy     the old handleIncoming(): String copy, indexOf/substring
+ *   text       DiscoveryModule::parseBeacon() on the same text packets
+ *   binary     DiscoveryModule::parseBeacon() on v1 binary beacons
+ *
+ * plus encodeBeacon(). Heap allocations are counted by the firmware's
+ * operator new (HeapMonitor's per-module accounting). Note that std::string keeps up to 15 characters inline, so
+ * the legacy count is lower here than with Arduino's String.
+ *
+ * Peer table scaling, for 10 to 250 peers: a beacon from a known peer and
+ * the per-loop expiry check, against the old fixed array (linear scan with
+ * String compares, every slot checked each loop) grown to the same size.
+ * An expiry run with a short timeout checks that refreshed peers survive,
+ * the others go, and re-added peers are found again.
+ *
+ * Then --nodes DiscoveryModules talk over loopback multicast:
+ *
+ *   join       one more node starts: time until it and every peer know
+ *              each other (query on join)
+ *   change     one node starts playing: time until every peer sees it
+ *   group      two nodes join a group, node 0 sets the group's volume:
+ *              time until both acks are in
+ *   retry      a command to node 1 and a device that does not answer:
+ *              node 1 sees every retry but runs the command once
+ *   mdns       node 0 changes status every 100 ms for 5 s: TXT record
+ *              changes handed to the mDNS responder
+ *
+ *   ./bench_discovery [--packets N] [--iterations N] [--nodes N] [--verbose]
+ */
+
+#include "Arduino.h"
+#include "SimControl.h"
+#include "DiscoveryModule.h"
+#include "HeapMonitor.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+static size_t allocations() {
+    size_t total = 0;
+    for (int i = 0; i < HEAP_MODULES; i++) total += HeapMonitor::getModuleStats((HeapModule)i).allocs;
+    return total;
+}
+
+static const char* STATIONS[] = {
+    "", "Radio Paradise Main Mix", "BBC World Service", "Deutschlandfunk Kultur", "FIP Jazz",
+    "SomaFM Groove Salad (128k AAC)", "KEXP 90.3 Seattle", "Jazz24",
+};
+
+struct Packet {
+    std::vector<uint8_t> bytes;
+};
+
+struct Fields {
+    std::string name;
+    std::string ip;
+    bool playing;
+    std::string station;
+};
+
+// Verbatim parse from the text-only firmware
+static bool parseLegacy(const uint8_t* data, int len, Fields& out) {
+    char buffer[256];
+    memcpy(buffer, data, len);
+    buffer[len] = '\0';
+
+    String message = String(buffer);
+    if (!message.startsWith("GRIDBEACON|")) return false;
+
+    int idx1 = message.indexOf('|', 11);
+    int idx2 = message.indexOf('|', idx1 + 1);
+    int idx3 = message.indexOf('|', idx2 + 1);
+    if (idx1 < 0 || idx2 < 0 || idx3 < 0) return false;
+
+    String name = message.substring(11, idx1);
+    String ipStr = message.substring(idx1 + 1, idx2);
+    String status = message.substring(idx2 + 1, idx3);
+    String station = message.substring(idx3 + 1);
+
+    IPAddress ip;
+    if (!ip.fromString(ipStr)) return false;
+
+    out.name = name.c_str();
+    out.ip = ipStr.c_str();
+    out.playing = status == "playing";
+    out.station = station.c_str();
+    return true;
+}
+
+static Fields fieldsOf(const BeaconView& beacon) {
+    Fields f;
+    f.name.assign(beacon.name, beacon.nameLen);
+    char ip[16];
+    snprintf(ip, sizeof(ip), "%u.%u.%u.%u", beacon.ip[0], beacon.ip[1], beacon.ip[2], beacon.ip[3]);
+    f.ip = ip;
+    f.playing = beacon.flags & BEACON_FLAG_PLAYING;
+    f.station.assign(beacon.station ? beacon.station : "", beacon.stationLen);
+    return f;
+}
+
+static bool sameFields(const Fields& a, const Fields& b) {
+    return a.name == b.name && a.ip == b.ip && a.playing == b.playing && a.station == b.station;
+}
+
+template <typename F>
+static void run(const char* name, int iterations, const std::vector<Packet>& packets, F parse) {
+    size_t before = allocations();
+    uint32_t ok = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        const Packet& p = packets[i % packets.size()];
+        ok += parse(p.bytes.data(), (int)p.bytes.size());
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    printf("%-10s %10.1f %12.2f %10.1f%%\n", name, ns / iterations, (allocations() - before) / (double)iterations,
+           100.0 * ok / iterations);
+}
+
+// The table from the fixed-array firmware, slot count raised to n
+class LegacyTable {
+public:
+    struct Device {
+        String name;
+        IPAddress ip;
+        String status;
+        String station;
+        unsigned long lastSeen;
+        bool active;
+    };
+
+    LegacyTable(int n) : devices(n) {
+        for (auto& d : devices) d.active = false;
+    }
+
+    void updateDevice(String name, IPAddress ip, String status, String station) {
+        int emptySlot = -1;
+        for (int i = 0; i < (int)devices.size(); i++) {
+            if (devices[i].active && devices[i].name == name) {
+                devices[i].ip = ip;
+                devices[i].status = status;
+                devices[i].station = station;
+                devices[i].lastSeen = millis();
+                return;
+            }
+            if (!devices[i].active && emptySlot < 0) emptySlot = i;
+        }
+        if (emptySlot >= 0) {
+            devices[emptySlot].name = name;
+            devices[emptySlot].ip = ip;
+            devices[emptySlot].status = status;
+            devices[emptySlot].station = station;
+            devices[emptySlot].lastSeen = millis();
+            devices[emptySlot].active = true;
+        }
+    }
+
+    void cleanupStale() {
+        unsigned long now = millis();
+        for (auto& d : devices) {
+            if (d.active && now - d.lastSeen > DEVICE_TIMEOUT) d.active = false;
+        }
+    }
+
+private:
+    std::vector<Device> devices;
+};
+
+static std::vector<uint8_t> peerBeacon(int i, bool playing) {
+    String name = "Peer-" + String(i) + "-" + String(i * 7919 % 10007);
+    const char* station = STATIONS[i % (sizeof(STATIONS) / sizeof(STATIONS[0]))];
+    BeaconView beacon;
+    memset(&beacon, 0, sizeof(beacon));
+    beacon.deviceId = DiscoveryModule::deviceId(name.c_str(), name.length());
+    beacon.type = BEACON_ANNOUNCE;
+    beacon.flags = playing ? BEACON_FLAG_PLAYING : 0;
+    beacon.name = name.c_str();
+    beacon.nameLen = name.length();
+    beacon.station = station;
+    beacon.stationLen = strlen(station);
+    uint8_t ip[4] = { 10, 0, (uint8_t)(i >> 8), (uint8_t)i };
+    memcpy(beacon.ip, ip, 4);
+    beacon.hasIp = true;
+    uint8_t packet[DISCOVERY_PACKET_MAX];
+    int len = DiscoveryModule::encodeBeacon(beacon, packet, sizeof(packet));
+    return std::vector<uint8_t>(packet, packet + len);
+}
+
+template <typename F>
+static double nsPerCall(int iterations, F call) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) call(i);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / iterations;
+}
+
+static void peerTable(int iterations) {
+    printf("\n%-6s %14s %14s %14s %14s\n", "peers", "update ns", "old update ns", "expiry ns", "old cleanup ns");
+    const int sizes[] = { 10, 50, 100, 200, 250 };
+    for (int n : sizes) {
+        std::vector<std::vector<uint8_t>> packets;
+        std::vector<String> names, ips, stations;
+        for (int i = 0; i < n; i++) {
+            packets.push_back(peerBeacon(i, i % 2));
+            BeaconView view;
+            DiscoveryModule::parseBeacon(packets.back().data(), packets.back().size(), view);
+            String name, station;
+            name.concat(view.name, view.nameLen);
+            station.concat(view.station, view.stationLen);
+            names.push_back(name);
+            stations.push_back(station);
+        }
+
+        DiscoveryModule table;
+        LegacyTable legacy(n);
+        IPAddress from(10, 0, 0, 1);
+        for (int i = 0; i < n; i++) {
+            table.receive(packets[i].data(), packets[i].size(), from);
+            legacy.updateDevice(names[i], from, i % 2 ? "playing" : "paused", stations[i]);
+        }
+        if (table.getDeviceCount() != n) {
+            fprintf(stderr, "peer table holds %d of %d peers\n", table.getDeviceCount(), n);
+            exit(1);
+        }
+
+        double update = nsPerCall(iterations, [&](int i) {
+            const std::vector<uint8_t>& p = packets[i % n];
+            table.receive(p.data(), p.size(), from);
+        });
+        double oldUpdate = nsPerCall(iterations, [&](int i) {
+            int k = i % n;
+            legacy.updateDevice(names[k], from, k % 2 ? "playing" : "paused", stations[k]);
+        });
+        double expiry = nsPerCall(iterations, [&](int) { table.expireStale(); });
+        double oldCleanup = nsPerCall(iterations, [&](int) { legacy.cleanupStale(); });
+        printf("%-6d %14.1f %14.1f %14.1f %14.1f\n", n, update, oldUpdate, expiry, oldCleanup);
+    }
+
+    // Short timeout: even peers keep talking, odd ones fall silent
+    const int n = 200;
+    const uint32_t timeoutMs = 300;
+    DiscoveryModule table(DISCOVERY_MAX_PEERS, timeoutMs);
+    std::vector<std::vector<uint8_t>> packets;
+    for (int i = 0; i < n; i++) packets.push_back(peerBeacon(i, false));
+    IPAddress from(10, 0, 0, 1);
+    for (auto& p : packets) table.receive(p.data(), p.size(), from);
+
+    unsigned long start = millis();
+    while (millis() - start < timeoutMs * 2) {
+        for (int i = 0; i < n; i += 2) table.receive(packets[i].data(), packets[i].size(), from);
+        table.expireStale();
+        delay(5);
+    }
+    int kept = table.getDeviceCount();
+    uint32_t expired = table.getStats().expired;
+
+    // Everyone again: survivors must be found, not added twice
+    for (auto& p : packets) table.receive(p.data(), p.size(), from);
+    int rejoined = table.getDeviceCount();
+    printf("expiry:  %d peers, %u expired after %u ms silence, %d kept, %d after all rejoin\n", n, expired,
+           timeoutMs, kept, rejoined);
+    if (kept != n / 2 || (int)expired != n / 2 || rejoined != n) {
+        fprintf(stderr, "peer table expiry is wrong\n");
+        exit(1);
+    }
+}
+
+static bool knows(DiscoveryModule& node, const String& name, bool playing) {
+    GridBeaconDevice* devices = node.getDevices();
+    for (int i = 0; i < node.getDeviceCount(); i++) {
+        if (devices[i].name == name) {
+            return !playing || devices[i].status == "playing";
+        }
+    }
+    return false;
+}
+
+// Runs every node's handle() until done() or the timeout; returns elapsed ms
+static uint32_t converge(std::vector<std::unique_ptr<DiscoveryModule>>& nodes, const std::function<bool()>& done,
+                         uint32_t timeoutMs) {
+    unsigned long start = millis();
+    while (!done() && millis() - start < timeoutMs) {
+        for (auto& node : nodes) node->handle();
+        delay(1);
+    }
+    return millis() - start;
+}
+
+static uint32_t packetsSent(std::vector<std::unique_ptr<DiscoveryModule>>& nodes) {
+    uint32_t sent = 0;
+    for (auto& node : nodes) sent += node->getStats().sent;
+    return sent;
+}
+
+int main(int argc, char** argv) {
+    int packetCount = 64;
+    int iterations = 1000000;
+    int nodeCount = 4;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--packets" && i + 1 < argc) packetCount = atoi(argv[++i]);
+        else if (a == "--iterations" && i + 1 < argc) iterations = atoi(argv[++i]);
+        else if (a == "--nodes" && i + 1 < argc) nodeCount = atoi(argv[++i]);
+        else if (a == "--verbose") verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--packets N] [--iterations N] [--nodes N] [--verbose]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (packetCount < 1) packetCount = 1;
+    if (nodeCount < 2) nodeCount = 2;
+    if (nodeCount > 32) nodeCount = 32;
+    sim::setSerialEnabled(verbose);
+
+    // The same devices in both formats
+    std::vector<Packet> textPackets(packetCount);
+    std::vector<Packet> binaryPackets(packetCount);
+    std::vector<Fields> expected(packetCount);
+    for (int i = 0; i < packetCount; i++) {
+        std::string name = (i % 3 == 0) ? "GridBeacon-" + std::to_string(1000 + i * 37 % 9000)
+                                        : "Room " + std::to_string(i) + (i % 2 ? " Kitchen" : " Living Room");
+        const char* station = STATIONS[i % (sizeof(STATIONS) / sizeof(STATIONS[0]))];
+        uint8_t ip[4] = { 192, 168, (uint8_t)(i / 200), (uint8_t)(10 + i % 200) };
+        bool playing = i % 2;
+
+        char text[DISCOVERY_PACKET_MAX];
+        int len = snprintf(text, sizeof(text), "GRIDBEACON|%s|%u.%u.%u.%u|%s|%s", name.c_str(), ip[0], ip[1], ip[2],
+                           ip[3], playing ? "playing" : "paused", station);
+        textPackets[i].bytes.assign(text, text + len);
+
+        BeaconView beacon;
+        memset(&beacon, 0, sizeof(beacon));
+        beacon.deviceId = DiscoveryModule::deviceId(name.c_str(), name.size());
+        beacon.type = BEACON_ANNOUNCE;
+        beacon.flags = playing ? BEACON_FLAG_PLAYING : 0;
+        beacon.name = name.c_str();
+        beacon.nameLen = name.size();
+        beacon.station = station;
+        beacon.stationLen = strlen(station);
+        memcpy(beacon.ip, ip, 4);
+        beacon.hasIp = true;
+        uint8_t packet[DISCOVERY_PACKET_MAX];
+        len = DiscoveryModule::encodeBeacon(beacon, packet, sizeof(packet));
+        binaryPackets[i].bytes.assign(packet, packet + len);
+
+        expected[i] = fieldsOf(beacon);
+    }
+
+    // All three parsers must agree before any timing
+    size_t textBytes = 0, binaryBytes = 0;
+    for (int i = 0; i < packetCount; i++) {
+        Fields legacy;
+        BeaconView text, binary;
+        if (!parseLegacy(textPackets[i].bytes.data(), textPackets[i].bytes.size(), legacy) ||
+            !DiscoveryModule::parseBeacon(textPackets[i].bytes.data(), textPackets[i].bytes.size(), text) ||
+            !DiscoveryModule::parseBeacon(binaryPackets[i].bytes.data(), binaryPackets[i].bytes.size(), binary) ||
+            !sameFields(legacy, expected[i]) || !sameFields(fieldsOf(text), expected[i]) ||
+            !sameFields(fieldsOf(binary), expected[i]) || text.deviceId != binary.deviceId || binary.text) {
+            fprintf(stderr, "packet %d: parsers disagree\n", i);
+            return 1;
+        }
+        textBytes += textPackets[i].bytes.size();
+        binaryBytes += binaryPackets[i].bytes.size();
+    }
+
+    printf("GridBeacon discovery bench: %d packets, %d iterations\n", packetCount, iterations);
+    printf("mean size: text %.1f bytes, binary %.1f bytes\n\n", textBytes / (double)packetCount,
+           binaryBytes / (double)packetCount);
+    printf("%-10s %10s %12s %11s\n", "parser", "ns/packet", "allocs/packet", "accepted");
+
+    run("legacy", iterations, textPackets, [](const uint8_t* data, int len) {
+        Fields f;
+        return parseLegacy(data, len, f);
+    });
+    run("text", iterations, textPackets, [](const uint8_t* data, int len) {
+        BeaconView beacon;
+        return DiscoveryModule::parseBeacon(data, len, beacon);
+    });
+    run("binary", iterations, binaryPackets, [](const uint8_t* data, int len) {
+        BeaconView beacon;
+        return DiscoveryModule::parseBeacon(data, len, beacon);
+    });
+
+    // Encoding, from a parsed view as broadcast() does
+    std::vector<BeaconView> views(packetCount);
+    for (int i = 0; i < packetCount; i++) {
+        DiscoveryModule::parseBeacon(binaryPackets[i].bytes.data(), binaryPackets[i].bytes.size(), views[i]);
+    }
+    size_t before = allocations();
+    size_t written = 0;
+    uint8_t out[DISCOVERY_PACKET_MAX];
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        written += DiscoveryModule::encodeBeacon(views[i % packetCount], out, sizeof(out));
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    printf("%-10s %10.1f %12.2f %11s\n", "encode", ns / iterations, (allocations() - before) / (double)iterations,
+           written > 0 ? "" : "-");
+
+    peerTable(iterations / 10);
+
+    // Live nodes: all but the last are up and settled
+    std::vector<std::unique_ptr<DiscoveryModule>> nodes;
+    std::vector<String> names;
+    for (int i = 0; i < nodeCount; i++) names.push_back("Node-" + String(i));
+    for (int i = 0; i < nodeCount - 1; i++) {
+        nodes.emplace_back(new DiscoveryModule());
+        nodes.back()->begin(names[i].c_str());
+    }
+    converge(nodes, [] { return false; }, 1000);
+
+    uint32_t sentBefore = packetsSent(nodes);
+    nodes.emplace_back(new DiscoveryModule());
+    nodes.back()->begin(names[nodeCount - 1].c_str());
+    uint32_t joinMs = converge(nodes, [&] {
+        for (int i = 0; i < nodeCount - 1; i++) {
+            if (!knows(*nodes.back(), names[i], false) || !knows(*nodes[i], names[nodeCount - 1], false)) return false;
+        }
+        return true;
+    }, 120000);
+    uint32_t joinPackets = packetsSent(nodes) - sentBefore;
+
+    sentBefore = packetsSent(nodes);
+    nodes[0]->setStatus(true, "Jazz24");
+    uint32_t changeMs = converge(nodes, [&] {
+        for (int i = 1; i < nodeCount; i++) {
+            if (!knows(*nodes[i], names[0], true)) return false;
+        }
+        return true;
+    }, 120000);
+    uint32_t changePackets = packetsSent(nodes) - sentBefore;
+
+    // Unchanged status every loop() must not announce anything
+    sentBefore = packetsSent(nodes);
+    for (int i = 0; i < 1000; i++) nodes[0]->setStatus(true, "Jazz24");
+    converge(nodes, [] { return false; }, 500);
+    uint32_t repeatPackets = packetsSent(nodes) - sentBefore;
+
+    // Group control; every node counts what its handler ran. Station
+    // changes are accepted and left open, as a stream open would be
+    std::vector<int> runs(nodeCount, 0);
+    std::vector<CommandTicket> queued(nodeCount);
+    for (int i = 0; i < nodeCount; i++) {
+        nodes[i]->onCommand([&runs, &queued, i](const GroupCommand& command, const CommandTicket& ticket) -> uint8_t {
+            runs[i]++;
+            if (command.op != CMD_STATION) return CMD_OK;
+            queued[i] = ticket;
+            return CMD_ACCEPTED;
+        });
+    }
+    nodes[1]->setGroup("Kitchen");
+    nodes[nodeCount - 1]->setGroup("Kitchen");
+    converge(nodes, [&] {
+        const GridBeaconDevice* a = nodes[0]->findPeer(nodes[1]->getDeviceId());
+        const GridBeaconDevice* b = nodes[0]->findPeer(nodes[nodeCount - 1]->getDeviceId());
+        return a && b && a->group == "Kitchen" && b->group == "Kitchen";
+    }, 120000);
+    
+    GroupCommand volume = { CMD_VOLUME, 400, nullptr, 0 };
+    sentBefore = packetsSent(nodes);
+    uint32_t groupSeq = nodes[0]->sendCommand(volume, String("Kitchen"));
+    uint32_t groupMs = converge(nodes, [&] { return nodes[0]->getCommandStatus(groupSeq)->done; }, 5000);
+    uint32_t groupPackets = packetsSent(nodes) - sentBefore;
+    const CommandStatus* groupStatus = nodes[0]->getCommandStatus(groupSeq);
+    int groupOk = 0;
+    for (int i = 0; i < (int)groupStatus->results.size(); i++) groupOk += groupStatus->results[i] == CMD_OK;
+    int groupRuns = 0;
+    for (int i = 0; i < nodeCount; i++) groupRuns += runs[i];
+    
+    std::vector<uint32_t> targets = { nodes[1]->getDeviceId(), 0x12345678 };
+    int runsBefore = runs[1];
+    uint32_t retrySeq = nodes[0]->sendCommand(volume, targets);
+    uint32_t retryMs = converge(nodes, [&] { return nodes[0]->getCommandStatus(retrySeq)->done; }, 5000);
+    const CommandStatus* retryStatus = nodes[0]->getCommandStatus(retrySeq);
+    int retryRuns = runs[1] - runsBefore;
+    
+    // A station change that takes 3 s: acked on receipt, the result follows
+    GroupCommand station = { CMD_STATION, 0, "http://127.0.0.1/stream0.mp3", 28 };
+    std::vector<uint32_t> one = { nodes[1]->getDeviceId() };
+    uint32_t stationSeq = nodes[0]->sendCommand(station, one);
+    uint32_t acceptMs = converge(nodes, [&] {
+        return nodes[0]->getCommandStatus(stationSeq)->results[0] == CMD_ACCEPTED;
+    }, 5000);
+    converge(nodes, [] { return false; }, 3000 - acceptMs);
+    bool stillWaiting = !nodes[0]->getCommandStatus(stationSeq)->done;
+    nodes[1]->completeCommand(queued[1], true);
+    uint32_t completeMs = 3000 + converge(nodes, [&] { return nodes[0]->getCommandStatus(stationSeq)->done; }, 5000);
+    const CommandStatus* stationStatus = nodes[0]->getCommandStatus(stationSeq);
+    
+    // Status flapping reaches mDNS as a few TXT updates
+    uint32_t announcedBefore = MDNS.announcements();
+    for (int i = 0; i < 50; i++) {
+        nodes[0]->setStatus(i % 2 == 0, i % 2 == 0 ? "Jazz24" : "KEXP");
+        converge(nodes, [] { return false; }, 100);
+    }
+    converge(nodes, [] { return false; }, MDNS_TXT_INTERVAL + 100);
+    uint32_t txtUpdates = MDNS.announcements() - announcedBefore;
+    String flapStation = MDNS.txt("gridbeacon", "udp", "station");
+    
+    // A station change alone, play state as it was, is published too
+    nodes[0]->setStatus(false, "http://127.0.0.1/stream1.mp3");
+    converge(nodes, [] { return false; }, MDNS_TXT_INTERVAL + 100);
+    String newStation = MDNS.txt("gridbeacon", "udp", "station");
+    
+    printf("\n%d nodes over loopback multicast\n", nodeCount);
+    printf("join:      %u ms until all know each other, %u packets\n", joinMs, joinPackets);
+    printf("change:    %u ms until all peers see it, %u packets\n", changeMs, changePackets);
+    printf("unchanged: 1000 setStatus() calls, %u packets\n", repeatPackets);
+    printf("group:     %u ms until %d of %d acked, %u packets, run on %d node(s)\n", groupMs, groupOk,
+           (int)groupStatus->targets.size(), groupPackets, groupRuns);
+    printf("retry:     %u ms, %u sends, node 1 %s and ran it %d time(s), %u duplicate(s) answered\n", retryMs,
+           retryStatus->tries, retryStatus->results[0] == CMD_OK ? "acked" : "silent", retryRuns,
+           nodes[1]->getStats().duplicates);
+    printf("accepted:  station change acked in %u ms, %s at %u ms after %u sends\n", acceptMs,
+           stationStatus->results[0] == CMD_OK ? "ok" : "no result", completeMs, stationStatus->tries);
+    printf("mdns:      50 status changes in 5 s -> %u TXT update(s), now status=%s station=%s\n", txtUpdates,
+           MDNS.txt("gridbeacon", "udp", "status").c_str(), flapStation.c_str());
+    printf("           station change alone -> station=%s\n", newStation.c_str());
+    if (groupOk != 2 || groupRuns != 2 || retryRuns != 1 || !stillWaiting ||
+        stationStatus->results[0] != CMD_OK) {
+        fprintf(stderr, "group command went wrong\n");
+        return 1;
+    }
+    if (flapStation != "KEXP" || newStation != "http://127.0.0.1/stream1.mp3") {
+        fprintf(stderr, "mDNS TXT station went stale\n");
+        return 1;
+    }
+    return 0;
+}
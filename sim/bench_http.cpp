@@ -0,0 +1,267 @@
+/**
+ * HTTP load benchmark for the host build.
+ *
+ * Runs the real sketch (setup()/loop()) on the main thread, exactly like the
+ * device, while client threads hammer the web routes. Reports per-route
+ * latency percentiles, the simulated audio pipeline's underruns, what
+ * each scheduler task cost and what each module left on the heap.
+ *
+ *   ./bench_http [--clients N] [--seconds S] [--decode-us US] [--buffer-ms MS] [--verbose]
+ */
+
+#include "Arduino.h"
+#include "Preferences.h"
+#include "SimControl.h"
+#include "AudioModule.h"
+#include "BootTrace.h"
+#include "Scheduler.h"
+#include "HeapMonitor.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+void setup();
+void loop();
+extern AudioModule* audio;
+extern BootTrace boot;
+extern Scheduler scheduler;
+
+struct Route {
+    const char* name;
+    const char* method;
+    const char* path;
+    const char* contentType;
+    const char* body;
+    int weight;
+};
+
+static const Route ROUTES[] = {
+    { "GET /player",        "GET",  "/player",        nullptr, nullptr, 4 },
+    { "GET /library/get",   "GET",  "/library/get",   nullptr, nullptr, 3 },
+    { "GET /settings",      "GET",  "/settings",      nullptr, nullptr, 1 },
+    { "GET /metrics",       "GET",  "/metrics",       nullptr, nullptr, 1 },
+    { "GET /heap",          "GET",  "/heap",          nullptr, nullptr, 1 },
+    { "POST /volume",       "POST", "/volume",        "application/x-www-form-urlencoded", "value=%d", 6 },
+    { "POST /api/v1/batch", "POST", "/api/v1/batch",  "text/plain", "volume=%d\nplay", 2 },
+};
+static const int ROUTE_COUNT = sizeof(ROUTES) / sizeof(ROUTES[0]);
+
+struct Sample {
+    int route;
+    uint32_t latencyUs;
+    int status;
+};
+
+static std::atomic<bool> running(true);
+
+static int httpRequest(uint16_t port, const Route& route, int value) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    struct timeval tv = { 10, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    char body[128] = "";
+    if (route.body) snprintf(body, sizeof(body), route.body, value);
+
+    std::string request = std::string(route.method) + " " + route.path + " HTTP/1.1\r\nHost: gridbeacon\r\n";
+    if (route.contentType) {
+        request += "Content-Type: " + std::string(route.contentType) + "\r\n";
+        request += "Content-Length: " + std::to_string(strlen(body)) + "\r\n";
+    }
+    request += "Connection: close\r\n\r\n";
+    request += body;
+    send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+    // Read until the server closes; the status code is all we keep
+    char buf[4096];
+    std::string head;
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        if (head.size() < 16) head.append(buf, n);
+    }
+    close(fd);
+
+    if (head.compare(0, 5, "HTTP/") != 0 || head.size() < 12) return -1;
+    return atoi(head.c_str() + 9);
+}
+
+static void clientThread(uint16_t port, unsigned seed, std::vector<Sample>* out) {
+    int totalWeight = 0;
+    for (int i = 0; i < ROUTE_COUNT; i++) totalWeight += ROUTES[i].weight;
+
+    while (running) {
+        int pick = rand_r(&seed) % totalWeight;
+        int route = 0;
+        while (pick >= ROUTES[route].weight) pick -= ROUTES[route++].weight;
+
+        auto start = std::chrono::steady_clock::now();
+        int status = httpRequest(port, ROUTES[route], rand_r(&seed) % 101);
+        auto end = std::chrono::steady_clock::now();
+
+        out->push_back({ route, (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), status });
+    }
+}
+
+static uint32_t percentile(std::vector<uint32_t>& values, double p) {
+    if (values.empty()) return 0;
+    size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static void seedStorage() {
+    Preferences prefs;
+
+    prefs.begin("wifi", false);
+    prefs.putInt("count", 1);
+    prefs.putString("ssid0", "SimNet");
+    prefs.putString("pass0", "simpassword");
+    prefs.end();
+
+    prefs.begin("library", false);
+    prefs.putInt("count", 8);
+    for (int i = 0; i < 8; i++) {
+        prefs.putString(("name" + String(i)).c_str(), "Sim Station " + String(i));
+        prefs.putString(("url" + String(i)).c_str(), "http://127.0.0.1/stream" + String(i) + ".mp3");
+    }
+    prefs.end();
+
+    prefs.begin("discovery", false);
+    prefs.putString("name", "BenchBeacon");
+    prefs.end();
+}
+
+int main(int argc, char** argv) {
+    int clients = 4;
+    int seconds = 10;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--clients" && i + 1 < argc) clients = atoi(argv[++i]);
+        else if (a == "--seconds" && i + 1 < argc) seconds = atoi(argv[++i]);
+        else if (a == "--decode-us" && i + 1 < argc) sim::setDecodeCostUs(atoi(argv[++i]));
+        else if (a == "--buffer-ms" && i + 1 < argc) sim::setOutputBufferMs(atoi(argv[++i]));
+        else if (a == "--verbose") verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--clients N] [--seconds S] [--decode-us US] [--buffer-ms MS] [--verbose]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    sim::setSerialEnabled(verbose);
+    sim::setHttpPort(0);
+    seedStorage();
+
+    setup();
+
+    uint16_t port = sim::boundHttpPort();
+    if (port == 0) {
+        fprintf(stderr, "web server did not start\n");
+        return 1;
+    }
+    if (!audio) {
+        fprintf(stderr, "audio did not start\n");
+        return 1;
+    }
+
+    // Play for the whole run so every loop() stall is audible
+    audio->setURL("http://127.0.0.1/stream0.mp3");
+    audio->play();
+    for (int i = 0; i < 20; i++) loop();
+    sim::resetAudioStats();
+
+    printf("GridBeacon HTTP bench: %d clients, %d s, port %u\n", clients, seconds, port);
+    printf("boot: setup() done at %u ms (%s), first audio at %u ms:", boot.getReadyMs(),
+           boot.isFastBoot() ? "fast boot" : "serial wait", boot.getFirstAudioMs());
+    for (int i = 0; i < boot.getCount(); i++) {
+        const BootPhase& phase = boot.getPhases()[i];
+        printf(" %s %u", phase.name, phase.endMs - phase.startMs);
+    }
+    printf("\n");
+
+    std::vector<std::vector<Sample>> samples(clients);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; i++) {
+        threads.emplace_back(clientThread, port, 1000u + i, &samples[i]);
+    }
+
+    unsigned long end = millis() + seconds * 1000UL;
+    unsigned long loops = 0;
+    while (millis() < end) {
+        loop();
+        loops++;
+    }
+
+    running = false;
+    // Keep serving so in-flight requests finish
+    for (int i = 0; i < 200; i++) loop();
+    for (auto& t : threads) t.join();
+
+    printf("\n%-22s %8s %7s %9s %9s %9s %9s\n", "route", "requests", "errors", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    size_t total = 0;
+    std::vector<uint32_t> all;
+    for (int r = 0; r < ROUTE_COUNT; r++) {
+        std::vector<uint32_t> latencies;
+        int errors = 0;
+        for (const auto& list : samples) {
+            for (const auto& s : list) {
+                if (s.route != r) continue;
+                latencies.push_back(s.latencyUs);
+                if (s.status < 200 || s.status >= 400) errors++;
+            }
+        }
+        total += latencies.size();
+        all.insert(all.end(), latencies.begin(), latencies.end());
+        printf("%-22s %8zu %7d %9.2f %9.2f %9.2f %9.2f\n", ROUTES[r].name, latencies.size(), errors,
+               percentile(latencies, 0.50) / 1000.0, percentile(latencies, 0.90) / 1000.0,
+               percentile(latencies, 0.99) / 1000.0, percentile(latencies, 1.0) / 1000.0);
+    }
+    printf("%-22s %8zu %7s %9.2f %9.2f %9.2f %9.2f\n", "all", total, "",
+           percentile(all, 0.50) / 1000.0, percentile(all, 0.90) / 1000.0,
+           percentile(all, 0.99) / 1000.0, percentile(all, 1.0) / 1000.0);
+    printf("\nthroughput: %.1f req/s, loop(): %.1f iterations/s\n", total / (double)seconds, loops / (double)seconds);
+
+    sim::AudioStats stats = sim::audioStats();
+    printf("audio: %llu frames, %u underruns, %.1f ms starved, longest copy() gap %.2f ms\n",
+           (unsigned long long)stats.frames, stats.underruns, stats.starvedUs / 1000.0, stats.maxGapUs / 1000.0);
+
+    printf("\n%-10s %8s %9s %9s %9s %9s %9s\n", "task", "runs", "overruns", "deferred", "mean us", "max us",
+           "budget us");
+    for (int i = 0; i < scheduler.getCount(); i++) {
+        const TaskStats& t = scheduler.getTasks()[i];
+        printf("%-10s %8u %9u %9u %9.1f %9u %9u\n", t.name, t.runs, t.overruns, t.deferrals,
+               t.runs ? t.totalUs / (double)t.runs : 0.0, t.maxUs, t.budgetUs);
+    }
+    printf("longest pass %.2f ms over %u passes\n", scheduler.getMaxPassUs() / 1000.0, scheduler.getPasses());
+
+    printf("\n%-10s %9s %9s %11s %11s\n", "heap", "allocs", "live", "live bytes", "peak bytes");
+    for (int i = 0; i < HEAP_MODULES; i++) {
+        HeapModuleStats m = HeapMonitor::getModuleStats((HeapModule)i);
+        printf("%-10s %9u %9u %11u %11u\n", HeapMonitor::moduleName((HeapModule)i), m.allocs, m.allocs - m.frees,
+               m.liveBytes, m.peakBytes);
+    }
+    return 0;
+}
@@ -0,0 +1,209 @@
+/**
+ * Discovery mesh simulator for the host build.
+ *
+ * Runs --nodes DiscoveryModules in one process over loopback multicast,
+ * each with its own socket, round-robin like separate loop()s. The clock
+ * runs --scale times faster than real time so keepalives and the two-minute
+ * peer timeout fit in a short run. Every socket drops --loss percent of
+ * what it receives.
+ *
+ *   join       nodes start --stagger-ms apart: time from the last start
+ *              until every node knows every other
+ *   steady     --steady-s with nobody joining or leaving: packets per
+ *              second, peers wrongly expired, views still complete
+ *   churn      --churn nodes lose power and as many new ones start: time
+ *              until the joins are known everywhere, and until the
+ *              departed have expired everywhere
+ *
+ * Times are simulated. CPU is host time spent in each node's handle()
+ * per simulated second; only relative numbers mean much on an x86 host.
+ *
+ *   ./bench_mesh [--nodes N] [--loss PCT] [--churn N] [--steady-s S] [--stagger-ms MS] [--scale F] [--verbose]
+ */
+
+#include "Arduino.h"
+#include "SimControl.h"
+#include "DiscoveryModule.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Node {
+    std::unique_ptr<DiscoveryModule> module;
+    String name;
+    uint32_t id;
+    uint64_t cpuNs;     // inside handle()
+    uint64_t calls;
+};
+
+static std::vector<Node> nodes;
+static std::vector<uint32_t> departed;
+static int nextName = 0;
+
+static void startNode() {
+    nodes.emplace_back();
+    Node& node = nodes.back();
+    node.name = "Beacon-" + String(nextName++);
+    node.module.reset(new DiscoveryModule());
+    node.module->begin(node.name.c_str());
+    node.id = node.module->getDeviceId();
+    node.cpuNs = 0;
+    node.calls = 0;
+}
+
+// One pass over every node, then a 1 ms loop() tick
+static void tick() {
+    for (Node& node : nodes) {
+        auto t0 = std::chrono::steady_clock::now();
+        node.module->handle();
+        node.cpuNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+        node.calls++;
+    }
+    delay(1);
+}
+
+static bool joinsKnown() {
+    for (Node& node : nodes) {
+        for (Node& other : nodes) {
+            if (&other != &node && !node.module->findPeer(other.id)) return false;
+        }
+    }
+    return true;
+}
+
+static bool leavesGone() {
+    for (Node& node : nodes) {
+        for (uint32_t id : departed) {
+            if (node.module->findPeer(id)) return false;
+        }
+    }
+    return true;
+}
+
+// Runs tick() until done() or the timeout; returns elapsed ms
+static uint32_t runUntil(const std::function<bool()>& done, uint32_t timeoutMs) {
+    unsigned long start = millis();
+    while (!done() && millis() - start < timeoutMs) tick();
+    return millis() - start;
+}
+
+static uint32_t expiredTotal() {
+    uint32_t expired = 0;
+    for (Node& node : nodes) expired += node.module->getStats().expired;
+    return expired;
+}
+
+static void reportCpu(const char* phase, uint32_t simMs) {
+    double seconds = simMs / 1000.0;
+    double worst = 0;
+    uint64_t ns = 0;
+    uint64_t calls = 0;
+    for (Node& node : nodes) {
+        worst = std::max(worst, node.cpuNs / 1000.0 / seconds);
+        ns += node.cpuNs;
+        calls += node.calls;
+    }
+    printf("%-8s cpu per node: mean %.1f us/s, max %.1f us/s (%.0f handle() calls/s, %.2f us each)\n", phase,
+           ns / 1000.0 / nodes.size() / seconds, worst, calls / (double)nodes.size() / seconds,
+           calls ? ns / 1000.0 / calls : 0.0);
+}
+
+static void resetCpu() {
+    for (Node& node : nodes) {
+        node.cpuNs = 0;
+        node.calls = 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    int nodeCount = 50;
+    double lossPct = 0;
+    int churn = 5;
+    uint32_t steadyS = 300;
+    uint32_t staggerMs = 100;
+    uint32_t scale = 20;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--nodes" && i + 1 < argc) nodeCount = atoi(argv[++i]);
+        else if (a == "--loss" && i + 1 < argc) lossPct = atof(argv[++i]);
+        else if (a == "--churn" && i + 1 < argc) churn = atoi(argv[++i]);
+        else if (a == "--steady-s" && i + 1 < argc) steadyS = atoi(argv[++i]);
+        else if (a == "--stagger-ms" && i + 1 < argc) staggerMs = atoi(argv[++i]);
+        else if (a == "--scale" && i + 1 < argc) scale = atoi(argv[++i]);
+        else if (a == "--verbose") verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--nodes N] [--loss PCT] [--churn N] [--steady-s S] [--stagger-ms MS] [--scale F] "
+                            "[--verbose]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (nodeCount < 2 || churn >= nodeCount) {
+        fprintf(stderr, "need at least 2 nodes and fewer churned nodes than nodes\n");
+        return 1;
+    }
+
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    sim::setSerialEnabled(verbose);
+    sim::nvsClear();
+    sim::setTimeScale(scale);
+    sim::setUdpLoss(lossPct / 100.0);
+
+    printf("GridBeacon discovery mesh: %d nodes, %.1f%% loss, clock x%u, peer timeout %u s\n\n", nodeCount, lossPct,
+           scale, DEVICE_TIMEOUT / 1000);
+
+    // Join: staggered power-on
+    sim::resetUdpStats();
+    nodes.reserve(nodeCount + churn);
+    for (int i = 0; i < nodeCount; i++) {
+        startNode();
+        unsigned long wait = millis();
+        while (i < nodeCount - 1 && millis() - wait < staggerMs) tick();
+    }
+    uint32_t joinMs = runUntil(joinsKnown, 600000);
+    sim::UdpStats udp = sim::udpStats();
+    printf("join:    %s %u ms after the last start, %llu packets sent, %llu delivered, %llu dropped\n",
+           joinsKnown() ? "converged" : "NOT converged", joinMs, (unsigned long long)udp.sent,
+           (unsigned long long)udp.delivered, (unsigned long long)udp.dropped);
+
+    // Steady state: only keepalives, nobody should expire
+    sim::resetUdpStats();
+    resetCpu();
+    uint32_t expiredBefore = expiredTotal();
+    unsigned long steadyStart = millis();
+    while (millis() - steadyStart < steadyS * 1000) tick();
+    uint32_t steadyMs = millis() - steadyStart;
+    udp = sim::udpStats();
+    printf("steady:  %u s, %.2f packets/s (%.3f per node), %u peers wrongly expired, views %s\n", steadyMs / 1000,
+           udp.sent / (steadyMs / 1000.0), udp.sent / (steadyMs / 1000.0) / nodes.size(), expiredTotal() - expiredBefore,
+           joinsKnown() ? "complete" : "INCOMPLETE");
+    reportCpu("steady:", steadyMs);
+
+    // Churn: silent leaves (power cut) and fresh joins at the same moment
+    sim::resetUdpStats();
+    resetCpu();
+    for (int i = 0; i < churn; i++) {
+        int victim = random(0, nodes.size());
+        departed.push_back(nodes[victim].id);
+        nodes.erase(nodes.begin() + victim);
+    }
+    for (int i = 0; i < churn; i++) startNode();
+    unsigned long churnStart = millis();
+    uint32_t joinsMs = runUntil(joinsKnown, 600000);
+    runUntil(leavesGone, 600000);
+    uint32_t churnMs = millis() - churnStart;
+    udp = sim::udpStats();
+    printf("churn:   %d left, %d joined: joins known after %u ms, leaves expired after %u ms, %s, %llu packets\n", churn,
+           churn, joinsMs, churnMs, joinsKnown() && leavesGone() ? "converged" : "NOT converged",
+           (unsigned long long)udp.sent);
+    reportCpu("churn:", churnMs);
+
+    if (!joinsKnown() || !leavesGone()) return 1;
+    return 0;
+}
@@ -0,0 +1,377 @@
+/**
+ * Pull OTA benchmark for the host build.
+ *
+ * A local HTTP stand-in serves a manifest and a firmware image (gzip or
+ * plain) with Range support, at --kbps, closing every connection after
+ * --drop-kb of body to play a flaky link. OTAModule pulls it the way the
+ * device does, a chunk per handle(); the installed image is compared with
+ * the original.
+ *
+ *   clean      gzip, no drops
+ *   flaky      gzip, connection dropped every --drop-kb: Range resumes
+ *   no-range   the server ignores Range (200 from the start) and drops
+ *              one connection
+ *   plain      uncompressed image, flaky
+ *   bad-hash   manifest hash wrong: must fail and leave the boot image alone
+ *   no-length  manifest sent without Content-Length
+ *   huge       the same, padded past OTA_MANIFEST_MAX: must fail unread
+ *
+ * Then the same gzip download while a stream plays, with every 4 KB flash
+ * sector costing --sector-ms:
+ *
+ *   unmanaged   OTAModule does not know about audio (the old behaviour)
+ *   graceful    audio fades out and frees its pipeline for the download
+ *   background  audio keeps playing, the download is throttled
+ *
+ * The clock runs --scale times faster (resume delays); times are simulated.
+ *
+ *   ./bench_ota [--image-kb N] [--kbps N] [--drop-kb N] [--sector-ms N] [--scale F] [--verbose]
+ */
+
+#include "Arduino.h"
+#include "SimControl.h"
+#include "OTAModule.h"
+#include "AudioModule.h"
+
+#include <arpa/inet.h>
+#include <malloc.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Server {
+    int fd;
+    uint16_t port;
+    std::vector<uint8_t> gz;
+    std::vector<uint8_t> plain;
+    std::string manifest;
+    uint32_t kbps;
+    uint32_t dropBytes;     // 0 = never
+    int drops;              // connections still to cut, -1 = every one
+    bool ignoreRange;
+    bool manifestNoLength;  // body ends with the connection
+    std::atomic<uint32_t> requests;
+};
+
+static Server server;
+
+// Something like a firmware image: code-ish repeats with noise, and a
+// zero-filled table every 256 KB that inflates a thousandfold
+static std::vector<uint8_t> makeImage(size_t size, uint32_t seed) {
+    std::vector<uint8_t> image(size);
+    uint32_t x = seed;
+    for (size_t i = 0; i < size; i++) {
+        x = x * 1103515245 + 12345;
+        if (i % (256 * 1024) >= 192 * 1024 && i % (256 * 1024) < 224 * 1024) image[i] = 0;
+        else image[i] = (i % 64) < 40 ? (uint8_t)((i * 7) ^ (i >> 6)) : (uint8_t)(x >> 16);
+    }
+    return image;
+}
+
+static std::vector<uint8_t> gzipOf(const std::vector<uint8_t>& data) {
+    z_stream z = {};
+    deflateInit2(&z, 9, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY);
+    std::vector<uint8_t> out(deflateBound(&z, data.size()) + 32);
+    z.next_in = (Bytef*)data.data();
+    z.avail_in = data.size();
+    z.next_out = out.data();
+    z.avail_out = out.size();
+    deflate(&z, Z_FINISH);
+    out.resize(z.total_out);
+    deflateEnd(&z);
+    return out;
+}
+
+static std::string sha256Hex(const std::vector<uint8_t>& data) {
+    mbedtls_sha256_context ctx;
+    uint8_t digest[32];
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    mbedtls_sha256_update(&ctx, data.data(), data.size());
+    mbedtls_sha256_finish(&ctx, digest);
+    char hex[65];
+    for (int i = 0; i < 32; i++) snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    return hex;
+}
+
+static void sendAll(int fd, const void* data, size_t len) {
+    const char* p = (const char*)data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        p += n;
+        len -= n;
+    }
+}
+
+// One connection at a time is all the device ever opens
+static void serve() {
+    while (true) {
+        int client = accept(server.fd, nullptr, nullptr);
+        if (client < 0) return;
+        server.requests++;
+
+        std::string request;
+        char buf[1024];
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = recv(client, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            request.append(buf, n);
+        }
+        std::string path = request.substr(4, request.find(' ', 4) - 4);
+        size_t from = 0;
+        size_t range = request.find("Range: bytes=");
+        bool partial = range != std::string::npos && !server.ignoreRange;
+        if (partial) from = strtoul(request.c_str() + range + 13, nullptr, 10);
+
+        const std::vector<uint8_t>* body = nullptr;
+        if (path == "/fw/gridbeacon.bin.gz") body = &server.gz;
+        else if (path == "/fw/gridbeacon.bin") body = &server.plain;
+
+        std::string head;
+        if (path == "/fw/manifest.txt") {
+            head = "HTTP/1.1 200 OK\r\n";
+            if (!server.manifestNoLength) head += "Content-Length: " + std::to_string(server.manifest.size()) + "\r\n";
+            head += "Connection: close\r\n\r\n" + server.manifest;
+            sendAll(client, head.data(), head.size());
+        } else if (!body) {
+            head = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            sendAll(client, head.data(), head.size());
+        } else {
+            size_t total = body->size();
+            if (partial) {
+                head = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + std::to_string(from) + "-" +
+                       std::to_string(total - 1) + "/" + std::to_string(total) + "\r\n";
+            } else {
+                head = "HTTP/1.1 200 OK\r\n";
+            }
+            head += "Content-Length: " + std::to_string(total - from) + "\r\nConnection: close\r\n\r\n";
+            sendAll(client, head.data(), head.size());
+
+            // Paced on the simulated clock; cut off after dropBytes
+            size_t limit = total - from;
+            if (server.dropBytes && server.drops != 0 && server.dropBytes < limit) {
+                limit = server.dropBytes;
+                if (server.drops > 0) server.drops--;
+            }
+            size_t sent = 0;
+            unsigned long start = millis();
+            while (sent < limit) {
+                size_t n = std::min<size_t>(1024, limit - sent);
+                while ((sent + n) * 1000 / 1024 > (millis() - start) * server.kbps) delay(1);
+                sendAll(client, body->data() + from + sent, n);
+                sent += n;
+            }
+        }
+        close(client);
+    }
+}
+
+static void startServer() {
+    server.fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server.fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    bind(server.fd, (struct sockaddr*)&addr, sizeof(addr));
+    listen(server.fd, 4);
+    socklen_t len = sizeof(addr);
+    getsockname(server.fd, (struct sockaddr*)&addr, &len);
+    server.port = ntohs(addr.sin_port);
+    std::thread(serve).detach();
+}
+
+static std::string manifestFor(const char* file, const std::vector<uint8_t>& image, const std::string& hash,
+                               const char* encoding) {
+    return "version=2.0.0\nurl=" + std::string(file) + "\nsize=" + std::to_string(image.size()) + "\nsha256=" + hash +
+           "\nencoding=" + encoding + "\n";
+}
+
+struct Result {
+    OtaPullStats stats;
+    OtaTelemetry telemetry;
+    uint32_t maxHandleUs;
+    bool installed;     // boot image is this run's image
+    uint32_t pausedMs;  // audio released
+    bool playingAfter;
+};
+
+// mode < 0: audio plays but OTAModule is not told about it
+static Result run(const std::vector<uint8_t>& image, AudioModule* audio = nullptr, int mode = -1) {
+    OTAModule ota;
+    ota.setAutoReboot(false);
+    ota.setManifestUrl(("http://127.0.0.1:" + std::to_string(server.port) + "/fw/manifest.txt").c_str());
+    if (audio && mode >= 0) {
+        ota.setAudio(audio);
+        ota.setAudioMode((OtaAudioMode)mode);
+    }
+    ota.checkNow();
+
+    Result result;
+    result.maxHandleUs = 0;
+    result.pausedMs = 0;
+    unsigned long start = millis();
+    unsigned long lastPass = start;
+    while (ota.getPullStats().state != OTA_READY && ota.getPullStats().state != OTA_FAILED &&
+           millis() - start < 600000) {
+        auto t0 = std::chrono::steady_clock::now();
+        ota.handle();
+        uint32_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+        result.maxHandleUs = std::max(result.maxHandleUs, us);
+        if (audio) {
+            if (audio->isReleased()) result.pausedMs += millis() - lastPass;
+            lastPass = millis();
+            audio->process();
+        }
+        delay(1);
+    }
+    result.stats = ota.getPullStats();
+    result.telemetry = ota.getTelemetry();
+    result.installed = Update.committed() && Update.image() == image;
+    result.playingAfter = audio && audio->isPlaying() && !audio->isReleased();
+    return result;
+}
+
+static void report(const char* name, const Result& r) {
+    const OtaPullStats& s = r.stats;
+    printf("%-9s %8s %9u %9u %9u %8u %8u %9.2f  %s\n", name, s.state == OTA_READY ? "ready" : "failed", s.durationMs,
+           s.imageSize, s.downloaded, s.transferred, s.resumes, r.maxHandleUs / 1000.0,
+           s.error.length() ? s.error.c_str() : (r.installed ? "image matches" : "IMAGE DIFFERS"));
+}
+
+static void reportAudio(const char* name, const Result& r, const sim::AudioStats& audio) {
+    const OtaTelemetry& t = r.telemetry;
+    printf("%-11s %6s %7u %9u %9.1f %8.1f %9u %7.1f %10u %6u %6u  %s\n", name,
+           r.stats.state == OTA_READY ? "ready" : "failed", r.stats.durationMs, audio.underruns,
+           audio.starvedUs / 1000.0, audio.maxGapUs / 1000.0, r.pausedMs, t.avgBps / 1024.0, t.throttledMs,
+           t.heapStart / 1024, t.heapMin / 1024,
+           !r.installed ? "IMAGE DIFFERS" : r.playingAfter ? "playing after" : "NOT PLAYING AFTER");
+}
+
+int main(int argc, char** argv) {
+    uint32_t imageKb = 1024;
+    uint32_t kbps = 400;
+    uint32_t dropKb = 96;
+    uint32_t sectorMs = 40;
+    uint32_t scale = 10;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--image-kb" && i + 1 < argc) imageKb = atoi(argv[++i]);
+        else if (a == "--kbps" && i + 1 < argc) kbps = atoi(argv[++i]);
+        else if (a == "--drop-kb" && i + 1 < argc) dropKb = atoi(argv[++i]);
+        else if (a == "--sector-ms" && i + 1 < argc) sectorMs = atoi(argv[++i]);
+        else if (a == "--scale" && i + 1 < argc) scale = atoi(argv[++i]);
+        else if (a == "--verbose") verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--image-kb N] [--kbps N] [--drop-kb N] [--sector-ms N] [--scale F] [--verbose]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    mallopt(M_MMAP_THRESHOLD, 64 * 1024);  // host-side images stay out of the simulated heap
+    sim::setSerialEnabled(verbose);
+    sim::nvsClear();
+    sim::setTimeScale(scale);
+
+    std::vector<uint8_t> image = makeImage(imageKb * 1024, 1);
+    std::vector<uint8_t> other = makeImage(imageKb * 1024, 2);
+    server.plain = image;
+    server.gz = gzipOf(image);
+    server.kbps = kbps;
+    startServer();
+
+    printf("GridBeacon pull OTA bench: %u KB image, %zu KB gzip, %u KB/s, drop every %u KB, clock x%u\n\n", imageKb,
+           server.gz.size() / 1024, kbps, dropKb, scale);
+    printf("%-9s %8s %9s %9s %9s %8s %8s %9s  %s\n", "run", "state", "ms", "image", "download", "received", "resumes",
+           "handle ms", "");
+
+    std::string hash = sha256Hex(image);
+    server.manifest = manifestFor("gridbeacon.bin.gz", image, hash, "gzip");
+    Result clean = run(image);
+    report("clean", clean);
+
+    server.dropBytes = dropKb * 1024;
+    server.drops = -1;
+    Result flaky = run(image);
+    report("flaky", flaky);
+
+    server.ignoreRange = true;
+    server.dropBytes = server.gz.size() / 2;
+    server.drops = 1;
+    Result noRange = run(image);
+    report("no-range", noRange);
+    server.ignoreRange = false;
+    server.dropBytes = dropKb * 1024;
+    server.drops = -1;
+
+    server.manifest = manifestFor("/fw/gridbeacon.bin", image, hash, "identity");
+    Result plain = run(image);
+    report("plain", plain);
+
+    // A different image under the good image's hash
+    server.gz = gzipOf(other);
+    server.manifest = manifestFor("gridbeacon.bin.gz", other, hash, "gzip");
+    Result bad = run(other);
+    report("bad-hash", bad);
+    bool kept = Update.committed() && Update.image() == image;
+
+    // No Content-Length: read to the end of the connection, but never past
+    // OTA_MANIFEST_MAX
+    server.gz = gzipOf(image);
+    server.manifest = manifestFor("gridbeacon.bin.gz", image, hash, "gzip");
+    server.manifestNoLength = true;
+    Result noLength = run(image);
+    report("no-length", noLength);
+    server.manifest += std::string(4 * OTA_MANIFEST_MAX, '#');
+    Result huge = run(image);
+    report("huge", huge);
+    server.manifestNoLength = false;
+    printf("\nbad-hash: boot image %s\n", kept ? "unchanged" : "REPLACED");
+
+    // While a stream plays; no drops, flash writes cost time
+    server.gz = gzipOf(image);
+    server.manifest = manifestFor("gridbeacon.bin.gz", image, hash, "gzip");
+    server.dropBytes = 0;
+    sim::setFlashSectorUs(sectorMs * 1000);
+    WiFi.mode(WIFI_STA);
+    WiFi.begin("SimNet", "simpassword");
+    while (WiFi.status() != WL_CONNECTED) delay(10);
+    AudioModule audio((WiFiModule*)nullptr);
+    audio.begin();
+    audio.setURL("http://127.0.0.1/stream0.mp3");
+    audio.play();
+
+    printf("\nwhile playing, %u ms per flash sector:\n\n", sectorMs);
+    printf("%-11s %6s %7s %9s %9s %8s %9s %7s %10s %6s %6s\n", "run", "state", "ms", "underruns", "starved ms",
+           "gap ms", "paused ms", "KB/s", "held ms", "heap0", "heapmin");
+    const char* names[] = { "unmanaged", "graceful", "background" };
+    bool audioOk = true;
+    for (int mode = -1; mode <= OTA_AUDIO_BACKGROUND; mode++) {
+        unsigned long warm = millis();
+        while (millis() - warm < 1000) audio.process();
+        sim::resetAudioStats();
+        Result r = run(image, &audio, mode);
+        reportAudio(names[mode + 1], r, sim::audioStats());
+        audioOk = audioOk && r.installed && r.playingAfter;
+    }
+
+    bool ok = clean.installed && flaky.installed && noRange.installed && plain.installed &&
+              bad.stats.state == OTA_FAILED && kept && noLength.installed &&
+              huge.stats.error == "manifest too large" && audioOk;
+    return ok ? 0 : 1;
+}
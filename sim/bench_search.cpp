@@ -0,0 +1,312 @@
+/**
+ * Directory search benchmark for the host build.
+ *
+ * Writes a radio-browser style JSON export (synthetic unless --dump is
+ * given) to the simulated LittleFS, builds the directory index through
+ * DirectoryModule exactly as the device does, then times a query mix.
+ *
+ *   ./bench_search [--stations N] [--dump FILE] [--queries N] [--check] [--verbose]
+ *
+ * --check compares every result list against a linear scan of all records.
+ */
+
+#include "Arduino.h"
+#include "LittleFS.h"
+#include "SimControl.h"
+#include "DirectoryModule.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+static const char* ADJECTIVES[] = {
+    "Radio", "Classic", "Smooth", "Deep", "Big", "Hot", "Cool", "Free", "Golden", "Urban", "Coastal", "Northern",
+    "Southern", "Electric", "Sunny", "Midnight", "Royal", "Wild", "Pure", "Active", "Vintage", "Modern", "Chill",
+    "Happy", "Alpine", "Metro", "Total", "Real", "Planet", "Cosmic",
+};
+static const char* GENRES[] = {
+    "Rock", "Pop", "Jazz", "Blues", "Classical", "Country", "Dance", "Techno", "House", "Trance", "Ambient", "Lounge",
+    "Reggae", "Soul", "Funk", "Metal", "Punk", "Indie", "Folk", "Hits", "Oldies", "News", "Talk", "Sports", "Latin",
+    "Salsa", "Schlager", "Chanson", "Hiphop", "Gospel", "Christian", "Eighties", "Nineties", "Disco", "Dubstep",
+    "Drum and Bass", "Soundtrack", "Opera", "Kids", "Comedy",
+};
+static const char* SUFFIXES[] = {
+    "FM", "Radio", "Station", "Wave", "Live", "One", "24", "Sound", "Beat", "Channel", "Network", "Express", "Mix",
+};
+static const struct { const char* name; const char* code; } COUNTRIES[] = {
+    { "Germany", "DE" }, { "The United States Of America", "US" }, { "France", "FR" }, { "United Kingdom", "GB" },
+    { "Spain", "ES" }, { "Italy", "IT" }, { "Brazil", "BR" }, { "Mexico", "MX" }, { "Netherlands", "NL" },
+    { "Poland", "PL" }, { "Canada", "CA" }, { "Australia", "AU" }, { "Austria", "AT" }, { "Switzerland", "CH" },
+    { "Greece", "GR" }, { "Argentina", "AR" }, { "Russia", "RU" }, { "Japan", "JP" }, { "India", "IN" },
+    { "Türkiye", "TR" }, { "Sweden", "SE" }, { "Norway", "NO" }, { "Portugal", "PT" }, { "Belgium", "BE" },
+    { "Chile", "CL" }, { "Colombia", "CO" }, { "Romania", "RO" }, { "Hungary", "HU" }, { "Czechia", "CZ" },
+    { "Ireland", "IE" },
+};
+static const char* CITIES[] = {
+    "Berlin", "Hamburg", "Munich", "Paris", "Lyon", "London", "Leeds", "Madrid", "Sevilla", "Roma", "Milano",
+    "Chicago", "Austin", "Denver", "Toronto", "Sydney", "Wien", "Zürich", "Athens", "Lisboa", "Dublin", "Oslo",
+    "Tokyo", "Mumbai", "Bogotá", "Santiago", "Praha", "Warszawa", "Budapest", "Bucuresti",
+};
+
+#define COUNT(a) (sizeof(a) / sizeof(a[0]))
+
+struct Query {
+    std::string text;
+    const char* kind;
+};
+
+static std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Field order and the extra fields mirror a radio-browser /json/stations dump
+static bool writeSyntheticDump(int stations, unsigned seed) {
+    File f = LittleFS.open(DIRECTORY_SOURCE_PATH, "w");
+    if (!f) return false;
+
+    std::mt19937 rng(seed);
+    auto pick = [&](size_t n) { return rng() % n; };
+
+    std::string out = "[";
+    for (int i = 0; i < stations; i++) {
+        std::string name;
+        int style = pick(4);
+        if (style == 0) name = std::string(ADJECTIVES[pick(COUNT(ADJECTIVES))]) + " " + GENRES[pick(COUNT(GENRES))];
+        else if (style == 1) name = std::string(CITIES[pick(COUNT(CITIES))]) + " " + SUFFIXES[pick(COUNT(SUFFIXES))];
+        else if (style == 2) name = std::string(ADJECTIVES[pick(COUNT(ADJECTIVES))]) + " " + CITIES[pick(COUNT(CITIES))] + " " + GENRES[pick(COUNT(GENRES))];
+        else name = std::string(GENRES[pick(COUNT(GENRES))]) + " " + SUFFIXES[pick(COUNT(SUFFIXES))] + " " + std::to_string(pick(200));
+
+        std::string tags;
+        int tagCount = 1 + pick(4);
+        for (int t = 0; t < tagCount; t++) {
+            if (t) tags += ",";
+            std::string tag = GENRES[pick(COUNT(GENRES))];
+            std::transform(tag.begin(), tag.end(), tag.begin(), ::tolower);
+            tags += tag;
+        }
+
+        const auto& country = COUNTRIES[pick(COUNT(COUNTRIES))];
+        std::string url = "http://stream" + std::to_string(i) + ".example.net:8000/live";
+
+        if (i) out += ",";
+        out += "{\"changeuuid\":\"" + std::to_string(rng()) + "\",\"stationuuid\":\"" + std::to_string(rng()) + "\"";
+        out += ",\"name\":" + jsonString(name);
+        out += ",\"url\":" + jsonString(url + ".pls");
+        out += ",\"url_resolved\":" + jsonString(url + ".mp3");
+        out += ",\"homepage\":\"https://example.net/" + std::to_string(i) + "\",\"favicon\":\"\"";
+        out += ",\"tags\":" + jsonString(tags);
+        out += ",\"country\":" + jsonString(country.name) + ",\"countrycode\":\"" + country.code + "\"";
+        out += ",\"state\":\"\",\"language\":\"english\",\"votes\":" + std::to_string(pick(5000));
+        out += ",\"codec\":\"MP3\",\"bitrate\":128,\"hls\":0,\"lastcheckok\":1,\"geo_lat\":null,\"geo_long\":null";
+        out += ",\"has_extended_info\":false}";
+
+        if (out.size() > 64 * 1024) {
+            f.write((const uint8_t*)out.data(), out.size());
+            out.clear();
+        }
+    }
+    out += "]";
+    f.write((const uint8_t*)out.data(), out.size());
+    return true;
+}
+
+static std::vector<Query> makeQueries(int count, unsigned seed) {
+    std::mt19937 rng(seed);
+    auto pick = [&](size_t n) { return rng() % n; };
+    auto lower = [](std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        return s;
+    };
+
+    std::vector<Query> queries;
+    for (int i = 0; i < count; i++) {
+        switch (i % 5) {
+        case 0: {  // short prefix, as typed
+            std::string word = lower(GENRES[pick(COUNT(GENRES))]);
+            queries.push_back({ word.substr(0, 2 + pick(2)), "prefix" });
+            break;
+        }
+        case 1:
+            queries.push_back({ lower(CITIES[pick(COUNT(CITIES))]), "word" });
+            break;
+        case 2:
+            queries.push_back({ std::string(GENRES[pick(COUNT(GENRES))]) + " " + COUNTRIES[pick(COUNT(COUNTRIES))].name, "genre+country" });
+            break;
+        case 3:
+            queries.push_back({ std::string(ADJECTIVES[pick(COUNT(ADJECTIVES))]) + " " + CITIES[pick(COUNT(CITIES))], "name" });
+            break;
+        default:
+            queries.push_back({ "zzq" + std::to_string(pick(1000)), "miss" });
+            break;
+        }
+    }
+    return queries;
+}
+
+static std::vector<std::string> words(const std::string& text) {
+    std::vector<std::string> out;
+    std::string word;
+    for (size_t i = 0; i <= text.size(); i++) {
+        unsigned char c = i < text.size() ? text[i] : 0;
+        if (c >= 0x80 || isalnum(c)) {
+            if (word.size() < DIRECTORY_WORD_MAX) word += (char)tolower(c);
+        } else if (!word.empty()) {
+            out.push_back(word);
+            word.clear();
+        }
+    }
+    return out;
+}
+
+// Reference answer: first `limit` stations, in ID order, where every query
+// word prefixes a word of name, tags, country or country code
+static std::vector<uint32_t> linearSearch(DirectoryModule& directory, const std::string& query, int limit) {
+    std::vector<std::string> wanted = words(query);
+    if (wanted.size() > DIRECTORY_QUERY_WORDS) wanted.resize(DIRECTORY_QUERY_WORDS);
+
+    std::vector<uint32_t> ids;
+    DirectoryEntry e;
+    for (uint32_t id = 0; id < directory.getStats().stations && (int)ids.size() < limit; id++) {
+        directory.getEntry(id, e);
+        std::vector<std::string> have = words(std::string(e.name.c_str()) + " " + e.tags.c_str() + " " +
+                                              e.country.c_str() + " " + e.countryCode.c_str());
+        bool all = !wanted.empty();
+        for (const auto& w : wanted) {
+            bool found = false;
+            for (const auto& h : have) found = found || h.compare(0, w.size(), w) == 0;
+            all = all && found;
+        }
+        if (all) ids.push_back(id);
+    }
+    return ids;
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(p * (values.size() - 1) + 0.5)];
+}
+
+static size_t fileSize(const char* path) {
+    File f = LittleFS.open(path, "r");
+    return f ? f.size() : 0;
+}
+
+int main(int argc, char** argv) {
+    int stations = 30000;
+    int queryCount = 2000;
+    const char* dump = nullptr;
+    bool verbose = false;
+    bool check = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--stations" && i + 1 < argc) stations = atoi(argv[++i]);
+        else if (a == "--dump" && i + 1 < argc) dump = argv[++i];
+        else if (a == "--queries" && i + 1 < argc) queryCount = atoi(argv[++i]);
+        else if (a == "--check") check = true;
+        else if (a == "--verbose") verbose = true;
+        else {
+            fprintf(stderr, "usage: %s [--stations N] [--dump FILE] [--queries N] [--check] [--verbose]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    sim::setSerialEnabled(verbose);
+    LittleFS.begin(true);
+
+    if (dump) {
+        FILE* in = fopen(dump, "rb");
+        File out = LittleFS.open(DIRECTORY_SOURCE_PATH, "w");
+        if (!in || !out) {
+            fprintf(stderr, "cannot copy %s\n", dump);
+            return 1;
+        }
+        char buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), in)) > 0) out.write((const uint8_t*)buf, n);
+        fclose(in);
+    } else if (!writeSyntheticDump(stations, 42)) {
+        fprintf(stderr, "cannot write dump\n");
+        return 1;
+    }
+
+    printf("GridBeacon directory bench: %s, %.1f MB export\n", dump ? dump : "synthetic",
+           fileSize(DIRECTORY_SOURCE_PATH) / 1048576.0);
+
+    DirectoryModule directory;
+    auto t0 = std::chrono::steady_clock::now();
+    if (!directory.begin()) {
+        fprintf(stderr, "index build failed\n");
+        return 1;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    const DirectoryStats& stats = directory.getStats();
+
+    printf("\nbuild: %u stations, %u postings in %.0f ms\n", stats.stations, stats.postings,
+           std::chrono::duration<double, std::milli>(t1 - t0).count());
+    printf("flash: records %.1f KB, offsets %.1f KB, index %.1f KB (%.2f B/posting)\n",
+           fileSize("/directory/records.dat") / 1024.0, fileSize("/directory/offsets.dat") / 1024.0,
+           fileSize("/directory/index.dat") / 1024.0,
+           stats.postings ? (fileSize("/directory/index.dat") - (DIRECTORY_INDEX_BUCKETS + 1) * 4.0) / stats.postings : 0);
+
+    // Second boot: the index is reused, not rebuilt
+    DirectoryModule reopened;
+    t0 = std::chrono::steady_clock::now();
+    reopened.begin();
+    t1 = std::chrono::steady_clock::now();
+    printf("reopen: %.2f ms, %zu bytes of module state\n",
+           std::chrono::duration<double, std::milli>(t1 - t0).count(), sizeof(DirectoryModule));
+
+    std::vector<Query> queries = makeQueries(queryCount, 7);
+    const char* kinds[] = { "prefix", "word", "genre+country", "name", "miss" };
+
+    printf("\n%-15s %8s %9s %9s %9s %9s %8s\n", "query", "count", "p50 ms", "p90 ms", "p99 ms", "max ms", "hits");
+    std::vector<double> all;
+    int mismatches = 0;
+    for (const char* kind : kinds) {
+        std::vector<double> latencies;
+        size_t hits = 0;
+        for (const auto& q : queries) {
+            if (strcmp(q.kind, kind) != 0) continue;
+
+            std::vector<DirectoryEntry> results;
+            auto start = std::chrono::steady_clock::now();
+            reopened.search(q.text.c_str(), 20, results);
+            auto end = std::chrono::steady_clock::now();
+
+            latencies.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            hits += results.size();
+
+            if (check) {
+                std::vector<uint32_t> expected = linearSearch(reopened, q.text, 20);
+                std::vector<uint32_t> got;
+                for (const auto& r : results) got.push_back(r.id);
+                if (got != expected) {
+                    mismatches++;
+                    printf("  mismatch for \"%s\": %zu results, expected %zu\n", q.text.c_str(), got.size(), expected.size());
+                }
+            }
+            if (verbose && &q == &queries[0]) {
+                for (const auto& r : results) printf("  %s | %s | %s\n", r.name.c_str(), r.tags.c_str(), r.country.c_str());
+            }
+        }
+        all.insert(all.end(), latencies.begin(), latencies.end());
+        printf("%-15s %8zu %9.3f %9.3f %9.3f %9.3f %8.1f\n", kind, latencies.size(), percentile(latencies, 0.5),
+               percentile(latencies, 0.9), percentile(latencies, 0.99), percentile(latencies, 1.0),
+               latencies.empty() ? 0.0 : hits / (double)latencies.size());
+    }
+    printf("%-15s %8zu %9.3f %9.3f %9.3f %9.3f\n", "all", all.size(), percentile(all, 0.5), percentile(all, 0.9),
+           percentile(all, 0.99), percentile(all, 1.0));
+    if (check) printf("\ncheck: %d of %zu queries differ from a linear scan\n", mismatches, queries.size());
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,228 @@
+#include "Arduino.h"
+#include "SimControl.h"
+
+#include <chrono>
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <malloc.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static const auto bootTime = std::chrono::steady_clock::now();
+static uint32_t timeScale = 1;
+static int64_t scaleBaseReal = 0;  // real and simulated us at the last change
+static int64_t scaleBaseSim = 0;
+static bool serialEnabled = true;
+static std::mutex serialMutex;
+static std::mt19937 rng(1234);
+static std::mutex rngMutex;
+
+// Same budget as the ESP32-C3
+static const uint32_t SIM_HEAP_SIZE = 400 * 1024;
+static uint32_t minFreeHeap = SIM_HEAP_SIZE;
+static const size_t baselineHeapUsed = mallinfo2().uordblks;
+
+static int64_t realMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - bootTime).count();
+}
+
+static int64_t simMicros() {
+    return scaleBaseSim + (realMicros() - scaleBaseReal) * timeScale;
+}
+
+unsigned long millis() {
+    return simMicros() / 1000;
+}
+
+unsigned long micros() {
+    return simMicros();
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::microseconds(ms * 1000 / timeScale));
+}
+
+void delayMicroseconds(unsigned int us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us / timeScale));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+long random(long howbig) {
+    if (howbig <= 0) return 0;
+    std::lock_guard<std::mutex> lock(rngMutex);
+    return std::uniform_int_distribution<long>(0, howbig - 1)(rng);
+}
+
+long random(long howsmall, long howbig) {
+    if (howsmall >= howbig) return howsmall;
+    return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+    std::lock_guard<std::mutex> lock(rngMutex);
+    rng.seed(seed);
+}
+
+namespace sim {
+
+void setTimeScale(uint32_t factor) {
+    if (factor == 0) factor = 1;
+    int64_t now = simMicros();
+    scaleBaseReal = realMicros();
+    scaleBaseSim = now;
+    timeScale = factor;
+}
+
+}  // namespace sim
+
+// --- String ---
+
+std::string String::format(long long value, unsigned char base) {
+    if (value < 0 && base == DEC) return "-" + format((unsigned long long)(-value), base);
+    return format((unsigned long long)value, base);
+}
+
+std::string String::format(unsigned long long value, unsigned char base) {
+    if (base < 2 || base > 36) base = DEC;
+    char buf[72];
+    int pos = sizeof(buf) - 1;
+    buf[pos] = '\0';
+    do {
+        int digit = value % base;
+        buf[--pos] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+        value /= base;
+    } while (value > 0);
+    return std::string(buf + pos);
+}
+
+std::string String::formatFloat(double value, unsigned int decimals) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, value);
+    return buf;
+}
+
+bool String::equalsIgnoreCase(const String& other) const {
+    if (s.size() != other.s.size()) return false;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (tolower((unsigned char)s[i]) != tolower((unsigned char)other.s[i])) return false;
+    }
+    return true;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= s.size()) return String();
+    if (to > s.size()) to = s.size();
+    return String(s.substr(from, to - from).c_str());
+}
+
+void String::replace(const String& find, const String& replacement) {
+    if (find.s.empty()) return;
+    size_t pos = 0;
+    while ((pos = s.find(find.s, pos)) != std::string::npos) {
+        s.replace(pos, find.s.size(), replacement.s);
+        pos += replacement.s.size();
+    }
+}
+
+void String::toLowerCase() {
+    for (auto& c : s) c = tolower((unsigned char)c);
+}
+
+void String::toUpperCase() {
+    for (auto& c : s) c = toupper((unsigned char)c);
+}
+
+void String::trim() {
+    size_t begin = 0;
+    while (begin < s.size() && isspace((unsigned char)s[begin])) begin++;
+    size_t end = s.size();
+    while (end > begin && isspace((unsigned char)s[end - 1])) end--;
+    s = s.substr(begin, end - begin);
+}
+
+void String::getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index) const {
+    if (!buf || bufsize == 0) return;
+    if (index >= s.size()) {
+        buf[0] = 0;
+        return;
+    }
+    unsigned int n = std::min<unsigned int>(bufsize - 1, s.size() - index);
+    memcpy(buf, s.data() + index, n);
+    buf[n] = 0;
+}
+
+// --- Print / Serial ---
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0) return 0;
+    return write((const uint8_t*)buf, std::min<size_t>(len, sizeof(buf) - 1));
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    if (!serialEnabled) return size;
+    std::lock_guard<std::mutex> lock(serialMutex);
+    return fwrite(buffer, 1, size, stdout);
+}
+
+// --- ESP ---
+
+uint32_t EspClass::getHeapSize() {
+    return SIM_HEAP_SIZE;
+}
+
+uint32_t EspClass::getFreeHeap() {
+    // Process-wide usage since start-up, mapped onto the device budget
+    size_t now = mallinfo2().uordblks;
+    size_t used = now > baselineHeapUsed ? now - baselineHeapUsed : 0;
+    uint32_t freeHeap = used >= SIM_HEAP_SIZE ? 0 : SIM_HEAP_SIZE - used;
+    if (freeHeap < minFreeHeap) minFreeHeap = freeHeap;
+    return freeHeap;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    getFreeHeap();
+    return minFreeHeap;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return getFreeHeap();
+}
+
+void EspClass::restart() {
+    fflush(stdout);
+    fprintf(stderr, "[sim] ESP.restart() requested - exiting\n");
+    exit(0);
+}
+
+namespace sim {
+
+void setSerialEnabled(bool enabled) {
+    serialEnabled = enabled;
+}
+
+}  // namespace sim
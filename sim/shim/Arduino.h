@@ -0,0 +1,226 @@
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+/**
+ * Host shim for the subset of the Arduino/ESP32 core used by GridBeacon.
+ * Only what the modules actually call is provided.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+#define PROGMEM
+#define PGM_P const char*
+#define F(s) (s)
+
+#define HEX 16
+#define DEC 10
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+// SNTP: the host clock is already set
+inline void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1) {}
+
+class String {
+public:
+    String(const char* cstr = "") : s(cstr ? cstr : "") {}
+    String(const String& other) = default;
+    String(String&& other) = default;
+    explicit String(char c) : s(1, c) {}
+    explicit String(unsigned char value, unsigned char base = DEC) : s(format(value, base)) {}
+    explicit String(int value, unsigned char base = DEC) : s(format(value, base)) {}
+    explicit String(unsigned int value, unsigned char base = DEC) : s(format(value, base)) {}
+    explicit String(long value, unsigned char base = DEC) : s(format(value, base)) {}
+    explicit String(unsigned long value, unsigned char base = DEC) : s(format(value, base)) {}
+    explicit String(long long value, unsigned char base = DEC) : s(format(value, base)) {}
+    explicit String(unsigned long long value, unsigned char base = DEC) : s(format(value, base)) {}
+    explicit String(float value, unsigned int decimals = 2) : s(formatFloat(value, decimals)) {}
+    explicit String(double value, unsigned int decimals = 2) : s(formatFloat(value, decimals)) {}
+
+    String& operator=(const String& other) = default;
+    String& operator=(String&& other) = default;
+    String& operator=(const char* cstr) { s = cstr ? cstr : ""; return *this; }
+
+    unsigned int length() const { return s.size(); }
+    bool isEmpty() const { return s.empty(); }
+    const char* c_str() const { return s.c_str(); }
+    bool reserve(unsigned int size) { s.reserve(size); return true; }
+
+    char charAt(unsigned int index) const { return index < s.size() ? s[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char& operator[](unsigned int index) { return s[index]; }
+    void setCharAt(unsigned int index, char c) { if (index < s.size()) s[index] = c; }
+
+    bool concat(const String& other) { s += other.s; return true; }
+    bool concat(const char* cstr) { if (cstr) s += cstr; return true; }
+    bool concat(const char* cstr, unsigned int len) { if (cstr) s.append(cstr, len); return true; }
+    bool concat(char c) { s += c; return true; }
+
+    String& operator+=(const String& other) { s += other.s; return *this; }
+    String& operator+=(const char* cstr) { if (cstr) s += cstr; return *this; }
+    String& operator+=(char c) { s += c; return *this; }
+    String& operator+=(unsigned char v) { s += format(v, DEC); return *this; }
+    String& operator+=(int v) { s += format(v, DEC); return *this; }
+    String& operator+=(unsigned int v) { s += format(v, DEC); return *this; }
+    String& operator+=(long v) { s += format(v, DEC); return *this; }
+    String& operator+=(unsigned long v) { s += format(v, DEC); return *this; }
+    String& operator+=(long long v) { s += format(v, DEC); return *this; }
+    String& operator+=(unsigned long long v) { s += format(v, DEC); return *this; }
+    String& operator+=(float v) { s += formatFloat(v, 2); return *this; }
+    String& operator+=(double v) { s += formatFloat(v, 2); return *this; }
+
+    bool equals(const String& other) const { return s == other.s; }
+    bool equals(const char* cstr) const { return s == (cstr ? cstr : ""); }
+    bool equalsIgnoreCase(const String& other) const;
+    bool operator==(const String& other) const { return s == other.s; }
+    bool operator==(const char* cstr) const { return equals(cstr); }
+    bool operator!=(const String& other) const { return s != other.s; }
+    bool operator!=(const char* cstr) const { return !equals(cstr); }
+    bool operator<(const String& other) const { return s < other.s; }
+    bool operator>(const String& other) const { return s > other.s; }
+    int compareTo(const String& other) const { return s.compare(other.s); }
+
+    bool startsWith(const String& prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+    bool startsWith(const String& prefix, unsigned int offset) const {
+        return offset <= s.size() && s.compare(offset, prefix.s.size(), prefix.s) == 0;
+    }
+    bool endsWith(const String& suffix) const {
+        return s.size() >= suffix.s.size() && s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+    }
+
+    int indexOf(char c, unsigned int from = 0) const { return toIndex(s.find(c, from)); }
+    int indexOf(const String& str, unsigned int from = 0) const { return toIndex(s.find(str.s, from)); }
+    int lastIndexOf(char c) const { return toIndex(s.rfind(c)); }
+    int lastIndexOf(char c, unsigned int from) const { return toIndex(s.rfind(c, from)); }
+    int lastIndexOf(const String& str) const { return toIndex(s.rfind(str.s)); }
+
+    String substring(unsigned int from) const { return from < s.size() ? String(s.substr(from).c_str()) : String(); }
+    String substring(unsigned int from, unsigned int to) const;
+
+    void replace(char find, char replacement) { std::replace(s.begin(), s.end(), find, replacement); }
+    void replace(const String& find, const String& replacement);
+    void remove(unsigned int index) { if (index < s.size()) s.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < s.size()) s.erase(index, count); }
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return atof(s.c_str()); }
+    double toDouble() const { return atof(s.c_str()); }
+
+    void getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index = 0) const;
+    void toCharArray(char* buf, unsigned int bufsize, unsigned int index = 0) const {
+        getBytes((unsigned char*)buf, bufsize, index);
+    }
+
+private:
+    std::string s;
+
+    static int toIndex(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+    static std::string format(long long value, unsigned char base);
+    static std::string format(unsigned long long value, unsigned char base);
+    static std::string format(int value, unsigned char base) { return format((long long)value, base); }
+    static std::string format(long value, unsigned char base) { return format((long long)value, base); }
+    static std::string format(unsigned char value, unsigned char base) { return format((unsigned long long)value, base); }
+    static std::string format(unsigned int value, unsigned char base) { return format((unsigned long long)value, base); }
+    static std::string format(unsigned long value, unsigned char base) { return format((unsigned long long)value, base); }
+    static std::string formatFloat(double value, unsigned int decimals);
+};
+
+inline String operator+(const String& lhs, const String& rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String& lhs, const char* rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const char* lhs, const String& rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String& lhs, char rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String& lhs, int rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String& lhs, unsigned int rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String& lhs, long rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String& lhs, unsigned long rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String& lhs, float rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String& lhs, double rhs) { String r(lhs); r += rhs; return r; }
+inline bool operator==(const char* lhs, const String& rhs) { return rhs == lhs; }
+inline bool operator!=(const char* lhs, const String& rhs) { return rhs != lhs; }
+
+class Print;
+
+class Printable {
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print& p) const = 0;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+
+    size_t print(const char* str) { return write(str); }
+    size_t print(const String& str) { return write(str.c_str(), str.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(int v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(unsigned int v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(unsigned long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(long long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(unsigned long long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(double v, int digits = 2) { return print(String(v, (unsigned int)digits)); }
+    size_t print(const Printable& p) { return p.printTo(*this); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    template <typename T>
+    size_t println(const T& v, int format) { size_t n = print(v, format); return n + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    virtual int peek() { return -1; }
+};
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    operator bool() const { return true; }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    void restart();
+};
+
+extern EspClass ESP;
+
+#endif
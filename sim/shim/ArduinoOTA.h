@@ -0,0 +1,43 @@
+#ifndef SIM_ARDUINOOTA_H
+#define SIM_ARDUINOOTA_H
+
+#include "Arduino.h"
+#include <functional>
+
+typedef enum {
+    OTA_AUTH_ERROR,
+    OTA_BEGIN_ERROR,
+    OTA_CONNECT_ERROR,
+    OTA_RECEIVE_ERROR,
+    OTA_END_ERROR
+} ota_error_t;
+
+// Push updates never arrive on the host; callbacks are kept for completeness
+class ArduinoOTAClass {
+public:
+    typedef std::function<void(void)> THandlerFunction;
+    typedef std::function<void(ota_error_t)> THandlerFunction_Error;
+    typedef std::function<void(unsigned int, unsigned int)> THandlerFunction_Progress;
+
+    ArduinoOTAClass& setHostname(const char* name) { hostname = name; return *this; }
+    ArduinoOTAClass& setPassword(const char* password) { (void)password; return *this; }
+    ArduinoOTAClass& setPort(uint16_t port) { (void)port; return *this; }
+    ArduinoOTAClass& onStart(THandlerFunction fn) { startFn = fn; return *this; }
+    ArduinoOTAClass& onEnd(THandlerFunction fn) { endFn = fn; return *this; }
+    ArduinoOTAClass& onError(THandlerFunction_Error fn) { errorFn = fn; return *this; }
+    ArduinoOTAClass& onProgress(THandlerFunction_Progress fn) { progressFn = fn; return *this; }
+    void begin() {}
+    void end() {}
+    void handle() {}
+
+private:
+    String hostname;
+    THandlerFunction startFn;
+    THandlerFunction endFn;
+    THandlerFunction_Error errorFn;
+    THandlerFunction_Progress progressFn;
+};
+
+extern ArduinoOTAClass ArduinoOTA;
+
+#endif
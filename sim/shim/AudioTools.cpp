@@ -0,0 +1,102 @@
+#include "AudioTools.h"
+#include "SimControl.h"
+
+AudioToolsLoggerClass AudioToolsLogger;
+
+// One MP3 frame at 44.1 kHz (1152 samples)
+static const int64_t FRAME_US = 26122;
+static const size_t FRAME_BYTES = 1152 * 2 * 2;
+
+static uint32_t decodeCostUs = 1500;    // Helix on a 160 MHz C3, roughly
+static uint32_t outputBufferMs = 120;
+static uint32_t streamOpenMs = 0;
+static sim::AudioStats stats = {};
+
+static void burnCpu(uint32_t us) {
+    unsigned long start = micros();
+    while (micros() - start < us) {
+    }
+}
+
+bool URLStream::begin(const char* url) {
+    currentUrl = url ? url : "";
+    if (ssid != nullptr && password != nullptr && WiFi.status() != WL_CONNECTED) {
+        WiFi.begin(ssid, password);
+        while (WiFi.status() != WL_CONNECTED) {
+            delay(500);
+        }
+    }
+    if (WiFi.status() != WL_CONNECTED || currentUrl.length() == 0) return false;
+
+    delay(streamOpenMs);
+    return true;
+}
+
+bool AudioPlayer::begin(int index, bool isActive) {
+    (void)index;
+    (void)isActive;
+    source.begin();
+    started = true;
+    bufferedUs = 0;
+    lastCopyUs = 0;
+    return true;
+}
+
+size_t AudioPlayer::copy() {
+    if (!started) return 0;
+
+    unsigned long now = micros();
+    if (lastCopyUs != 0) {
+        uint32_t gap = now - lastCopyUs;
+        if (gap > stats.maxGapUs) stats.maxGapUs = gap;
+
+        // The I2S side kept playing since the last call
+        bufferedUs -= gap;
+        if (bufferedUs < 0) {
+            stats.underruns++;
+            stats.starvedUs += -bufferedUs;
+            bufferedUs = 0;
+        }
+    }
+
+    burnCpu(decodeCostUs);
+
+    // A full DMA queue blocks the writer, as i2s_write() does on the device
+    int64_t capacityUs = (int64_t)outputBufferMs * 1000;
+    int64_t excess = bufferedUs + FRAME_US - capacityUs;
+    if (excess > 0) delayMicroseconds(excess);
+
+    // Account for the time spent decoding and blocking
+    unsigned long after = micros();
+    bufferedUs -= (int64_t)(after - now);
+    if (bufferedUs < 0) bufferedUs = 0;
+    bufferedUs += FRAME_US;
+    lastCopyUs = after;
+
+    stats.frames++;
+    return FRAME_BYTES;
+}
+
+namespace sim {
+
+void setDecodeCostUs(uint32_t us) {
+    decodeCostUs = us;
+}
+
+void setStreamOpenMs(uint32_t ms) {
+    streamOpenMs = ms;
+}
+
+void setOutputBufferMs(uint32_t ms) {
+    outputBufferMs = ms;
+}
+
+AudioStats audioStats() {
+    return stats;
+}
+
+void resetAudioStats() {
+    stats = {};
+}
+
+}  // namespace sim
@@ -0,0 +1,127 @@
+#ifndef SIM_AUDIOTOOLS_H
+#define SIM_AUDIOTOOLS_H
+
+/**
+ * Simulated stand-in for the parts of arduino-audio-tools GridBeacon uses.
+ * No audio is fetched or decoded: AudioPlayer::copy() spends a configurable
+ * decode cost and feeds a virtual I2S buffer that drains in real time, so a
+ * loop() that stalls shows up as underruns (see SimControl.h).
+ */
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include <vector>
+
+enum class AudioToolsLogLevel { Debug, Info, Warning, Error };
+
+class AudioToolsLoggerClass {
+public:
+    void begin(Print& out, AudioToolsLogLevel level) {
+        (void)out;
+        (void)level;
+    }
+};
+
+extern AudioToolsLoggerClass AudioToolsLogger;
+
+enum RxTxMode { UNDEFINED_MODE, TX_MODE, RX_MODE, RXTX_MODE };
+
+struct I2SConfig {
+    RxTxMode rx_tx_mode = TX_MODE;
+    int sample_rate = 44100;
+    int channels = 2;
+    int bits_per_sample = 16;
+    int pin_bck = -1;
+    int pin_ws = -1;
+    int pin_data = -1;
+    int buffer_count = 6;
+    int buffer_size = 512;
+};
+
+class I2SStream {
+public:
+    I2SConfig defaultConfig(RxTxMode mode = TX_MODE) {
+        I2SConfig cfg;
+        cfg.rx_tx_mode = mode;
+        return cfg;
+    }
+    bool begin(I2SConfig cfg) {
+        config = cfg;
+        active = true;
+        dma.assign((size_t)cfg.buffer_count * cfg.buffer_size * cfg.channels * cfg.bits_per_sample / 8, 0);
+        return true;
+    }
+    void end() {
+        active = false;
+        std::vector<uint8_t>().swap(dma);
+    }
+
+private:
+    I2SConfig config;
+    bool active = false;
+    std::vector<uint8_t> dma;   // driver DMA buffers, for heap accounting
+};
+
+// Connecting takes the simulated stream open time. Given credentials it
+// first joins the network itself whenever the link is down, blocking like
+// the library's login().
+class URLStream {
+public:
+    URLStream() {}
+    URLStream(const char* network, const char* password) : ssid(network), password(password) {}
+    bool begin(const char* url);
+    void end() {}
+
+private:
+    const char* ssid = nullptr;
+    const char* password = nullptr;
+    String currentUrl;
+};
+
+class AudioSourceURL {
+public:
+    AudioSourceURL(URLStream& stream, const char* urls[], const char* mime, int startPos = 0)
+        : stream(stream), urls(urls), mime(mime), pos(startPos) {}
+
+    bool begin() { return stream.begin(urls[pos]); }
+
+private:
+    URLStream& stream;
+    const char** urls;
+    const char* mime;
+    int pos;
+};
+
+// Helix keeps about 30 KB of decoder state and frame buffers
+class MP3DecoderHelix {
+private:
+    std::vector<uint8_t> state = std::vector<uint8_t>(30 * 1024, 0);
+};
+
+class AudioPlayer {
+public:
+    AudioPlayer(AudioSourceURL& source, I2SStream& output, MP3DecoderHelix& decoder)
+        : source(source), output(output), decoder(decoder) {}
+
+    bool begin(int index = 0, bool isActive = true);
+    void end() { started = false; }
+    size_t copy();
+    bool setVolume(float vol) {
+        volume = vol;
+        return true;
+    }
+    float getVolume() { return volume; }
+
+private:
+    AudioSourceURL& source;
+    I2SStream& output;
+    MP3DecoderHelix& decoder;
+    float volume = 1.0;
+    bool started = false;
+
+    // Virtual output buffer, in microseconds of audio
+    int64_t bufferedUs = 0;
+    unsigned long lastCopyUs = 0;
+};
+
+#endif
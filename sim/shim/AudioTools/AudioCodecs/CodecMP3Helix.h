@@ -0,0 +1,7 @@
+#ifndef SIM_AUDIOTOOLS_AUDIOCODECS_CODECMP3HELIX_H
+#define SIM_AUDIOTOOLS_AUDIOCODECS_CODECMP3HELIX_H
+
+// Everything lives in the single AudioTools shim header
+#include "AudioTools.h"
+
+#endif
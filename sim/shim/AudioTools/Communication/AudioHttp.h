@@ -0,0 +1,7 @@
+#ifndef SIM_AUDIOTOOLS_COMMUNICATION_AUDIOHTTP_H
+#define SIM_AUDIOTOOLS_COMMUNICATION_AUDIOHTTP_H
+
+// Everything lives in the single AudioTools shim header
+#include "AudioTools.h"
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef SIM_AUDIOTOOLS_DISK_AUDIOSOURCEURL_H
+#define SIM_AUDIOTOOLS_DISK_AUDIOSOURCEURL_H
+
+// Everything lives in the single AudioTools shim header
+#include "AudioTools.h"
+
+#endif
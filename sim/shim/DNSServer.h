@@ -0,0 +1,20 @@
+#ifndef SIM_DNSSERVER_H
+#define SIM_DNSSERVER_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+// Captive-portal DNS has nothing to answer on the host
+class DNSServer {
+public:
+    bool start(uint16_t port, const String& domainName, const IPAddress& resolvedIP) {
+        (void)port;
+        (void)domainName;
+        (void)resolvedIP;
+        return true;
+    }
+    void stop() {}
+    void processNextRequest() {}
+};
+
+#endif
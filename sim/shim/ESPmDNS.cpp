@@ -0,0 +1,49 @@
+#include "ESPmDNS.h"
+
+MDNSResponder MDNS;
+
+static std::string serviceKey(const char* service, const char* proto) {
+    return std::string("_") + service + "._" + proto;
+}
+
+// Like the core, a second begin() fails and keeps the first hostname
+bool MDNSResponder::begin(const char* hostName) {
+    if (started) return false;
+    started = true;
+    host = hostName;
+    announced++;
+    return true;
+}
+
+void MDNSResponder::end() {
+    started = false;
+    services.clear();
+    txtRecords.clear();
+}
+
+void MDNSResponder::setInstanceName(String name) {
+    instance = name;
+}
+
+bool MDNSResponder::addService(const char* service, const char* proto, uint16_t port) {
+    if (!started) return false;
+    services[serviceKey(service, proto)] = port;
+    announced++;
+    return true;
+}
+
+bool MDNSResponder::addServiceTxt(const char* service, const char* proto, const char* key, const char* value) {
+    std::string name = serviceKey(service, proto);
+    if (!started || services.find(name) == services.end()) return false;
+    std::string& current = txtRecords[name + "/" + key];
+    if (current != value) {
+        current = value;
+        announced++;
+    }
+    return true;
+}
+
+String MDNSResponder::txt(const char* service, const char* proto, const char* key) {
+    auto it = txtRecords.find(serviceKey(service, proto) + "/" + key);
+    return it == txtRecords.end() ? String("") : String(it->second.c_str());
+}
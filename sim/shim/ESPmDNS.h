@@ -0,0 +1,36 @@
+#ifndef SIM_ESPMDNS_H
+#define SIM_ESPMDNS_H
+
+#include "Arduino.h"
+#include <map>
+#include <string>
+
+// Records what would be advertised; nothing goes on the wire. A TXT value
+// that changes counts as one announcement, as with the ESP-IDF responder.
+class MDNSResponder {
+public:
+    bool begin(const char* hostName);
+    void end();
+    void setInstanceName(String name);
+    bool addService(const char* service, const char* proto, uint16_t port);
+    bool addServiceTxt(const char* service, const char* proto, const char* key, const char* value);
+    bool addServiceTxt(const char* service, const char* proto, String key, String value) {
+        return addServiceTxt(service, proto, key.c_str(), value.c_str());
+    }
+
+    String hostname() { return host; }
+    String txt(const char* service, const char* proto, const char* key);
+    uint32_t announcements() { return announced; }
+
+private:
+    bool started = false;
+    String host;
+    String instance;
+    std::map<std::string, uint16_t> services;
+    std::map<std::string, std::string> txtRecords;
+    uint32_t announced = 0;
+};
+
+extern MDNSResponder MDNS;
+
+#endif
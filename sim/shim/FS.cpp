@@ -0,0 +1,198 @@
+#include "LittleFS.h"
+#include "SimControl.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+LittleFSFS LittleFS;
+
+static std::string fsRoot;
+
+// Same size as the default ESP32-C3 "spiffs" partition
+static const size_t SIM_FS_SIZE = 1536 * 1024;
+
+static void removeTree(const std::string& path);
+
+static void removeScratchRoot() {
+    removeTree(fsRoot);
+}
+
+static const std::string& root() {
+    if (fsRoot.empty()) {
+        const char* env = getenv("SIM_FS_DIR");
+        if (env) {
+            fsRoot = env;
+        } else {
+            // Per-process scratch directory, gone when the process exits
+            fsRoot = "/tmp/gridbeacon-fs-" + std::to_string(getpid());
+            atexit(removeScratchRoot);
+        }
+    }
+    return fsRoot;
+}
+
+static void removeTree(const std::string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        unlink(path.c_str());
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        removeTree(path + "/" + name);
+    }
+    closedir(dir);
+    rmdir(path.c_str());
+}
+
+static size_t treeSize(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return 0;
+    if (!S_ISDIR(st.st_mode)) return st.st_size;
+
+    size_t total = 0;
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        total += treeSize(path + "/" + name);
+    }
+    closedir(dir);
+    return total;
+}
+
+// --- File ---
+
+File::File(FILE* f, const String& path) : fp(f, fclose), filePath(path) {}
+
+size_t File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buf, size_t size) {
+    return fp ? fwrite(buf, 1, size, fp.get()) : 0;
+}
+
+int File::available() {
+    return fp ? (int)(size() - position()) : 0;
+}
+
+int File::read() {
+    return fp ? fgetc(fp.get()) : -1;
+}
+
+int File::peek() {
+    if (!fp) return -1;
+    int c = fgetc(fp.get());
+    if (c != EOF) ungetc(c, fp.get());
+    return c;
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+    return fp ? fread(buf, 1, size, fp.get()) : 0;
+}
+
+void File::flush() {
+    if (fp) fflush(fp.get());
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!fp) return false;
+    int whence = mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END;
+    return fseek(fp.get(), pos, whence) == 0;
+}
+
+size_t File::position() const {
+    return fp ? ftell(fp.get()) : 0;
+}
+
+size_t File::size() const {
+    if (!fp) return 0;
+    long pos = ftell(fp.get());
+    fseek(fp.get(), 0, SEEK_END);
+    long end = ftell(fp.get());
+    fseek(fp.get(), pos, SEEK_SET);
+    return end;
+}
+
+// --- FS ---
+
+std::string FS::hostPath(const char* path) {
+    std::string p = path ? path : "/";
+    if (p.empty() || p[0] != '/') p = "/" + p;
+    return root() + p;
+}
+
+File FS::open(const char* path, const char* mode, const bool create) {
+    (void)create;
+    std::string m = mode ? mode : "r";
+    // Binary on the host; "r+"/"w+"/"a+" pass through unchanged
+    if (m.find('b') == std::string::npos) m += "b";
+    FILE* fp = fopen(hostPath(path).c_str(), m.c_str());
+    return fp ? File(fp, path) : File();
+}
+
+bool FS::exists(const char* path) {
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path) {
+    return unlink(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* from, const char* to) {
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0 || exists(path);
+}
+
+bool FS::rmdir(const char* path) {
+    return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+// --- LittleFS ---
+
+bool LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel) {
+    (void)formatOnFail;
+    (void)basePath;
+    (void)maxOpenFiles;
+    (void)partitionLabel;
+    ::mkdir(root().c_str(), 0755);
+    struct stat st;
+    return stat(root().c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool LittleFSFS::format() {
+    removeTree(root());
+    return ::mkdir(root().c_str(), 0755) == 0;
+}
+
+size_t LittleFSFS::totalBytes() {
+    return SIM_FS_SIZE;
+}
+
+size_t LittleFSFS::usedBytes() {
+    return treeSize(root());
+}
+
+namespace sim {
+
+void setFsRoot(const char* path) {
+    fsRoot = path;
+}
+
+void fsFormat() {
+    LittleFS.format();
+}
+
+}  // namespace sim
@@ -0,0 +1,62 @@
+#ifndef SIM_FS_H
+#define SIM_FS_H
+
+#include "Arduino.h"
+#include <memory>
+#include <stdio.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+// Copyable handle, like the ESP32 File: the stream closes with the last copy
+class File : public Stream {
+public:
+    File() {}
+    File(FILE* fp, const String& path);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t read(uint8_t* buf, size_t size);
+    void flush();
+    bool seek(uint32_t pos, SeekMode mode);
+    bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+    size_t position() const;
+    size_t size() const;
+    void close() { fp.reset(); }
+    operator bool() const { return (bool)fp; }
+    const char* path() const { return filePath.c_str(); }
+
+private:
+    std::shared_ptr<FILE> fp;
+    String filePath;
+};
+
+// Maps the flash filesystem onto a host directory (see SimControl.h)
+class FS {
+public:
+    File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+    File open(const String& path, const char* mode = FILE_READ, const bool create = false) {
+        return open(path.c_str(), mode, create);
+    }
+    bool exists(const char* path);
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path);
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool rename(const char* from, const char* to);
+    bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+    bool mkdir(const char* path);
+    bool mkdir(const String& path) { return mkdir(path.c_str()); }
+    bool rmdir(const char* path);
+
+protected:
+    std::string hostPath(const char* path);
+};
+
+#endif
@@ -0,0 +1,160 @@
+#include "HTTPClient.h"
+
+HTTPClient::HTTPClient()
+    : port(80), secure(false), http10(false), timeoutMs(HTTPC_DEFAULT_TCP_TIMEOUT), connectTimeoutMs(HTTPC_DEFAULT_TCP_TIMEOUT),
+      followRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS), userAgent("ESP32HTTPClient"), contentLength(-1) {}
+
+bool HTTPClient::begin(const String& url) {
+    end();
+    requestHeaders = "";
+    for (auto& h : collected) h.value = "";
+
+    int schemeEnd = url.indexOf("://");
+    if (schemeEnd < 0) return false;
+    String scheme = url.substring(0, schemeEnd);
+    scheme.toLowerCase();
+    if (scheme != "http" && scheme != "https") return false;
+    secure = scheme == "https";
+    port = secure ? 443 : 80;
+
+    String rest = url.substring(schemeEnd + 3);
+    int slash = rest.indexOf('/');
+    host = slash < 0 ? rest : rest.substring(0, slash);
+    path = slash < 0 ? String("/") : rest.substring(slash);
+
+    int at = host.indexOf('@');
+    if (at >= 0) host = host.substring(at + 1);
+    int colon = host.indexOf(':');
+    if (colon >= 0) {
+        port = host.substring(colon + 1).toInt();
+        host = host.substring(0, colon);
+    }
+    return host.length() > 0;
+}
+
+void HTTPClient::end() {
+    client.stop();
+    contentLength = -1;
+    location = "";
+}
+
+void HTTPClient::addHeader(const String& name, const String& value) {
+    requestHeaders += name + ": " + value + "\r\n";
+}
+
+void HTTPClient::collectHeaders(const char* keys[], const size_t count) {
+    collected.clear();
+    for (size_t i = 0; i < count; i++) collected.push_back({ keys[i], "" });
+}
+
+String HTTPClient::header(const char* name) {
+    for (auto& h : collected) {
+        if (h.name.equalsIgnoreCase(name)) return h.value;
+    }
+    return "";
+}
+
+bool HTTPClient::hasHeader(const char* name) {
+    return header(name).length() > 0;
+}
+
+bool HTTPClient::readLine(String& line) {
+    line = "";
+    unsigned long start = millis();
+    while (millis() - start < timeoutMs) {
+        int c = client.read();
+        if (c < 0) {
+            if (!client.connected()) return false;
+            delay(1);
+            continue;
+        }
+        if (c == '\n') {
+            if (line.endsWith("\r")) line.remove(line.length() - 1);
+            return true;
+        }
+        line += (char)c;
+    }
+    return false;
+}
+
+int HTTPClient::GET() {
+    if (secure) return HTTPC_ERROR_CONNECTION_REFUSED;  // no TLS in the simulator
+
+    for (int hop = 0; hop < 10; hop++) {
+        client.stop();
+        client.setTimeout(timeoutMs);
+        if (!client.connect(host.c_str(), port, connectTimeoutMs)) return HTTPC_ERROR_CONNECTION_REFUSED;
+
+        String request = "GET " + path + (http10 ? " HTTP/1.0" : " HTTP/1.1") + "\r\nHost: " + host + "\r\nUser-Agent: " + userAgent +
+                         "\r\nConnection: close\r\n" + requestHeaders + "\r\n";
+        if (client.write((const uint8_t*)request.c_str(), request.length()) != request.length()) {
+            return HTTPC_ERROR_SEND_HEADER_FAILED;
+        }
+
+        String line;
+        if (!readLine(line)) return HTTPC_ERROR_READ_TIMEOUT;
+        if (!line.startsWith("HTTP/1.")) return HTTPC_ERROR_NO_HTTP_SERVER;
+        int code = line.substring(9, 12).toInt();
+
+        contentLength = -1;
+        location = "";
+        for (auto& h : collected) h.value = "";
+        while (true) {
+            if (!readLine(line)) return HTTPC_ERROR_CONNECTION_LOST;
+            if (line.length() == 0) break;
+
+            int colon = line.indexOf(':');
+            if (colon < 0) continue;
+            String name = line.substring(0, colon);
+            String value = line.substring(colon + 1);
+            value.trim();
+
+            if (name.equalsIgnoreCase("Content-Length")) contentLength = value.toInt();
+            if (name.equalsIgnoreCase("Location")) location = value;
+            for (auto& h : collected) {
+                if (h.name.equalsIgnoreCase(name)) h.value = value;
+            }
+        }
+
+        bool redirect = code == 301 || code == 302 || code == 303 || code == 307 || code == 308;
+        if (!redirect || followRedirects == HTTPC_DISABLE_FOLLOW_REDIRECTS || location.length() == 0) {
+            return code;
+        }
+
+        String next = location;
+        if (next.startsWith("/")) next = "http://" + host + ":" + String(port) + next;
+        String headers = requestHeaders;
+        if (!begin(next)) return code;
+        requestHeaders = headers;
+    }
+    return HTTPC_ERROR_CONNECTION_LOST;
+}
+
+String HTTPClient::getString() {
+    String body;
+    uint8_t buf[512];
+    unsigned long start = millis();
+    while ((contentLength < 0 || (int)body.length() < contentLength) && millis() - start < timeoutMs) {
+        int n = client.read(buf, sizeof(buf));
+        if (n > 0) {
+            body.concat((const char*)buf, n);
+        } else if (!client.connected()) {
+            break;
+        } else {
+            delay(1);
+        }
+    }
+    return body;
+}
+
+String HTTPClient::errorToString(int error) {
+    switch (error) {
+    case HTTPC_ERROR_CONNECTION_REFUSED: return "connection refused";
+    case HTTPC_ERROR_SEND_HEADER_FAILED: return "send header failed";
+    case HTTPC_ERROR_NOT_CONNECTED: return "not connected";
+    case HTTPC_ERROR_CONNECTION_LOST: return "connection lost";
+    case HTTPC_ERROR_NO_HTTP_SERVER: return "no HTTP server";
+    case HTTPC_ERROR_READ_TIMEOUT: return "read Timeout";
+    default: return String();
+    }
+}
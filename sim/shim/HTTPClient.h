@@ -0,0 +1,90 @@
+#ifndef SIM_HTTPCLIENT_H
+#define SIM_HTTPCLIENT_H
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+#include <vector>
+
+// Plain-HTTP subset of the ESP32 HTTPClient: one request per begin(), the
+// body is left on the stream for the caller. https:// URLs fail to connect.
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+#define HTTPC_DEFAULT_TCP_TIMEOUT 5000
+
+typedef enum {
+    HTTPC_DISABLE_FOLLOW_REDIRECTS,
+    HTTPC_STRICT_FOLLOW_REDIRECTS,
+    HTTPC_FORCE_FOLLOW_REDIRECTS
+} followRedirects_t;
+
+typedef enum {
+    HTTP_CODE_OK = 200,
+    HTTP_CODE_PARTIAL_CONTENT = 206,
+    HTTP_CODE_MOVED_PERMANENTLY = 301,
+    HTTP_CODE_FOUND = 302,
+    HTTP_CODE_SEE_OTHER = 303,
+    HTTP_CODE_NOT_MODIFIED = 304,
+    HTTP_CODE_TEMPORARY_REDIRECT = 307,
+    HTTP_CODE_PERMANENT_REDIRECT = 308,
+    HTTP_CODE_NOT_FOUND = 404,
+    HTTP_CODE_RANGE_NOT_SATISFIABLE = 416
+} t_http_codes;
+
+class HTTPClient {
+public:
+    HTTPClient();
+    ~HTTPClient() { end(); }
+
+    bool begin(const String& url);
+    void end();
+
+    void setTimeout(uint16_t ms) { timeoutMs = ms; }
+    void setConnectTimeout(int32_t ms) { connectTimeoutMs = ms; }
+    void setFollowRedirects(followRedirects_t follow) { followRedirects = follow; }
+    void setUserAgent(const String& agent) { userAgent = agent; }
+    void useHTTP10(bool use) { http10 = use; }  // no chunked bodies
+    void addHeader(const String& name, const String& value);
+    void collectHeaders(const char* keys[], const size_t count);
+    String header(const char* name);
+    bool hasHeader(const char* name);
+
+    int GET();
+    int getSize() { return contentLength; }
+    String getLocation() { return location; }
+    String getString();
+    WiFiClient& getStream() { return client; }
+    WiFiClient* getStreamPtr() { return &client; }
+
+    static String errorToString(int error);
+
+private:
+    struct Header {
+        String name;
+        String value;
+    };
+
+    WiFiClient client;
+    String host;
+    uint16_t port;
+    String path;
+    bool secure;
+    bool http10;
+    uint16_t timeoutMs;
+    int32_t connectTimeoutMs;
+    followRedirects_t followRedirects;
+    String userAgent;
+    String requestHeaders;
+    std::vector<Header> collected;
+    int contentLength;
+    String location;
+
+    bool readLine(String& line);
+};
+
+#endif
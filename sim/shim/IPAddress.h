@@ -0,0 +1,32 @@
+#ifndef SIM_IPADDRESS_H
+#define SIM_IPADDRESS_H
+
+#include "Arduino.h"
+
+class IPAddress : public Printable {
+public:
+    IPAddress() : addr{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr{a, b, c, d} {}
+    // Network byte order, as on the ESP32
+    IPAddress(uint32_t address) { memcpy(addr, &address, 4); }
+
+    operator uint32_t() const {
+        uint32_t v;
+        memcpy(&v, addr, 4);
+        return v;
+    }
+    bool operator==(const IPAddress& other) const { return memcmp(addr, other.addr, 4) == 0; }
+    bool operator!=(const IPAddress& other) const { return !(*this == other); }
+    uint8_t operator[](int index) const { return addr[index]; }
+    uint8_t& operator[](int index) { return addr[index]; }
+
+    bool fromString(const char* str);
+    bool fromString(const String& str) { return fromString(str.c_str()); }
+    String toString() const;
+    size_t printTo(Print& p) const override { return p.print(toString()); }
+
+private:
+    uint8_t addr[4];
+};
+
+#endif
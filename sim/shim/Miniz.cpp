@@ -0,0 +1,41 @@
+#include "rom/miniz.h"
+
+tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* pIn_buf_next, size_t* pIn_buf_size,
+                              uint8_t* pOut_buf_start, uint8_t* pOut_buf_next, size_t* pOut_buf_size,
+                              const uint32_t decomp_flags) {
+    (void)pOut_buf_start;
+    if (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) return TINFL_STATUS_BAD_PARAM;
+
+    // tinfl_init() only clears m_state; the zlib stream is reused
+    if (r->m_state == 0) {
+        if (r->open) {
+            inflateReset(&r->stream);
+        } else {
+            r->stream = z_stream();
+            if (inflateInit2(&r->stream, -15) != Z_OK) return TINFL_STATUS_FAILED;
+            r->open = true;
+        }
+        r->m_state = 1;
+    }
+
+    z_stream& z = r->stream;
+    z.next_in = (Bytef*)pIn_buf_next;
+    z.avail_in = *pIn_buf_size;
+    z.next_out = pOut_buf_next;
+    z.avail_out = *pOut_buf_size;
+    int rc = inflate(&z, Z_NO_FLUSH);
+    *pIn_buf_size -= z.avail_in;
+    *pOut_buf_size -= z.avail_out;
+
+    // ROM tinfl allocates nothing, so callers just free() the decompressor;
+    // release zlib's state once the stream is over. One abandoned midway
+    // leaks it (host only).
+    if (rc == Z_STREAM_END || (rc != Z_OK && rc != Z_BUF_ERROR)) {
+        inflateEnd(&z);
+        r->open = false;
+        return rc == Z_STREAM_END ? TINFL_STATUS_DONE : TINFL_STATUS_FAILED;
+    }
+    if (z.avail_out == 0) return TINFL_STATUS_HAS_MORE_OUTPUT;
+    if (!(decomp_flags & TINFL_FLAG_HAS_MORE_INPUT)) return TINFL_STATUS_FAILED;
+    return TINFL_STATUS_NEEDS_MORE_INPUT;
+}
@@ -0,0 +1,101 @@
+#include "Preferences.h"
+#include "SimControl.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+typedef std::map<std::string, std::vector<uint8_t>> Namespace;
+
+static std::map<std::string, Namespace> store;
+static std::mutex storeMutex;
+
+bool Preferences::begin(const char* name, bool ro, const char* partitionLabel) {
+    (void)partitionLabel;
+    if (!name || strlen(name) > 15) return false;
+    ns = name;
+    readOnly = ro;
+    opened = true;
+    return true;
+}
+
+bool Preferences::clear() {
+    if (!opened || readOnly) return false;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    store[ns.c_str()].clear();
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (!opened || readOnly) return false;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    return store[ns.c_str()].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    if (!opened) return false;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    const Namespace& space = store[ns.c_str()];
+    return space.find(key) != space.end();
+}
+
+size_t Preferences::putRaw(const char* key, const void* value, size_t len) {
+    // NVS keys are limited to 15 characters
+    if (!opened || readOnly || !key || strlen(key) > 15) return 0;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    const uint8_t* bytes = (const uint8_t*)value;
+    store[ns.c_str()][key].assign(bytes, bytes + len);
+    return len;
+}
+
+bool Preferences::lookup(const char* key, void* out, size_t len) {
+    if (!opened || !key) return false;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    const Namespace& space = store[ns.c_str()];
+    auto it = space.find(key);
+    if (it == space.end() || it->second.size() != len) return false;
+    memcpy(out, it->second.data(), len);
+    return true;
+}
+
+size_t Preferences::putString(const char* key, const char* value) {
+    // Stored with the terminator, as NVS does
+    return putRaw(key, value, strlen(value) + 1) > 0 ? strlen(value) : 0;
+}
+
+String Preferences::getString(const char* key, const String& def) {
+    if (!opened || !key) return def;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    const Namespace& space = store[ns.c_str()];
+    auto it = space.find(key);
+    if (it == space.end() || it->second.empty()) return def;
+    return String((const char*)it->second.data());
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    if (!opened || !key) return 0;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    const Namespace& space = store[ns.c_str()];
+    auto it = space.find(key);
+    return it == space.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+    if (!opened || !key) return 0;
+    std::lock_guard<std::mutex> lock(storeMutex);
+    const Namespace& space = store[ns.c_str()];
+    auto it = space.find(key);
+    if (it == space.end() || it->second.size() > maxLen) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+namespace sim {
+
+void nvsClear() {
+    std::lock_guard<std::mutex> lock(storeMutex);
+    store.clear();
+}
+
+}  // namespace sim
@@ -0,0 +1,65 @@
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+#include "Arduino.h"
+
+// NVS stand-in: process-wide, in-memory key-value store keyed by namespace
+class Preferences {
+public:
+    Preferences() : opened(false), readOnly(false) {}
+
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+    void end() { opened = false; }
+
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putChar(const char* key, int8_t value) { return putRaw(key, &value, sizeof(value)); }
+    size_t putUChar(const char* key, uint8_t value) { return putRaw(key, &value, sizeof(value)); }
+    size_t putShort(const char* key, int16_t value) { return putRaw(key, &value, sizeof(value)); }
+    size_t putUShort(const char* key, uint16_t value) { return putRaw(key, &value, sizeof(value)); }
+    size_t putInt(const char* key, int32_t value) { return putRaw(key, &value, sizeof(value)); }
+    size_t putUInt(const char* key, uint32_t value) { return putRaw(key, &value, sizeof(value)); }
+    size_t putLong(const char* key, int32_t value) { return putRaw(key, &value, sizeof(value)); }
+    size_t putULong(const char* key, uint32_t value) { return putRaw(key, &value, sizeof(value)); }
+    size_t putLong64(const char* key, int64_t value) { return putRaw(key, &value, sizeof(value)); }
+    size_t putULong64(const char* key, uint64_t value) { return putRaw(key, &value, sizeof(value)); }
+    size_t putFloat(const char* key, float value) { return putRaw(key, &value, sizeof(value)); }
+    size_t putBool(const char* key, bool value) { return putUChar(key, value ? 1 : 0); }
+    size_t putString(const char* key, const char* value);
+    size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+    size_t putBytes(const char* key, const void* value, size_t len) { return putRaw(key, value, len); }
+
+    int8_t getChar(const char* key, int8_t def = 0) { return getRaw(key, def); }
+    uint8_t getUChar(const char* key, uint8_t def = 0) { return getRaw(key, def); }
+    int16_t getShort(const char* key, int16_t def = 0) { return getRaw(key, def); }
+    uint16_t getUShort(const char* key, uint16_t def = 0) { return getRaw(key, def); }
+    int32_t getInt(const char* key, int32_t def = 0) { return getRaw(key, def); }
+    uint32_t getUInt(const char* key, uint32_t def = 0) { return getRaw(key, def); }
+    int32_t getLong(const char* key, int32_t def = 0) { return getRaw(key, def); }
+    uint32_t getULong(const char* key, uint32_t def = 0) { return getRaw(key, def); }
+    int64_t getLong64(const char* key, int64_t def = 0) { return getRaw(key, def); }
+    uint64_t getULong64(const char* key, uint64_t def = 0) { return getRaw(key, def); }
+    float getFloat(const char* key, float def = NAN) { return getRaw(key, def); }
+    bool getBool(const char* key, bool def = false) { return getUChar(key, def ? 1 : 0) != 0; }
+    String getString(const char* key, const String& def = String());
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buf, size_t maxLen);
+
+private:
+    String ns;
+    bool opened;
+    bool readOnly;
+
+    size_t putRaw(const char* key, const void* value, size_t len);
+    bool lookup(const char* key, void* out, size_t len);
+
+    template <typename T>
+    T getRaw(const char* key, T def) {
+        T value;
+        return lookup(key, &value, sizeof(value)) ? value : def;
+    }
+};
+
+#endif
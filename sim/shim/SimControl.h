@@ -0,0 +1,78 @@
+#ifndef SIM_CONTROL_H
+#define SIM_CONTROL_H
+
+/**
+ * Knobs and counters of the host simulator. Only benchmark drivers use
+ * this header; the modules never see it.
+ */
+
+#include <stdint.h>
+
+namespace sim {
+
+// Serial output (off keeps benchmarks quiet)
+void setSerialEnabled(bool enabled);
+
+// Clock: millis()/micros() run `factor` times faster than real time and
+// delay() sleeps that much shorter. Set before starting any threads.
+void setTimeScale(uint32_t factor);
+
+// HTTP: 0 binds an ephemeral port, read it back with boundHttpPort()
+void setHttpPort(uint16_t port);
+uint16_t boundHttpPort();
+
+// WiFi: WiFi.begin() to WL_CONNECTED is scan + associate + DHCP. Directed
+// connects (channel + BSSID) skip the scan, static IP configs skip DHCP.
+void setAssociateDelayMs(uint32_t ms);
+void setScanDelayMs(uint32_t ms);
+void setDhcpDelayMs(uint32_t ms);
+
+// Access points (default: "SimNet" on channel 6 at -55 dBm). Hidden ones
+// show up in scans without an SSID. Moving an AP breaks cached connects.
+int addAccessPoint(const char* ssid, int32_t channel, int32_t rssi, bool hidden = false);
+void moveAccessPoint(int index, int32_t channel);
+void setAccessPointUp(int index, bool up);  // down drops stations joined to it
+void setAccessPointDownFor(int index, uint32_t ms);  // back up on its own
+void setAccessPointRssi(int index, int32_t rssi);
+void clearAccessPoints();
+
+// Simulated audio pipeline
+struct AudioStats {
+    uint64_t frames;        // decoded frames written to the output
+    uint32_t underruns;     // times the output buffer ran dry while playing
+    uint64_t starvedUs;     // total silence caused by underruns
+    uint32_t maxGapUs;      // longest gap between two copy() calls
+};
+
+void setDecodeCostUs(uint32_t us);      // busy CPU time per decoded frame
+void setOutputBufferMs(uint32_t ms);    // I2S DMA + decoder buffering
+void setStreamOpenMs(uint32_t ms);      // TCP + HTTP handshake of a stream
+AudioStats audioStats();
+void resetAudioStats();
+
+// UDP: each received datagram is dropped with the given probability, per
+// socket, like Wi-Fi multicast loss at one station
+struct UdpStats {
+    uint64_t sent;          // datagrams sent
+    uint64_t delivered;     // datagrams handed to a socket's reader
+    uint64_t dropped;
+};
+
+void setUdpLoss(double probability);
+UdpStats udpStats();
+void resetUdpStats();
+
+// OTA partition: Update.write() blocks this long per 4 KB sector it fills
+// (erase + program on the device; default 0)
+void setFlashSectorUs(uint32_t us);
+
+// Preferences backing store
+void nvsClear();
+
+// LittleFS backing directory (default: $SIM_FS_DIR or /tmp/gridbeacon-fs-<pid>)
+void setFsRoot(const char* path);
+void fsFormat();
+
+}  // namespace sim
+
+#endif
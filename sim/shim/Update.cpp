@@ -0,0 +1,68 @@
+#include "Update.h"
+#include "SimControl.h"
+
+UpdateClass Update;
+
+static const size_t SECTOR_SIZE = 4096;
+static uint32_t sectorUs = 0;
+
+bool UpdateClass::begin(size_t size, int command) {
+    (void)command;
+    if (running) return false;
+    running = true;
+    expected = size;
+    error = UPDATE_ERROR_OK;
+    written.clear();
+    if (size != UPDATE_SIZE_UNKNOWN) written.reserve(size);
+    return true;
+}
+
+size_t UpdateClass::write(uint8_t* data, size_t len) {
+    if (!running || hasError()) return 0;
+    if (expected != UPDATE_SIZE_UNKNOWN && written.size() + len > expected) {
+        error = UPDATE_ERROR_SIZE;
+        return 0;
+    }
+    size_t sectorsBefore = written.size() / SECTOR_SIZE;
+    written.insert(written.end(), data, data + len);
+    size_t sectors = written.size() / SECTOR_SIZE - sectorsBefore;
+    if (sectors > 0 && sectorUs > 0) delayMicroseconds(sectors * sectorUs);
+    return len;
+}
+
+bool UpdateClass::end(bool evenIfRemaining) {
+    if (!running || hasError()) return false;
+    if (!evenIfRemaining && expected != UPDATE_SIZE_UNKNOWN && written.size() != expected) {
+        error = UPDATE_ERROR_SIZE;
+        return false;
+    }
+    running = false;
+    installed = written;
+    hasImage = true;
+    written.clear();
+    return true;
+}
+
+void UpdateClass::abort() {
+    running = false;
+    error = UPDATE_ERROR_ABORT;
+    written.clear();
+}
+
+namespace sim {
+
+void setFlashSectorUs(uint32_t us) {
+    sectorUs = us;
+}
+
+}  // namespace sim
+
+const char* UpdateClass::errorString() {
+    switch (error) {
+        case UPDATE_ERROR_OK: return "No Error";
+        case UPDATE_ERROR_WRITE: return "Flash Write Failed";
+        case UPDATE_ERROR_SIZE: return "Bad Size Given";
+        case UPDATE_ERROR_ABORT: return "Update Aborted";
+    }
+    return "Unknown Error";
+}
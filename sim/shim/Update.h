@@ -0,0 +1,45 @@
+#ifndef SIM_UPDATE_H
+#define SIM_UPDATE_H
+
+#include "Arduino.h"
+#include <vector>
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+#define U_FLASH 0
+
+#define UPDATE_ERROR_OK 0
+#define UPDATE_ERROR_WRITE 1
+#define UPDATE_ERROR_SIZE 4
+#define UPDATE_ERROR_ABORT 8
+
+// Writes into RAM instead of the OTA partition. end(true) "switches the
+// boot partition": the image stays readable through image()/committed().
+class UpdateClass {
+public:
+    bool begin(size_t size = UPDATE_SIZE_UNKNOWN, int command = U_FLASH);
+    size_t write(uint8_t* data, size_t len);
+    bool end(bool evenIfRemaining = false);
+    void abort();
+
+    bool isRunning() { return running; }
+    bool hasError() { return error != UPDATE_ERROR_OK; }
+    uint8_t getError() { return error; }
+    const char* errorString();
+    size_t progress() { return written.size(); }
+    size_t remaining() { return expected == UPDATE_SIZE_UNKNOWN ? 0 : expected - written.size(); }
+
+    const std::vector<uint8_t>& image() { return installed; }
+    bool committed() { return hasImage; }
+
+private:
+    bool running = false;
+    size_t expected = 0;
+    uint8_t error = UPDATE_ERROR_OK;
+    std::vector<uint8_t> written;
+    std::vector<uint8_t> installed;
+    bool hasImage = false;
+};
+
+extern UpdateClass Update;
+
+#endif
@@ -0,0 +1,348 @@
+#include "WebServer.h"
+#include "SimControl.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int httpPortOverride = -1;
+static uint16_t lastBoundPort = 0;
+
+static const char* reasonPhrase(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 206: return "Partial Content";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 416: return "Range Not Satisfiable";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        case 507: return "Insufficient Storage";
+        default: return "";
+    }
+}
+
+static String urlDecode(const String& text) {
+    String decoded;
+    decoded.reserve(text.length());
+    for (unsigned int i = 0; i < text.length(); i++) {
+        char c = text[i];
+        if (c == '+') {
+            decoded += ' ';
+        } else if (c == '%' && i + 2 < text.length()) {
+            char hex[3] = { text[i + 1], text[i + 2], 0 };
+            decoded += (char)strtol(hex, nullptr, 16);
+            i += 2;
+        } else {
+            decoded += c;
+        }
+    }
+    return decoded;
+}
+
+WebServer::WebServer(int port)
+    : port(port), listenFd(-1), clientFd(-1), clientAccepted(0),
+      currentMethod(HTTP_ANY), contentLengthOverride(CONTENT_LENGTH_NOT_SET), chunked(false) {}
+
+WebServer::~WebServer() {
+    stop();
+}
+
+void WebServer::begin() {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) return;
+
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(httpPortOverride >= 0 ? httpPortOverride : port);
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 64) < 0) {
+        fprintf(stderr, "[sim] WebServer: cannot listen: %s\n", strerror(errno));
+        close(listenFd);
+        listenFd = -1;
+        return;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd, (struct sockaddr*)&addr, &len);
+    lastBoundPort = ntohs(addr.sin_port);
+}
+
+void WebServer::stop() {
+    closeClient();
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+void WebServer::on(const String& uri, HTTPMethod method, THandlerFunction handler) {
+    routes.push_back({ uri, method, handler });
+}
+
+void WebServer::handleClient() {
+    if (listenFd < 0) return;
+
+    if (clientFd < 0) {
+        clientFd = accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0) return;
+        int one = 1;
+        setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        clientAccepted = millis();
+    }
+
+    // Like the ESP32 server, wait across calls until the request starts arriving
+    struct pollfd pfd = { clientFd, POLLIN, 0 };
+    if (poll(&pfd, 1, 0) <= 0) {
+        if (millis() - clientAccepted > HTTP_MAX_DATA_WAIT) closeClient();
+        return;
+    }
+
+    if (readRequest()) {
+        dispatch();
+    }
+    closeClient();
+}
+
+bool WebServer::readRequest() {
+    currentArgs.clear();
+    currentHeaders.clear();
+    responseHeaders.clear();
+    contentLengthOverride = CONTENT_LENGTH_NOT_SET;
+    chunked = false;
+
+    struct timeval tv = { HTTP_MAX_DATA_WAIT / 1000, 0 };
+    setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::string raw;
+    char buf[1024];
+    size_t headerEnd = std::string::npos;
+    while (headerEnd == std::string::npos) {
+        ssize_t n = recv(clientFd, buf, sizeof(buf), 0);
+        if (n <= 0) return false;
+        raw.append(buf, n);
+        headerEnd = raw.find("\r\n\r\n");
+        if (raw.size() > 16384) return false;
+    }
+
+    std::string head = raw.substr(0, headerEnd);
+    std::string body = raw.substr(headerEnd + 4);
+
+    size_t lineEnd = head.find("\r\n");
+    std::string requestLine = head.substr(0, lineEnd);
+    size_t sp1 = requestLine.find(' ');
+    size_t sp2 = requestLine.find(' ', sp1 + 1);
+    if (sp1 == std::string::npos || sp2 == std::string::npos) return false;
+
+    std::string methodStr = requestLine.substr(0, sp1);
+    std::string target = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+    currentMethod = methodStr == "GET" ? HTTP_GET
+                  : methodStr == "POST" ? HTTP_POST
+                  : methodStr == "HEAD" ? HTTP_HEAD
+                  : methodStr == "PUT" ? HTTP_PUT
+                  : methodStr == "DELETE" ? HTTP_DELETE
+                  : methodStr == "PATCH" ? HTTP_PATCH
+                  : methodStr == "OPTIONS" ? HTTP_OPTIONS : HTTP_ANY;
+
+    String query;
+    size_t q = target.find('?');
+    currentUri = String(target.substr(0, q).c_str());
+    if (q != std::string::npos) query = String(target.substr(q + 1).c_str());
+
+    size_t contentLength = 0;
+    String contentType;
+    size_t pos = lineEnd == std::string::npos ? head.size() : lineEnd + 2;
+    while (pos < head.size()) {
+        size_t end = head.find("\r\n", pos);
+        if (end == std::string::npos) end = head.size();
+        std::string line = head.substr(pos, end - pos);
+        pos = end + 2;
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        String name(line.substr(0, colon).c_str());
+        String value(line.substr(colon + 1).c_str());
+        value.trim();
+
+        if (name.equalsIgnoreCase("Content-Length")) contentLength = value.toInt();
+        if (name.equalsIgnoreCase("Content-Type")) contentType = value;
+        for (const auto& key : headerKeys) {
+            if (name.equalsIgnoreCase(key)) currentHeaders.push_back({ key, value });
+        }
+    }
+
+    while (body.size() < contentLength) {
+        ssize_t n = recv(clientFd, buf, sizeof(buf), 0);
+        if (n <= 0) return false;
+        body.append(buf, n);
+    }
+    body.resize(contentLength);
+
+    if (contentType.startsWith("application/x-www-form-urlencoded")) {
+        if (query.length() > 0 && body.size() > 0) query += "&";
+        query += body.c_str();
+        parseArguments(query);
+    } else {
+        parseArguments(query);
+        if (contentLength > 0) currentArgs.push_back({ "plain", String(body.c_str()) });
+    }
+    return true;
+}
+
+void WebServer::parseArguments(const String& data) {
+    int start = 0;
+    while (start < (int)data.length()) {
+        int end = data.indexOf('&', start);
+        if (end < 0) end = data.length();
+        String pair = data.substring(start, end);
+        int eq = pair.indexOf('=');
+        if (pair.length() > 0) {
+            if (eq < 0) {
+                currentArgs.push_back({ urlDecode(pair), "" });
+            } else {
+                currentArgs.push_back({ urlDecode(pair.substring(0, eq)), urlDecode(pair.substring(eq + 1)) });
+            }
+        }
+        start = end + 1;
+    }
+}
+
+void WebServer::dispatch() {
+    for (const auto& route : routes) {
+        if (route.uri == currentUri && (route.method == HTTP_ANY || route.method == currentMethod)) {
+            route.handler();
+            return;
+        }
+    }
+    if (notFoundHandler) {
+        notFoundHandler();
+    } else {
+        send(404, "text/plain", "Not found");
+    }
+}
+
+void WebServer::closeClient() {
+    if (clientFd >= 0) {
+        close(clientFd);
+        clientFd = -1;
+    }
+}
+
+String WebServer::arg(const String& name) {
+    for (const auto& a : currentArgs) {
+        if (a.key == name) return a.value;
+    }
+    return String();
+}
+
+String WebServer::arg(int i) {
+    return i >= 0 && i < (int)currentArgs.size() ? currentArgs[i].value : String();
+}
+
+String WebServer::argName(int i) {
+    return i >= 0 && i < (int)currentArgs.size() ? currentArgs[i].key : String();
+}
+
+bool WebServer::hasArg(const String& name) {
+    for (const auto& a : currentArgs) {
+        if (a.key == name) return true;
+    }
+    return false;
+}
+
+void WebServer::collectHeaders(const char* keys[], const size_t count) {
+    headerKeys.clear();
+    for (size_t i = 0; i < count; i++) headerKeys.push_back(keys[i]);
+}
+
+String WebServer::header(const String& name) {
+    for (const auto& h : currentHeaders) {
+        if (h.key.equalsIgnoreCase(name)) return h.value;
+    }
+    return String();
+}
+
+bool WebServer::hasHeader(const String& name) {
+    for (const auto& h : currentHeaders) {
+        if (h.key.equalsIgnoreCase(name)) return true;
+    }
+    return false;
+}
+
+void WebServer::sendHeader(const String& name, const String& value, bool first) {
+    if (first) {
+        responseHeaders.insert(responseHeaders.begin(), { name, value });
+    } else {
+        responseHeaders.push_back({ name, value });
+    }
+}
+
+void WebServer::send(int code, const char* contentType, const String& content) {
+    if (clientFd < 0) return;
+
+    String head = "HTTP/1.1 " + String(code) + " " + reasonPhrase(code) + "\r\n";
+    head += "Content-Type: " + String(contentType ? contentType : "text/html") + "\r\n";
+    if (contentLengthOverride == CONTENT_LENGTH_UNKNOWN) {
+        head += "Transfer-Encoding: chunked\r\n";
+        chunked = true;
+    } else {
+        size_t length = contentLengthOverride == CONTENT_LENGTH_NOT_SET ? content.length() : contentLengthOverride;
+        head += "Content-Length: " + String((unsigned long)length) + "\r\n";
+    }
+    for (const auto& h : responseHeaders) {
+        head += h.key + ": " + h.value + "\r\n";
+    }
+    head += "Connection: close\r\n\r\n";
+    responseHeaders.clear();
+
+    sendAll(head.c_str(), head.length());
+    if (content.length() > 0) sendContent(content);
+}
+
+void WebServer::sendContent(const char* content, size_t size) {
+    if (clientFd < 0) return;
+    if (!chunked) {
+        sendAll(content, size);
+        return;
+    }
+    char prefix[16];
+    int n = snprintf(prefix, sizeof(prefix), "%zx\r\n", size);
+    sendAll(prefix, n);
+    sendAll(content, size);
+    sendAll("\r\n", 2);
+    if (size == 0) chunked = false;
+}
+
+void WebServer::sendAll(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::send(clientFd, data, size, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        data += n;
+        size -= n;
+    }
+}
+
+namespace sim {
+
+void setHttpPort(uint16_t port) {
+    httpPortOverride = port;
+}
+
+uint16_t boundHttpPort() {
+    return lastBoundPort;
+}
+
+}  // namespace sim
@@ -0,0 +1,98 @@
+#ifndef SIM_WEBSERVER_H
+#define SIM_WEBSERVER_H
+
+#include "Arduino.h"
+#include <functional>
+#include <vector>
+
+typedef enum {
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS
+} HTTPMethod;
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+#define HTTP_MAX_DATA_WAIT 5000
+
+// Same model as the ESP32 WebServer: one client per handleClient() call,
+// handled to completion on the calling (loop) thread, then closed.
+class WebServer {
+public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    WebServer(int port = 80);
+    ~WebServer();
+
+    void begin();
+    void stop();
+    void handleClient();
+
+    void on(const String& uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+    void on(const String& uri, HTTPMethod method, THandlerFunction handler);
+    void onNotFound(THandlerFunction handler) { notFoundHandler = handler; }
+
+    String uri() { return currentUri; }
+    HTTPMethod method() { return currentMethod; }
+
+    String arg(const String& name);
+    String arg(int i);
+    String argName(int i);
+    int args() { return currentArgs.size(); }
+    bool hasArg(const String& name);
+
+    void collectHeaders(const char* headerKeys[], const size_t headerKeysCount);
+    String header(const String& name);
+    bool hasHeader(const String& name);
+
+    void sendHeader(const String& name, const String& value, bool first = false);
+    void setContentLength(const size_t contentLength) { contentLengthOverride = contentLength; }
+    void send(int code, const char* contentType = nullptr, const String& content = String(""));
+    void send(int code, const String& contentType, const String& content) {
+        send(code, contentType.c_str(), content);
+    }
+    void send_P(int code, PGM_P contentType, PGM_P content) { send(code, contentType, String(content)); }
+    void sendContent(const String& content) { sendContent(content.c_str(), content.length()); }
+    void sendContent(const char* content, size_t size);
+
+private:
+    struct Route {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction handler;
+    };
+    struct KeyValue {
+        String key;
+        String value;
+    };
+
+    int port;
+    int listenFd;
+    int clientFd;
+    unsigned long clientAccepted;
+
+    std::vector<Route> routes;
+    THandlerFunction notFoundHandler;
+    std::vector<String> headerKeys;
+
+    String currentUri;
+    HTTPMethod currentMethod;
+    std::vector<KeyValue> currentArgs;
+    std::vector<KeyValue> currentHeaders;
+    std::vector<KeyValue> responseHeaders;
+    size_t contentLengthOverride;
+    bool chunked;
+
+    bool readRequest();
+    void dispatch();
+    void closeClient();
+    void sendAll(const char* data, size_t size);
+    void parseArguments(const String& data);
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "WiFi.h"
+#include "SimControl.h"
+
+#include <arpa/inet.h>
+#include <vector>
+
+WiFiClass WiFi;
+
+static uint32_t associateDelayMs = 300;
+static uint32_t scanDelayMs = 0;
+static uint32_t dhcpDelayMs = 0;
+
+struct AccessPoint {
+    String ssid;
+    int32_t channel;
+    int32_t rssi;
+    bool hidden;   // scans list it with an empty SSID
+    bool up;
+    unsigned long downUntil;  // millis() of a scheduled return, 0 = none
+    uint8_t bssid[6];
+};
+
+static std::vector<AccessPoint> accessPoints = {
+    { "SimNet", 6, -55, false, true, 0, { 0x24, 0x0A, 0xC4, 0x5A, 0x11, 0x01 } },
+};
+
+static bool isUp(const AccessPoint& ap) {
+    return ap.up && (ap.downUntil == 0 || (long)(millis() - ap.downUntil) >= 0);
+}
+
+// Strongest AP that would accept a join for ssid
+static int findAccessPoint(const String& ssid) {
+    int best = -1;
+    for (size_t i = 0; i < accessPoints.size(); i++) {
+        if (accessPoints[i].ssid != ssid || !isUp(accessPoints[i])) continue;
+        if (best < 0 || accessPoints[i].rssi > accessPoints[best].rssi) best = i;
+    }
+    return best;
+}
+
+bool IPAddress::fromString(const char* str) {
+    struct in_addr parsed;
+    if (!str || inet_pton(AF_INET, str, &parsed) != 1) return false;
+    memcpy(addr, &parsed.s_addr, 4);
+    return true;
+}
+
+String IPAddress::toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", addr[0], addr[1], addr[2], addr[3]);
+    return String(buf);
+}
+
+bool WiFiClass::mode(wifi_mode_t m) {
+    currentMode = m;
+    return true;
+}
+
+wifi_mode_t WiFiClass::getMode() {
+    return currentMode;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel,
+                             const uint8_t* bssid, bool connect) {
+    (void)passphrase;
+    currentSSID = ssid ? ssid : "";
+    beginTime = millis();
+    joining = connect && currentSSID.length() > 0;
+
+    bool directed = channel != 0 && bssid != nullptr;
+    currentAp = -1;
+    if (directed) {
+        for (size_t i = 0; i < accessPoints.size(); i++) {
+            const AccessPoint& ap = accessPoints[i];
+            if (isUp(ap) && ap.channel == channel && memcmp(ap.bssid, bssid, 6) == 0 && ap.ssid == currentSSID) {
+                currentAp = i;
+            }
+        }
+    } else {
+        currentAp = findAccessPoint(currentSSID);
+    }
+    missing = currentAp < 0;  // nothing answers the probes
+    connectDelay = (directed ? 0 : scanDelayMs) + associateDelayMs + (staticIP != IPAddress() ? 0 : dhcpDelayMs);
+    return status();
+}
+
+bool WiFiClass::config(IPAddress localIP, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2) {
+    (void)gateway;
+    (void)subnet;
+    (void)dns1;
+    (void)dns2;
+    staticIP = localIP;  // 0.0.0.0 re-enables DHCP
+    return true;
+}
+
+bool WiFiClass::disconnect(bool wifioff) {
+    joining = false;
+    if (wifioff) currentMode = WIFI_OFF;
+    return true;
+}
+
+wl_status_t WiFiClass::status() {
+    if (!joining || !(currentMode & WIFI_STA)) return WL_DISCONNECTED;
+    if (missing && autoReconnect && findAccessPoint(currentSSID) >= 0) {
+        // The driver keeps retrying a failed join on its own
+        currentAp = findAccessPoint(currentSSID);
+        missing = false;
+        beginTime = millis();
+        connectDelay = scanDelayMs + associateDelayMs + (staticIP != IPAddress() ? 0 : dhcpDelayMs);
+    }
+    if (missing) return millis() - beginTime >= associateDelayMs ? WL_NO_SSID_AVAIL : WL_DISCONNECTED;
+    if (!isUp(accessPoints[currentAp])) {
+        joining = false;  // stays down until the next begin()
+        return WL_CONNECTION_LOST;
+    }
+    return millis() - beginTime >= connectDelay ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+IPAddress WiFiClass::localIP() {
+    return status() == WL_CONNECTED ? IPAddress(127, 0, 0, 1) : IPAddress();
+}
+
+IPAddress WiFiClass::gatewayIP() {
+    return status() == WL_CONNECTED ? IPAddress(127, 0, 0, 1) : IPAddress();
+}
+
+IPAddress WiFiClass::subnetMask() {
+    return status() == WL_CONNECTED ? IPAddress(255, 0, 0, 0) : IPAddress();
+}
+
+IPAddress WiFiClass::dnsIP(uint8_t index) {
+    return status() == WL_CONNECTED && index == 0 ? IPAddress(127, 0, 0, 1) : IPAddress();
+}
+
+uint8_t* WiFiClass::BSSID() {
+    static uint8_t none[6] = { 0 };
+    return status() == WL_CONNECTED ? accessPoints[currentAp].bssid : none;
+}
+
+int32_t WiFiClass::channel() {
+    return status() == WL_CONNECTED ? accessPoints[currentAp].channel : 0;
+}
+
+int8_t WiFiClass::RSSI() {
+    return status() == WL_CONNECTED ? accessPoints[currentAp].rssi : 0;
+}
+
+// Active scan over all channels; the AP list is sampled when it finishes
+int16_t WiFiClass::scanNetworks(bool async, bool showHidden) {
+    scanHidden = showHidden;
+    scanStart = millis();
+    scanRunning = true;
+    scanDone = false;
+    if (async) return WIFI_SCAN_RUNNING;
+
+    delay(scanDelayMs);
+    return scanComplete();
+}
+
+int16_t WiFiClass::scanComplete() {
+    if (scanRunning) {
+        if (millis() - scanStart < scanDelayMs) return WIFI_SCAN_RUNNING;
+        scanRunning = false;
+        scanDone = true;
+        scanCount = 0;
+        for (const AccessPoint& ap : accessPoints) {
+            if (isUp(ap) && (!ap.hidden || scanHidden)) scanCount++;
+        }
+    }
+    return scanDone ? scanCount : WIFI_SCAN_FAILED;
+}
+
+static const AccessPoint* scanResult(uint8_t index, bool showHidden) {
+    for (const AccessPoint& ap : accessPoints) {
+        if (!isUp(ap) || (ap.hidden && !showHidden)) continue;
+        if (index-- == 0) return &ap;
+    }
+    return nullptr;
+}
+
+String WiFiClass::SSID(uint8_t index) {
+    const AccessPoint* ap = index < scanCount ? scanResult(index, scanHidden) : nullptr;
+    return ap && !ap->hidden ? ap->ssid : String();
+}
+
+int32_t WiFiClass::RSSI(uint8_t index) {
+    const AccessPoint* ap = index < scanCount ? scanResult(index, scanHidden) : nullptr;
+    return ap ? ap->rssi : 0;
+}
+
+uint8_t* WiFiClass::BSSID(uint8_t index) {
+    const AccessPoint* ap = index < scanCount ? scanResult(index, scanHidden) : nullptr;
+    return ap ? (uint8_t*)ap->bssid : nullptr;
+}
+
+int32_t WiFiClass::channel(uint8_t index) {
+    const AccessPoint* ap = index < scanCount ? scanResult(index, scanHidden) : nullptr;
+    return ap ? ap->channel : 0;
+}
+
+void WiFiClass::scanDelete() {
+    scanCount = 0;
+    scanDone = false;
+}
+
+String WiFiClass::SSID() {
+    return status() == WL_CONNECTED ? currentSSID : String();
+}
+
+bool WiFiClass::softAP(const char* ssid, const char* passphrase) {
+    (void)ssid;
+    (void)passphrase;
+    return (currentMode & WIFI_AP) != 0;
+}
+
+IPAddress WiFiClass::softAPIP() {
+    return IPAddress(192, 168, 4, 1);
+}
+
+namespace sim {
+
+void setAssociateDelayMs(uint32_t ms) {
+    associateDelayMs = ms;
+}
+
+void setScanDelayMs(uint32_t ms) {
+    scanDelayMs = ms;
+}
+
+void setDhcpDelayMs(uint32_t ms) {
+    dhcpDelayMs = ms;
+}
+
+int addAccessPoint(const char* ssid, int32_t channel, int32_t rssi, bool hidden) {
+    AccessPoint ap = { ssid, channel, rssi, hidden, true, 0, { 0x24, 0x0A, 0xC4, 0x5A, 0x11, 0 } };
+    ap.bssid[5] = accessPoints.size() + 1;
+    accessPoints.push_back(ap);
+    return accessPoints.size() - 1;
+}
+
+void moveAccessPoint(int index, int32_t channel) {
+    accessPoints[index].channel = channel;
+}
+
+void setAccessPointUp(int index, bool up) {
+    accessPoints[index].up = up;
+}
+
+void setAccessPointDownFor(int index, uint32_t ms) {
+    accessPoints[index].downUntil = millis() + ms;
+}
+
+void setAccessPointRssi(int index, int32_t rssi) {
+    accessPoints[index].rssi = rssi;
+}
+
+void clearAccessPoints() {
+    accessPoints.clear();
+}
+
+}  // namespace sim
@@ -0,0 +1,88 @@
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA = 1,
+    WIFI_AP = 2,
+    WIFI_AP_STA = 3
+} wifi_mode_t;
+
+#define WIFI_SCAN_RUNNING -1
+#define WIFI_SCAN_FAILED -2
+
+// Station joins any SSID broadcast by the simulated access points (by default
+// one, "SimNet"). A connect takes the scan, associate and DHCP delays; a
+// directed connect (BSSID + channel) skips the scan and a static config skips
+// DHCP. The host's loopback interface stands in for the LAN.
+class WiFiClass {
+public:
+    bool mode(wifi_mode_t m);
+    wifi_mode_t getMode();
+
+    wl_status_t begin(const char* ssid, const char* passphrase = nullptr,
+                      int32_t channel = 0, const uint8_t* bssid = nullptr, bool connect = true);
+    bool config(IPAddress localIP, IPAddress gateway, IPAddress subnet,
+                IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+    bool disconnect(bool wifioff = false);
+    wl_status_t status();
+    bool isConnected() { return status() == WL_CONNECTED; }
+
+    IPAddress localIP();
+    IPAddress gatewayIP();
+    IPAddress subnetMask();
+    IPAddress dnsIP(uint8_t index = 0);
+    String SSID();
+    uint8_t* BSSID();
+    int32_t channel();
+    int8_t RSSI();
+    bool setAutoReconnect(bool enable) {
+        autoReconnect = enable;
+        return true;
+    }
+
+    // async: returns WIFI_SCAN_RUNNING, poll scanComplete()
+    int16_t scanNetworks(bool async = false, bool showHidden = false);
+    int16_t scanComplete();
+    String SSID(uint8_t index);
+    int32_t RSSI(uint8_t index);
+    uint8_t* BSSID(uint8_t index);
+    int32_t channel(uint8_t index);
+    void scanDelete();
+
+    bool softAP(const char* ssid, const char* passphrase = nullptr);
+    IPAddress softAPIP();
+
+private:
+    wifi_mode_t currentMode = WIFI_OFF;
+    String currentSSID;
+    int currentAp = -1;
+    int scanCount = 0;
+    bool scanHidden = false;
+    bool scanRunning = false;
+    bool scanDone = false;
+    unsigned long scanStart = 0;
+    unsigned long beginTime = 0;
+    unsigned long connectDelay = 0;
+    bool joining = false;
+    bool missing = false;
+    bool autoReconnect = true;
+    IPAddress staticIP;
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,147 @@
+#include "WiFiClient.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+struct WiFiClient::Socket {
+    int fd = -1;
+    bool eof = false;
+    uint8_t buf[2048];
+    size_t len = 0;
+    size_t pos = 0;
+
+    ~Socket() {
+        if (fd >= 0) close(fd);
+    }
+};
+
+WiFiClient::WiFiClient() : timeoutMs(3000) {}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeout) {
+    stop();
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* res = nullptr;
+    if (getaddrinfo(host, std::to_string(port).c_str(), &hints, &res) != 0 || !res) return 0;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        freeaddrinfo(res);
+        return 0;
+    }
+
+    // Non-blocking connect so the timeout applies
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int rc = ::connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return 0;
+    }
+    if (rc < 0) {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        int err = 0;
+        socklen_t errLen = sizeof(err);
+        if (poll(&pfd, 1, timeout) != 1 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen) < 0 || err != 0) {
+            close(fd);
+            return 0;
+        }
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sock = std::make_shared<Socket>();
+    sock->fd = fd;
+    return 1;
+}
+
+void WiFiClient::stop() {
+    sock.reset();
+}
+
+uint8_t WiFiClient::connected() {
+    if (!sock) return 0;
+    if (sock->pos < sock->len) return 1;
+    fill(false);
+    return !sock->eof || sock->pos < sock->len;
+}
+
+size_t WiFiClient::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* data, size_t size) {
+    if (!sock) return 0;
+
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t n = send(sock->fd, data + sent, size - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd pfd = { sock->fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, timeoutMs) != 1) break;
+        } else {
+            break;
+        }
+    }
+    return sent;
+}
+
+// Pulls more bytes into the buffer; with wait, blocks up to the timeout
+bool WiFiClient::fill(bool wait) {
+    if (!sock || sock->eof) return false;
+    if (sock->pos < sock->len) return true;
+
+    if (wait) {
+        struct pollfd pfd = { sock->fd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeoutMs) != 1) return false;
+    }
+
+    ssize_t n = recv(sock->fd, sock->buf, sizeof(sock->buf), MSG_DONTWAIT);
+    if (n > 0) {
+        sock->len = n;
+        sock->pos = 0;
+        return true;
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        sock->eof = true;
+    }
+    return false;
+}
+
+int WiFiClient::available() {
+    if (!sock) return 0;
+    fill(false);
+    return sock->len - sock->pos;
+}
+
+int WiFiClient::read() {
+    if (!fill(false)) return -1;
+    return sock->buf[sock->pos++];
+}
+
+int WiFiClient::read(uint8_t* out, size_t size) {
+    if (!fill(false)) return -1;
+    size_t n = sock->len - sock->pos;
+    if (n > size) n = size;
+    memcpy(out, sock->buf + sock->pos, n);
+    sock->pos += n;
+    return n;
+}
+
+int WiFiClient::peek() {
+    if (!fill(false)) return -1;
+    return sock->buf[sock->pos];
+}
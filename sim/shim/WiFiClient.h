@@ -0,0 +1,35 @@
+#ifndef SIM_WIFICLIENT_H
+#define SIM_WIFICLIENT_H
+
+#include "Arduino.h"
+#include <memory>
+
+// Blocking TCP client on a real socket. Copies share the connection, like
+// the ESP32 WiFiClient.
+class WiFiClient : public Stream {
+public:
+    WiFiClient();
+
+    int connect(const char* host, uint16_t port, int32_t timeoutMs = 3000);
+    void stop();
+    uint8_t connected();
+    operator bool() { return connected(); }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size);
+    int peek() override;
+    void setTimeout(uint32_t ms) { timeoutMs = ms; }
+
+private:
+    struct Socket;
+    std::shared_ptr<Socket> sock;
+    uint32_t timeoutMs;
+
+    bool fill(bool wait);
+};
+
+#endif
@@ -0,0 +1,188 @@
+#include "WiFiUdp.h"
+#include "SimControl.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <random>
+
+static std::mutex lossMutex;
+static std::mt19937 lossRng(5353);
+static double lossProbability = 0;
+static sim::UdpStats udpCounters;
+
+namespace sim {
+
+void setUdpLoss(double probability) {
+    std::lock_guard<std::mutex> lock(lossMutex);
+    lossProbability = probability;
+}
+
+UdpStats udpStats() {
+    std::lock_guard<std::mutex> lock(lossMutex);
+    return udpCounters;
+}
+
+void resetUdpStats() {
+    std::lock_guard<std::mutex> lock(lossMutex);
+    udpCounters = {};
+}
+
+}  // namespace sim
+
+// True if the datagram just read counts as lost
+static bool dropReceived() {
+    std::lock_guard<std::mutex> lock(lossMutex);
+    if (lossProbability > 0 && std::uniform_real_distribution<double>(0, 1)(lossRng) < lossProbability) {
+        udpCounters.dropped++;
+        return true;
+    }
+    udpCounters.delivered++;
+    return false;
+}
+
+WiFiUDP::WiFiUDP()
+    : fd(-1), localPort(0), txPort(0), txLen(0), rxLen(0), rxPos(0), remotePortNum(0) {}
+
+WiFiUDP::~WiFiUDP() {
+    stop();
+}
+
+bool WiFiUDP::openSocket(uint16_t port) {
+    stop();
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return false;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        stop();
+        return false;
+    }
+
+    localPort = port;
+    return true;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+    return openSocket(port) ? 1 : 0;
+}
+
+uint8_t WiFiUDP::beginMulticast(IPAddress multicast, uint16_t port) {
+    if (!openSocket(port)) return 0;
+
+    struct ip_mreq mreq = {};
+    mreq.imr_multiaddr.s_addr = (uint32_t)multicast;
+    mreq.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        stop();
+        return 0;
+    }
+
+    struct in_addr iface = {};
+    iface.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface));
+    unsigned char loop = 1;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    multicastAddr = multicast;
+    return 1;
+}
+
+void WiFiUDP::stop() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    rxLen = rxPos = 0;
+    txLen = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+    txAddr = ip;
+    txPort = port;
+    txLen = 0;
+    return 1;
+}
+
+int WiFiUDP::beginMulticastPacket() {
+    return beginPacket(multicastAddr, localPort);
+}
+
+int WiFiUDP::endPacket() {
+    if (fd < 0) return 0;
+
+    struct sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = (uint32_t)txAddr;
+    to.sin_port = htons(txPort);
+    ssize_t sent = sendto(fd, txBuf, txLen, 0, (struct sockaddr*)&to, sizeof(to));
+    txLen = 0;
+    if (sent >= 0) {
+        std::lock_guard<std::mutex> lock(lossMutex);
+        udpCounters.sent++;
+    }
+    return sent >= 0 ? 1 : 0;
+}
+
+size_t WiFiUDP::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size) {
+    size_t n = std::min(size, sizeof(txBuf) - txLen);
+    memcpy(txBuf + txLen, buffer, n);
+    txLen += n;
+    return n;
+}
+
+int WiFiUDP::parsePacket() {
+    rxLen = rxPos = 0;
+    if (fd < 0) return 0;
+
+    struct sockaddr_in from = {};
+    socklen_t fromLen = sizeof(from);
+    ssize_t n;
+    do {
+        fromLen = sizeof(from);
+        n = recvfrom(fd, rxBuf, sizeof(rxBuf), 0, (struct sockaddr*)&from, &fromLen);
+        if (n <= 0) return 0;
+    } while (dropReceived());
+
+    rxLen = n;
+    remoteAddr = IPAddress((uint32_t)from.sin_addr.s_addr);
+    remotePortNum = ntohs(from.sin_port);
+    return n;
+}
+
+int WiFiUDP::available() {
+    return rxLen - rxPos;
+}
+
+int WiFiUDP::read() {
+    return rxPos < rxLen ? rxBuf[rxPos++] : -1;
+}
+
+int WiFiUDP::read(unsigned char* buffer, size_t len) {
+    size_t n = std::min(len, rxLen - rxPos);
+    memcpy(buffer, rxBuf + rxPos, n);
+    rxPos += n;
+    return n;
+}
+
+int WiFiUDP::peek() {
+    return rxPos < rxLen ? rxBuf[rxPos] : -1;
+}
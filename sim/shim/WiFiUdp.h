@@ -0,0 +1,55 @@
+#ifndef SIM_WIFIUDP_H
+#define SIM_WIFIUDP_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+
+// Real UDP socket; multicast is bound to the loopback interface so that
+// several simulated devices on one host hear each other.
+class WiFiUDP : public Stream {
+public:
+    WiFiUDP();
+    ~WiFiUDP();
+
+    uint8_t begin(uint16_t port);
+    uint8_t beginMulticast(IPAddress multicast, uint16_t port);
+    void stop();
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    int beginMulticastPacket();
+    int endPacket();
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    int parsePacket();
+    int available() override;
+    int read() override;
+    int read(unsigned char* buffer, size_t len);
+    int read(char* buffer, size_t len) { return read((unsigned char*)buffer, len); }
+    int peek() override;
+    void flush() { rxLen = rxPos = 0; }
+
+    IPAddress remoteIP() { return remoteAddr; }
+    uint16_t remotePort() { return remotePortNum; }
+
+private:
+    int fd;
+    uint16_t localPort;
+    IPAddress multicastAddr;
+
+    IPAddress txAddr;
+    uint16_t txPort;
+    uint8_t txBuf[1460];
+    size_t txLen;
+
+    uint8_t rxBuf[1460];
+    size_t rxLen;
+    size_t rxPos;
+    IPAddress remoteAddr;
+    uint16_t remotePortNum;
+
+    bool openSocket(uint16_t port);
+};
+
+#endif